@@ -1,28 +1,53 @@
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <vulkan/vulkan_core.h>
 
 #include "displays/display.h"
 #include "displays/sdl/sdl_display.h"
+#include "frame_stats.h"
 #include "gpu/gpu_device.h"
 #include "gpu/vk_config.h"
 #include "log.h"
 #include "network/network_client.h"
 #include "network/network_server.h"
 #include "renderer/renderer.h"
+#include "renderer/viewport_atlas.h"
 #include "world/world.h"
 
 typedef struct cli_state_s
 {
   /* params */
   int is_headless;
+  int is_offscreen;
+  int is_stereo;
+  int has_depth;
+  int atlas_camera_num;
+  int star_num;
+  const char *mesh_pack_path;
   int is_client;
+  int frame_limit;
+  struct sdl_display_config display_config;
+  int frames_in_flight;
+  enum renderer_latency_mode latency_mode;
+  const char *frame_stats_path;
+  const char *capture_path;
+  float gpu_budget_ms;
+  enum gpu_debug_level debug_level;
+  enum debug_vertex_format debug_vertex_format;
+  int debug_vertex_pulling;
 
   /* objects */
+  frame_stats_t *frame_stats;
   sdl_display_t *dp;
   gpu_device_t *gpu;
+  camera_t *offscreen_camera;
+  viewport_atlas_t *atlas;
+  camera_t **cameras;
+  int camera_num;
   renderer_t *ren;
+  frame_capture_t *capture;
   world_t *w;
 
   union
@@ -35,14 +60,142 @@ typedef struct cli_state_s
 void
 print_help (const char *argv0)
 {
-  fprintf (stderr, "Usage\n  %s [--headless] [--server]", argv0);
+  fprintf (stderr,
+           "Usage\n  %s [--headless] [--offscreen] [--stereo] "
+           "[--frames <num>] [--present-mode <mode>]\n"
+           "  [--swapchain-images <num>] [--frames-in-flight <num>] "
+           "[--low-latency]\n"
+           "  [--frame-stats <path>] [--atlas-cameras <num>] "
+           "[--stars <num>]\n"
+           "  [--mesh-pack <path>] [--capture <path>] [--gpu-budget <ms>] "
+           "[--gpu-debug <level>]\n"
+           "  [--debug-vertices <format>] [--vertex-pulling] [--depth] "
+           "[--server]\n"
+           "\n"
+           "  --headless       Run without a window or renderer.\n"
+           "  --offscreen      Run without a window, but still render into "
+           "offscreen images.\n"
+           "  --stereo         Render offscreen in stereo with multiview.\n"
+           "  --atlas-cameras <num>\n"
+           "                   Also render this many small offscreen cameras "
+           "into an atlas.\n"
+           "  --mesh-pack <path>\n"
+           "                   Load a pack from mdo-mesh-cook and place each "
+           "mesh in a\n"
+           "                   row in front of the camera.\n"
+           "  --stars <num>    Scatter this many random stars around the "
+           "origin.\n"
+           "  --frames <num>   Exit after rendering this many frames.\n"
+           "  --present-mode <mode>\n"
+           "                   One of fifo (default), mailbox, or immediate.\n"
+           "  --swapchain-images <num>\n"
+           "                   How many swapchain images to ask for.\n"
+           "  --frames-in-flight <num>\n"
+           "                   How many frames the GPU may queue up.\n"
+           "  --low-latency    Wait for the previous frame before sampling "
+           "input.\n"
+           "  --frame-stats <path>\n"
+           "                   Time frame stages and dump them on exit, "
+           "as JSON\n"
+           "                   if the path ends in .json, or CSV otherwise.\n"
+           "  --capture <path>\n"
+           "                   Write every rendered frame to a .y4m stream, "
+           "numbered\n"
+           "                   .png files, or numbered raw .rgba files.\n"
+           "  --gpu-budget <ms>\n"
+           "                   Scale the resolution down to keep GPU frame "
+           "times\n"
+           "                   within this budget.\n"
+           "  --gpu-debug <level>\n"
+           "                   One of off, errors, validation, or "
+           "gpu-assisted.\n"
+           "                   Defaults to off in release builds and "
+           "validation\n"
+           "                   otherwise.\n"
+           "  --debug-vertices <format>\n"
+           "                   Pack debug lines as float (default), half, "
+           "or snorm16.\n"
+           "  --vertex-pulling Fetch debug vertices from a storage buffer in "
+           "the\n"
+           "                   vertex shader.\n"
+           "  --depth          Depth-test debug draws and stars with a "
+           "reversed-Z\n"
+           "                   depth buffer.\n"
+           "  --server         Host a server instead of connecting to one.\n",
+           argv0);
+}
+
+static int
+parse_present_mode (const char *arg, enum viewport_present_mode *mode)
+{
+  if (strcmp (arg, "fifo") == 0)
+    *mode = VIEWPORT_PRESENT_MODE_FIFO;
+  else if (strcmp (arg, "mailbox") == 0)
+    *mode = VIEWPORT_PRESENT_MODE_MAILBOX;
+  else if (strcmp (arg, "immediate") == 0)
+    *mode = VIEWPORT_PRESENT_MODE_IMMEDIATE;
+  else
+    return 1;
+
+  return 0;
+}
+
+static int
+parse_debug_level (const char *arg, enum gpu_debug_level *level)
+{
+  if (strcmp (arg, "off") == 0)
+    *level = GPU_DEBUG_LEVEL_OFF;
+  else if (strcmp (arg, "errors") == 0)
+    *level = GPU_DEBUG_LEVEL_ERRORS;
+  else if (strcmp (arg, "validation") == 0)
+    *level = GPU_DEBUG_LEVEL_VALIDATION;
+  else if (strcmp (arg, "gpu-assisted") == 0)
+    *level = GPU_DEBUG_LEVEL_GPU_ASSISTED;
+  else
+    return 1;
+
+  return 0;
+}
+
+static int
+parse_debug_vertex_format (const char *arg, enum debug_vertex_format *format)
+{
+  if (strcmp (arg, "float") == 0)
+    *format = DEBUG_VERTEX_FORMAT_FLOAT;
+  else if (strcmp (arg, "half") == 0)
+    *format = DEBUG_VERTEX_FORMAT_HALF;
+  else if (strcmp (arg, "snorm16") == 0)
+    *format = DEBUG_VERTEX_FORMAT_SNORM16;
+  else
+    return 1;
+
+  return 0;
 }
 
 int
 parse_cli_args (cli_state_t *cli, int argc, const char *argv[])
 {
   cli->is_headless = 0;
+  cli->is_offscreen = 0;
+  cli->is_stereo = 0;
+  cli->atlas_camera_num = 0;
+  cli->star_num = 0;
+  cli->mesh_pack_path = NULL;
   cli->is_client = 1;
+  cli->frame_limit = 0;
+  cli->display_config.present_mode = VIEWPORT_PRESENT_MODE_FIFO;
+  cli->display_config.image_num = 0;
+  cli->display_config.dynamic_resolution = 0;
+  cli->display_config.has_depth = 0;
+  cli->frames_in_flight = 0;
+  cli->latency_mode = RENDERER_LATENCY_THROUGHPUT;
+  cli->frame_stats_path = NULL;
+  cli->capture_path = NULL;
+  cli->gpu_budget_ms = 0.0f;
+  cli->debug_level = GPU_DEBUG_LEVEL_DEFAULT;
+  cli->debug_vertex_format = DEBUG_VERTEX_FORMAT_FLOAT;
+  cli->debug_vertex_pulling = 0;
+  cli->has_depth = 0;
 
   for (int i = 1; i < argc; i++)
     {
@@ -52,6 +205,89 @@ parse_cli_args (cli_state_t *cli, int argc, const char *argv[])
         {
           cli->is_headless = 1;
         }
+      else if (strcmp (arg, "--offscreen") == 0)
+        {
+          cli->is_offscreen = 1;
+        }
+      else if (strcmp (arg, "--stereo") == 0)
+        {
+          cli->is_stereo = 1;
+        }
+      else if (strcmp (arg, "--atlas-cameras") == 0 && i + 1 < argc)
+        {
+          cli->atlas_camera_num = atoi (argv[++i]);
+        }
+      else if (strcmp (arg, "--mesh-pack") == 0 && i + 1 < argc)
+        {
+          cli->mesh_pack_path = argv[++i];
+        }
+      else if (strcmp (arg, "--stars") == 0 && i + 1 < argc)
+        {
+          cli->star_num = atoi (argv[++i]);
+        }
+      else if (strcmp (arg, "--frames") == 0 && i + 1 < argc)
+        {
+          cli->frame_limit = atoi (argv[++i]);
+        }
+      else if (strcmp (arg, "--present-mode") == 0 && i + 1 < argc)
+        {
+          if (parse_present_mode (argv[++i],
+                                  &cli->display_config.present_mode))
+            {
+              print_help (argv[0]);
+              return 1;
+            }
+        }
+      else if (strcmp (arg, "--swapchain-images") == 0 && i + 1 < argc)
+        {
+          cli->display_config.image_num = atoi (argv[++i]);
+        }
+      else if (strcmp (arg, "--frames-in-flight") == 0 && i + 1 < argc)
+        {
+          cli->frames_in_flight = atoi (argv[++i]);
+        }
+      else if (strcmp (arg, "--low-latency") == 0)
+        {
+          cli->latency_mode = RENDERER_LATENCY_LOW;
+        }
+      else if (strcmp (arg, "--frame-stats") == 0 && i + 1 < argc)
+        {
+          cli->frame_stats_path = argv[++i];
+        }
+      else if (strcmp (arg, "--capture") == 0 && i + 1 < argc)
+        {
+          cli->capture_path = argv[++i];
+        }
+      else if (strcmp (arg, "--gpu-budget") == 0 && i + 1 < argc)
+        {
+          cli->gpu_budget_ms = atof (argv[++i]);
+        }
+      else if (strcmp (arg, "--gpu-debug") == 0 && i + 1 < argc)
+        {
+          if (parse_debug_level (argv[++i], &cli->debug_level))
+            {
+              print_help (argv[0]);
+              return 1;
+            }
+        }
+      else if (strcmp (arg, "--debug-vertices") == 0 && i + 1 < argc)
+        {
+          if (parse_debug_vertex_format (argv[++i],
+                                         &cli->debug_vertex_format))
+            {
+              print_help (argv[0]);
+              return 1;
+            }
+        }
+      else if (strcmp (arg, "--vertex-pulling") == 0)
+        {
+          cli->debug_vertex_pulling = 1;
+        }
+      else if (strcmp (arg, "--depth") == 0)
+        {
+          cli->has_depth = 1;
+          cli->display_config.has_depth = 1;
+        }
       else if (strcmp (arg, "--server") == 0)
         {
           cli->is_client = 0;
@@ -63,15 +299,35 @@ parse_cli_args (cli_state_t *cli, int argc, const char *argv[])
         }
     }
 
+  cli->display_config.dynamic_resolution = cli->gpu_budget_ms > 0.0f;
+
+  if (cli->is_stereo && !cli->is_offscreen)
+    {
+      LOG_ERR ("stereo rendering is only supported offscreen");
+      return 1;
+    }
+
+  if (cli->atlas_camera_num > 0 && (!cli->is_offscreen || cli->is_stereo))
+    {
+      LOG_ERR ("atlas cameras are only supported offscreen in mono");
+      return 1;
+    }
+
   return 0;
 }
 
 void
 init_cli_state (cli_state_t *cli)
 {
+  cli->frame_stats = NULL;
   cli->dp = NULL;
   cli->gpu = NULL;
+  cli->offscreen_camera = NULL;
+  cli->atlas = NULL;
+  cli->cameras = NULL;
+  cli->camera_num = 0;
   cli->ren = NULL;
+  cli->capture = NULL;
   cli->w = NULL;
 
   if (cli->is_client)
@@ -80,13 +336,299 @@ init_cli_state (cli_state_t *cli)
     cli->network.server = NULL;
 }
 
+static void
+offscreen_vk_config (struct vk_config_t *config)
+{
+  config->min_api_version = VK_API_VERSION_1_2;
+  config->max_api_version = VK_API_VERSION_1_2;
+  config->instance_extensions = "";
+  config->device_extensions = "";
+  config->optional_device_extensions = "";
+  config->physical_device = VK_NULL_HANDLE;
+  config->device_override = NULL;
+  config->create_surface = NULL;
+  config->surface_userdata = NULL;
+  config->debug_level = GPU_DEBUG_LEVEL_DEFAULT;
+}
+
+static int
+create_offscreen_camera (cli_state_t *cli)
+{
+  struct viewport_config vp_config = {
+    .gpu = cli->gpu,
+    .type = VIEWPORT_TYPE_OFFSCREEN,
+    .width = 800,
+    .height = 600,
+    .dynamic_resolution = cli->gpu_budget_ms > 0.0f,
+
+    .sub = {
+      .offscreen = {
+        .image_num = 0,
+        .readback = 0,
+      },
+    },
+  };
+
+  struct camera_config cam_config = {
+    .gpu = cli->gpu,
+    .viewport_configs = &vp_config,
+    .viewport_num = 1,
+    .mode = cli->is_stereo ? CAMERA_MODE_STEREO : CAMERA_MODE_MONO,
+    .eye_separation = 0.064,
+    .has_depth = cli->has_depth,
+  };
+
+  return camera_new (&cli->offscreen_camera, &cam_config);
+}
+
+#define STAR_SHELL_INNER 100.0f
+#define STAR_SHELL_OUTER 900.0f
+
+static float
+random_float (float min, float max)
+{
+  return min + (max - min) * ((float)rand () / RAND_MAX);
+}
+
+/* fills a shell around the origin, inside the far plane */
+static int
+create_stars (cli_state_t *cli)
+{
+  star_instance_t *stars = malloc (cli->star_num * sizeof (star_instance_t));
+  if (!stars)
+    {
+      LOG_ERR ("failed to allocate %d stars", cli->star_num);
+      return 1;
+    }
+
+  /* the same field every run, so captures are comparable */
+  srand (1);
+
+  const float INNER_SQ = STAR_SHELL_INNER * STAR_SHELL_INNER;
+  const float OUTER_SQ = STAR_SHELL_OUTER * STAR_SHELL_OUTER;
+
+  for (int i = 0; i < cli->star_num; i++)
+    {
+      star_instance_t *star = &stars[i];
+
+      float distance_sq;
+      do
+        {
+          for (int j = 0; j < 3; j++)
+            star->position[j]
+                = random_float (-STAR_SHELL_OUTER, STAR_SHELL_OUTER);
+
+          distance_sq = star->position[0] * star->position[0]
+                        + star->position[1] * star->position[1]
+                        + star->position[2] * star->position[2];
+        }
+      while (distance_sq < INNER_SQ || distance_sq > OUTER_SQ);
+
+      star->radius = random_float (0.2f, 2.0f);
+
+      float warmth = random_float (0.0f, 1.0f);
+      star->color[0] = 0.6f + 0.4f * warmth;
+      star->color[1] = 0.7f + 0.2f * warmth;
+      star->color[2] = 1.0f - 0.4f * warmth;
+      star->padding = 0.0f;
+    }
+
+  int result = renderer_set_stars (cli->ren, stars, cli->star_num);
+  free (stars);
+  return result;
+}
+
+/* meshes are placed this far apart, this far in front of the origin */
+#define MESH_SPACING 2.0f
+#define MESH_DISTANCE 5.0f
+
+static int
+create_meshes (cli_state_t *cli)
+{
+  if (renderer_load_meshes (cli->ren, cli->mesh_pack_path))
+    return 1;
+
+  uint32_t mesh_num = renderer_get_mesh_num (cli->ren);
+  if (mesh_num == 0)
+    return 0;
+
+  mesh_instance_t *instances = calloc (mesh_num, sizeof (mesh_instance_t));
+  if (!instances)
+    {
+      LOG_ERR ("failed to allocate %u mesh instances", mesh_num);
+      return 1;
+    }
+
+  for (uint32_t i = 0; i < mesh_num; i++)
+    {
+      mesh_instance_t *instance = &instances[i];
+      instance->position[0] = MESH_SPACING * (i - (mesh_num - 1) * 0.5f);
+      instance->position[1] = 0.0f;
+      instance->position[2] = -MESH_DISTANCE;
+      instance->scale = 1.0f;
+      instance->color[0] = 0.8f;
+      instance->color[1] = 0.8f;
+      instance->color[2] = 0.8f;
+      instance->mesh = i;
+      instance->lod = 0;
+    }
+
+  int result = renderer_set_mesh_instances (cli->ren, instances, mesh_num);
+  free (instances);
+  return result;
+}
+
+#define ATLAS_SIZE 2048
+#define ATLAS_CAMERA_SIZE 128
+
+static int
+create_atlas_cameras (cli_state_t *cli)
+{
+  struct viewport_atlas_config atlas_config = {
+    .gpu = cli->gpu,
+    .width = ATLAS_SIZE,
+    .height = ATLAS_SIZE,
+    .image_num = 0,
+    .readback = 0,
+    .depth_format = camera_get_depth_format (cli->offscreen_camera),
+  };
+
+  VkRenderPass rp = camera_get_render_pass (cli->offscreen_camera);
+  if (viewport_atlas_new (&cli->atlas, rp, &atlas_config))
+    return 1;
+
+  /* the first camera is the main one */
+  cli->cameras = calloc (cli->atlas_camera_num + 1, sizeof (camera_t *));
+  cli->cameras[0] = cli->offscreen_camera;
+  cli->camera_num = 1;
+
+  struct viewport_config vp_config = {
+    .gpu = cli->gpu,
+    .type = VIEWPORT_TYPE_ATLAS,
+    .width = ATLAS_CAMERA_SIZE,
+    .height = ATLAS_CAMERA_SIZE,
+
+    .sub = {
+      .atlas = {
+        .atlas = cli->atlas,
+      },
+    },
+  };
+
+  /* matches the atlas's attachments, so its framebuffers fit our passes */
+  struct camera_config cam_config = {
+    .gpu = cli->gpu,
+    .viewport_configs = &vp_config,
+    .viewport_num = 1,
+    .has_depth = cli->has_depth,
+  };
+
+  for (int i = 0; i < cli->atlas_camera_num; i++)
+    {
+      if (camera_new (&cli->cameras[cli->camera_num], &cam_config))
+        return 1;
+
+      cli->camera_num++;
+    }
+
+  LOG_INF ("rendering %d cameras into a %dx%d atlas", cli->atlas_camera_num,
+           ATLAS_SIZE, ATLAS_SIZE);
+
+  return 0;
+}
+
+static camera_t *
+cli_camera (cli_state_t *cli)
+{
+  if (cli->is_offscreen)
+    return cli->offscreen_camera;
+  else
+    return sdl_display_get_camera (cli->dp);
+}
+
+static int
+has_suffix (const char *str, const char *suffix)
+{
+  size_t str_len = strlen (str);
+  size_t suffix_len = strlen (suffix);
+  return str_len >= suffix_len
+         && strcmp (str + str_len - suffix_len, suffix) == 0;
+}
+
+static int
+create_capture (cli_state_t *cli)
+{
+  const char *path = cli->capture_path;
+  size_t path_len = strlen (path);
+
+  struct frame_capture_config config = {
+    .gpu = cli->gpu,
+    .vp = camera_get_viewport (cli_camera (cli), 0),
+    .format = FRAME_CAPTURE_FORMAT_RAW,
+    .path = path,
+  };
+
+  /* numbered frames get their extensions appended, so strip it here */
+  char *prefix = malloc (path_len + 1);
+  strcpy (prefix, path);
+
+  if (has_suffix (path, ".y4m"))
+    config.format = FRAME_CAPTURE_FORMAT_Y4M;
+  else if (has_suffix (path, ".png"))
+    {
+      config.format = FRAME_CAPTURE_FORMAT_PNG;
+      prefix[path_len - 4] = '\0';
+      config.path = prefix;
+    }
+
+  int result = frame_capture_new (&cli->capture, &config);
+  free (prefix);
+
+  if (result)
+    return 1;
+
+  return renderer_add_capture (cli->ren, cli->capture);
+}
+
 int
 create_cli_objects (cli_state_t *cli)
 {
+  if (cli->frame_stats_path)
+    {
+      if (frame_stats_new (&cli->frame_stats, 0))
+        {
+          LOG_ERR ("failed to create frame stats");
+          return 1;
+        }
+    }
+
+  if (cli->is_offscreen)
+    {
+      struct vk_config_t vk_config;
+      offscreen_vk_config (&vk_config);
+      vk_config.debug_level = cli->debug_level;
+
+      if (gpu_device_new (&cli->gpu, &vk_config))
+        {
+          LOG_ERR ("failed to create GPU device");
+          return 1;
+        }
+
+      if (create_offscreen_camera (cli))
+        {
+          LOG_ERR ("failed to create offscreen camera");
+          return 1;
+        }
 
-  if (!cli->is_headless)
+      if (cli->atlas_camera_num > 0 && create_atlas_cameras (cli))
+        {
+          LOG_ERR ("failed to create atlas cameras");
+          return 1;
+        }
+    }
+  else if (!cli->is_headless)
     {
-      if (sdl_display_new (&cli->dp))
+      if (sdl_display_new (&cli->dp, &cli->display_config))
         {
           LOG_ERR ("failed to create SDL display");
           return 1;
@@ -94,6 +636,7 @@ create_cli_objects (cli_state_t *cli)
 
       struct vk_config_t vk_config;
       sdl_display_vk_config (cli->dp, &vk_config);
+      vk_config.debug_level = cli->debug_level;
 
       if (gpu_device_new (&cli->gpu, &vk_config))
         {
@@ -106,15 +649,51 @@ create_cli_objects (cli_state_t *cli)
           LOG_ERR ("failed to begin SDL session");
           return 1;
         }
+    }
 
-      VkRenderPass rp
-          = camera_get_render_pass (sdl_display_get_camera (cli->dp));
-      if (renderer_new (&cli->ren, cli->gpu, rp))
+  if (cli->gpu)
+    {
+      camera_t *camera = cli_camera (cli);
+      VkRenderPass rp = camera_get_render_pass (camera);
+      int is_stereo = camera_get_mode (camera) == CAMERA_MODE_STEREO;
+
+      struct renderer_config ren_config = {
+        .gpu = cli->gpu,
+        .rp = is_stereo ? VK_NULL_HANDLE : rp,
+        .multiview_rp = is_stereo ? rp : VK_NULL_HANDLE,
+        .frames_in_flight = cli->frames_in_flight,
+        .latency_mode = cli->latency_mode,
+        .frame_stats = cli->frame_stats,
+        .gpu_budget_ms = cli->gpu_budget_ms,
+        .debug_vertex_format = cli->debug_vertex_format,
+        .debug_vertex_pulling = cli->debug_vertex_pulling,
+        .has_depth = camera_get_depth_format (camera) != VK_FORMAT_UNDEFINED,
+      };
+
+      if (renderer_new (&cli->ren, &ren_config))
         {
           LOG_ERR ("failed to create renderer");
           return 1;
         }
 
+      if (cli->star_num > 0 && create_stars (cli))
+        {
+          LOG_ERR ("failed to create stars");
+          return 1;
+        }
+
+      if (cli->mesh_pack_path && create_meshes (cli))
+        {
+          LOG_ERR ("failed to create meshes");
+          return 1;
+        }
+
+      if (cli->capture_path && create_capture (cli))
+        {
+          LOG_ERR ("failed to create frame capture");
+          return 1;
+        }
+
       if (world_new (&cli->w, renderer_get_debug_draw_list (cli->ren)))
         {
           LOG_ERR ("failed to create world");
@@ -148,6 +727,30 @@ create_cli_objects (cli_state_t *cli)
   return 0;
 }
 
+static void
+dump_frame_stats (cli_state_t *cli)
+{
+  frame_stats_log_summary (cli->frame_stats);
+
+  FILE *file = fopen (cli->frame_stats_path, "w");
+  if (!file)
+    {
+      LOG_ERR ("failed to open %s", cli->frame_stats_path);
+      return;
+    }
+
+  int result;
+  if (has_suffix (cli->frame_stats_path, ".json"))
+    result = frame_stats_write_json (cli->frame_stats, file);
+  else
+    result = frame_stats_write_csv (cli->frame_stats, file);
+
+  if (fclose (file) || result)
+    LOG_ERR ("failed to write %s", cli->frame_stats_path);
+  else
+    LOG_INF ("wrote frame stats to %s", cli->frame_stats_path);
+}
+
 void
 cleanup_cli_state (cli_state_t *cli)
 {
@@ -165,9 +768,28 @@ cleanup_cli_state (cli_state_t *cli)
   if (cli->w)
     world_delete (cli->w);
 
+  if (cli->capture)
+    {
+      renderer_remove_capture (cli->ren, cli->capture);
+      frame_capture_delete (cli->capture);
+    }
+
   if (cli->ren)
     renderer_delete (cli->ren);
 
+  /* the first camera is deleted as the offscreen camera */
+  for (int i = 1; i < cli->camera_num; i++)
+    camera_delete (cli->cameras[i]);
+
+  if (cli->cameras)
+    free (cli->cameras);
+
+  if (cli->atlas)
+    viewport_atlas_delete (cli->atlas);
+
+  if (cli->offscreen_camera)
+    camera_delete (cli->offscreen_camera);
+
   if (cli->dp)
     {
       sdl_display_end_session (cli->dp);
@@ -176,6 +798,12 @@ cleanup_cli_state (cli_state_t *cli)
 
   if (cli->gpu)
     gpu_device_delete (cli->gpu);
+
+  if (cli->frame_stats)
+    {
+      dump_frame_stats (cli);
+      frame_stats_delete (cli->frame_stats);
+    }
 }
 
 static int g_interrupted = 0;
@@ -227,25 +855,66 @@ main (int argc, const char *argv[])
   if (signal (SIGINT, signal_handler) == SIG_ERR)
     LOG_WRN ("can't catch SIGINT");
 
+  int frame_num = 0;
   struct display_poll_t poll;
   poll.should_exit = 0;
   while (!poll.should_exit && !g_interrupted)
     {
-      if (!cli.is_headless)
+      if (cli.frame_stats)
+        frame_stats_begin_frame (cli.frame_stats);
+
+      /* in low-latency mode, this blocks until input is worth sampling */
+      if (cli.ren)
+        renderer_begin_frame (cli.ren);
+
+      if (cli.frame_stats)
+        {
+          frame_stats_mark_input (cli.frame_stats);
+          frame_stats_begin_stage (cli.frame_stats, FRAME_STAGE_POLL);
+        }
+
+      if (cli.is_offscreen)
+        {
+          /* no display to pace us, so step at a fixed rate */
+          poll.dt = 1.0 / 60.0;
+          poll.should_run = 1;
+          poll.should_render = 1;
+        }
+      else if (!cli.is_headless)
         {
           sdl_display_poll (cli.dp, &poll);
+        }
 
+      if (cli.frame_stats)
+        frame_stats_end_stage (cli.frame_stats, FRAME_STAGE_POLL);
+
+      if (cli.ren)
+        {
           if (poll.should_run)
             {
+              if (cli.frame_stats)
+                frame_stats_begin_stage (cli.frame_stats, FRAME_STAGE_SIM);
+
               world_step (cli.w, poll.dt);
+
+              if (cli.frame_stats)
+                frame_stats_end_stage (cli.frame_stats, FRAME_STAGE_SIM);
             }
 
           if (poll.should_render)
             {
-              camera_t *camera = sdl_display_camera (cli.dp);
+              camera_t *camera = cli_camera (&cli);
               temporary_debug_draw (renderer_get_debug_draw_list (cli.ren));
-              renderer_render_frame (cli.ren, &camera, 1);
+
+              if (cli.camera_num > 0)
+                renderer_render_frame (cli.ren, cli.cameras, cli.camera_num);
+              else
+                renderer_render_frame (cli.ren, &camera, 1);
+              frame_num++;
             }
+
+          if (cli.frame_limit > 0 && frame_num >= cli.frame_limit)
+            poll.should_exit = 1;
         }
 
       if (cli.is_client)
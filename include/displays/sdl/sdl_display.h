@@ -5,6 +5,7 @@
 
 #include "gpu/gpu_device.h"
 #include "renderer/camera.h"
+#include "renderer/viewport.h"
 
 /* forward declarations */
 struct display_poll_t;
@@ -14,11 +15,32 @@ struct vk_config_t;
  */
 typedef struct sdl_display_s sdl_display_t;
 
+struct sdl_display_config
+{
+  enum viewport_present_mode present_mode;
+
+  /**
+   * The number of swapchain images. If zero, a default is used.
+   */
+  int image_num;
+
+  /**
+   * Whether the window's viewport is rendered with dynamic resolution.
+   */
+  int dynamic_resolution;
+
+  /**
+   * Whether the window's render pass has a depth attachment.
+   */
+  int has_depth;
+};
+
 /** @function sdl_display_new
  * @param new_sdl_display
+ * @param config
  * @return Zero on success.
  */
-int sdl_display_new (sdl_display_t **);
+int sdl_display_new (sdl_display_t **, const struct sdl_display_config *);
 
 /** @function sdl_display_delete
  */
@@ -10,3 +10,11 @@
 #else
 #define MDO_EXPORT
 #endif
+
+/* for globals that must never be interposed by other libraries; DLLs only
+ * export what's marked, so Windows needs nothing */
+#if defined(__GNUC__)
+#define MDO_HIDDEN __attribute__ ((visibility ("hidden")))
+#else
+#define MDO_HIDDEN
+#endif
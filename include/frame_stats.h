@@ -0,0 +1,161 @@
+/** @file frame_stats.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint64_t */
+#include <stdio.h>  /* for FILE */
+
+/** @typedef frame_stats_t
+ * Keeps per-stage CPU timings and end-to-end latency for the most recent
+ * frames in a ring buffer, and summarizes them into percentiles. Not thread
+ * safe; every call must come from the thread driving the frame loop.
+ */
+typedef struct frame_stats_s frame_stats_t;
+
+enum frame_stage
+{
+  FRAME_STAGE_POLL,
+  FRAME_STAGE_SIM,
+
+  /**
+   * Blocked on the GPU before the frame could begin.
+   */
+  FRAME_STAGE_WAIT,
+
+  /**
+   * Acquiring cameras and swapchain images.
+   */
+  FRAME_STAGE_ACQUIRE,
+
+  /**
+   * Writing uniforms and building the frame's render graph.
+   */
+  FRAME_STAGE_EXTRACT,
+
+  FRAME_STAGE_RECORD,
+  FRAME_STAGE_SUBMIT,
+  FRAME_STAGE_PRESENT,
+  FRAME_STAGE_NUM,
+};
+
+enum frame_metric
+{
+  /* metrics below FRAME_STAGE_NUM are the stages themselves */
+
+  /**
+   * Time between the beginnings of a frame and the next one.
+   */
+  FRAME_METRIC_FRAME_TIME = FRAME_STAGE_NUM,
+
+  /**
+   * Time from input being sampled to the frame reaching the display.
+   */
+  FRAME_METRIC_LATENCY,
+
+  FRAME_METRIC_NUM,
+};
+
+/**
+ * Where a frame's latency was measured up to, from worst to best estimate.
+ */
+enum frame_latency_source
+{
+  FRAME_LATENCY_NONE,
+
+  /**
+   * The frame was seen to finish on the GPU. Presentation happens later.
+   */
+  FRAME_LATENCY_GPU_COMPLETE,
+
+  /**
+   * The frame was seen to be presented, with VK_KHR_present_wait.
+   */
+  FRAME_LATENCY_PRESENTED,
+};
+
+struct frame_stats_summary
+{
+  int sample_num;
+  double mean_ms;
+  double p50_ms;
+  double p95_ms;
+  double p99_ms;
+  double max_ms;
+};
+
+/** @function frame_stats_new
+ * @param new_stats
+ * @param capacity How many frames to keep. If zero, a default is used.
+ */
+int frame_stats_new (frame_stats_t **, int);
+
+/** @function frame_stats_delete
+ */
+void frame_stats_delete (frame_stats_t *);
+
+/** @function frame_stats_begin_frame
+ * Starts recording a frame, overwriting the oldest one if the ring is full.
+ * Input is assumed to be sampled now unless #frame_stats_mark_input says
+ * otherwise.
+ * @return the new frame's ID, counting up from one.
+ */
+uint64_t frame_stats_begin_frame (frame_stats_t *);
+
+/** @function frame_stats_current
+ * @return the current frame's ID, or zero if no frame has begun.
+ */
+uint64_t frame_stats_current (frame_stats_t *);
+
+/** @function frame_stats_mark_input
+ * Records that the current frame's input is being sampled now.
+ */
+void frame_stats_mark_input (frame_stats_t *);
+
+/** @function frame_stats_begin_stage
+ */
+void frame_stats_begin_stage (frame_stats_t *, enum frame_stage);
+
+/** @function frame_stats_end_stage
+ * Adds the time since the matching #frame_stats_begin_stage to the current
+ * frame, so a stage may be timed in several pieces.
+ */
+void frame_stats_end_stage (frame_stats_t *, enum frame_stage);
+
+/** @function frame_stats_mark_latency
+ * Ends a frame's latency measurement. Later calls only replace it with a
+ * better source. Does nothing if the frame has left the ring.
+ * @param stats
+ * @param frame
+ * @param time The uv_hrtime() the frame was seen to reach this point.
+ * @param source
+ */
+void frame_stats_mark_latency (frame_stats_t *, uint64_t, uint64_t,
+                               enum frame_latency_source);
+
+/** @function frame_stats_summarize
+ * @return the number of samples summarized.
+ */
+int frame_stats_summarize (frame_stats_t *, int, struct frame_stats_summary *);
+
+/** @function frame_stats_metric_name
+ */
+const char *frame_stats_metric_name (int);
+
+/** @function frame_stats_log_summary
+ */
+void frame_stats_log_summary (frame_stats_t *);
+
+/** @function frame_stats_write_csv
+ * Writes one row per recorded frame, oldest first. Unmeasured values are
+ * left empty.
+ * @return zero on success.
+ */
+int frame_stats_write_csv (frame_stats_t *, FILE *);
+
+/** @function frame_stats_write_json
+ * Writes every recorded frame, plus a summary of every metric. Unmeasured
+ * values are null.
+ * @return zero on success.
+ */
+int frame_stats_write_json (frame_stats_t *, FILE *);
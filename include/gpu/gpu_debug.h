@@ -0,0 +1,25 @@
+/** @file gpu_debug.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint64_t */
+
+#include "gpu/gpu_device.h"
+
+/** @function gpu_debug_begin_label
+ * Opens a named region in a command buffer, for captures and validation
+ * messages. Does nothing if the GPU debug level is off.
+ */
+void gpu_debug_begin_label (VkCommandBuffer, const char *);
+
+/** @function gpu_debug_end_label
+ * Closes the region opened by #gpu_debug_begin_label.
+ */
+void gpu_debug_end_label (VkCommandBuffer);
+
+/** @function gpu_debug_set_name
+ * Names a Vulkan object. Does nothing if the GPU debug level is off.
+ */
+void gpu_debug_set_name (gpu_device_t *, VkObjectType, uint64_t,
+                         const char *);
@@ -3,10 +3,13 @@
 
 #pragma once
 
-#include <vulkan/vulkan_core.h> /* for handle types */
+#include "gpu/gpu_dispatch.h" /* for handle types and entry points */
+#include "gpu/vk_config.h"     /* for enum gpu_debug_level */
 
 /* forward declarations */
 struct vk_config_t;
+struct gpu_timeline_s;
+struct gpu_memory_s;
 
 /** @typedef gpu_device_t
  */
@@ -20,6 +23,12 @@ int gpu_device_new (gpu_device_t **, const struct vk_config_t *);
  */
 void gpu_device_delete (gpu_device_t *);
 
+/** @function gpu_device_get_debug_level
+ * @return the debug level actually in use, which may be lower than the one
+ * asked for if the system lacks validation layers.
+ */
+enum gpu_debug_level gpu_device_get_debug_level (gpu_device_t *);
+
 /** @function gpu_device_get_instance
  */
 VkInstance gpu_device_get_instance (gpu_device_t *);
@@ -35,3 +44,71 @@ VkDevice gpu_device_get (gpu_device_t *);
 /** @function gpu_device_gfx_family
  */
 int gpu_device_gfx_family (gpu_device_t *);
+
+/** @function gpu_device_has_extension
+ * @return non-zero if the device extension was enabled.
+ */
+int gpu_device_has_extension (gpu_device_t *, const char *);
+
+/** @function gpu_device_has_present_wait
+ * @return non-zero if present IDs and vkWaitForPresentKHR can be used.
+ */
+int gpu_device_has_present_wait (gpu_device_t *);
+
+/** @function gpu_device_has_multiview
+ * @return non-zero if render passes may render to several views at once.
+ */
+int gpu_device_has_multiview (gpu_device_t *);
+
+/** @function gpu_device_has_multi_draw_indirect
+ * @return non-zero if one indirect draw call may issue several draws.
+ */
+int gpu_device_has_multi_draw_indirect (gpu_device_t *);
+
+/** @function gpu_device_has_draw_indirect_count
+ * @return non-zero if indirect draw counts may be read from a buffer.
+ */
+int gpu_device_has_draw_indirect_count (gpu_device_t *);
+
+/** @function gpu_device_has_draw_indirect_first_instance
+ * @return non-zero if indirect draws may start past the first instance.
+ */
+int gpu_device_has_draw_indirect_first_instance (gpu_device_t *);
+
+/** @function gpu_device_find_memory_type
+ * @param gpu
+ * @param type_filter A VkMemoryRequirements::memoryTypeBits mask.
+ * @param desired The property flags the memory type must have.
+ * @return the memory type index, or -1 if none is suitable.
+ */
+int gpu_device_find_memory_type (gpu_device_t *, uint32_t,
+                                 VkMemoryPropertyFlags);
+
+/** @function gpu_device_find_preferred_memory_type
+ * Like #gpu_device_find_memory_type, but picks a type that also has the
+ * preferred flags when there is one.
+ */
+int gpu_device_find_preferred_memory_type (gpu_device_t *, uint32_t,
+                                           VkMemoryPropertyFlags,
+                                           VkMemoryPropertyFlags);
+
+/** @function gpu_device_get_memory_type_flags
+ * @return the property flags of a memory type index.
+ */
+VkMemoryPropertyFlags gpu_device_get_memory_type_flags (gpu_device_t *, int);
+
+/** @function gpu_device_get_timeline
+ * @return the device-wide GPU timeline.
+ */
+struct gpu_timeline_s *gpu_device_get_timeline (gpu_device_t *);
+
+/** @function gpu_device_get_pipeline_cache
+ * @return a pipeline cache shared by every pipeline made on the device, so
+ * that variants of the same shaders are compiled faster.
+ */
+VkPipelineCache gpu_device_get_pipeline_cache (gpu_device_t *);
+
+/** @function gpu_device_get_memory
+ * @return the device's memory tracker.
+ */
+struct gpu_memory_s *gpu_device_get_memory (gpu_device_t *);
@@ -0,0 +1,188 @@
+/** @file gpu_dispatch.h
+ * Vulkan entry points, resolved at runtime instead of linked against.
+ *
+ * The Vulkan loader is opened on demand by #gpu_device_new, so processes
+ * that never create a GPU device never load it. Device-level entry points
+ * are resolved straight from the device with vkGetDeviceProcAddr, skipping
+ * the loader's per-call trampolines.
+ *
+ * Each entry point is a global function pointer named after the function it
+ * replaces, so calls are written the same as with prototypes. There is only
+ * ever one device, so the table is global rather than per-device. The
+ * pointers are hidden from the shared library's exports: they share the
+ * loader's names, and other libraries in the process (the OpenXR runtime,
+ * for one) must never bind to them.
+ */
+
+#pragma once
+
+#ifndef VK_NO_PROTOTYPES
+#error "VK_NO_PROTOTYPES must be defined for every file including Vulkan"
+#endif
+
+#include <vulkan/vulkan_core.h>
+
+#include "export.h"
+
+/* resolved with a null instance */
+#define GPU_DISPATCH_GLOBAL(X)                                               \
+  X (vkCreateInstance)                                                       \
+  X (vkEnumerateInstanceExtensionProperties)                                 \
+  X (vkEnumerateInstanceLayerProperties)
+
+#define GPU_DISPATCH_INSTANCE(X)                                             \
+  GPU_DISPATCH_INSTANCE_CORE (X)                                             \
+  GPU_DISPATCH_INSTANCE_DEBUG_UTILS (X)
+
+#define GPU_DISPATCH_INSTANCE_CORE(X)                                        \
+  X (vkCreateDevice)                                                         \
+  X (vkDestroyInstance)                                                      \
+  X (vkDestroySurfaceKHR)                                                    \
+  X (vkEnumerateDeviceExtensionProperties)                                   \
+  X (vkEnumeratePhysicalDevices)                                             \
+  X (vkGetDeviceProcAddr)                                                    \
+  X (vkGetPhysicalDeviceFeatures2)                                           \
+  X (vkGetPhysicalDeviceFormatProperties)                                    \
+  X (vkGetPhysicalDeviceMemoryProperties)                                    \
+  X (vkGetPhysicalDeviceMemoryProperties2)                                   \
+  X (vkGetPhysicalDeviceProperties)                                          \
+  X (vkGetPhysicalDeviceProperties2)                                         \
+  X (vkGetPhysicalDeviceQueueFamilyProperties)                               \
+  X (vkGetPhysicalDeviceSurfaceCapabilitiesKHR)                              \
+  X (vkGetPhysicalDeviceSurfacePresentModesKHR)                              \
+  X (vkGetPhysicalDeviceSurfaceSupportKHR)
+
+/* null unless VK_EXT_debug_utils is enabled, which the GPU debug level
+ * decides */
+#define GPU_DISPATCH_INSTANCE_DEBUG_UTILS(X)                                 \
+  X (vkCmdBeginDebugUtilsLabelEXT)                                           \
+  X (vkCmdEndDebugUtilsLabelEXT)                                             \
+  X (vkCreateDebugUtilsMessengerEXT)                                         \
+  X (vkDestroyDebugUtilsMessengerEXT)                                        \
+  X (vkSetDebugUtilsObjectNameEXT)
+
+#define GPU_DISPATCH_DEVICE_CORE(X)                                          \
+  X (vkAllocateCommandBuffers)                                               \
+  X (vkAllocateDescriptorSets)                                               \
+  X (vkAllocateMemory)                                                       \
+  X (vkBeginCommandBuffer)                                                   \
+  X (vkBindBufferMemory)                                                     \
+  X (vkBindImageMemory)                                                      \
+  X (vkCmdBeginRenderPass)                                                   \
+  X (vkCmdBindDescriptorSets)                                                \
+  X (vkCmdBindIndexBuffer)                                                   \
+  X (vkCmdBindPipeline)                                                      \
+  X (vkCmdBindVertexBuffers)                                                 \
+  X (vkCmdBlitImage)                                                         \
+  X (vkCmdCopyBuffer)                                                        \
+  X (vkCmdCopyImageToBuffer)                                                 \
+  X (vkCmdDispatch)                                                          \
+  X (vkCmdDrawIndexed)                                                       \
+  X (vkCmdDrawIndexedIndirect)                                               \
+  X (vkCmdDrawIndexedIndirectCount)                                          \
+  X (vkCmdEndRenderPass)                                                     \
+  X (vkCmdExecuteCommands)                                                   \
+  X (vkCmdPipelineBarrier)                                                   \
+  X (vkCmdPushConstants)                                                     \
+  X (vkCmdResetQueryPool)                                                    \
+  X (vkCmdSetScissor)                                                        \
+  X (vkCmdSetViewport)                                                       \
+  X (vkCmdWriteTimestamp)                                                    \
+  X (vkCreateBuffer)                                                         \
+  X (vkCreateCommandPool)                                                    \
+  X (vkCreateComputePipelines)                                               \
+  X (vkCreateDescriptorPool)                                                 \
+  X (vkCreateDescriptorSetLayout)                                            \
+  X (vkCreateFramebuffer)                                                    \
+  X (vkCreateGraphicsPipelines)                                              \
+  X (vkCreateImage)                                                          \
+  X (vkCreateImageView)                                                      \
+  X (vkCreatePipelineCache)                                                  \
+  X (vkCreatePipelineLayout)                                                 \
+  X (vkCreateQueryPool)                                                      \
+  X (vkCreateRenderPass)                                                     \
+  X (vkCreateSemaphore)                                                      \
+  X (vkCreateShaderModule)                                                   \
+  X (vkDestroyBuffer)                                                        \
+  X (vkDestroyCommandPool)                                                   \
+  X (vkDestroyDescriptorPool)                                                \
+  X (vkDestroyDescriptorSetLayout)                                           \
+  X (vkDestroyDevice)                                                        \
+  X (vkDestroyFramebuffer)                                                   \
+  X (vkDestroyImage)                                                         \
+  X (vkDestroyImageView)                                                     \
+  X (vkDestroyPipeline)                                                      \
+  X (vkDestroyPipelineCache)                                                 \
+  X (vkDestroyPipelineLayout)                                                \
+  X (vkDestroyQueryPool)                                                     \
+  X (vkDestroyRenderPass)                                                    \
+  X (vkDestroySemaphore)                                                     \
+  X (vkDestroyShaderModule)                                                  \
+  X (vkDeviceWaitIdle)                                                       \
+  X (vkEndCommandBuffer)                                                     \
+  X (vkFlushMappedMemoryRanges)                                              \
+  X (vkFreeMemory)                                                           \
+  X (vkGetBufferMemoryRequirements)                                          \
+  X (vkGetDeviceQueue)                                                       \
+  X (vkGetImageMemoryRequirements)                                           \
+  X (vkGetQueryPoolResults)                                                  \
+  X (vkGetSemaphoreCounterValue)                                             \
+  X (vkInvalidateMappedMemoryRanges)                                         \
+  X (vkMapMemory)                                                            \
+  X (vkQueueSubmit)                                                          \
+  X (vkQueueWaitIdle)                                                        \
+  X (vkResetCommandPool)                                                     \
+  X (vkUnmapMemory)                                                          \
+  X (vkUpdateDescriptorSets)                                                 \
+  X (vkWaitSemaphores)
+
+/* null unless VK_KHR_swapchain is enabled */
+#define GPU_DISPATCH_DEVICE_SWAPCHAIN(X)                                     \
+  X (vkAcquireNextImageKHR)                                                  \
+  X (vkCreateSwapchainKHR)                                                   \
+  X (vkDestroySwapchainKHR)                                                  \
+  X (vkGetSwapchainImagesKHR)                                                \
+  X (vkQueuePresentKHR)
+
+/* null unless VK_KHR_present_wait is enabled */
+#ifdef VK_KHR_present_wait
+#define GPU_DISPATCH_DEVICE_PRESENT_WAIT(X) X (vkWaitForPresentKHR)
+#else
+#define GPU_DISPATCH_DEVICE_PRESENT_WAIT(X)
+#endif
+
+#define GPU_DISPATCH_DEVICE(X)                                               \
+  GPU_DISPATCH_DEVICE_CORE (X)                                               \
+  GPU_DISPATCH_DEVICE_SWAPCHAIN (X)                                          \
+  GPU_DISPATCH_DEVICE_PRESENT_WAIT (X)
+
+#define GPU_DISPATCH_DECLARE(name) extern MDO_HIDDEN PFN_##name name;
+
+extern MDO_HIDDEN PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+GPU_DISPATCH_GLOBAL (GPU_DISPATCH_DECLARE)
+GPU_DISPATCH_INSTANCE (GPU_DISPATCH_DECLARE)
+GPU_DISPATCH_DEVICE (GPU_DISPATCH_DECLARE)
+
+/** @function gpu_dispatch_load_library
+ * Opens the Vulkan loader and resolves the global entry points. Does nothing
+ * if it's already open.
+ * @return zero on success.
+ */
+int gpu_dispatch_load_library (void);
+
+/** @function gpu_dispatch_load_instance
+ * Resolves every instance-level entry point from the instance.
+ */
+void gpu_dispatch_load_instance (VkInstance);
+
+/** @function gpu_dispatch_load_device
+ * Resolves every device-level entry point from the device, bypassing the
+ * loader's dispatch.
+ */
+void gpu_dispatch_load_device (VkDevice);
+
+/** @function gpu_dispatch_unload_library
+ * Clears every entry point and closes the Vulkan loader. Every instance must
+ * have been destroyed.
+ */
+void gpu_dispatch_unload_library (void);
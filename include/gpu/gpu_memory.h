@@ -0,0 +1,126 @@
+/** @file gpu_memory.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint64_t */
+
+#include "gpu/gpu_device.h"
+
+/** @typedef gpu_memory_t
+ * Tracks every device memory allocation against the heap budgets reported
+ * by VK_EXT_memory_budget, or against a conservative estimate when the
+ * extension is unavailable. Owned by the GPU device.
+ */
+typedef struct gpu_memory_s gpu_memory_t;
+
+/** @typedef gpu_memory_pressure_callback_t
+ * Called with its userdata whenever a heap's usage nears its budget, or an
+ * allocation runs out of memory. Subsystems should release what they can.
+ */
+typedef void (*gpu_memory_pressure_callback_t) (void *);
+
+/**
+ * The subsystems that allocations are accounted to.
+ */
+enum gpu_memory_category
+{
+  GPU_MEMORY_OTHER,
+  GPU_MEMORY_DEBUG_GEOMETRY,
+  GPU_MEMORY_GEOMETRY,
+  GPU_MEMORY_UNIFORMS,
+  GPU_MEMORY_INSTANCES,
+  GPU_MEMORY_INDIRECT,
+  GPU_MEMORY_READBACK,
+  GPU_MEMORY_RENDER_TARGETS,
+  GPU_MEMORY_CATEGORY_NUM,
+};
+
+struct gpu_memory_heap_stats
+{
+  /**
+   * How much the process may allocate from the heap without degrading
+   * performance.
+   */
+  VkDeviceSize budget;
+
+  /**
+   * How much the process has allocated from the heap, as reported by the
+   * driver if possible.
+   */
+  VkDeviceSize usage;
+
+  /**
+   * How much of the usage was allocated through #gpu_memory_allocate.
+   */
+  VkDeviceSize tracked;
+
+  int is_device_local;
+};
+
+struct gpu_memory_stats
+{
+  uint32_t heap_num;
+  struct gpu_memory_heap_stats heaps[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize categories[GPU_MEMORY_CATEGORY_NUM];
+
+  /**
+   * Non-zero if the budgets came from VK_EXT_memory_budget.
+   */
+  int has_budget_extension;
+};
+
+/** @function gpu_memory_new
+ * Called by the GPU device once its logical device exists.
+ */
+int gpu_memory_new (gpu_memory_t **, gpu_device_t *);
+
+/** @function gpu_memory_delete
+ * Warns about allocations that were never freed.
+ */
+void gpu_memory_delete (gpu_memory_t *);
+
+/** @function gpu_memory_allocate
+ * Allocates device memory and accounts it to a subsystem.
+ * @return zero on success.
+ */
+int gpu_memory_allocate (gpu_memory_t *, const VkMemoryAllocateInfo *,
+                         enum gpu_memory_category, VkDeviceMemory *);
+
+/** @function gpu_memory_free
+ * Frees memory from #gpu_memory_allocate. Does nothing for null handles.
+ */
+void gpu_memory_free (gpu_memory_t *, VkDeviceMemory);
+
+/** @function gpu_memory_update
+ * Refreshes the heap budgets, plots them, and runs the pressure callbacks if
+ * any heap is nearly full. Meant to be called once per frame.
+ */
+void gpu_memory_update (gpu_memory_t *);
+
+/** @function gpu_memory_get_stats
+ * Fills in the budgets as of the last #gpu_memory_update and the current
+ * tracked usage.
+ */
+void gpu_memory_get_stats (gpu_memory_t *, struct gpu_memory_stats *);
+
+/** @function gpu_memory_get_pressure_count
+ * @return how many times memory pressure has been signaled. Buffers that are
+ * rewritten every frame can compare this to shrink once they're idle.
+ */
+uint64_t gpu_memory_get_pressure_count (gpu_memory_t *);
+
+/** @function gpu_memory_add_pressure_callback
+ */
+int gpu_memory_add_pressure_callback (gpu_memory_t *,
+                                      gpu_memory_pressure_callback_t, void *);
+
+/** @function gpu_memory_remove_pressure_callback
+ */
+void gpu_memory_remove_pressure_callback (gpu_memory_t *,
+                                          gpu_memory_pressure_callback_t,
+                                          void *);
+
+/** @function gpu_memory_category_name
+ */
+const char *gpu_memory_category_name (enum gpu_memory_category);
@@ -0,0 +1,117 @@
+/** @file gpu_profiler.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint64_t */
+
+#include "gpu/gpu_device.h"
+
+#define GPU_PROFILER_MAX_ZONES 128
+
+/* the most views a subzone's render pass may broadcast to */
+#define GPU_PROFILER_MAX_VIEWS 2
+
+/** @typedef gpu_profiler_t
+ * Measures GPU execution time with timestamp queries. Results are read back
+ * once a frame slot is reused, so collecting them never stalls the GPU.
+ */
+typedef struct gpu_profiler_s gpu_profiler_t;
+
+struct gpu_zone_stats
+{
+  /**
+   * The static string the zone was opened with.
+   */
+  const char *name;
+
+  /**
+   * How many zones this zone is nested in.
+   */
+  int depth;
+
+  /**
+   * Start time relative to the beginning of the frame, and duration, in
+   * milliseconds.
+   */
+  double begin_ms;
+  double duration_ms;
+};
+
+struct gpu_frame_stats
+{
+  /**
+   * The frame number these results were recorded on. Zero if no results have
+   * been resolved yet.
+   */
+  uint64_t frame;
+
+  /**
+   * Total GPU time spent on the frame's command buffer, in milliseconds.
+   */
+  double gpu_time_ms;
+
+  struct gpu_zone_stats zones[GPU_PROFILER_MAX_ZONES];
+  int zone_num;
+};
+
+/** @function gpu_profiler_new
+ * @param new_profiler
+ * @param gpu
+ * @param queue Used once to calibrate GPU timestamps against the CPU clock.
+ * @param frame_num The number of frame slots that may be in flight.
+ */
+int gpu_profiler_new (gpu_profiler_t **, gpu_device_t *, VkQueue, int);
+
+/** @function gpu_profiler_delete
+ */
+void gpu_profiler_delete (gpu_profiler_t *);
+
+/** @function gpu_profiler_begin_frame
+ * Resolves the results last recorded into this frame slot, then starts
+ * recording a new frame. The slot's previous submission must have finished.
+ * Must be called outside of a render pass.
+ */
+void gpu_profiler_begin_frame (gpu_profiler_t *, VkCommandBuffer, int);
+
+/** @function gpu_profiler_end_frame
+ */
+void gpu_profiler_end_frame (gpu_profiler_t *, VkCommandBuffer);
+
+/** @function gpu_profiler_begin_zone
+ * @param profiler
+ * @param cmd
+ * @param name Must point to static storage.
+ * @return a zone handle for #gpu_profiler_end_zone, or -1 if out of queries.
+ */
+int gpu_profiler_begin_zone (gpu_profiler_t *, VkCommandBuffer, const char *);
+
+/** @function gpu_profiler_begin_subzone
+ * Like #gpu_profiler_begin_zone, but with an explicit nesting depth instead of
+ * the calling thread's. Safe to call from command recording threads.
+ * @param profiler
+ * @param cmd
+ * @param name Must point to static storage.
+ * @param depth
+ * @param view_num The view count of the render pass the zone is recorded
+ * in, since multiview timestamps take a query per view, or 1 outside of
+ * render passes.
+ */
+int gpu_profiler_begin_subzone (gpu_profiler_t *, VkCommandBuffer,
+                                const char *, int, uint32_t);
+
+/** @function gpu_profiler_end_zone
+ * Ends a zone or subzone.
+ */
+void gpu_profiler_end_zone (gpu_profiler_t *, VkCommandBuffer, int);
+
+/** @function gpu_profiler_get_frame
+ * @return the number of the frame most recently begun, which its results
+ * will be reported under, or zero if timestamps are unsupported.
+ */
+uint64_t gpu_profiler_get_frame (gpu_profiler_t *);
+
+/** @function gpu_profiler_get_stats
+ * @return the most recently resolved frame's results.
+ */
+const struct gpu_frame_stats *gpu_profiler_get_stats (gpu_profiler_t *);
@@ -0,0 +1,67 @@
+/** @file gpu_push_constants.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint32_t */
+
+#include "gpu/gpu_device.h"
+
+/* the most blocks one pipeline layout can declare */
+#define GPU_PUSH_BLOCK_MAX 4
+
+/* the smallest maxPushConstantsSize a device may have */
+#define GPU_PUSH_CONSTANTS_MIN_SIZE 128
+
+/**
+ * A typed block of push constants: a byte range of a pipeline layout's push
+ * constant space, visible to a fixed set of shader stages. Small per-draw or
+ * per-viewport data pushed this way needs no descriptor or buffer updates.
+ */
+struct gpu_push_block
+{
+  VkShaderStageFlags stages;
+  uint32_t offset;
+  uint32_t size;
+};
+
+/**
+ * Collects the push constant ranges of a pipeline layout as its blocks are
+ * declared. Pass ranges and range_num straight to VkPipelineLayoutCreateInfo.
+ */
+struct gpu_push_layout
+{
+  VkPushConstantRange ranges[GPU_PUSH_BLOCK_MAX];
+  uint32_t range_num;
+  uint32_t size;
+};
+
+/** @function gpu_push_layout_init
+ */
+void gpu_push_layout_init (struct gpu_push_layout *);
+
+/** @function gpu_push_layout_add
+ * Declares a block after the last one, 16-byte aligned so it can start with
+ * a vec4. Blocks must fit in #GPU_PUSH_CONSTANTS_MIN_SIZE bytes, so that
+ * every device can use the layout.
+ * @param layout
+ * @param stages The shader stages the block is visible to.
+ * @param size The size of the block's C struct.
+ * @param block Filled in with where the block was placed.
+ * @return zero on success.
+ */
+int gpu_push_layout_add (struct gpu_push_layout *, VkShaderStageFlags,
+                         uint32_t, struct gpu_push_block *);
+
+/** @function gpu_push_block_record
+ * Pushes a whole block. The data's size must match the block's.
+ */
+void gpu_push_block_record (VkCommandBuffer, VkPipelineLayout,
+                            const struct gpu_push_block *, const void *,
+                            uint32_t);
+
+/**
+ * Pushes a pointer to a block's C struct, checking its size.
+ */
+#define GPU_PUSH_BLOCK(cmd, layout, block, data)                             \
+  gpu_push_block_record ((cmd), (layout), (block), (data), sizeof (*(data)))
@@ -3,12 +3,73 @@
 
 #pragma once
 
+#include <stdint.h> /* for uint32_t, uint64_t */
+
 #include "gpu/gpu_device.h"
 
+#define GPU_SPECIALIZATION_MAX 16
+
 /** @typedef gpu_shader_t
  */
 typedef struct gpu_shader_s gpu_shader_t;
 
+/**
+ * The GLSL type of a specialization constant. All of them are four bytes.
+ */
+enum gpu_constant_type
+{
+  GPU_CONSTANT_BOOL,
+  GPU_CONSTANT_INT,
+  GPU_CONSTANT_UINT,
+  GPU_CONSTANT_FLOAT,
+};
+
+/**
+ * A set of specialization constants, kept sorted by constant ID so that
+ * equal sets hash equally. Must stay alive and unmoved until the pipeline
+ * it's passed to has been created.
+ */
+struct gpu_specialization
+{
+  uint32_t constant_num;
+  VkSpecializationMapEntry entries[GPU_SPECIALIZATION_MAX];
+  enum gpu_constant_type types[GPU_SPECIALIZATION_MAX];
+  uint32_t data[GPU_SPECIALIZATION_MAX];
+  VkSpecializationInfo info;
+};
+
+/** @function gpu_specialization_init
+ * Empties a specialization constant set.
+ */
+void gpu_specialization_init (struct gpu_specialization *);
+
+/** @function gpu_specialization_set_bool
+ * Sets a constant, replacing any earlier value for the same ID.
+ * @return zero on success, or non-zero if the set is full or the ID was
+ * set with another type.
+ */
+int gpu_specialization_set_bool (struct gpu_specialization *, uint32_t, int);
+
+/** @function gpu_specialization_set_int
+ */
+int gpu_specialization_set_int (struct gpu_specialization *, uint32_t,
+                                int32_t);
+
+/** @function gpu_specialization_set_uint
+ */
+int gpu_specialization_set_uint (struct gpu_specialization *, uint32_t,
+                                 uint32_t);
+
+/** @function gpu_specialization_set_float
+ */
+int gpu_specialization_set_float (struct gpu_specialization *, uint32_t,
+                                  float);
+
+/** @function gpu_specialization_hash
+ * @return a hash of every constant's ID, type, and value.
+ */
+uint64_t gpu_specialization_hash (const struct gpu_specialization *);
+
 /** @function gpu_shader_new
  */
 int gpu_shader_new (gpu_shader_t **, gpu_device_t *, VkShaderStageFlags);
@@ -24,3 +85,19 @@ int gpu_shader_load_from_file (gpu_shader_t *, const char *);
 /** @function gpu_shader_get
  */
 int gpu_shader_get (gpu_shader_t *, VkPipelineShaderStageCreateInfo *);
+
+/** @function gpu_shader_get_specialized
+ * Like #gpu_shader_get, but specializes the shader with a constant set. The
+ * stage info points into the set.
+ */
+int gpu_shader_get_specialized (gpu_shader_t *, struct gpu_specialization *,
+                                VkPipelineShaderStageCreateInfo *);
+
+/** @function gpu_shader_get_key
+ * @param shader
+ * @param spec The constant set, or NULL for none.
+ * @return a key identifying the shader's code, stage, and specialization,
+ * for looking up pipeline variants.
+ */
+uint64_t gpu_shader_get_key (gpu_shader_t *,
+                             const struct gpu_specialization *);
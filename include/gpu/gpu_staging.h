@@ -0,0 +1,72 @@
+/** @file gpu_staging.h
+ */
+
+#pragma once
+
+#include <stddef.h> /* for size_t */
+#include <stdint.h> /* for uint64_t */
+
+#include "gpu/gpu_device.h"
+
+/** @typedef gpu_staging_t
+ * Streams host data into device-local buffers through a ring of
+ * host-visible chunks. Copies are batched into a chunk until it fills, then
+ * submitted on the graphics queue, signaling the device's GPU timeline. A
+ * full ring only waits for the oldest chunk, so uploads keep the disk and
+ * the copy engine busy at the same time.
+ *
+ * Submits to the same queue as the renderer, so it must be used on the
+ * renderer's thread, and never while a frame is being submitted. Uploaded
+ * data is visible to every command submitted after the flush that sends
+ * it.
+ */
+typedef struct gpu_staging_s gpu_staging_t;
+
+struct gpu_staging_config
+{
+  gpu_device_t *gpu;
+
+  /**
+   * The size of each chunk in bytes. If zero, a default is used.
+   */
+  size_t chunk_size;
+
+  /**
+   * How many chunks may be in flight at once. If zero, a default is used.
+   */
+  int chunk_num;
+};
+
+/** @function gpu_staging_new
+ */
+int gpu_staging_new (gpu_staging_t **, const struct gpu_staging_config *);
+
+/** @function gpu_staging_delete
+ * Flushes, then waits for every chunk to finish copying.
+ */
+void gpu_staging_delete (gpu_staging_t *);
+
+/** @function gpu_staging_upload
+ * Copies host data into a buffer, splitting it across as many chunks as it
+ * needs. The source may be released as soon as this returns.
+ * @param staging
+ * @param dst A buffer created with TRANSFER_DST usage.
+ * @param dst_offset
+ * @param src
+ * @param size
+ * @return zero on success.
+ */
+int gpu_staging_upload (gpu_staging_t *, VkBuffer, VkDeviceSize,
+                        const void *, size_t);
+
+/** @function gpu_staging_flush
+ * Submits the partially filled chunk, if there is one.
+ * @return zero on success.
+ */
+int gpu_staging_flush (gpu_staging_t *);
+
+/** @function gpu_staging_get_value
+ * @return the GPU timeline value that every submitted upload is finished
+ * by, or zero if nothing has been submitted.
+ */
+uint64_t gpu_staging_get_value (gpu_staging_t *);
@@ -0,0 +1,83 @@
+/** @file gpu_timeline.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint64_t */
+
+#include "gpu/gpu_device.h"
+
+/** @typedef gpu_timeline_t
+ * A monotonically increasing GPU timeline, backed by a Vulkan timeline
+ * semaphore. Every queue submission that signals the timeline is assigned a
+ * value, and anything on the CPU can poll or wait for that value.
+ */
+typedef struct gpu_timeline_s gpu_timeline_t;
+
+/** @typedef gpu_timeline_callback_t
+ * Called with its userdata once the timeline value it was deferred on has
+ * been reached by the GPU.
+ */
+typedef void (*gpu_timeline_callback_t) (void *);
+
+/** @function gpu_timeline_new
+ */
+int gpu_timeline_new (gpu_timeline_t **, gpu_device_t *);
+
+/** @function gpu_timeline_delete
+ * Waits for all pending values and runs any outstanding deferred callbacks.
+ */
+void gpu_timeline_delete (gpu_timeline_t *);
+
+/** @function gpu_timeline_get_semaphore
+ */
+VkSemaphore gpu_timeline_get_semaphore (gpu_timeline_t *);
+
+/** @function gpu_timeline_next
+ * Reserves the next value on the timeline. The caller is responsible for
+ * submitting work that signals it.
+ */
+uint64_t gpu_timeline_next (gpu_timeline_t *);
+
+/** @function gpu_timeline_cancel
+ * Gives back a value whose submission failed, so that nothing waits on a
+ * value that will never be signaled. Only the most recently reserved value
+ * can be cancelled.
+ * @return zero on success.
+ */
+int gpu_timeline_cancel (gpu_timeline_t *, uint64_t);
+
+/** @function gpu_timeline_pending
+ * @return the most recently reserved value.
+ */
+uint64_t gpu_timeline_pending (gpu_timeline_t *);
+
+/** @function gpu_timeline_completed
+ * @return the most recent value reached by the GPU. Does not block.
+ */
+uint64_t gpu_timeline_completed (gpu_timeline_t *);
+
+/** @function gpu_timeline_is_complete
+ * @return non-zero if the GPU has reached the given value. Does not block.
+ */
+int gpu_timeline_is_complete (gpu_timeline_t *, uint64_t);
+
+/** @function gpu_timeline_wait
+ * @param timeline
+ * @param value
+ * @param timeout In nanoseconds.
+ * @return zero once the value has been reached, non-zero on timeout/error.
+ */
+int gpu_timeline_wait (gpu_timeline_t *, uint64_t, uint64_t);
+
+/** @function gpu_timeline_defer
+ * Runs a callback once the GPU reaches the given value. Used for deferred
+ * deletion of resources that may still be in use by in-flight work.
+ */
+int gpu_timeline_defer (gpu_timeline_t *, uint64_t, gpu_timeline_callback_t,
+                        void *);
+
+/** @function gpu_timeline_collect
+ * Runs every deferred callback whose value has been reached.
+ */
+void gpu_timeline_collect (gpu_timeline_t *);
@@ -4,14 +4,31 @@
 #pragma once
 
 #include "gpu_device.h"
+#include "gpu_memory.h"
 
 /** @typedef gpu_vector_t
+ * A growable host-visible buffer. Under memory pressure, its next write
+ * shrinks it if it's much bigger than what's written.
  */
 typedef struct gpu_vector_s gpu_vector_t;
 
 /** @function gpu_vector_new
+ * @param new_vec
+ * @param gpu
+ * @param usage
+ * @param category The subsystem the memory is accounted to.
  */
-int gpu_vector_new (gpu_vector_t **, gpu_device_t *, VkBufferUsageFlags);
+int gpu_vector_new (gpu_vector_t **, gpu_device_t *, VkBufferUsageFlags,
+                    enum gpu_memory_category);
+
+/** @function gpu_vector_new_device_local
+ * Like #gpu_vector_new, but the buffer lives in device-local memory, which
+ * the host can't write or read. Fill it through a gpu_staging_t instead.
+ * Resizing it discards its contents, and it's never trimmed.
+ */
+int gpu_vector_new_device_local (gpu_vector_t **, gpu_device_t *,
+                                 VkBufferUsageFlags,
+                                 enum gpu_memory_category);
 
 /** @function gpu_vector_delete
  */
@@ -29,6 +46,19 @@ int gpu_vector_reserve (gpu_vector_t *, size_t);
  */
 int gpu_vector_write (gpu_vector_t *, const void *, size_t, size_t);
 
+/** @function gpu_vector_read
+ * Copies the start of the buffer back to host memory. The caller must make
+ * sure the GPU has finished writing to it.
+ */
+int gpu_vector_read (gpu_vector_t *, void *, size_t);
+
 /** @function gpu_vector_get
  */
 VkBuffer gpu_vector_get (gpu_vector_t *);
+
+/** @function gpu_vector_get_generation
+ * @return a count of the buffers the vector has had, which changes whenever
+ * it's reallocated. Unlike the buffer handle, it's never reused, so it's
+ * safe for telling whether descriptors are stale. Never zero.
+ */
+uint64_t gpu_vector_get_generation (gpu_vector_t *);
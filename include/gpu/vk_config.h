@@ -7,6 +7,38 @@
 
 #include <vulkan/vulkan_core.h> /* for VkPhysicalDevice */
 
+enum gpu_debug_level
+{
+  /**
+   * No layers, messenger, labels, or object names, so Vulkan calls cost
+   * nothing extra.
+   */
+  GPU_DEBUG_LEVEL_OFF,
+
+  /**
+   * Validation layers, reporting errors only, plus labels and object names.
+   */
+  GPU_DEBUG_LEVEL_ERRORS,
+
+  /**
+   * Validation layers, reporting everything.
+   */
+  GPU_DEBUG_LEVEL_VALIDATION,
+
+  /**
+   * Full validation, plus GPU-assisted validation of shader accesses. Very
+   * slow.
+   */
+  GPU_DEBUG_LEVEL_GPU_ASSISTED,
+};
+
+/* release builds skip validation unless asked for it */
+#ifdef NDEBUG
+#define GPU_DEBUG_LEVEL_DEFAULT GPU_DEBUG_LEVEL_OFF
+#else
+#define GPU_DEBUG_LEVEL_DEFAULT GPU_DEBUG_LEVEL_VALIDATION
+#endif
+
 struct vk_config_t
 {
   /**
@@ -24,10 +56,39 @@ struct vk_config_t
   const char *instance_extensions;
   const char *device_extensions;
 
+  /**
+   * Device extensions that are enabled only if the device supports them. Same
+   * format as the required lists. Check for them afterwards with
+   * #gpu_device_has_extension.
+   */
+  const char *optional_device_extensions;
+
   /**
    * The VkPhysicalDevice to use.
    *
    * If set to VK_NULL_HANDLE, the physical device is selected automatically.
    */
   VkPhysicalDevice physical_device;
+
+  /**
+   * When selecting automatically, only this device is considered. Matches
+   * either part of the device's name, case-insensitively, or its UUID, as
+   * hex digits with or without dashes. If null, the MDO_GPU environment
+   * variable is used instead, if set.
+   */
+  const char *device_override;
+
+  /**
+   * If not null, called once the instance exists to create the surface the
+   * device will present to, so that only devices able to present to it are
+   * selected. The caller keeps ownership of the surface.
+   */
+  VkSurfaceKHR (*create_surface) (VkInstance, void *);
+  void *surface_userdata;
+
+  /**
+   * Which validation and debugging tools to enable. Falls back to lower
+   * levels if the system doesn't support the one asked for.
+   */
+  enum gpu_debug_level debug_level;
 };
@@ -12,11 +12,36 @@
  */
 typedef struct camera_s camera_t;
 
+enum camera_mode
+{
+  CAMERA_MODE_MONO,
+
+  /**
+   * Renders both eyes of each viewport in a single pass with multiview, so
+   * draws are only recorded once. Needs #gpu_device_has_multiview.
+   */
+  CAMERA_MODE_STEREO,
+};
+
 struct camera_config
 {
   gpu_device_t *gpu;
   const struct viewport_config *viewport_configs;
   int viewport_num;
+
+  enum camera_mode mode;
+
+  /**
+   * Stereo only. The distance between the eyes, in world units.
+   */
+  float eye_separation;
+
+  /**
+   * If non-zero, the render pass has a reversed-Z depth attachment, cleared
+   * to zero. Depth buffers are render graph transients, so viewports drawn
+   * one after another share their memory.
+   */
+  int has_depth;
 };
 
 /** @function camera_new
@@ -31,6 +56,21 @@ void camera_delete (camera_t *);
  */
 VkRenderPass camera_get_render_pass (camera_t *);
 
+/** @function camera_get_depth_format
+ * @return the render pass's depth format, or VK_FORMAT_UNDEFINED if it has
+ * no depth attachment.
+ */
+VkFormat camera_get_depth_format (camera_t *);
+
+/** @function camera_get_mode
+ */
+enum camera_mode camera_get_mode (camera_t *);
+
+/** @function camera_get_viewport
+ * @return the viewport at an index, or NULL if it's out of range.
+ */
+viewport_t *camera_get_viewport (camera_t *, int);
+
 /** @function camera_acquire
  * @return the number of viewports acquired.
  */
@@ -0,0 +1,82 @@
+/** @file command_recorder.h
+ */
+
+#pragma once
+
+#include "gpu/gpu_device.h"
+
+/** @typedef command_recorder_t
+ * Owns every command pool the renderer records into. Command buffers are
+ * allocated once per frame slot and recycled by resetting their pools, and
+ * secondary command buffers can be recorded in parallel on worker threads,
+ * each of which has its own pool per frame slot.
+ */
+typedef struct command_recorder_s command_recorder_t;
+
+/** @typedef command_record_callback_t
+ * Records a single job into a secondary command buffer that has already been
+ * begun. Called from worker threads, so it must not touch shared state.
+ * @param userdata
+ * @param job The index of the job to record.
+ * @param cmd
+ */
+typedef void (*command_record_callback_t) (void *, int, VkCommandBuffer);
+
+struct command_recorder_config
+{
+  gpu_device_t *gpu;
+
+  /**
+   * The number of frame slots that may be in flight at once.
+   */
+  int frame_num;
+
+  /**
+   * The number of worker threads. Negative picks one per spare CPU core, and
+   * zero records everything on the calling thread.
+   */
+  int thread_num;
+};
+
+/** @function command_recorder_new
+ */
+int command_recorder_new (command_recorder_t **,
+                          const struct command_recorder_config *);
+
+/** @function command_recorder_delete
+ * The caller must make sure none of the recorder's command buffers are still
+ * in use by the GPU.
+ */
+void command_recorder_delete (command_recorder_t *);
+
+/** @function command_recorder_thread_num
+ * @return the number of worker threads.
+ */
+int command_recorder_thread_num (command_recorder_t *);
+
+/** @function command_recorder_begin_frame
+ * Resets every pool of a frame slot so its command buffers can be reused.
+ * The slot's previous submission must have finished.
+ */
+void command_recorder_begin_frame (command_recorder_t *, int);
+
+/** @function command_recorder_get_primary
+ * @return the current frame slot's primary command buffer, not yet begun.
+ */
+VkCommandBuffer command_recorder_get_primary (command_recorder_t *);
+
+/** @function command_recorder_record
+ * Records jobs into secondary command buffers across the calling thread and
+ * every worker, and returns once all of them are finished.
+ * @param recorder
+ * @param job_num
+ * @param inheritance One inheritance info per job.
+ * @param callback
+ * @param userdata
+ * @param secondaries Receives one finished secondary command buffer per job.
+ * @return zero on success.
+ */
+int command_recorder_record (command_recorder_t *, int,
+                             const VkCommandBufferInheritanceInfo *,
+                             command_record_callback_t, void *,
+                             VkCommandBuffer *);
@@ -4,12 +4,27 @@
 #pragma once
 
 #include "gpu/gpu_vector.h"
+#include "renderer/debug/debug_vertex.h"
 
 struct debug_frame_data
 {
   gpu_vector_t *vertices;
   size_t vertex_num;
 
+  /* what this frame's vertices were packed relative to */
+  struct debug_vertex_bounds bounds;
+
   gpu_vector_t *indices;
   size_t index_num;
+
+  /* vertex pulling only; points at this frame's vertices */
+  VkDescriptorPool descriptor_pool;
+  VkDescriptorSet set;
+
+  /* this frame's batch in the frame's indirect draws */
+  int batch;
+
+  /* the variants for the format this frame was packed in */
+  VkPipeline pipeline;
+  VkPipeline multiview_pipeline;
 };
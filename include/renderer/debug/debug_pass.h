@@ -5,6 +5,7 @@
 
 #include "renderer/debug/debug_draw.h"
 #include "renderer/debug/debug_frame_data.h"
+#include "renderer/debug/debug_vertex.h"
 #include "renderer/render_phases.h"
 #include "renderer/renderer.h"
 
@@ -13,13 +14,28 @@
 typedef struct debug_pass_s debug_pass_t;
 
 /** @function debug_pass_new
+ * @param new_dbp
+ * @param ren
+ * @param rp A single-view render pass, or VK_NULL_HANDLE.
+ * @param multiview_rp A stereo render pass, or VK_NULL_HANDLE.
+ * @param format How vertices are packed for the GPU.
+ * @param vertex_pulling If non-zero, the vertex shader fetches vertices from
+ * a storage buffer instead of through fixed-function vertex input.
  */
-int debug_pass_new (debug_pass_t **, renderer_t *, VkRenderPass);
+int debug_pass_new (debug_pass_t **, renderer_t *, VkRenderPass,
+                    VkRenderPass, enum debug_vertex_format, int);
 
 /** @function debug_pass_delete
  */
 void debug_pass_delete (debug_pass_t *);
 
+/** @function debug_pass_set_format
+ * Changes how vertices are packed from the next prepared frame on. Each
+ * format's pipelines are only built the first time it's used.
+ * @return zero on success.
+ */
+int debug_pass_set_format (debug_pass_t *, enum debug_vertex_format);
+
 /** @function debug_pass_get_draw_list
  */
 debug_draw_list_t *debug_pass_get_draw_list (debug_pass_t *);
@@ -32,7 +48,15 @@ int debug_frame_data_init (debug_pass_t *, struct debug_frame_data *);
  */
 void debug_frame_data_cleanup (debug_pass_t *, struct debug_frame_data *);
 
+/** @function debug_pass_prepare
+ * Uploads and clears the draw list, and adds its draw to the frame's
+ * indirect draws. Called once per frame before rendering.
+ */
+void debug_pass_prepare (debug_pass_t *, struct debug_frame_data *,
+                         indirect_draws_t *);
+
 /** @function debug_pass_render
+ * Only records commands, so it may run on any recording thread.
  */
 void debug_pass_render (debug_pass_t *, const struct render_context *,
                         struct debug_frame_data *);
@@ -0,0 +1,72 @@
+/** @file debug_vertex.h
+ */
+
+#pragma once
+
+#include <stddef.h> /* for size_t */
+
+#include <vulkan/vulkan_core.h>
+
+#include "renderer/debug/debug_draw.h"
+
+/**
+ * How debug vertices are laid out in GPU memory.
+ */
+enum debug_vertex_format
+{
+  /**
+   * #debug_draw_vertex_t as-is: 24 bytes.
+   */
+  DEBUG_VERTEX_FORMAT_FLOAT,
+
+  /**
+   * Half-float positions relative to the batch's center, and RGBA8 colors:
+   * 12 bytes. Precision falls off far from the center.
+   */
+  DEBUG_VERTEX_FORMAT_HALF,
+
+  /**
+   * 16-bit fixed-point positions within the batch's bounds, and RGBA8
+   * colors: 12 bytes. Precision is even across the bounds, so it suits
+   * batches that are small or evenly spread out.
+   */
+  DEBUG_VERTEX_FORMAT_SNORM16,
+};
+
+/**
+ * Decodes packed positions: the vertex shader computes
+ * origin + position * scale.
+ */
+struct debug_vertex_bounds
+{
+  float origin[4];
+  float scale[4];
+};
+
+/** @function debug_vertex_format_stride
+ * @return the size of one vertex in the format.
+ */
+size_t debug_vertex_format_stride (enum debug_vertex_format);
+
+/** @function debug_vertex_format_describe
+ * Fills in a vertex binding, and the position and color attributes at
+ * locations zero and one.
+ */
+void debug_vertex_format_describe (enum debug_vertex_format, uint32_t,
+                                   VkVertexInputBindingDescription *,
+                                   VkVertexInputAttributeDescription[2]);
+
+/** @function debug_vertex_compute_bounds
+ * Chooses the bounds that vertices are packed relative to.
+ */
+void debug_vertex_compute_bounds (enum debug_vertex_format,
+                                  const debug_draw_vertex_t *, size_t,
+                                  struct debug_vertex_bounds *);
+
+/** @function debug_vertex_pack
+ * Converts vertices to a format. The destination must have room for
+ * #debug_vertex_format_stride bytes per vertex.
+ */
+void debug_vertex_pack (enum debug_vertex_format,
+                        const struct debug_vertex_bounds *,
+                        const debug_draw_vertex_t *, size_t, void *);
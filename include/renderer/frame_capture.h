@@ -0,0 +1,113 @@
+/** @file frame_capture.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint64_t */
+
+#include "gpu/gpu_device.h"
+#include "renderer/viewport.h"
+
+/** @typedef frame_capture_t
+ * Continuously captures a viewport's frames to files without stalling the
+ * frame loop. Each captured frame is copied into one of a ring of
+ * host-visible buffers, picked up once the GPU timeline shows the copy has
+ * finished, and encoded on a worker thread. Frames are dropped, not waited
+ * for, whenever every buffer is busy.
+ *
+ * Atlas regions can't be captured on their own; capture the atlas's
+ * viewport instead.
+ */
+typedef struct frame_capture_s frame_capture_t;
+
+enum frame_capture_format
+{
+  /**
+   * One file of tightly packed RGBA8 pixels per frame.
+   */
+  FRAME_CAPTURE_FORMAT_RAW,
+
+  /**
+   * One uncompressed PNG per frame.
+   */
+  FRAME_CAPTURE_FORMAT_PNG,
+
+  /**
+   * A single YUV4MPEG2 stream, for piping into video encoders. Frames of a
+   * different size than the first are dropped.
+   */
+  FRAME_CAPTURE_FORMAT_Y4M,
+};
+
+struct frame_capture_config
+{
+  gpu_device_t *gpu;
+  viewport_t *vp;
+  enum frame_capture_format format;
+
+  /**
+   * For streams, the file to write. Otherwise, the prefix that each frame's
+   * number and extension are appended to.
+   */
+  const char *path;
+
+  /**
+   * How many frames may be copying or encoding at once. If zero, a default
+   * is used.
+   */
+  int slot_num;
+
+  /**
+   * The frame rate written into stream headers. If zero, 60 is used.
+   */
+  int frame_rate;
+};
+
+struct frame_capture_stats
+{
+  uint64_t captured;
+  uint64_t dropped;
+  uint64_t failed;
+};
+
+/** @function frame_capture_new
+ */
+int frame_capture_new (frame_capture_t **,
+                       const struct frame_capture_config *);
+
+/** @function frame_capture_delete
+ * Waits for every frame still copying and encoding to be written. Must be
+ * called while the viewport and GPU device are alive.
+ */
+void frame_capture_delete (frame_capture_t *);
+
+/** @function frame_capture_get_viewport
+ */
+viewport_t *frame_capture_get_viewport (frame_capture_t *);
+
+/** @function frame_capture_poll
+ * Hands every finished copy to the worker thread. Never waits on the GPU.
+ */
+void frame_capture_poll (frame_capture_t *);
+
+/** @function frame_capture_begin
+ * Reserves a buffer for the viewport's current image.
+ * @return the buffer to copy into, or VK_NULL_HANDLE if the frame is
+ * dropped.
+ */
+VkBuffer frame_capture_begin (frame_capture_t *);
+
+/** @function frame_capture_record
+ * Records the copy into the buffer from #frame_capture_begin. The image must
+ * be in TRANSFER_SRC_OPTIMAL.
+ */
+void frame_capture_record (frame_capture_t *, VkCommandBuffer);
+
+/** @function frame_capture_mark_submitted
+ * Tells the capture which GPU timeline value its copy will be finished at.
+ */
+void frame_capture_mark_submitted (frame_capture_t *, uint64_t);
+
+/** @function frame_capture_get_stats
+ */
+void frame_capture_get_stats (frame_capture_t *, struct frame_capture_stats *);
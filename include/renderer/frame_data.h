@@ -3,25 +3,42 @@
 
 #pragma once
 
+#include <stdint.h> /* for uint64_t */
 #include <vulkan/vulkan.h>
 
 #include "gpu/gpu_vector.h"
 #include "renderer/debug/debug_frame_data.h"
+#include "renderer/indirect_draws.h"
+#include "renderer/mesh/mesh_frame_data.h"
+#include "renderer/render_graph.h"
+#include "renderer/stars/star_frame_data.h"
 
 struct frame_data
 {
-  /* commands and synchronization */
-  VkCommandPool command_pool;
+  /* synchronization; command buffers belong to the renderer's recorder */
   VkSemaphore on_finished;
-  VkFence is_in_flight;
+
+  /* GPU timeline value signaled once this frame's commands have finished */
+  uint64_t timeline_value;
 
   /* global GPU data */
   gpu_vector_t *viewport_buf;
 
+  /* every pass's draw commands, refilled each frame */
+  indirect_draws_t *draws;
+
   /* descriptors */
   VkDescriptorPool descriptor_pool;
   VkDescriptorSet viewport_set;
 
+  /* the viewport buffer generation the set points at, or zero */
+  uint64_t viewport_set_generation;
+
+  /* rebuilt every frame; owns this frame's transient images */
+  render_graph_t *graph;
+
   /* per-pass frame data */
   struct debug_frame_data debug;
+  struct mesh_frame_data meshes;
+  struct star_frame_data stars;
 };
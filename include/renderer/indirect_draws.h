@@ -0,0 +1,74 @@
+/** @file indirect_draws.h
+ */
+
+#pragma once
+
+#include "gpu/gpu_device.h"
+
+/** @typedef indirect_draws_t
+ * A frame's indexed draw commands, kept in GPU buffers so that a whole batch
+ * of draws costs one vkCmdDrawIndexedIndirect (or
+ * vkCmdDrawIndexedIndirectCount) call. Passes add their batches while the
+ * frame is prepared, then record them from any thread once uploaded.
+ *
+ * Each batch also has its draw count in a buffer, so a compute pass may
+ * later cull the commands and rewrite the counts without the passes
+ * changing.
+ */
+typedef struct indirect_draws_s indirect_draws_t;
+
+/** @function indirect_draws_new
+ */
+int indirect_draws_new (indirect_draws_t **, gpu_device_t *);
+
+/** @function indirect_draws_delete
+ */
+void indirect_draws_delete (indirect_draws_t *);
+
+/** @function indirect_draws_clear
+ * Removes every batch. Called once per frame before passes are prepared.
+ */
+void indirect_draws_clear (indirect_draws_t *);
+
+/** @function indirect_draws_begin_batch
+ * Starts a batch of draws sharing a pipeline and bound buffers. Commands
+ * added after this go into it.
+ * @return the batch's index, or -1 on failure.
+ */
+int indirect_draws_begin_batch (indirect_draws_t *);
+
+/** @function indirect_draws_add
+ * Adds a command to the current batch. firstInstance must be zero unless
+ * the device supports drawIndirectFirstInstance.
+ * @return zero on success.
+ */
+int indirect_draws_add (indirect_draws_t *,
+                        const VkDrawIndexedIndirectCommand *);
+
+/** @function indirect_draws_upload
+ * Writes every batch to the GPU. Must be called after the last batch is
+ * added and before any are recorded.
+ * @return zero on success.
+ */
+int indirect_draws_upload (indirect_draws_t *);
+
+/** @function indirect_draws_record
+ * Draws a batch with the currently bound pipeline and buffers. Only records
+ * commands, so it may run on any recording thread.
+ */
+void indirect_draws_record (indirect_draws_t *, VkCommandBuffer, int);
+
+/** @function indirect_draws_get_first
+ * @return the index of a batch's first command in the command buffer.
+ */
+uint32_t indirect_draws_get_first (indirect_draws_t *, int);
+
+/** @function indirect_draws_get_commands
+ * @return the buffer of VkDrawIndexedIndirectCommand records.
+ */
+VkBuffer indirect_draws_get_commands (indirect_draws_t *);
+
+/** @function indirect_draws_get_counts
+ * @return the buffer of uint32_t draw counts, one per batch.
+ */
+VkBuffer indirect_draws_get_counts (indirect_draws_t *);
@@ -0,0 +1,21 @@
+/** @file mesh_frame_data.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint32_t */
+#include <vulkan/vulkan.h>
+
+struct mesh_frame_data
+{
+  /* points at the pass's vertices and instances */
+  VkDescriptorPool descriptor_pool;
+  VkDescriptorSet set;
+
+  /* this frame's batch in the frame's indirect draws, or -1 if the
+   * instances are drawn directly */
+  int batch;
+
+  /* the instance count when this frame was prepared */
+  uint32_t instance_num;
+};
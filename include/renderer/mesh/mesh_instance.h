@@ -0,0 +1,23 @@
+/** @file mesh_instance.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint32_t */
+
+/** @typedef mesh_instance_t
+ * Laid out to match the mesh shaders' std430 storage buffer.
+ */
+typedef struct mesh_instance_t
+{
+  float position[3];
+  float scale;
+  float color[3];
+
+  /* which of the loaded pack's meshes to draw */
+  uint32_t mesh;
+
+  /* clamped to the mesh's least detailed LOD */
+  uint32_t lod;
+  uint32_t padding[3];
+} mesh_instance_t;
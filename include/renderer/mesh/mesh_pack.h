@@ -0,0 +1,51 @@
+/** @file mesh_pack.h
+ */
+
+#pragma once
+
+#include <stddef.h> /* for size_t */
+#include <stdint.h> /* for uint32_t */
+
+#include "renderer/mesh/mesh_pack_format.h"
+
+/** @typedef mesh_pack_t
+ * A cooked mesh pack, memory-mapped read-only. Opening one only validates
+ * its header and tables; the vertex and index blobs are paged in as they're
+ * read, so uploading them is bound by disk bandwidth.
+ */
+typedef struct mesh_pack_s mesh_pack_t;
+
+/** @function mesh_pack_open
+ * @return zero on success.
+ */
+int mesh_pack_open (mesh_pack_t **, const char *);
+
+/** @function mesh_pack_close
+ */
+void mesh_pack_close (mesh_pack_t *);
+
+/** @function mesh_pack_get_header
+ */
+const struct mesh_pack_header *mesh_pack_get_header (mesh_pack_t *);
+
+/** @function mesh_pack_get_meshes
+ */
+const struct mesh_pack_mesh *mesh_pack_get_meshes (mesh_pack_t *);
+
+/** @function mesh_pack_get_lods
+ */
+const struct mesh_pack_lod *mesh_pack_get_lods (mesh_pack_t *);
+
+/** @function mesh_pack_get_meshlets
+ */
+const struct mesh_pack_meshlet *mesh_pack_get_meshlets (mesh_pack_t *);
+
+/** @function mesh_pack_get_vertices
+ * @return the vertex blob, whose size is in the header.
+ */
+const void *mesh_pack_get_vertices (mesh_pack_t *);
+
+/** @function mesh_pack_get_indices
+ * @return the index blob of 32-bit indices, whose size is in the header.
+ */
+const void *mesh_pack_get_indices (mesh_pack_t *);
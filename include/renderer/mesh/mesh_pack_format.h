@@ -0,0 +1,97 @@
+/** @file mesh_pack_format.h
+ * The on-disk layout of mesh packs, shared by the cooking tool and the
+ * runtime. Everything is little-endian, and every section starts on a
+ * #MESH_PACK_ALIGNMENT boundary, so sections can be uploaded straight out
+ * of a memory-mapped file with no parsing or copying.
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint32_t, uint64_t */
+
+/* "MDOM" */
+#define MESH_PACK_MAGIC 0x4d4f444d
+#define MESH_PACK_VERSION 1
+
+/* at least any device's minStorageBufferOffsetAlignment */
+#define MESH_PACK_ALIGNMENT 256
+
+/* the most triangles in one meshlet */
+#define MESH_PACK_MESHLET_TRIANGLES 64
+
+struct mesh_pack_section
+{
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct mesh_pack_header
+{
+  uint32_t magic;
+  uint32_t version;
+
+  uint32_t mesh_num;
+  uint32_t lod_num;
+  uint32_t meshlet_num;
+  uint32_t vertex_num;
+  uint32_t index_num;
+  uint32_t padding;
+
+  /* arrays of the structs below, then the raw vertex and index blobs */
+  struct mesh_pack_section meshes;
+  struct mesh_pack_section lods;
+  struct mesh_pack_section meshlets;
+  struct mesh_pack_section vertices;
+  struct mesh_pack_section indices;
+};
+
+/**
+ * Laid out to match the mesh shaders' std430 storage buffer.
+ */
+struct mesh_pack_vertex
+{
+  float position[3];
+
+  /* snorm8 xyz, as read by unpackSnorm4x8 */
+  uint32_t normal;
+};
+
+struct mesh_pack_mesh
+{
+  /* a sphere bounding every LOD */
+  float center[3];
+  float radius;
+
+  /* LODs are ordered from most to least detailed */
+  uint32_t first_lod;
+  uint32_t lod_num;
+  uint32_t padding[2];
+};
+
+struct mesh_pack_lod
+{
+  /* a range of the index blob; indices are relative to vertex_offset */
+  uint32_t first_index;
+  uint32_t index_num;
+  int32_t vertex_offset;
+
+  uint32_t first_meshlet;
+  uint32_t meshlet_num;
+
+  /* how far, in object units, vertices moved from the full-detail mesh */
+  float error;
+  uint32_t padding[2];
+};
+
+/**
+ * A run of at most #MESH_PACK_MESHLET_TRIANGLES consecutive triangles in
+ * its LOD's indices, with bounds for culling.
+ */
+struct mesh_pack_meshlet
+{
+  float center[3];
+  float radius;
+  uint32_t first_index;
+  uint32_t triangle_num;
+  uint32_t padding[2];
+};
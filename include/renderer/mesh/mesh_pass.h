@@ -0,0 +1,71 @@
+/** @file mesh_pass.h
+ */
+
+#pragma once
+
+#include "renderer/indirect_draws.h"
+#include "renderer/mesh/mesh_frame_data.h"
+#include "renderer/mesh/mesh_instance.h"
+#include "renderer/render_phases.h"
+#include "renderer/renderer.h"
+
+/** @typedef mesh_pass_t
+ * Draws instances of the meshes in a cooked mesh pack. The pack's vertex
+ * and index blobs are streamed from the mapped file into device-local
+ * buffers, and vertices are pulled from a storage buffer, so every mesh and
+ * LOD shares one pipeline and one multi-draw.
+ */
+typedef struct mesh_pass_s mesh_pass_t;
+
+/** @function mesh_pass_new
+ * @param new_mp
+ * @param ren
+ * @param rp A single-view render pass, or VK_NULL_HANDLE.
+ * @param multiview_rp A stereo render pass, or VK_NULL_HANDLE.
+ */
+int mesh_pass_new (mesh_pass_t **, renderer_t *, VkRenderPass, VkRenderPass);
+
+/** @function mesh_pass_delete
+ */
+void mesh_pass_delete (mesh_pass_t *);
+
+/** @function mesh_pass_load
+ * Replaces the loaded meshes with a mesh pack's, and clears the instances.
+ * Waits for the GPU to go idle first.
+ * @return zero on success.
+ */
+int mesh_pass_load (mesh_pass_t *, const char *);
+
+/** @function mesh_pass_get_mesh_num
+ */
+uint32_t mesh_pass_get_mesh_num (mesh_pass_t *);
+
+/** @function mesh_pass_set_instances
+ * Replaces every instance. Waits for the GPU to go idle first, so this is
+ * for placing scenery rather than animating it.
+ * @return zero on success.
+ */
+int mesh_pass_set_instances (mesh_pass_t *, const mesh_instance_t *,
+                             uint32_t);
+
+/** @function mesh_frame_data_init
+ */
+int mesh_frame_data_init (mesh_pass_t *, struct mesh_frame_data *);
+
+/** @function mesh_frame_data_cleanup
+ */
+void mesh_frame_data_cleanup (mesh_pass_t *, struct mesh_frame_data *);
+
+/** @function mesh_pass_prepare
+ * Adds every instance's draw to the frame's indirect draws, and points the
+ * frame's descriptors at the mesh buffers. Called once per frame before
+ * rendering.
+ */
+void mesh_pass_prepare (mesh_pass_t *, struct mesh_frame_data *,
+                        indirect_draws_t *);
+
+/** @function mesh_pass_render
+ * Only records commands, so it may run on any recording thread.
+ */
+void mesh_pass_render (mesh_pass_t *, const struct render_context *,
+                       struct mesh_frame_data *);
@@ -0,0 +1,137 @@
+/** @file render_graph.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint32_t */
+
+#include "gpu/gpu_device.h"
+
+/** @typedef render_graph_t
+ * Orders a frame's passes and synchronizes the resources they share. Passes
+ * declare what they read and write, and compiling the graph culls passes
+ * that don't lead to an output, computes the barriers between passes, and
+ * places transient images in shared memory wherever their lifetimes don't
+ * overlap.
+ *
+ * A graph is rebuilt every frame, but transient images are kept for as long
+ * as their layout doesn't change.
+ */
+typedef struct render_graph_s render_graph_t;
+
+/** @typedef render_pass_callback_t
+ * Records a pass's commands. Barriers have already been recorded.
+ * @param userdata
+ * @param cmd
+ */
+typedef void (*render_pass_callback_t) (void *, VkCommandBuffer);
+
+/**
+ * How a pass accesses a resource. The layout is ignored for buffers.
+ */
+struct render_access
+{
+  VkPipelineStageFlags stage;
+  VkAccessFlags access;
+  VkImageLayout layout;
+};
+
+struct render_image_desc
+{
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t layer_num;
+  VkImageUsageFlags usage;
+  VkImageAspectFlags aspect;
+};
+
+/** @function render_graph_new
+ */
+int render_graph_new (render_graph_t **, gpu_device_t *);
+
+/** @function render_graph_delete
+ * The GPU must have finished with the graph's last execution.
+ */
+void render_graph_delete (render_graph_t *);
+
+/** @function render_graph_reset
+ * Removes every pass and resource so the graph can be built again.
+ */
+void render_graph_reset (render_graph_t *);
+
+/** @function render_graph_import_image
+ * Adds an image owned outside of the graph.
+ * @param graph
+ * @param image
+ * @param aspect
+ * @param initial The last access before the graph runs.
+ * @param final The access the image is left ready for.
+ * @return a resource handle, or -1 on failure.
+ */
+int render_graph_import_image (render_graph_t *, VkImage, VkImageAspectFlags,
+                               const struct render_access *,
+                               const struct render_access *);
+
+/** @function render_graph_import_buffer
+ * Like #render_graph_import_image, for a whole buffer.
+ */
+int render_graph_import_buffer (render_graph_t *, VkBuffer,
+                                const struct render_access *,
+                                const struct render_access *);
+
+/** @function render_graph_create_image
+ * Adds an image that only lives for the duration of the graph. Its contents
+ * are undefined before its first write.
+ * @return a resource handle, or -1 on failure.
+ */
+int render_graph_create_image (render_graph_t *,
+                               const struct render_image_desc *);
+
+/** @function render_graph_add_pass
+ * Passes run in the order they are added.
+ * @param graph
+ * @param name Must point to static storage.
+ * @param callback
+ * @param userdata Must stay valid until the graph is executed.
+ * @return a pass handle, or -1 on failure.
+ */
+int render_graph_add_pass (render_graph_t *, const char *,
+                           render_pass_callback_t, void *);
+
+/** @function render_graph_read
+ * @param graph
+ * @param pass
+ * @param resource
+ * @param access
+ */
+void render_graph_read (render_graph_t *, int, int,
+                        const struct render_access *);
+
+/** @function render_graph_write
+ */
+void render_graph_write (render_graph_t *, int, int,
+                         const struct render_access *);
+
+/** @function render_graph_mark_output
+ * Marks a resource as a result of the graph. Passes that don't write to an
+ * output, directly or through the resources they feed, are culled.
+ */
+void render_graph_mark_output (render_graph_t *, int);
+
+/** @function render_graph_get_image_view
+ * Transient images only. Valid once the graph has been compiled.
+ */
+VkImageView render_graph_get_image_view (render_graph_t *, int);
+
+/** @function render_graph_compile
+ * The GPU must have finished with the graph's previous execution.
+ * @return zero on success.
+ */
+int render_graph_compile (render_graph_t *);
+
+/** @function render_graph_execute
+ * Records every live pass and its barriers into a command buffer, followed
+ * by the transitions of imported resources to their final access.
+ */
+void render_graph_execute (render_graph_t *, VkCommandBuffer);
@@ -3,7 +3,10 @@
 
 #pragma once
 
+#include <stdint.h> /* for uint32_t */
+
 #include "renderer/camera.h"
+#include "renderer/indirect_draws.h"
 
 #define MAX_FRAMES_IN_FLIGHT 4
 
@@ -12,5 +15,15 @@ struct render_context
   VkCommandBuffer cmd;
   camera_t *camera;
   int viewport_index;
+
+  /* more than one means the render pass is multiview */
+  int view_num;
+
   VkDescriptorSet viewport_set;
+
+  /* dynamic offset of this viewport's uniform within viewport_set */
+  uint32_t viewport_offset;
+
+  /* the frame's uploaded draw commands */
+  indirect_draws_t *draws;
 };
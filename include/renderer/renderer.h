@@ -3,22 +3,147 @@
 
 #pragma once
 
+#include <stdint.h> /* for uint64_t */
+
+#include "frame_stats.h"
 #include "gpu/gpu_device.h"
+#include "gpu/gpu_profiler.h"
 #include "renderer/debug/debug_draw.h"
+#include "renderer/debug/debug_vertex.h"
 #include "renderer/camera.h"
+#include "renderer/frame_capture.h"
+#include "renderer/mesh/mesh_instance.h"
+#include "renderer/stars/star_instance.h"
 
 /** @typedef renderer_t
  */
 typedef struct renderer_s renderer_t;
 
+enum renderer_latency_mode
+{
+  /**
+   * Queues frames up to the frames-in-flight limit, keeping the GPU busy at
+   * the cost of input latency.
+   */
+  RENDERER_LATENCY_THROUGHPUT,
+
+  /**
+   * Waits for the previous frame to finish before input is sampled, so each
+   * frame is rendered from the freshest input possible.
+   */
+  RENDERER_LATENCY_LOW,
+};
+
+struct renderer_config
+{
+  gpu_device_t *gpu;
+
+  /**
+   * TODO(marceline-cramer): The render pass is passed in so that pipelines
+   * for each render pass can be created ahead of time. A pipeline creation
+   * abstraction object is needed so that renderer render pass coupling can be
+   * deferred until #renderer_render_frame, where the renderer actually
+   * receives the cameras and by association render passes.
+   */
+  VkRenderPass rp;
+
+  /**
+   * The render pass of a stereo camera, if any are going to be rendered.
+   * Either this or rp may be VK_NULL_HANDLE, but not both.
+   */
+  VkRenderPass multiview_rp;
+
+  /**
+   * How many frames may be recorded or rendering at once, from 1 to
+   * MAX_FRAMES_IN_FLIGHT. If zero, a default for the latency mode is used.
+   */
+  int frames_in_flight;
+
+  enum renderer_latency_mode latency_mode;
+
+  /**
+   * If not null, the renderer times its stages into the current frame, and
+   * measures each frame's latency up to presentation where the device
+   * supports present waits, or GPU completion otherwise. Viewports presented
+   * to must outlive the renderer.
+   */
+  frame_stats_t *frame_stats;
+
+  /**
+   * If positive, dynamic resolution viewports are scaled every frame to keep
+   * the GPU time of each frame within this many milliseconds. Needs GPU
+   * timestamp support.
+   */
+  float gpu_budget_ms;
+
+  /**
+   * The smallest fraction of each dimension dynamic resolution may scale
+   * down to. If zero, a default is used.
+   */
+  float min_render_scale;
+
+  /**
+   * How debug draw vertices are packed for the GPU.
+   */
+  enum debug_vertex_format debug_vertex_format;
+
+  /**
+   * If non-zero, debug vertices are fetched from a storage buffer by the
+   * vertex shader instead of through fixed-function vertex input.
+   */
+  int debug_vertex_pulling;
+
+  /**
+   * If non-zero, rp and multiview_rp have reversed-Z depth attachments, and
+   * debug draws and stars are depth-tested against each other.
+   */
+  int has_depth;
+};
+
+/**
+ * CPU-side frame pacing, measured the same way in every latency mode.
+ */
+struct renderer_frame_stats
+{
+  /**
+   * Counts up from one for every frame begun.
+   */
+  uint64_t frame;
+
+  /**
+   * Time between the beginnings of this frame and the previous one.
+   */
+  double frame_time_ms;
+
+  /**
+   * Time spent blocked on the GPU before the frame could begin.
+   */
+  double wait_ms;
+
+  /**
+   * Time from the frame beginning, where input is sampled, to its submission.
+   */
+  double input_to_submit_ms;
+
+  /**
+   * Time spent recording and submitting the frame.
+   */
+  double record_ms;
+
+  /**
+   * The number of frames still on the GPU when this one began.
+   */
+  int queued_frames;
+
+  /**
+   * The scale dynamic resolution viewports were rendered at.
+   */
+  float render_scale;
+};
+
 /** @function renderer_new
- * TODO(marceline-cramer): The render pass is passed in so that pipelines for
- * each render pass can be created ahead of time. A pipeline creation
- * abstraction object is needed so that renderer render pass coupling can be
- * deferred until #renderer_render_frame, where the renderer actually receives
- * the cameras and by association render passes.
  */
-int renderer_new (renderer_t **, gpu_device_t *, VkRenderPass);
+int renderer_new (renderer_t **, const struct renderer_config *);
 
 /** @function renderer_delete
  */
@@ -36,6 +161,81 @@ debug_draw_list_t *renderer_get_debug_draw_list (renderer_t *);
  */
 VkDescriptorSetLayout renderer_get_viewport_layout (renderer_t *);
 
+/** @function renderer_has_depth
+ * @return non-zero if the renderer's render passes have depth attachments.
+ */
+int renderer_has_depth (renderer_t *);
+
+/** @function renderer_add_capture
+ * Starts capturing the capture's viewport every frame it's rendered. The
+ * capture must be removed before it's deleted.
+ * @return zero on success.
+ */
+int renderer_add_capture (renderer_t *, frame_capture_t *);
+
+/** @function renderer_remove_capture
+ */
+void renderer_remove_capture (renderer_t *, frame_capture_t *);
+
+/** @function renderer_set_debug_vertex_format
+ * Changes how debug draw vertices are packed, overriding the config.
+ * @return zero on success.
+ */
+int renderer_set_debug_vertex_format (renderer_t *, enum debug_vertex_format);
+
+/** @function renderer_set_stars
+ * Replaces the star field. Stars are culled on the GPU every frame, so this
+ * is only needed when the catalog itself changes, and stalls until the GPU
+ * is idle.
+ * @return zero on success.
+ */
+int renderer_set_stars (renderer_t *, const star_instance_t *, uint32_t);
+
+/** @function renderer_load_meshes
+ * Replaces the loaded meshes with a cooked mesh pack's, streaming it into
+ * GPU memory. Clears the mesh instances, and stalls until the GPU is idle.
+ * @return zero on success.
+ */
+int renderer_load_meshes (renderer_t *, const char *);
+
+/** @function renderer_get_mesh_num
+ * @return how many meshes the loaded mesh pack has.
+ */
+uint32_t renderer_get_mesh_num (renderer_t *);
+
+/** @function renderer_set_mesh_instances
+ * Replaces the placed instances of the loaded meshes. Stalls until the GPU
+ * is idle.
+ * @return zero on success.
+ */
+int renderer_set_mesh_instances (renderer_t *, const mesh_instance_t *,
+                                 uint32_t);
+
+/** @function renderer_begin_frame
+ * Waits until a frame slot is free, plus the previous frame in low-latency
+ * mode. Call this right before sampling input. Does nothing if the current
+ * frame has already begun.
+ */
+void renderer_begin_frame (renderer_t *);
+
 /** @function renderer_render_frame
+ * Begins the frame first if #renderer_begin_frame hasn't been called.
  */
 void renderer_render_frame (renderer_t *, camera_t **, int);
+
+/** @function renderer_get_frame_value
+ * @return the GPU timeline value signaled once the most recently submitted
+ * frame has finished rendering. Poll it with #gpu_timeline_is_complete.
+ */
+uint64_t renderer_get_frame_value (renderer_t *);
+
+/** @function renderer_get_gpu_stats
+ * @return GPU timings of the most recently resolved frame. Results lag a few
+ * frames behind the frame being recorded.
+ */
+const struct gpu_frame_stats *renderer_get_gpu_stats (renderer_t *);
+
+/** @function renderer_get_frame_stats
+ * @return pacing of the most recently submitted frame.
+ */
+const struct renderer_frame_stats *renderer_get_frame_stats (renderer_t *);
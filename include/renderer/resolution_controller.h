@@ -0,0 +1,59 @@
+/** @file resolution_controller.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint64_t */
+
+#include "gpu/gpu_profiler.h"
+
+/** @typedef resolution_controller_t
+ * Picks the render scale of dynamic resolution viewports from measured GPU
+ * frame times, so frames stay within a fixed GPU time budget. Frame times
+ * are assumed to grow with the number of pixels rendered. Scales drop as
+ * soon as a frame runs over budget, but only climb back gradually, so load
+ * spikes are absorbed without the resolution oscillating.
+ */
+typedef struct resolution_controller_s resolution_controller_t;
+
+struct resolution_controller_config
+{
+  /**
+   * The GPU time each frame should fit in, in milliseconds.
+   */
+  float budget_ms;
+
+  /**
+   * The smallest scale of each viewport dimension. If zero, a default is
+   * used.
+   */
+  float min_scale;
+};
+
+/** @function resolution_controller_new
+ */
+int resolution_controller_new (resolution_controller_t **,
+                               const struct resolution_controller_config *);
+
+/** @function resolution_controller_delete
+ */
+void resolution_controller_delete (resolution_controller_t *);
+
+/** @function resolution_controller_update
+ * Feeds in the GPU profiler's most recent results, which are skipped if
+ * they've already been seen.
+ * @return the scale to render the next frame at.
+ */
+float resolution_controller_update (resolution_controller_t *,
+                                    const struct gpu_frame_stats *);
+
+/** @function resolution_controller_mark_frame
+ * Records the scale a GPU profiler frame is rendered at, so its results can
+ * be compared against the scale that produced them.
+ */
+void resolution_controller_mark_frame (resolution_controller_t *, uint64_t,
+                                       float);
+
+/** @function resolution_controller_get_scale
+ */
+float resolution_controller_get_scale (resolution_controller_t *);
@@ -0,0 +1,40 @@
+/** @file star_frame_data.h
+ */
+
+#pragma once
+
+#include <stdint.h> /* for uint32_t */
+#include <vulkan/vulkan.h>
+
+#include "gpu/gpu_vector.h"
+
+struct star_draw
+{
+  /* the draw's batch in the frame's indirect draws, and its command */
+  int batch;
+  uint32_t command_index;
+
+  uint32_t viewport_offset;
+  uint32_t view_num;
+  float viewport_height;
+};
+
+struct star_frame_data
+{
+  /* indices of the stars surviving culling, one visible_capacity run per
+   * draw; only ever written by culling, so it's device-local */
+  gpu_vector_t *visible;
+
+  VkDescriptorPool descriptor_pool;
+  VkDescriptorSet set;
+
+  /* indexed by the render context's viewport index */
+  struct star_draw *draws;
+  int draw_num;
+  int draw_capacity;
+
+  /* the star count when this frame was prepared, and how many of them each
+   * draw has room for */
+  uint32_t star_num;
+  uint32_t visible_capacity;
+};
@@ -0,0 +1,15 @@
+/** @file star_instance.h
+ */
+
+#pragma once
+
+/** @typedef star_instance_t
+ * Laid out to match the star shaders' std430 storage buffer.
+ */
+typedef struct star_instance_t
+{
+  float position[3];
+  float radius;
+  float color[3];
+  float padding;
+} star_instance_t;
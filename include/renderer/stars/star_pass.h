@@ -0,0 +1,94 @@
+/** @file star_pass.h
+ */
+
+#pragma once
+
+#include "renderer/indirect_draws.h"
+#include "renderer/render_phases.h"
+#include "renderer/renderer.h"
+#include "renderer/stars/star_frame_data.h"
+#include "renderer/stars/star_instance.h"
+#include "renderer/viewport.h"
+
+/** @typedef star_pass_t
+ * Draws every star as an instanced billboard. Each frame a compute shader
+ * culls the stars against every viewport's frustum, drops the ones too small
+ * to see, and compacts the survivors into that viewport's indirect draw, so
+ * the CPU never touches individual stars.
+ */
+typedef struct star_pass_s star_pass_t;
+
+/** @function star_pass_new
+ * @param new_sp
+ * @param ren
+ * @param rp A single-view render pass, or VK_NULL_HANDLE.
+ * @param multiview_rp A stereo render pass, or VK_NULL_HANDLE.
+ */
+int star_pass_new (star_pass_t **, renderer_t *, VkRenderPass, VkRenderPass);
+
+/** @function star_pass_delete
+ */
+void star_pass_delete (star_pass_t *);
+
+/** @function star_pass_set_stars
+ * Replaces every star. Waits for the GPU to go idle first, so this is for
+ * loading catalogs rather than animating them.
+ * @return zero on success.
+ */
+int star_pass_set_stars (star_pass_t *, const star_instance_t *, uint32_t);
+
+/** @function star_frame_data_init
+ */
+int star_frame_data_init (star_pass_t *, struct star_frame_data *);
+
+/** @function star_frame_data_cleanup
+ */
+void star_frame_data_cleanup (star_pass_t *, struct star_frame_data *);
+
+/** @function star_pass_prepare
+ * Starts a frame's draws. Called once per frame before rendering.
+ */
+void star_pass_prepare (star_pass_t *, struct star_frame_data *);
+
+/** @function star_pass_add_viewport
+ * Adds a viewport's draw to the frame's indirect draws, with no instances
+ * until the stars are culled. Must be called for each viewport in the order
+ * of their render context viewport indices.
+ * @param sp
+ * @param frame
+ * @param draws
+ * @param vp
+ * @param viewport_offset The viewport's dynamic uniform offset.
+ */
+void star_pass_add_viewport (star_pass_t *, struct star_frame_data *,
+                             indirect_draws_t *, viewport_t *, uint32_t);
+
+/** @function star_pass_update
+ * Points the frame's descriptors at its buffers. Called after the indirect
+ * draws are uploaded, and before any commands using them are recorded.
+ * @return zero on success.
+ */
+int star_pass_update (star_pass_t *, struct star_frame_data *,
+                      indirect_draws_t *);
+
+/** @function star_pass_has_work
+ * @return non-zero if the frame has stars to cull and draw.
+ */
+int star_pass_has_work (star_pass_t *, struct star_frame_data *);
+
+/** @function star_pass_cull
+ * Records the culling dispatches. The indirect draw commands and the visible
+ * buffer must then be synchronized before any viewport is drawn.
+ * @param sp
+ * @param frame
+ * @param cmd
+ * @param viewport_set The frame's viewport descriptor set.
+ */
+void star_pass_cull (star_pass_t *, struct star_frame_data *, VkCommandBuffer,
+                     VkDescriptorSet);
+
+/** @function star_pass_render
+ * Only records commands, so it may run on any recording thread.
+ */
+void star_pass_render (star_pass_t *, const struct render_context *,
+                       struct star_frame_data *);
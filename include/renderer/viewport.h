@@ -5,10 +5,17 @@
 
 #include "gpu/gpu_device.h"
 
+#include <stddef.h> /* for size_t */
+#include <stdint.h> /* for uint64_t */
 #include <vulkan/vulkan_core.h> /* for VkSurfaceKHR, VkSwapchainKHR */
 
 #include "renderer/viewport_uniform.h"
 
+struct render_image_desc;
+
+/* forward declarations */
+struct viewport_atlas_s;
+
 /** @typedef viewport_t
  */
 typedef struct viewport_s viewport_t;
@@ -16,11 +23,64 @@ typedef struct viewport_s viewport_t;
 enum viewport_type
 {
   VIEWPORT_TYPE_SURFACE,
+  VIEWPORT_TYPE_OFFSCREEN,
+
+  /**
+   * A region of a shared viewport atlas. Has no images of its own.
+   */
+  VIEWPORT_TYPE_ATLAS,
+};
+
+enum viewport_present_mode
+{
+  /**
+   * Waits for vertical blank. Never tears, but queues up the most latency.
+   */
+  VIEWPORT_PRESENT_MODE_FIFO,
+
+  /**
+   * Replaces the queued image with newer ones, falling back to FIFO.
+   */
+  VIEWPORT_PRESENT_MODE_MAILBOX,
+
+  /**
+   * Presents right away and may tear, falling back to mailbox, then FIFO.
+   */
+  VIEWPORT_PRESENT_MODE_IMMEDIATE,
 };
 
 struct viewport_surface_config
 {
   VkSurfaceKHR surface;
+  enum viewport_present_mode present_mode;
+
+  /**
+   * The number of swapchain images to ask for, clamped to what the surface
+   * supports. If zero, a default is used.
+   */
+  int image_num;
+};
+
+struct viewport_offscreen_config
+{
+  /**
+   * The number of images to cycle through. If zero, a default is used.
+   */
+  int image_num;
+
+  /**
+   * If non-zero, each rendered image is copied to host-visible memory, and
+   * can be read back with #viewport_read_pixels once the GPU is finished.
+   */
+  int readback;
+};
+
+struct viewport_atlas_region_config
+{
+  /**
+   * The atlas to allocate the viewport's width by height region from.
+   */
+  struct viewport_atlas_s *atlas;
 };
 
 struct viewport_config
@@ -30,9 +90,37 @@ struct viewport_config
   int width;
   int height;
 
+  /**
+   * How many views are rendered at once, each into its own image layer. If
+   * zero, there is one. Multiple views need a multiview render pass and are
+   * only supported offscreen. Stereo cameras set this themselves.
+   */
+  int view_num;
+
+  /**
+   * The distance between the eyes of a two-view viewport, in world units.
+   */
+  float eye_separation;
+
+  /**
+   * If non-zero, the viewport is rendered into a target of its own at the
+   * scale set by #viewport_set_render_scale, then upscaled into its image by
+   * #viewport_record_upscale. Not supported by atlas viewports, and turned
+   * off for surfaces that can't be blitted into.
+   */
+  int dynamic_resolution;
+
+  /**
+   * The render pass's depth attachment format, or VK_FORMAT_UNDEFINED if it
+   * has none. Cameras fill this in for their viewports.
+   */
+  VkFormat depth_format;
+
   union
   {
     struct viewport_surface_config surface;
+    struct viewport_offscreen_config offscreen;
+    struct viewport_atlas_region_config atlas;
   } sub;
 };
 
@@ -45,19 +133,67 @@ int viewport_new (viewport_t **, VkRenderPass, const struct viewport_config *);
 void viewport_delete (viewport_t *);
 
 /** @function viewport_write_uniform
+ * Writes one view per layer; the rest are left untouched.
  */
 void viewport_write_uniform (viewport_t *, viewport_uniform_t *);
 
 /** @function viewport_acquire
- * @param Non-zero if the swapchain has been acquired.
+ * @param viewport
+ * @param frame_index The renderer's frame slot, which picks the semaphore
+ * signaled on acquisition. The slot's previous submission must have finished.
+ * @return non-zero if the swapchain has been acquired.
+ */
+int viewport_acquire (viewport_t *, int);
+
+/** @function viewport_get_type
+ */
+enum viewport_type viewport_get_type (viewport_t *);
+
+/** @function viewport_get_view_num
+ */
+int viewport_get_view_num (viewport_t *);
+
+/** @function viewport_get_extent
+ * @return the size drawn to, which for atlas viewports is their region's.
+ */
+VkExtent2D viewport_get_extent (viewport_t *);
+
+/** @function viewport_get_render_extent
+ * @return the size actually rendered at, which is smaller than
+ * #viewport_get_extent when dynamic resolution scales it down.
+ */
+VkExtent2D viewport_get_render_extent (viewport_t *);
+
+/** @function viewport_set_render_scale
+ * Sets the fraction of each dimension that's rendered, from 0.25 to 1. Has
+ * no effect without dynamic resolution.
+ */
+void viewport_set_render_scale (viewport_t *, float);
+
+/** @function viewport_get_atlas
+ * @return the atlas an atlas viewport is drawn into, or NULL for other types.
+ */
+struct viewport_atlas_s *viewport_get_atlas (viewport_t *);
+
+/** @function viewport_get_atlas_rect
+ * @return the atlas viewport's region of its atlas.
  */
-int viewport_acquire (viewport_t *);
+VkRect2D viewport_get_atlas_rect (viewport_t *);
 
 /** @function viewport_get_swapchain
+ * @return the swapchain to present to, or VK_NULL_HANDLE if there is none.
  */
 VkSwapchainKHR viewport_get_swapchain (viewport_t *);
 
+/** @function viewport_owns_swapchain
+ * Retired swapchains may be destroyed at any time, so check this before
+ * using a swapchain handle kept from an earlier frame.
+ * @return non-zero if the swapchain is the viewport's current one.
+ */
+int viewport_owns_swapchain (viewport_t *, VkSwapchainKHR);
+
 /** @function viewport_get_on_acquire
+ * @return the semaphore to wait on before rendering, or VK_NULL_HANDLE.
  */
 VkSemaphore viewport_get_on_acquire (viewport_t *);
 
@@ -65,6 +201,110 @@ VkSemaphore viewport_get_on_acquire (viewport_t *);
  */
 int viewport_get_image_index (viewport_t *);
 
+/** @function viewport_get_render_pass
+ */
+VkRenderPass viewport_get_render_pass (viewport_t *);
+
+/** @function viewport_get_framebuffer
+ * @return the viewport's imageless framebuffer, shared by all its images.
+ */
+VkFramebuffer viewport_get_framebuffer (viewport_t *);
+
+/** @function viewport_get_depth_desc
+ * Describes the depth attachment that the render graph creates for the
+ * viewport every frame.
+ * @return non-zero if the viewport's render pass has a depth attachment.
+ */
+int viewport_get_depth_desc (viewport_t *, struct render_image_desc *);
+
 /** @function viewport_begin_render_pass
+ * Inline render passes also get their viewport and scissor set here.
+ * @param viewport
+ * @param cmd
+ * @param depth_view A view of the image described by
+ * #viewport_get_depth_desc, or VK_NULL_HANDLE if there is none.
+ * @param contents Whether the subpass is recorded inline or in secondaries.
+ */
+void viewport_begin_render_pass (viewport_t *, VkCommandBuffer, VkImageView,
+                                 VkSubpassContents);
+
+/** @function viewport_set_dynamic_state
+ * Sets the viewport and scissor to cover the whole viewport, which for atlas
+ * viewports is only their region.
+ */
+void viewport_set_dynamic_state (viewport_t *, VkCommandBuffer);
+
+/** @function viewport_get_image
+ * @return the currently acquired image.
+ */
+VkImage viewport_get_image (viewport_t *);
+
+/** @function viewport_get_scaled_image
+ * @return the current image's dynamic resolution target, or VK_NULL_HANDLE
+ * if the viewport is rendered into its image directly.
+ */
+VkImage viewport_get_scaled_image (viewport_t *);
+
+/** @function viewport_record_upscale
+ * Blits the rendered part of the scaled image over the whole current image.
+ * The scaled image must be in TRANSFER_SRC_OPTIMAL, and the image in
+ * TRANSFER_DST_OPTIMAL.
+ */
+void viewport_record_upscale (viewport_t *, VkCommandBuffer);
+
+/** @function viewport_get_readback_buffer
+ * @return the current image's readback buffer, or VK_NULL_HANDLE if the
+ * viewport isn't read back.
+ */
+VkBuffer viewport_get_readback_buffer (viewport_t *);
+
+/** @function viewport_record_readback
+ * Copies the current image into its readback buffer. The image must be in
+ * TRANSFER_SRC_OPTIMAL.
+ */
+void viewport_record_readback (viewport_t *, VkCommandBuffer);
+
+/** @function viewport_is_copyable
+ * @return non-zero if the viewport's images can be copied out of, which
+ * surfaces only allow on some platforms, and atlas regions never do.
+ */
+int viewport_is_copyable (viewport_t *);
+
+/** @function viewport_record_copy
+ * Like #viewport_record_readback, but into any buffer big enough for every
+ * view's layer, as tightly packed BGRA8 pixels.
+ */
+void viewport_record_copy (viewport_t *, VkCommandBuffer, VkBuffer);
+
+/** @function viewport_present_result
+ * Reports the result of presenting this viewport's swapchain, so suboptimal
+ * or out-of-date swapchains are recreated on the next acquisition.
+ */
+void viewport_present_result (viewport_t *, VkResult);
+
+/** @function viewport_abandon_image
+ * Gives up on presenting the acquired swapchain image. It can't be released
+ * on its own, so the swapchain is recreated on the next acquisition.
+ */
+void viewport_abandon_image (viewport_t *);
+
+/** @function viewport_resize
+ * Recreates the swapchain at a new size on the next acquisition, without
+ * waiting on frames in flight. Surface viewports only.
+ */
+int viewport_resize (viewport_t *, int, int);
+
+/** @function viewport_mark_submitted
+ * Tells the viewport which GPU timeline value its current image's rendering
+ * will be finished at.
+ */
+void viewport_mark_submitted (viewport_t *, uint64_t);
+
+/** @function viewport_read_pixels
+ * Copies the most recently finished readback into host memory, as tightly
+ * packed BGRA8 pixels with each view's layer after the last. Never waits on
+ * the GPU.
+ * @return the timeline value of the frame that was read, or zero if no
+ * readback has finished yet.
  */
-void viewport_begin_render_pass (viewport_t *, VkCommandBuffer);
+uint64_t viewport_read_pixels (viewport_t *, void *, size_t);
@@ -0,0 +1,71 @@
+/** @file viewport_atlas.h
+ */
+
+#pragma once
+
+#include "gpu/gpu_device.h"
+#include "renderer/viewport.h"
+
+/** @typedef viewport_atlas_t
+ * A shared offscreen image that many small viewports render into, each to
+ * its own region. The renderer draws every viewport in an atlas in a single
+ * render pass, switching regions with the viewport and scissor, so lots of
+ * minimaps or thumbnails cost one pass instead of one each.
+ *
+ * The whole atlas is cleared when it's rendered, so every viewport in it
+ * should be rendered in the same frames.
+ */
+typedef struct viewport_atlas_s viewport_atlas_t;
+
+struct viewport_atlas_config
+{
+  gpu_device_t *gpu;
+  int width;
+  int height;
+
+  /**
+   * The number of images to cycle through. If zero, a default is used.
+   */
+  int image_num;
+
+  /**
+   * If non-zero, the whole atlas is read back like an offscreen viewport.
+   */
+  int readback;
+
+  /**
+   * The depth format of the render pass, as for #viewport_config.
+   */
+  VkFormat depth_format;
+};
+
+/** @function viewport_atlas_new
+ * @param new_atlas
+ * @param rp A single-view render pass compatible with the cameras drawing
+ * into the atlas.
+ * @param config
+ */
+int viewport_atlas_new (viewport_atlas_t **, VkRenderPass,
+                        const struct viewport_atlas_config *);
+
+/** @function viewport_atlas_delete
+ * Viewports in the atlas must be deleted first.
+ */
+void viewport_atlas_delete (viewport_atlas_t *);
+
+/** @function viewport_atlas_allocate
+ * Packs a region into the atlas, on the first shelf of rows it fits on.
+ * @return zero on success, or non-zero if the atlas is full.
+ */
+int viewport_atlas_allocate (viewport_atlas_t *, int, int, VkRect2D *);
+
+/** @function viewport_atlas_free
+ * Space is reclaimed once every region on the same shelf has been freed.
+ */
+void viewport_atlas_free (viewport_atlas_t *, const VkRect2D *);
+
+/** @function viewport_atlas_get_viewport
+ * @return the offscreen viewport holding the atlas's images, for reading
+ * back or sampling them.
+ */
+viewport_t *viewport_atlas_get_viewport (viewport_atlas_t *);
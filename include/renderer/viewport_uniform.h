@@ -5,10 +5,22 @@
 
 #include <cglm/cglm.h>
 
-/** @typedef viewport_uniform_t
+/* stereo viewports render both eyes at once with multiview */
+#define MAX_VIEWPORT_VIEWS 2
+
+/** @typedef viewport_view_t
  */
-typedef struct viewport_uniform_s
+typedef struct viewport_view_s
 {
   mat4 projection_mat;
   mat4 view_mat;
+} viewport_view_t;
+
+/** @typedef viewport_uniform_t
+ * Single-view shaders only declare the first view, which is laid out the
+ * same way on its own.
+ */
+typedef struct viewport_uniform_s
+{
+  viewport_view_t views[MAX_VIEWPORT_VIEWS];
 } viewport_uniform_t;
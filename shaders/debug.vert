@@ -9,6 +9,13 @@ layout (set = 0, binding = 0) uniform ViewportUniform
   mat4 view_mat;
 } viewport;
 
+/* packed vertex positions are decoded as origin + position * scale */
+layout (push_constant) uniform DebugConstants
+{
+  vec4 origin;
+  vec4 scale;
+} constants;
+
 layout (location = 0) in vec3 vert_position;
 layout (location = 1) in vec3 vert_color;
 
@@ -17,6 +24,7 @@ layout (location = 0) out vec3 frag_color;
 void
 main ()
 {
-  gl_Position = viewport.projection_mat * viewport.view_mat * vec4 (vert_position, 1.0);
+  vec3 position = constants.origin.xyz + vert_position * constants.scale.xyz;
+  gl_Position = viewport.projection_mat * viewport.view_mat * vec4 (position, 1.0);
   frag_color = vert_color;
 }
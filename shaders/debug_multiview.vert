@@ -0,0 +1,38 @@
+/** @file debug_multiview.vert
+ */
+
+#version 450
+
+#extension GL_EXT_multiview : require
+
+struct ViewportView
+{
+  mat4 projection_mat;
+  mat4 view_mat;
+};
+
+layout (set = 0, binding = 0) uniform ViewportUniform
+{
+  ViewportView views[2];
+} viewport;
+
+/* packed vertex positions are decoded as origin + position * scale */
+layout (push_constant) uniform DebugConstants
+{
+  vec4 origin;
+  vec4 scale;
+} constants;
+
+layout (location = 0) in vec3 vert_position;
+layout (location = 1) in vec3 vert_color;
+
+layout (location = 0) out vec3 frag_color;
+
+void
+main ()
+{
+  ViewportView view = viewport.views[gl_ViewIndex];
+  vec3 position = constants.origin.xyz + vert_position * constants.scale.xyz;
+  gl_Position = view.projection_mat * view.view_mat * vec4 (position, 1.0);
+  frag_color = vert_color;
+}
@@ -0,0 +1,73 @@
+/** @file debug_pull.vert
+ */
+
+#version 450
+
+/* matches enum debug_vertex_format */
+#define FORMAT_FLOAT 0
+#define FORMAT_HALF 1
+#define FORMAT_SNORM16 2
+
+layout (constant_id = 0) const uint VERTEX_FORMAT = FORMAT_FLOAT;
+
+layout (set = 0, binding = 0) uniform ViewportUniform
+{
+  mat4 projection_mat;
+  mat4 view_mat;
+} viewport;
+
+/* vertices are fetched by index instead of through vertex input, so one
+ * pipeline can read any layout */
+layout (std430, set = 1, binding = 0) readonly buffer DebugVertices
+{
+  uint words[];
+} vertices;
+
+/* packed vertex positions are decoded as origin + position * scale */
+layout (push_constant) uniform DebugConstants
+{
+  vec4 origin;
+  vec4 scale;
+} constants;
+
+layout (location = 0) out vec3 frag_color;
+
+void
+fetch_vertex (uint index, out vec3 position, out vec3 color)
+{
+  if (VERTEX_FORMAT == FORMAT_FLOAT)
+    {
+      uint base = index * 6;
+      position = uintBitsToFloat (uvec3 (vertices.words[base],
+                                         vertices.words[base + 1],
+                                         vertices.words[base + 2]));
+      color = uintBitsToFloat (uvec3 (vertices.words[base + 3],
+                                      vertices.words[base + 4],
+                                      vertices.words[base + 5]));
+      return;
+    }
+
+  /* four 16-bit position components, then RGBA8 */
+  uint base = index * 3;
+  uint xy = vertices.words[base];
+  uint zw = vertices.words[base + 1];
+
+  if (VERTEX_FORMAT == FORMAT_HALF)
+    position = vec3 (unpackHalf2x16 (xy), unpackHalf2x16 (zw).x);
+  else
+    position = vec3 (unpackSnorm2x16 (xy), unpackSnorm2x16 (zw).x);
+
+  color = unpackUnorm4x8 (vertices.words[base + 2]).rgb;
+}
+
+void
+main ()
+{
+  vec3 vert_position;
+  vec3 vert_color;
+  fetch_vertex (uint (gl_VertexIndex), vert_position, vert_color);
+
+  vec3 position = constants.origin.xyz + vert_position * constants.scale.xyz;
+  gl_Position = viewport.projection_mat * viewport.view_mat * vec4 (position, 1.0);
+  frag_color = vert_color;
+}
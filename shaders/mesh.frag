@@ -0,0 +1,20 @@
+/** @file mesh.frag
+ */
+
+#version 450
+
+layout (location = 0) in vec3 frag_color;
+layout (location = 1) in vec3 frag_normal;
+
+layout (location = 0) out vec4 out_color;
+
+/* a fixed key light, until the renderer has lights of its own */
+const vec3 LIGHT_DIRECTION = vec3 (0.267, 0.802, 0.535);
+const float AMBIENT = 0.2;
+
+void
+main ()
+{
+  float diffuse = max (dot (normalize (frag_normal), LIGHT_DIRECTION), 0.0);
+  out_color = vec4 (frag_color * (AMBIENT + diffuse * (1.0 - AMBIENT)), 1.0);
+}
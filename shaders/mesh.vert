@@ -0,0 +1,56 @@
+/** @file mesh.vert
+ */
+
+#version 450
+
+layout (set = 0, binding = 0) uniform ViewportUniform
+{
+  mat4 projection_mat;
+  mat4 view_mat;
+} viewport;
+
+/* matches struct mesh_pack_vertex */
+struct MeshVertex
+{
+  vec3 position;
+  uint normal;
+};
+
+/* matches mesh_instance_t */
+struct MeshInstance
+{
+  vec3 position;
+  float scale;
+  vec3 color;
+  uint mesh;
+  uint lod;
+};
+
+/* vertices are fetched by index, which already includes the LOD's vertex
+ * offset, so every mesh shares one buffer and one pipeline */
+layout (std430, set = 1, binding = 0) readonly buffer MeshVertices
+{
+  MeshVertex vertices[];
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer MeshInstances
+{
+  MeshInstance instances[];
+};
+
+layout (location = 0) out vec3 frag_color;
+layout (location = 1) out vec3 frag_normal;
+
+void
+main ()
+{
+  MeshVertex vertex = vertices[gl_VertexIndex];
+  MeshInstance instance = instances[gl_InstanceIndex];
+
+  /* instances are only translated and uniformly scaled */
+  vec3 position = instance.position + vertex.position * instance.scale;
+
+  gl_Position = viewport.projection_mat * viewport.view_mat * vec4 (position, 1.0);
+  frag_color = instance.color;
+  frag_normal = unpackSnorm4x8 (vertex.normal).xyz;
+}
@@ -0,0 +1,59 @@
+/** @file mesh_multiview.vert
+ */
+
+#version 450
+
+#extension GL_EXT_multiview : require
+
+struct ViewportView
+{
+  mat4 projection_mat;
+  mat4 view_mat;
+};
+
+layout (set = 0, binding = 0) uniform ViewportUniform
+{
+  ViewportView views[2];
+} viewport;
+
+struct MeshVertex
+{
+  vec3 position;
+  uint normal;
+};
+
+struct MeshInstance
+{
+  vec3 position;
+  float scale;
+  vec3 color;
+  uint mesh;
+  uint lod;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer MeshVertices
+{
+  MeshVertex vertices[];
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer MeshInstances
+{
+  MeshInstance instances[];
+};
+
+layout (location = 0) out vec3 frag_color;
+layout (location = 1) out vec3 frag_normal;
+
+void
+main ()
+{
+  ViewportView view = viewport.views[gl_ViewIndex];
+  MeshVertex vertex = vertices[gl_VertexIndex];
+  MeshInstance instance = instances[gl_InstanceIndex];
+
+  vec3 position = instance.position + vertex.position * instance.scale;
+
+  gl_Position = view.projection_mat * view.view_mat * vec4 (position, 1.0);
+  frag_color = instance.color;
+  frag_normal = unpackSnorm4x8 (vertex.normal).xyz;
+}
@@ -0,0 +1,20 @@
+/** @file star.frag
+ */
+
+#version 450
+
+layout (location = 0) in vec3 frag_color;
+layout (location = 1) in vec2 frag_corner;
+
+layout (location = 0) out vec4 out_color;
+
+void
+main ()
+{
+  /* round off the quad, fading towards the edge */
+  float falloff = 1.0 - dot (frag_corner, frag_corner);
+  if (falloff <= 0.0)
+    discard;
+
+  out_color = vec4 (frag_color * falloff, 1.0);
+}
@@ -0,0 +1,50 @@
+/** @file star.vert
+ */
+
+#version 450
+
+layout (set = 0, binding = 0) uniform ViewportUniform
+{
+  mat4 projection_mat;
+  mat4 view_mat;
+} viewport;
+
+struct Star
+{
+  vec4 position_radius;
+  vec4 color;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer StarBuffer
+{
+  Star stars[];
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer VisibleBuffer
+{
+  uint visible[];
+};
+
+layout (push_constant) uniform StarConstants
+{
+  uint star_num;
+  uint visible_base;
+} constants;
+
+layout (location = 0) out vec3 frag_color;
+layout (location = 1) out vec2 frag_corner;
+
+void
+main ()
+{
+  Star star = stars[visible[constants.visible_base + gl_InstanceIndex]];
+
+  /* a camera-facing quad, with corners picked by the vertex index */
+  vec2 corner = vec2 (gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+  vec4 center = viewport.view_mat * vec4 (star.position_radius.xyz, 1.0);
+  vec4 position = center + vec4 (corner * star.position_radius.w, 0.0, 0.0);
+
+  gl_Position = viewport.projection_mat * position;
+  frag_color = star.color.rgb;
+  frag_corner = corner;
+}
@@ -0,0 +1,57 @@
+/** @file star_multiview.vert
+ */
+
+#version 450
+
+#extension GL_EXT_multiview : require
+
+struct ViewportView
+{
+  mat4 projection_mat;
+  mat4 view_mat;
+};
+
+layout (set = 0, binding = 0) uniform ViewportUniform
+{
+  ViewportView views[2];
+} viewport;
+
+struct Star
+{
+  vec4 position_radius;
+  vec4 color;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer StarBuffer
+{
+  Star stars[];
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer VisibleBuffer
+{
+  uint visible[];
+};
+
+layout (push_constant) uniform StarConstants
+{
+  uint star_num;
+  uint visible_base;
+} constants;
+
+layout (location = 0) out vec3 frag_color;
+layout (location = 1) out vec2 frag_corner;
+
+void
+main ()
+{
+  ViewportView view = viewport.views[gl_ViewIndex];
+  Star star = stars[visible[constants.visible_base + gl_InstanceIndex]];
+
+  vec2 corner = vec2 (gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+  vec4 center = view.view_mat * vec4 (star.position_radius.xyz, 1.0);
+  vec4 position = center + vec4 (corner * star.position_radius.w, 0.0, 0.0);
+
+  gl_Position = view.projection_mat * position;
+  frag_color = star.color.rgb;
+  frag_corner = corner;
+}
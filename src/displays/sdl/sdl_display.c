@@ -24,9 +24,11 @@ struct sdl_display_s
 {
   SDL_Window *window;
   char *instance_extensions;
+  struct sdl_display_config config;
 
   /* session data */
   gpu_device_t *gpu;
+  VkInstance instance;
   VkSurfaceKHR surface;
   camera_t *camera;
 };
@@ -36,7 +38,8 @@ create_window (sdl_display_t *dp)
 {
   dp->window = SDL_CreateWindow ("Mondradiko Core", SDL_WINDOWPOS_UNDEFINED,
                                  SDL_WINDOWPOS_UNDEFINED, 800, 600,
-                                 SDL_WINDOW_SHOWN | SDL_WINDOW_VULKAN);
+                                 SDL_WINDOW_SHOWN | SDL_WINDOW_VULKAN
+                                     | SDL_WINDOW_RESIZABLE);
 
   if (!dp->window)
     {
@@ -78,7 +81,8 @@ get_instance_extensions (sdl_display_t *dp)
 }
 
 int
-sdl_display_new (sdl_display_t **new_dp)
+sdl_display_new (sdl_display_t **new_dp,
+                 const struct sdl_display_config *config)
 {
   if (SDL_Init (SDL_INIT_VIDEO))
     {
@@ -90,6 +94,8 @@ sdl_display_new (sdl_display_t **new_dp)
   *new_dp = dp;
 
   dp->instance_extensions = NULL;
+  dp->config = *config;
+  dp->instance = VK_NULL_HANDLE;
   dp->surface = VK_NULL_HANDLE;
   dp->camera = NULL;
 
@@ -118,14 +124,46 @@ sdl_display_delete (sdl_display_t *dp)
   SDL_Quit ();
 }
 
+/* created before the GPU device, so only GPUs that can present to the
+ * window are picked; the session picks it back up */
+static VkSurfaceKHR
+create_surface (VkInstance instance, void *userdata)
+{
+  sdl_display_t *dp = userdata;
+
+  if (dp->surface != VK_NULL_HANDLE)
+    {
+      LOG_ERR ("window surface already exists");
+      return VK_NULL_HANDLE;
+    }
+
+  if (SDL_Vulkan_CreateSurface (dp->window, instance, &dp->surface)
+      != SDL_TRUE)
+    {
+      LOG_ERR ("failed to create window surface: %s", SDL_GetError ());
+      dp->surface = VK_NULL_HANDLE;
+      return VK_NULL_HANDLE;
+    }
+
+  dp->instance = instance;
+  return dp->surface;
+}
+
 void
 sdl_display_vk_config (sdl_display_t *dp, struct vk_config_t *config)
 {
-  config->min_api_version = VK_API_VERSION_1_0;
+  config->min_api_version = VK_API_VERSION_1_2;
   config->max_api_version = VK_API_VERSION_1_2;
   config->instance_extensions = dp->instance_extensions;
   config->device_extensions = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+
+  /* spelled out, since older headers don't define these names */
+  config->optional_device_extensions = "VK_KHR_present_id VK_KHR_present_wait";
   config->physical_device = VK_NULL_HANDLE;
+  config->device_override = NULL;
+  config->create_surface = create_surface;
+  config->surface_userdata = dp;
+  config->debug_level = GPU_DEBUG_LEVEL_DEFAULT;
 }
 
 int
@@ -133,14 +171,9 @@ sdl_display_begin_session (sdl_display_t *dp, gpu_device_t *gpu)
 {
   dp->gpu = gpu;
 
-  SDL_Window *window = dp->window;
   VkInstance instance = gpu_device_get_instance (gpu);
-  VkSurfaceKHR *surface = &dp->surface;
-  if (SDL_Vulkan_CreateSurface (window, instance, surface) != SDL_TRUE)
-    {
-      LOG_ERR ("failed to create window surface: %s", SDL_GetError ());
-      return 1;
-    }
+  if (dp->surface == VK_NULL_HANDLE && !create_surface (instance, dp))
+    return 1;
 
   int width;
   int height;
@@ -151,9 +184,14 @@ sdl_display_begin_session (sdl_display_t *dp, gpu_device_t *gpu)
     .type = VIEWPORT_TYPE_SURFACE,
     .width = width,
     .height = height,
+    .dynamic_resolution = dp->config.dynamic_resolution,
 
     .sub = {
-      .surface = dp->surface,
+      .surface = {
+        .surface = dp->surface,
+        .present_mode = dp->config.present_mode,
+        .image_num = dp->config.image_num,
+      },
     },
   };
 
@@ -161,6 +199,7 @@ sdl_display_begin_session (sdl_display_t *dp, gpu_device_t *gpu)
     .gpu = dp->gpu,
     .viewport_configs = &vp_config,
     .viewport_num = 1,
+    .has_depth = dp->config.has_depth,
   };
 
   if (camera_new (&dp->camera, &cam_config))
@@ -179,9 +218,10 @@ sdl_display_end_session (sdl_display_t *dp)
     camera_delete (dp->camera);
 
   if (dp->surface)
-    vkDestroySurfaceKHR (gpu_device_get_instance (dp->gpu), dp->surface, NULL);
+    vkDestroySurfaceKHR (dp->instance, dp->surface, NULL);
 
   dp->camera = NULL;
+  dp->instance = VK_NULL_HANDLE;
   dp->surface = VK_NULL_HANDLE;
 }
 
@@ -191,6 +231,22 @@ sdl_display_get_camera (sdl_display_t *dp)
   return dp->camera;
 }
 
+static void
+handle_resize (sdl_display_t *dp)
+{
+  if (!dp->camera)
+    return;
+
+  int width;
+  int height;
+  SDL_Vulkan_GetDrawableSize (dp->window, &width, &height);
+
+  /* the swapchain is recreated on the next frame, not here */
+  viewport_t *vp = camera_get_viewport (dp->camera, 0);
+  if (vp)
+    viewport_resize (vp, width, height);
+}
+
 void
 sdl_display_poll (sdl_display_t *dp, struct display_poll_t *poll)
 {
@@ -209,6 +265,13 @@ sdl_display_poll (sdl_display_t *dp, struct display_poll_t *poll)
             break;
           }
 
+        case SDL_WINDOWEVENT:
+          {
+            if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+              handle_resize (dp);
+            break;
+          }
+
         default:
           break;
         }
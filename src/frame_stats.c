@@ -0,0 +1,351 @@
+/** @file frame_stats.c
+ */
+
+#include "frame_stats.h"
+
+#include "log.h"
+
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdlib.h> /* for mem alloc, qsort */
+
+#include <uv.h>
+
+#define DEFAULT_CAPACITY 1024
+
+/* marks a value that was never measured */
+#define UNMEASURED -1.0
+
+struct frame_record
+{
+  /* zero if the slot hasn't been used yet */
+  uint64_t frame;
+
+  uint64_t begin_time;
+  uint64_t input_time;
+  double values[FRAME_METRIC_NUM];
+  enum frame_latency_source latency_source;
+};
+
+struct frame_stats_s
+{
+  struct frame_record *records;
+  int capacity;
+  uint64_t frame;
+
+  uint64_t stage_begin[FRAME_STAGE_NUM];
+
+  /* sorted copies of one metric, for percentiles */
+  double *scratch;
+};
+
+static const char *metric_names[FRAME_METRIC_NUM] = {
+  "poll",    "sim",    "wait",    "acquire",    "extract",
+  "record",  "submit", "present", "frame_time", "latency",
+};
+
+static const char *latency_source_names[] = {
+  "none",
+  "gpu_complete",
+  "presented",
+};
+
+static struct frame_record *
+find_record (frame_stats_t *fs, uint64_t frame)
+{
+  if (frame == 0)
+    return NULL;
+
+  struct frame_record *record = &fs->records[(frame - 1) % fs->capacity];
+  if (record->frame != frame)
+    return NULL;
+
+  return record;
+}
+
+static double
+elapsed_ms (uint64_t start, uint64_t end)
+{
+  return (end - start) / 1000000.0;
+}
+
+static int
+compare_doubles (const void *a, const void *b)
+{
+  double lhs = *(const double *)a;
+  double rhs = *(const double *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+/* nearest-rank percentile of a sorted array */
+static double
+percentile (const double *sorted, int num, int percent)
+{
+  int rank = (num * percent + 99) / 100;
+  if (rank < 1)
+    rank = 1;
+
+  return sorted[rank - 1];
+}
+
+int
+frame_stats_new (frame_stats_t **new_fs, int capacity)
+{
+  frame_stats_t *fs = malloc (sizeof (frame_stats_t));
+  *new_fs = fs;
+
+  if (capacity <= 0)
+    capacity = DEFAULT_CAPACITY;
+
+  fs->capacity = capacity;
+  fs->frame = 0;
+  fs->records = calloc (capacity, sizeof (struct frame_record));
+  fs->scratch = malloc (capacity * sizeof (double));
+
+  for (int i = 0; i < FRAME_STAGE_NUM; i++)
+    fs->stage_begin[i] = 0;
+
+  if (!fs->records || !fs->scratch)
+    {
+      LOG_ERR ("failed to allocate frame records");
+      return 1;
+    }
+
+  return 0;
+}
+
+void
+frame_stats_delete (frame_stats_t *fs)
+{
+  if (fs->records)
+    free (fs->records);
+
+  if (fs->scratch)
+    free (fs->scratch);
+
+  free (fs);
+}
+
+uint64_t
+frame_stats_begin_frame (frame_stats_t *fs)
+{
+  uint64_t now = uv_hrtime ();
+
+  struct frame_record *last = find_record (fs, fs->frame);
+  if (last)
+    last->values[FRAME_METRIC_FRAME_TIME] = elapsed_ms (last->begin_time, now);
+
+  fs->frame++;
+
+  struct frame_record *record = &fs->records[(fs->frame - 1) % fs->capacity];
+  record->frame = fs->frame;
+  record->begin_time = now;
+  record->input_time = now;
+  record->latency_source = FRAME_LATENCY_NONE;
+
+  for (int i = 0; i < FRAME_METRIC_NUM; i++)
+    record->values[i] = UNMEASURED;
+
+  return fs->frame;
+}
+
+uint64_t
+frame_stats_current (frame_stats_t *fs)
+{
+  return fs->frame;
+}
+
+void
+frame_stats_mark_input (frame_stats_t *fs)
+{
+  struct frame_record *record = find_record (fs, fs->frame);
+  if (record)
+    record->input_time = uv_hrtime ();
+}
+
+void
+frame_stats_begin_stage (frame_stats_t *fs, enum frame_stage stage)
+{
+  fs->stage_begin[stage] = uv_hrtime ();
+}
+
+void
+frame_stats_end_stage (frame_stats_t *fs, enum frame_stage stage)
+{
+  struct frame_record *record = find_record (fs, fs->frame);
+  if (!record || fs->stage_begin[stage] == 0)
+    return;
+
+  double ms = elapsed_ms (fs->stage_begin[stage], uv_hrtime ());
+  fs->stage_begin[stage] = 0;
+
+  if (record->values[stage] == UNMEASURED)
+    record->values[stage] = ms;
+  else
+    record->values[stage] += ms;
+}
+
+void
+frame_stats_mark_latency (frame_stats_t *fs, uint64_t frame, uint64_t time,
+                          enum frame_latency_source source)
+{
+  struct frame_record *record = find_record (fs, frame);
+  if (!record || source <= record->latency_source)
+    return;
+
+  record->values[FRAME_METRIC_LATENCY] = elapsed_ms (record->input_time, time);
+  record->latency_source = source;
+}
+
+int
+frame_stats_summarize (frame_stats_t *fs, int metric,
+                       struct frame_stats_summary *summary)
+{
+  *summary = (struct frame_stats_summary){ 0 };
+
+  int num = 0;
+  double total = 0.0;
+  for (int i = 0; i < fs->capacity; i++)
+    {
+      const struct frame_record *record = &fs->records[i];
+      if (record->frame == 0 || record->values[metric] == UNMEASURED)
+        continue;
+
+      fs->scratch[num++] = record->values[metric];
+      total += record->values[metric];
+    }
+
+  if (num == 0)
+    return 0;
+
+  qsort (fs->scratch, num, sizeof (double), compare_doubles);
+
+  summary->sample_num = num;
+  summary->mean_ms = total / num;
+  summary->p50_ms = percentile (fs->scratch, num, 50);
+  summary->p95_ms = percentile (fs->scratch, num, 95);
+  summary->p99_ms = percentile (fs->scratch, num, 99);
+  summary->max_ms = fs->scratch[num - 1];
+  return num;
+}
+
+const char *
+frame_stats_metric_name (int metric)
+{
+  if (metric < 0 || metric >= FRAME_METRIC_NUM)
+    return "unknown";
+
+  return metric_names[metric];
+}
+
+void
+frame_stats_log_summary (frame_stats_t *fs)
+{
+  for (int i = 0; i < FRAME_METRIC_NUM; i++)
+    {
+      struct frame_stats_summary summary;
+      if (!frame_stats_summarize (fs, i, &summary))
+        continue;
+
+      LOG_INF ("%-10s p50 %7.3fms  p95 %7.3fms  p99 %7.3fms  max %7.3fms",
+               metric_names[i], summary.p50_ms, summary.p95_ms,
+               summary.p99_ms, summary.max_ms);
+    }
+}
+
+/* visits recorded frames oldest first */
+static int
+first_record_index (frame_stats_t *fs)
+{
+  if (fs->frame <= fs->capacity)
+    return 0;
+
+  return fs->frame % fs->capacity;
+}
+
+static int
+recorded_num (frame_stats_t *fs)
+{
+  if (fs->frame < fs->capacity)
+    return fs->frame;
+
+  return fs->capacity;
+}
+
+int
+frame_stats_write_csv (frame_stats_t *fs, FILE *file)
+{
+  fprintf (file, "frame");
+  for (int i = 0; i < FRAME_METRIC_NUM; i++)
+    fprintf (file, ",%s_ms", metric_names[i]);
+  fprintf (file, ",latency_source\n");
+
+  int first = first_record_index (fs);
+  int num = recorded_num (fs);
+  for (int i = 0; i < num; i++)
+    {
+      const struct frame_record *record
+          = &fs->records[(first + i) % fs->capacity];
+
+      fprintf (file, "%llu", (unsigned long long)record->frame);
+
+      for (int j = 0; j < FRAME_METRIC_NUM; j++)
+        {
+          if (record->values[j] == UNMEASURED)
+            fprintf (file, ",");
+          else
+            fprintf (file, ",%.4f", record->values[j]);
+        }
+
+      fprintf (file, ",%s\n", latency_source_names[record->latency_source]);
+    }
+
+  return ferror (file) ? 1 : 0;
+}
+
+int
+frame_stats_write_json (frame_stats_t *fs, FILE *file)
+{
+  fprintf (file, "{\n  \"frames\": [");
+
+  int first = first_record_index (fs);
+  int num = recorded_num (fs);
+  for (int i = 0; i < num; i++)
+    {
+      const struct frame_record *record
+          = &fs->records[(first + i) % fs->capacity];
+
+      fprintf (file, "%s\n    { \"frame\": %llu", i > 0 ? "," : "",
+               (unsigned long long)record->frame);
+
+      for (int j = 0; j < FRAME_METRIC_NUM; j++)
+        {
+          if (record->values[j] == UNMEASURED)
+            fprintf (file, ", \"%s_ms\": null", metric_names[j]);
+          else
+            fprintf (file, ", \"%s_ms\": %.4f", metric_names[j],
+                     record->values[j]);
+        }
+
+      fprintf (file, ", \"latency_source\": \"%s\" }",
+               latency_source_names[record->latency_source]);
+    }
+
+  fprintf (file, "\n  ],\n  \"summary\": {");
+
+  for (int i = 0; i < FRAME_METRIC_NUM; i++)
+    {
+      struct frame_stats_summary summary;
+      frame_stats_summarize (fs, i, &summary);
+
+      fprintf (file,
+               "%s\n    \"%s_ms\": { \"samples\": %d, \"mean\": %.4f, "
+               "\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+               i > 0 ? "," : "", metric_names[i], summary.sample_num,
+               summary.mean_ms, summary.p50_ms, summary.p95_ms,
+               summary.p99_ms, summary.max_ms);
+    }
+
+  fprintf (file, "\n  }\n}\n");
+
+  return ferror (file) ? 1 : 0;
+}
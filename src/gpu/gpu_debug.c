@@ -0,0 +1,49 @@
+/** @file gpu_debug.c
+ */
+
+#include "gpu/gpu_debug.h"
+
+#include <vulkan/vulkan_core.h>
+
+/* the debug utils entry points are left null by gpu_device when debugging is
+ * off, so each of these costs a single branch in release */
+
+void
+gpu_debug_begin_label (VkCommandBuffer cmd, const char *name)
+{
+  if (!vkCmdBeginDebugUtilsLabelEXT)
+    return;
+
+  VkDebugUtilsLabelEXT label = {
+    .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
+    .pLabelName = name,
+  };
+
+  vkCmdBeginDebugUtilsLabelEXT (cmd, &label);
+}
+
+void
+gpu_debug_end_label (VkCommandBuffer cmd)
+{
+  if (!vkCmdEndDebugUtilsLabelEXT)
+    return;
+
+  vkCmdEndDebugUtilsLabelEXT (cmd);
+}
+
+void
+gpu_debug_set_name (gpu_device_t *gpu, VkObjectType type, uint64_t handle,
+                    const char *name)
+{
+  if (!vkSetDebugUtilsObjectNameEXT)
+    return;
+
+  VkDebugUtilsObjectNameInfoEXT info = {
+    .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
+    .objectType = type,
+    .objectHandle = handle,
+    .pObjectName = name,
+  };
+
+  vkSetDebugUtilsObjectNameEXT (gpu_device_get (gpu), &info);
+}
@@ -3,26 +3,53 @@
 
 #include "gpu/gpu_device.h"
 
+#include "gpu/gpu_dispatch.h"
+#include "gpu/gpu_memory.h"
+#include "gpu/gpu_timeline.h"
 #include "gpu/vk_config.h"
 #include "log.h"
 
+#include <ctype.h>  /* for tolower */
+#include <stdio.h>  /* for snprintf */
 /* TODO(marceline-cramer): use mdo-allocator */
-#include <stdlib.h> /* for mem alloc */
-#include <string.h> /* for strlen, memcpy */
+#include <stdlib.h> /* for mem alloc, getenv */
+#include <string.h> /* for strlen, strcmp, memcpy */
 
-#include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
 #define MAX_EXTENSIONS 32
 #define MAX_PHYSICAL_DEVICES 32
 #define MAX_QUEUE_FAMILIES 32
+#define MAX_REASONS_LEN 256
+
+#define VALIDATION_LAYER "VK_LAYER_KHRONOS_validation"
 
 struct gpu_device_s
 {
   VkInstance instance;
+  enum gpu_debug_level debug_level;
+  VkDebugUtilsMessengerEXT messenger;
   VkPhysicalDevice physical_device;
   uint32_t gfx_queue_family;
   VkDevice device;
+
+  /* not owned; devices must be able to present to it, if there is one */
+  VkSurfaceKHR surface;
+  int has_library;
+
+  /* enabled device extensions; the names point into the lists */
+  char *device_ext_lists[2];
+  const char *device_exts[MAX_EXTENSIONS];
+  int device_ext_num;
+  int has_present_wait;
+  int has_multiview;
+  int has_multi_draw_indirect;
+  int has_draw_indirect_count;
+  int has_draw_indirect_first_instance;
+
+  gpu_timeline_t *timeline;
+  gpu_memory_t *memory;
+  VkPipelineCache pipeline_cache;
 };
 
 static int
@@ -99,6 +126,132 @@ debug_callback (VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
   return VK_FALSE;
 }
 
+static int
+is_extension_supported (const VkExtensionProperties *props, uint32_t prop_num,
+                        const char *name)
+{
+  for (uint32_t i = 0; i < prop_num; i++)
+    {
+      if (strcmp (props[i].extensionName, name) == 0)
+        return 1;
+    }
+
+  return 0;
+}
+
+static int
+has_instance_layer (const char *name)
+{
+  uint32_t prop_num = 0;
+  vkEnumerateInstanceLayerProperties (&prop_num, NULL);
+
+  VkLayerProperties *props = malloc (prop_num * sizeof (*props));
+  vkEnumerateInstanceLayerProperties (&prop_num, props);
+
+  int has_layer = 0;
+  for (uint32_t i = 0; i < prop_num && !has_layer; i++)
+    has_layer = strcmp (props[i].layerName, name) == 0;
+
+  free (props);
+  return has_layer;
+}
+
+/* @param layer The layer providing the extension, or NULL for the loader's
+ * and drivers' own */
+static int
+has_instance_extension (const char *layer, const char *name)
+{
+  uint32_t prop_num = 0;
+  vkEnumerateInstanceExtensionProperties (layer, &prop_num, NULL);
+
+  VkExtensionProperties *props = malloc (prop_num * sizeof (*props));
+  vkEnumerateInstanceExtensionProperties (layer, &prop_num, props);
+
+  int has_extension = is_extension_supported (props, prop_num, name);
+
+  free (props);
+  return has_extension;
+}
+
+static const char *
+debug_level_name (enum gpu_debug_level level)
+{
+  switch (level)
+    {
+    case GPU_DEBUG_LEVEL_OFF:
+      return "off";
+    case GPU_DEBUG_LEVEL_ERRORS:
+      return "errors only";
+    case GPU_DEBUG_LEVEL_VALIDATION:
+      return "full validation";
+    case GPU_DEBUG_LEVEL_GPU_ASSISTED:
+      return "GPU-assisted validation";
+    default:
+      return "unknown";
+    }
+}
+
+/* lowers the debug level to what the system can actually provide */
+static enum gpu_debug_level
+choose_debug_level (enum gpu_debug_level level)
+{
+  if (level == GPU_DEBUG_LEVEL_OFF)
+    return level;
+
+  if (!has_instance_layer (VALIDATION_LAYER))
+    {
+      LOG_WRN ("%s is unavailable, so GPU debugging is off",
+               VALIDATION_LAYER);
+      return GPU_DEBUG_LEVEL_OFF;
+    }
+
+  if (!has_instance_extension (NULL, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
+      && !has_instance_extension (VALIDATION_LAYER,
+                                  VK_EXT_DEBUG_UTILS_EXTENSION_NAME))
+    {
+      LOG_WRN ("%s is unavailable, so GPU debugging is off",
+               VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+      return GPU_DEBUG_LEVEL_OFF;
+    }
+
+  if (level == GPU_DEBUG_LEVEL_GPU_ASSISTED
+      && !has_instance_extension (VALIDATION_LAYER,
+                                  VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME))
+    {
+      LOG_WRN ("GPU-assisted validation is unavailable, falling back to "
+               "full validation");
+      return GPU_DEBUG_LEVEL_VALIDATION;
+    }
+
+  return level;
+}
+
+static VkDebugUtilsMessageSeverityFlagsEXT
+messenger_severity (enum gpu_debug_level level)
+{
+  VkDebugUtilsMessageSeverityFlagsEXT severity
+      = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+
+  if (level >= GPU_DEBUG_LEVEL_VALIDATION)
+    severity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT
+                | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+
+  return severity;
+}
+
+static void
+fill_messenger_info (gpu_device_t *gpu, VkDebugUtilsMessengerCreateInfoEXT *ci)
+{
+  *ci = (VkDebugUtilsMessengerCreateInfoEXT){
+    .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+    .messageSeverity = messenger_severity (gpu->debug_level),
+    .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
+                   | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT
+                   | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+    .pfnUserCallback = debug_callback,
+  };
+}
+
 static int
 create_instance (gpu_device_t *gpu, const struct vk_config_t *config)
 {
@@ -111,37 +264,65 @@ create_instance (gpu_device_t *gpu, const struct vk_config_t *config)
     .pEngineName = "Mondradiko",
     .engineVersion = VK_MAKE_VERSION (0, 0, 0),
 
-    .apiVersion = config->min_api_version,
+    .apiVersion = config->max_api_version,
   };
 
+  gpu->debug_level = choose_debug_level (config->debug_level);
+  LOG_INF ("GPU debugging: %s", debug_level_name (gpu->debug_level));
+
   char *instance_ext_list = malloc (strlen (config->instance_extensions) + 1);
   strcpy (instance_ext_list, config->instance_extensions);
   const char *instance_exts[MAX_EXTENSIONS];
   int instance_ext_num = split_list (instance_ext_list, instance_exts);
 
-  const char *layers[] = { "VK_LAYER_KHRONOS_validation" };
+  /* room is left for the debugging extensions */
+  if (instance_ext_num > MAX_EXTENSIONS - 2)
+    {
+      LOG_ERR ("too many instance extensions");
+      free (instance_ext_list);
+      return -1;
+    }
+
+  int is_debug = gpu->debug_level != GPU_DEBUG_LEVEL_OFF;
+  if (is_debug)
+    instance_exts[instance_ext_num++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+
+  if (gpu->debug_level == GPU_DEBUG_LEVEL_GPU_ASSISTED)
+    instance_exts[instance_ext_num++]
+        = VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME;
+
+  const char *layers[] = { VALIDATION_LAYER };
 
   VkInstanceCreateInfo ci = {
     .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
     .pApplicationInfo = &app_info,
-    .enabledLayerCount = 1,
+    .enabledLayerCount = is_debug ? 1 : 0,
     .ppEnabledLayerNames = layers,
     .enabledExtensionCount = instance_ext_num,
     .ppEnabledExtensionNames = instance_exts,
   };
 
-  VkDebugUtilsMessengerCreateInfoEXT messenger_ci = {
-    .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
-    .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT
-                       | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT
-                       | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
-    .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
-                   | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT
-                   | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
-    .pfnUserCallback = debug_callback,
+  /* covers instance creation and destruction, which the persistent
+   * messenger can't */
+  VkDebugUtilsMessengerCreateInfoEXT messenger_ci;
+  fill_messenger_info (gpu, &messenger_ci);
+
+  VkValidationFeatureEnableEXT gpu_assisted[] = {
+    VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_EXT,
+    VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_RESERVE_BINDING_SLOT_EXT,
+  };
+
+  VkValidationFeaturesEXT validation_features = {
+    .sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT,
+    .enabledValidationFeatureCount = 2,
+    .pEnabledValidationFeatures = gpu_assisted,
   };
 
-  ci.pNext = &messenger_ci;
+  if (is_debug)
+    ci.pNext = &messenger_ci;
+
+  if (gpu->debug_level == GPU_DEBUG_LEVEL_GPU_ASSISTED)
+    messenger_ci.pNext = &validation_features;
 
   if (vkCreateInstance (&ci, NULL, &gpu->instance) != VK_SUCCESS)
     {
@@ -155,8 +336,307 @@ create_instance (gpu_device_t *gpu, const struct vk_config_t *config)
   return 0;
 }
 
+static int
+create_messenger (gpu_device_t *gpu)
+{
+  /* entry points of disabled extensions may still resolve, so make sure
+   * labels and names are skipped */
+  if (gpu->debug_level == GPU_DEBUG_LEVEL_OFF)
+    {
+      vkCmdBeginDebugUtilsLabelEXT = NULL;
+      vkCmdEndDebugUtilsLabelEXT = NULL;
+      vkSetDebugUtilsObjectNameEXT = NULL;
+      return 0;
+    }
+
+  VkDebugUtilsMessengerCreateInfoEXT ci;
+  fill_messenger_info (gpu, &ci);
+
+  if (vkCreateDebugUtilsMessengerEXT (gpu->instance, &ci, NULL,
+                                      &gpu->messenger)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create debug messenger");
+      return -1;
+    }
+
+  return 0;
+}
+
+/* graphics and presentation share a queue, so a family must do both
+ * @return the family's index, or -1 if there is none */
+static int
+find_gfx_family (gpu_device_t *gpu, VkPhysicalDevice physical_device)
+{
+  uint32_t num = MAX_QUEUE_FAMILIES;
+  VkQueueFamilyProperties props[MAX_QUEUE_FAMILIES];
+  vkGetPhysicalDeviceQueueFamilyProperties (physical_device, &num, props);
+
+  for (int i = 0; i < num; i++)
+    {
+      if (!(props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        continue;
+
+      if (gpu->surface != VK_NULL_HANDLE)
+        {
+          VkBool32 supported = VK_FALSE;
+          vkGetPhysicalDeviceSurfaceSupportKHR (physical_device, i,
+                                                gpu->surface, &supported);
+          if (supported != VK_TRUE)
+            continue;
+        }
+
+      return i;
+    }
+
+  return -1;
+}
+
+static int
+find_queue_families (gpu_device_t *gpu)
+{
+  int family = find_gfx_family (gpu, gpu->physical_device);
+  if (family < 0)
+    {
+      LOG_ERR ("failed to find necessary queue families");
+      return -1;
+    }
+
+  gpu->gfx_queue_family = family;
+  return 0;
+}
+
+static void
+append_reason (char *reasons, const char *reason)
+{
+  size_t len = strlen (reasons);
+  snprintf (&reasons[len], MAX_REASONS_LEN - len, "%s%s",
+            len > 0 ? ", " : "", reason);
+}
+
+static const char *
+device_type_name (VkPhysicalDeviceType type)
+{
+  switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      return "software";
+    default:
+      return "unknown type";
+    }
+}
+
+/* the type always outweighs everything else */
+static int
+device_type_score (VkPhysicalDeviceType type)
+{
+  switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return 100000;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return 50000;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return 20000;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      return 0;
+    default:
+      return 10000;
+    }
+}
+
+static int
+has_required_extensions (VkPhysicalDevice physical_device,
+                         const struct vk_config_t *config, char *reasons)
+{
+  const char *list = config->device_extensions ? config->device_extensions
+                                               : "";
+  char *required_list = malloc (strlen (list) + 1);
+  strcpy (required_list, list);
+
+  const char *required[MAX_EXTENSIONS];
+  int required_num = split_list (required_list, required);
+
+  uint32_t prop_num = 0;
+  vkEnumerateDeviceExtensionProperties (physical_device, NULL, &prop_num,
+                                        NULL);
+
+  VkExtensionProperties *props = malloc (prop_num * sizeof (*props));
+  vkEnumerateDeviceExtensionProperties (physical_device, NULL, &prop_num,
+                                        props);
+
+  int has_all = 1;
+  for (int i = 0; i < required_num; i++)
+    {
+      if (is_extension_supported (props, prop_num, required[i]))
+        continue;
+
+      char reason[MAX_REASONS_LEN];
+      snprintf (reason, sizeof (reason), "no %s", required[i]);
+      append_reason (reasons, reason);
+      has_all = 0;
+    }
+
+  free (props);
+  free (required_list);
+  return has_all;
+}
+
+static void
+format_uuid (const uint8_t uuid[VK_UUID_SIZE], char str[VK_UUID_SIZE * 2 + 1])
+{
+  for (int i = 0; i < VK_UUID_SIZE; i++)
+    snprintf (&str[i * 2], 3, "%02x", uuid[i]);
+}
+
+static int
+contains_ignoring_case (const char *str, const char *part)
+{
+  size_t part_len = strlen (part);
+  for (; *str; str++)
+    {
+      size_t i = 0;
+      while (i < part_len && str[i]
+             && tolower ((unsigned char)str[i])
+                    == tolower ((unsigned char)part[i]))
+        i++;
+
+      if (i == part_len)
+        return 1;
+    }
+
+  return 0;
+}
+
+static int
+matches_override (const char *override, const char *name, const char *uuid)
+{
+  /* UUIDs are commonly written with dashes, which are skipped */
+  const char *digit = uuid;
+  const char *c = override;
+  for (; *c && *digit; c++)
+    {
+      if (*c == '-')
+        continue;
+
+      if (tolower ((unsigned char)*c) != *digit)
+        break;
+
+      digit++;
+    }
+
+  if (*c == '\0' && *digit == '\0')
+    return 1;
+
+  return contains_ignoring_case (name, override);
+}
+
+/* @return the device's score, or -1 if it can't be used at all */
+static int
+rate_device (gpu_device_t *gpu, VkPhysicalDevice physical_device,
+             const struct vk_config_t *config,
+             const VkPhysicalDeviceProperties *props, char *reasons)
+{
+  int score = device_type_score (props->deviceType);
+  append_reason (reasons, device_type_name (props->deviceType));
+
+  if (props->apiVersion < config->min_api_version)
+    {
+      append_reason (reasons, "Vulkan version too old");
+      return -1;
+    }
+
+  VkPhysicalDeviceVulkan12Features vk12_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+  };
+
+  VkPhysicalDeviceVulkan11Features vk11_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES,
+    .pNext = &vk12_features,
+  };
+
+  VkPhysicalDeviceFeatures2 features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    .pNext = &vk11_features,
+  };
+
+  vkGetPhysicalDeviceFeatures2 (physical_device, &features);
+
+  int is_suitable = 1;
+  if (!vk12_features.timelineSemaphore)
+    {
+      append_reason (reasons, "no timeline semaphores");
+      is_suitable = 0;
+    }
+
+  if (!vk12_features.imagelessFramebuffer)
+    {
+      append_reason (reasons, "no imageless framebuffers");
+      is_suitable = 0;
+    }
+
+  if (!has_required_extensions (physical_device, config, reasons))
+    is_suitable = 0;
+
+  if (find_gfx_family (gpu, physical_device) < 0)
+    {
+      append_reason (reasons, gpu->surface ? "can't present to the surface"
+                                           : "no graphics queue");
+      is_suitable = 0;
+    }
+
+  if (!is_suitable)
+    return -1;
+
+  VkPhysicalDeviceMemoryProperties memory;
+  vkGetPhysicalDeviceMemoryProperties (physical_device, &memory);
+
+  VkDeviceSize local_size = 0;
+  for (uint32_t i = 0; i < memory.memoryHeapCount; i++)
+    {
+      if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        local_size += memory.memoryHeaps[i].size;
+    }
+
+  /* one point per 64MiB, so a few GiB never outweighs the type */
+  int local_mib = local_size / (1024 * 1024);
+  score += local_mib / 64;
+
+  char reason[MAX_REASONS_LEN];
+  snprintf (reason, sizeof (reason), "%d MiB device-local", local_mib);
+  append_reason (reasons, reason);
+
+  /* optional features only break ties */
+  if (vk11_features.multiview)
+    {
+      score += 10;
+      append_reason (reasons, "multiview");
+    }
+
+  if (features.features.multiDrawIndirect)
+    {
+      score += 10;
+      append_reason (reasons, "multi-draw indirect");
+    }
+
+  if (vk12_features.drawIndirectCount)
+    {
+      score += 10;
+      append_reason (reasons, "indirect count");
+    }
+
+  return score;
+}
+
 static VkPhysicalDevice
-autoselect_physical_device (gpu_device_t *gpu)
+autoselect_physical_device (gpu_device_t *gpu,
+                            const struct vk_config_t *config)
 {
   uint32_t device_count = MAX_PHYSICAL_DEVICES;
   VkPhysicalDevice devices[MAX_PHYSICAL_DEVICES];
@@ -165,40 +645,192 @@ autoselect_physical_device (gpu_device_t *gpu)
    * have way too many GPUs */
   vkEnumeratePhysicalDevices (gpu->instance, &device_count, devices);
 
-  /* TODO(marceline-cramer) check for present queue, surface support */
-  if (device_count > 0)
-    return devices[0];
+  const char *override = config->device_override;
+  if (!override)
+    override = getenv ("MDO_GPU");
+
+  if (override && *override == '\0')
+    override = NULL;
+
+  VkPhysicalDevice best = VK_NULL_HANDLE;
+  int best_score = -1;
+  char best_name[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE] = "";
+  char best_reasons[MAX_REASONS_LEN] = "";
+
+  for (uint32_t i = 0; i < device_count; i++)
+    {
+      VkPhysicalDeviceIDProperties id_props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+      };
+
+      VkPhysicalDeviceProperties2 props2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &id_props,
+      };
+
+      vkGetPhysicalDeviceProperties2 (devices[i], &props2);
+      const VkPhysicalDeviceProperties *props = &props2.properties;
+
+      char uuid[VK_UUID_SIZE * 2 + 1];
+      format_uuid (id_props.deviceUUID, uuid);
+
+      if (override && !matches_override (override, props->deviceName, uuid))
+        {
+          LOG_INF ("GPU %u: %s (%s) skipped by override", i,
+                   props->deviceName, uuid);
+          continue;
+        }
+
+      char reasons[MAX_REASONS_LEN] = "";
+      int score = rate_device (gpu, devices[i], config, props, reasons);
 
-  return VK_NULL_HANDLE;
+      if (score < 0)
+        {
+          LOG_INF ("GPU %u: %s (%s) is unsuitable: %s", i, props->deviceName,
+                   uuid, reasons);
+          continue;
+        }
+
+      LOG_INF ("GPU %u: %s (%s) scored %d: %s", i, props->deviceName, uuid,
+               score, reasons);
+
+      if (score > best_score)
+        {
+          best = devices[i];
+          best_score = score;
+          strcpy (best_name, props->deviceName);
+          strcpy (best_reasons, reasons);
+        }
+    }
+
+  if (best == VK_NULL_HANDLE)
+    {
+      if (override)
+        LOG_ERR ("no suitable GPU matches \"%s\"", override);
+
+      return VK_NULL_HANDLE;
+    }
+
+  LOG_INF ("selected %s: %s", best_name, best_reasons);
+  return best;
 }
 
 static int
-find_queue_families (gpu_device_t *gpu)
+check_device_support (gpu_device_t *gpu, const struct vk_config_t *config)
 {
-  uint32_t num = MAX_PHYSICAL_DEVICES;
-  VkQueueFamilyProperties props[MAX_PHYSICAL_DEVICES];
-  vkGetPhysicalDeviceQueueFamilyProperties (gpu->physical_device, &num, props);
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties (gpu->physical_device, &props);
 
-  for (int i = 0; i < num; i++)
+  if (props.apiVersion < config->min_api_version)
     {
-      if (props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+      LOG_ERR ("%s only supports Vulkan %d.%d", props.deviceName,
+               VK_VERSION_MAJOR (props.apiVersion),
+               VK_VERSION_MINOR (props.apiVersion));
+      return 1;
+    }
+
+  VkPhysicalDeviceVulkan12Features vk12_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+  };
+
+  VkPhysicalDeviceFeatures2 features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    .pNext = &vk12_features,
+  };
+
+  vkGetPhysicalDeviceFeatures2 (gpu->physical_device, &features);
+
+  if (!vk12_features.timelineSemaphore)
+    {
+      LOG_ERR ("%s does not support timeline semaphores", props.deviceName);
+      return 1;
+    }
+
+  /* depth attachments come from the render graph, so they're only bound
+   * when their render pass begins */
+  if (!vk12_features.imagelessFramebuffer)
+    {
+      LOG_ERR ("%s does not support imageless framebuffers",
+               props.deviceName);
+      return 1;
+    }
+
+  return 0;
+}
+
+static void
+add_optional_extensions (gpu_device_t *gpu, const char *optional[],
+                         int optional_num)
+{
+  uint32_t prop_num = 0;
+  vkEnumerateDeviceExtensionProperties (gpu->physical_device, NULL, &prop_num,
+                                        NULL);
+
+  VkExtensionProperties *props = malloc (prop_num * sizeof (*props));
+  vkEnumerateDeviceExtensionProperties (gpu->physical_device, NULL, &prop_num,
+                                        props);
+
+  for (int i = 0; i < optional_num; i++)
+    {
+      if (!is_extension_supported (props, prop_num, optional[i]))
         {
-          gpu->gfx_queue_family = i;
-          return 0;
+          LOG_INF ("optional device extension %s is unsupported", optional[i]);
+          continue;
         }
+
+      if (gpu->device_ext_num >= MAX_EXTENSIONS)
+        {
+          LOG_WRN ("too many device extensions to enable %s", optional[i]);
+          continue;
+        }
+
+      gpu->device_exts[gpu->device_ext_num++] = optional[i];
     }
 
-  LOG_ERR ("failed to find necessary queue families");
-  return -1;
+  free (props);
+}
+
+static void
+remove_extension (gpu_device_t *gpu, const char *name)
+{
+  for (int i = 0; i < gpu->device_ext_num; i++)
+    {
+      if (strcmp (gpu->device_exts[i], name) == 0)
+        {
+          gpu->device_ext_num--;
+          gpu->device_exts[i] = gpu->device_exts[gpu->device_ext_num];
+          return;
+        }
+    }
 }
 
 static int
 create_logical_device (gpu_device_t *gpu, const struct vk_config_t *config)
 {
-  char *device_ext_list = malloc (strlen (config->device_extensions) + 1);
-  strcpy (device_ext_list, config->device_extensions);
-  const char *device_exts[MAX_EXTENSIONS];
-  int device_ext_num = split_list (device_ext_list, device_exts);
+  const char *ext_lists[2] = {
+    config->device_extensions,
+    config->optional_device_extensions,
+  };
+
+  for (int i = 0; i < 2; i++)
+    {
+      const char *list = ext_lists[i] ? ext_lists[i] : "";
+      gpu->device_ext_lists[i] = malloc (strlen (list) + 1);
+      strcpy (gpu->device_ext_lists[i], list);
+    }
+
+  gpu->device_ext_num
+      = split_list (gpu->device_ext_lists[0], gpu->device_exts);
+
+  const char *optional_exts[MAX_EXTENSIONS];
+  int optional_ext_num
+      = split_list (gpu->device_ext_lists[1], optional_exts);
+  add_optional_extensions (gpu, optional_exts, optional_ext_num);
+
+  /* wanted regardless of the display, for tracking memory budgets */
+  const char *internal_exts[] = { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME };
+  if (!gpu_device_has_extension (gpu, internal_exts[0]))
+    add_optional_extensions (gpu, internal_exts, 1);
 
   float queue_priority = 1.0f;
 
@@ -209,30 +841,113 @@ create_logical_device (gpu_device_t *gpu, const struct vk_config_t *config)
     .pQueuePriorities = &queue_priority,
   };
 
-  const char *layers[] = { "VK_LAYER_KHRONOS_validation" };
+  /* device layers are deprecated, but older loaders still want them */
+  const char *layers[] = { VALIDATION_LAYER };
+  int is_debug = gpu->debug_level != GPU_DEBUG_LEVEL_OFF;
+
+  VkPhysicalDeviceVulkan12Features supported_vk12 = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+  };
+
+  VkPhysicalDeviceVulkan11Features supported_vk11 = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES,
+    .pNext = &supported_vk12,
+  };
+
+  VkPhysicalDeviceFeatures2 supported_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    .pNext = &supported_vk11,
+  };
+
+  vkGetPhysicalDeviceFeatures2 (gpu->physical_device, &supported_features);
+
+  /* stereo cameras need multiview, but nothing else does */
+  gpu->has_multiview = supported_vk11.multiview;
+  if (!gpu->has_multiview)
+    LOG_INF ("multiview is unsupported, so stereo cameras are unavailable");
+
+  /* indirect draws fall back to one call per command without these */
+  gpu->has_multi_draw_indirect
+      = supported_features.features.multiDrawIndirect;
+  gpu->has_draw_indirect_count = supported_vk12.drawIndirectCount;
+  gpu->has_draw_indirect_first_instance
+      = supported_features.features.drawIndirectFirstInstance;
+
+  VkPhysicalDeviceVulkan12Features vk12_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    .timelineSemaphore = VK_TRUE,
+    .imagelessFramebuffer = VK_TRUE,
+    .drawIndirectCount = gpu->has_draw_indirect_count,
+  };
+
+  VkPhysicalDeviceVulkan11Features vk11_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES,
+    .pNext = &vk12_features,
+    .multiview = gpu->has_multiview,
+  };
+
+  VkPhysicalDeviceFeatures2 device_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    .pNext = &vk11_features,
+    .features = {
+      .multiDrawIndirect = gpu->has_multi_draw_indirect,
+      .drawIndirectFirstInstance = gpu->has_draw_indirect_first_instance,
+    },
+  };
 
-  VkPhysicalDeviceFeatures device_features = { 0 };
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+  VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+  };
+
+  VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+    .pNext = &present_wait_features,
+  };
+
+  /* the extensions are useless without each other and their features */
+  if (gpu_device_has_extension (gpu, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+      && gpu_device_has_extension (gpu, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+      VkPhysicalDeviceFeatures2 supported = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &present_id_features,
+      };
+
+      vkGetPhysicalDeviceFeatures2 (gpu->physical_device, &supported);
+
+      gpu->has_present_wait = present_id_features.presentId
+                              && present_wait_features.presentWait;
+    }
+
+  /* the queried features are all true by now, so they can be chained */
+  if (gpu->has_present_wait)
+    vk12_features.pNext = &present_id_features;
+  else
+    {
+      remove_extension (gpu, VK_KHR_PRESENT_ID_EXTENSION_NAME);
+      remove_extension (gpu, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+#endif
 
   VkDeviceCreateInfo ci = {
     .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+    .pNext = &device_features,
     .queueCreateInfoCount = 1,
     .pQueueCreateInfos = &queue_ci,
-    .enabledLayerCount = 1,
+    .enabledLayerCount = is_debug ? 1 : 0,
     .ppEnabledLayerNames = layers,
-    .enabledExtensionCount = device_ext_num,
-    .ppEnabledExtensionNames = device_exts,
-    .pEnabledFeatures = &device_features,
+    .enabledExtensionCount = gpu->device_ext_num,
+    .ppEnabledExtensionNames = gpu->device_exts,
   };
 
   if (vkCreateDevice (gpu->physical_device, &ci, NULL, &gpu->device)
       != VK_SUCCESS)
     {
       LOG_ERR ("failed to create Vulkan logical device");
-      free (device_ext_list);
       return -1;
     }
 
-  free (device_ext_list);
   return 0;
 }
 
@@ -243,16 +958,53 @@ gpu_device_new (gpu_device_t **new_gpu, const struct vk_config_t *config)
   *new_gpu = gpu;
 
   gpu->instance = VK_NULL_HANDLE;
+  gpu->debug_level = GPU_DEBUG_LEVEL_OFF;
+  gpu->messenger = VK_NULL_HANDLE;
   gpu->physical_device = VK_NULL_HANDLE;
   gpu->device = VK_NULL_HANDLE;
+  gpu->has_library = 0;
+  gpu->surface = VK_NULL_HANDLE;
+  gpu->device_ext_lists[0] = NULL;
+  gpu->device_ext_lists[1] = NULL;
+  gpu->device_ext_num = 0;
+  gpu->has_present_wait = 0;
+  gpu->has_multiview = 0;
+  gpu->has_multi_draw_indirect = 0;
+  gpu->has_draw_indirect_count = 0;
+  gpu->has_draw_indirect_first_instance = 0;
+  gpu->timeline = NULL;
+  gpu->memory = NULL;
+  gpu->pipeline_cache = VK_NULL_HANDLE;
+
+  /* opened here rather than at startup, so headless runs never load it */
+  if (gpu_dispatch_load_library ())
+    return -1;
+
+  gpu->has_library = 1;
 
   if (create_instance (gpu, config))
     return -1;
 
+  gpu_dispatch_load_instance (gpu->instance);
+
+  if (create_messenger (gpu))
+    return -1;
+
+  if (config->create_surface)
+    {
+      gpu->surface
+          = config->create_surface (gpu->instance, config->surface_userdata);
+      if (gpu->surface == VK_NULL_HANDLE)
+        {
+          LOG_ERR ("failed to create surface to select a GPU for");
+          return -1;
+        }
+    }
+
   if (config->physical_device != VK_NULL_HANDLE)
     gpu->physical_device = config->physical_device;
   else
-    gpu->physical_device = autoselect_physical_device (gpu);
+    gpu->physical_device = autoselect_physical_device (gpu, config);
 
   if (gpu->physical_device == VK_NULL_HANDLE)
     {
@@ -260,27 +1012,83 @@ gpu_device_new (gpu_device_t **new_gpu, const struct vk_config_t *config)
       return -1;
     }
 
+  if (check_device_support (gpu, config))
+    return -1;
+
   if (find_queue_families (gpu))
     return -1;
 
   if (create_logical_device (gpu, config))
     return -1;
 
+  gpu_dispatch_load_device (gpu->device);
+
+  if (gpu_timeline_new (&gpu->timeline, gpu))
+    {
+      LOG_ERR ("failed to create GPU timeline");
+      return -1;
+    }
+
+  if (gpu_memory_new (&gpu->memory, gpu))
+    {
+      LOG_ERR ("failed to create GPU memory tracker");
+      return -1;
+    }
+
+  VkPipelineCacheCreateInfo cache_ci = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+  };
+
+  if (vkCreatePipelineCache (gpu->device, &cache_ci, NULL,
+                             &gpu->pipeline_cache)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create pipeline cache");
+      return -1;
+    }
+
   return 0;
 }
 
 void
 gpu_device_delete (gpu_device_t *gpu)
 {
+  if (gpu->timeline)
+    gpu_timeline_delete (gpu->timeline);
+
+  if (gpu->memory)
+    gpu_memory_delete (gpu->memory);
+
+  if (gpu->pipeline_cache)
+    vkDestroyPipelineCache (gpu->device, gpu->pipeline_cache, NULL);
+
   if (gpu->device)
     vkDestroyDevice (gpu->device, NULL);
 
+  if (gpu->messenger)
+    vkDestroyDebugUtilsMessengerEXT (gpu->instance, gpu->messenger, NULL);
+
   if (gpu->instance)
     vkDestroyInstance (gpu->instance, NULL);
 
+  if (gpu->has_library)
+    gpu_dispatch_unload_library ();
+
+  for (int i = 0; i < 2; i++)
+    {
+      if (gpu->device_ext_lists[i])
+        free (gpu->device_ext_lists[i]);
+    }
+
   free (gpu);
 }
 
+enum gpu_debug_level
+gpu_device_get_debug_level (gpu_device_t *gpu)
+{
+  return gpu->debug_level;
+}
+
 VkInstance
 gpu_device_get_instance (gpu_device_t *gpu)
 {
@@ -313,3 +1121,113 @@ gpu_device_gfx_family (gpu_device_t *gpu)
 {
   return gpu->gfx_queue_family;
 }
+
+gpu_timeline_t *
+gpu_device_get_timeline (gpu_device_t *gpu)
+{
+  return gpu->timeline;
+}
+
+VkPipelineCache
+gpu_device_get_pipeline_cache (gpu_device_t *gpu)
+{
+  return gpu->pipeline_cache;
+}
+
+gpu_memory_t *
+gpu_device_get_memory (gpu_device_t *gpu)
+{
+  return gpu->memory;
+}
+
+int
+gpu_device_has_extension (gpu_device_t *gpu, const char *name)
+{
+  for (int i = 0; i < gpu->device_ext_num; i++)
+    {
+      if (strcmp (gpu->device_exts[i], name) == 0)
+        return 1;
+    }
+
+  return 0;
+}
+
+int
+gpu_device_has_present_wait (gpu_device_t *gpu)
+{
+  return gpu->has_present_wait;
+}
+
+int
+gpu_device_has_multiview (gpu_device_t *gpu)
+{
+  return gpu->has_multiview;
+}
+
+int
+gpu_device_has_multi_draw_indirect (gpu_device_t *gpu)
+{
+  return gpu->has_multi_draw_indirect;
+}
+
+int
+gpu_device_has_draw_indirect_count (gpu_device_t *gpu)
+{
+  return gpu->has_draw_indirect_count;
+}
+
+int
+gpu_device_has_draw_indirect_first_instance (gpu_device_t *gpu)
+{
+  return gpu->has_draw_indirect_first_instance;
+}
+
+int
+gpu_device_find_memory_type (gpu_device_t *gpu, uint32_t type_filter,
+                             VkMemoryPropertyFlags desired)
+{
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties (gpu->physical_device, &properties);
+
+  for (int i = 0; i < properties.memoryTypeCount; i++)
+    {
+      if ((type_filter & (1 << i))
+          && (properties.memoryTypes[i].propertyFlags & desired) == desired)
+        return i;
+    }
+
+  LOG_ERR ("failed to find suitable memory type");
+  return -1;
+}
+
+int
+gpu_device_find_preferred_memory_type (gpu_device_t *gpu,
+                                       uint32_t type_filter,
+                                       VkMemoryPropertyFlags required,
+                                       VkMemoryPropertyFlags preferred)
+{
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties (gpu->physical_device, &properties);
+
+  VkMemoryPropertyFlags desired = required | preferred;
+  for (int i = 0; i < properties.memoryTypeCount; i++)
+    {
+      if ((type_filter & (1 << i))
+          && (properties.memoryTypes[i].propertyFlags & desired) == desired)
+        return i;
+    }
+
+  return gpu_device_find_memory_type (gpu, type_filter, required);
+}
+
+VkMemoryPropertyFlags
+gpu_device_get_memory_type_flags (gpu_device_t *gpu, int memory_type)
+{
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties (gpu->physical_device, &properties);
+
+  if (memory_type < 0 || memory_type >= properties.memoryTypeCount)
+    return 0;
+
+  return properties.memoryTypes[memory_type].propertyFlags;
+}
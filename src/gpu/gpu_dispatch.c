@@ -0,0 +1,133 @@
+/** @file gpu_dispatch.c
+ */
+
+#include "gpu/gpu_dispatch.h"
+
+#include "log.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h> /* for LoadLibraryA, GetProcAddress */
+#else
+#include <dlfcn.h> /* for dlopen, dlsym */
+#endif
+
+#if defined(_WIN32)
+#define LOADER_NAMES { "vulkan-1.dll" }
+#elif defined(__APPLE__)
+#define LOADER_NAMES { "libvulkan.1.dylib", "libvulkan.dylib" }
+#else
+#define LOADER_NAMES { "libvulkan.so.1", "libvulkan.so" }
+#endif
+
+#define GPU_DISPATCH_DEFINE(name) MDO_HIDDEN PFN_##name name = NULL;
+
+MDO_HIDDEN PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = NULL;
+GPU_DISPATCH_GLOBAL (GPU_DISPATCH_DEFINE)
+GPU_DISPATCH_INSTANCE (GPU_DISPATCH_DEFINE)
+GPU_DISPATCH_DEVICE (GPU_DISPATCH_DEFINE)
+
+static void *g_library = NULL;
+
+static void *
+open_library (const char *name)
+{
+#if defined(_WIN32)
+  return LoadLibraryA (name);
+#else
+  return dlopen (name, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void
+close_library (void *library)
+{
+#if defined(_WIN32)
+  FreeLibrary ((HMODULE)library);
+#else
+  dlclose (library);
+#endif
+}
+
+static PFN_vkGetInstanceProcAddr
+find_get_instance_proc_addr (void *library)
+{
+#if defined(_WIN32)
+  FARPROC proc = GetProcAddress ((HMODULE)library, "vkGetInstanceProcAddr");
+  return (PFN_vkGetInstanceProcAddr)(void (*) (void))proc;
+#else
+  return (PFN_vkGetInstanceProcAddr)dlsym (library, "vkGetInstanceProcAddr");
+#endif
+}
+
+int
+gpu_dispatch_load_library (void)
+{
+  if (g_library)
+    return 0;
+
+  const char *names[] = LOADER_NAMES;
+  const char *name = NULL;
+  for (int i = 0; i < sizeof (names) / sizeof (names[0]) && !g_library; i++)
+    {
+      name = names[i];
+      g_library = open_library (name);
+    }
+
+  if (!g_library)
+    {
+      LOG_ERR ("failed to open the Vulkan loader");
+      return 1;
+    }
+
+  vkGetInstanceProcAddr = find_get_instance_proc_addr (g_library);
+  if (!vkGetInstanceProcAddr)
+    {
+      LOG_ERR ("%s has no vkGetInstanceProcAddr", name);
+      gpu_dispatch_unload_library ();
+      return 1;
+    }
+
+#define GPU_DISPATCH_LOAD_GLOBAL(fn)                                         \
+  fn = (PFN_##fn)vkGetInstanceProcAddr (VK_NULL_HANDLE, #fn);
+  GPU_DISPATCH_GLOBAL (GPU_DISPATCH_LOAD_GLOBAL)
+#undef GPU_DISPATCH_LOAD_GLOBAL
+
+  LOG_INF ("opened Vulkan loader %s", name);
+  return 0;
+}
+
+void
+gpu_dispatch_load_instance (VkInstance instance)
+{
+#define GPU_DISPATCH_LOAD_INSTANCE(fn)                                       \
+  fn = (PFN_##fn)vkGetInstanceProcAddr (instance, #fn);
+  GPU_DISPATCH_INSTANCE (GPU_DISPATCH_LOAD_INSTANCE)
+#undef GPU_DISPATCH_LOAD_INSTANCE
+}
+
+void
+gpu_dispatch_load_device (VkDevice device)
+{
+#define GPU_DISPATCH_LOAD_DEVICE(fn)                                         \
+  fn = (PFN_##fn)vkGetDeviceProcAddr (device, #fn);
+  GPU_DISPATCH_DEVICE (GPU_DISPATCH_LOAD_DEVICE)
+#undef GPU_DISPATCH_LOAD_DEVICE
+}
+
+void
+gpu_dispatch_unload_library (void)
+{
+#define GPU_DISPATCH_CLEAR(fn) fn = NULL;
+  GPU_DISPATCH_DEVICE (GPU_DISPATCH_CLEAR)
+  GPU_DISPATCH_INSTANCE (GPU_DISPATCH_CLEAR)
+  GPU_DISPATCH_GLOBAL (GPU_DISPATCH_CLEAR)
+#undef GPU_DISPATCH_CLEAR
+
+  vkGetInstanceProcAddr = NULL;
+
+  if (g_library)
+    close_library (g_library);
+
+  g_library = NULL;
+}
@@ -0,0 +1,445 @@
+/** @file gpu_memory.c
+ */
+
+#include "gpu/gpu_memory.h"
+
+#include "log.h"
+
+#include <TracyC.h>
+
+/* TODO(marceline-cramer): custom mem alloc */
+#include <stdlib.h> /* for mem alloc */
+#include <vulkan/vulkan_core.h>
+
+#define INITIAL_CAPACITY 64
+
+/* fraction of a heap assumed to be ours without VK_EXT_memory_budget */
+#define FALLBACK_BUDGET 0.8
+
+/* pressure starts above the high mark and ends below the low mark, so that
+ * callbacks don't run every frame near the threshold */
+#define PRESSURE_HIGH 0.9
+#define PRESSURE_LOW 0.8
+
+#define MIB (1024.0 * 1024.0)
+
+struct allocation
+{
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  uint32_t heap;
+  enum gpu_memory_category category;
+};
+
+struct pressure_callback
+{
+  gpu_memory_pressure_callback_t callback;
+  void *userdata;
+};
+
+struct gpu_memory_s
+{
+  gpu_device_t *gpu;
+  VkDevice vkd;
+  VkPhysicalDevice vkpd;
+  int has_budget_extension;
+  VkPhysicalDeviceMemoryProperties props;
+
+  /* as of the last budget query */
+  VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize usages[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize tracked_at_query[VK_MAX_MEMORY_HEAPS];
+
+  VkDeviceSize tracked[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize categories[GPU_MEMORY_CATEGORY_NUM];
+
+  struct
+  {
+    struct allocation *vals;
+    size_t num;
+    size_t capacity;
+  } allocations;
+
+  struct
+  {
+    struct pressure_callback *vals;
+    size_t num;
+    size_t capacity;
+  } callbacks;
+
+  int is_under_pressure;
+  int is_out_of_memory;
+  uint64_t pressure_count;
+};
+
+static const char *CATEGORY_NAMES[GPU_MEMORY_CATEGORY_NUM] = {
+  [GPU_MEMORY_OTHER] = "other",
+  [GPU_MEMORY_DEBUG_GEOMETRY] = "debug geometry",
+  [GPU_MEMORY_GEOMETRY] = "geometry",
+  [GPU_MEMORY_UNIFORMS] = "uniforms",
+  [GPU_MEMORY_INSTANCES] = "instances",
+  [GPU_MEMORY_INDIRECT] = "indirect draws",
+  [GPU_MEMORY_READBACK] = "readback",
+  [GPU_MEMORY_RENDER_TARGETS] = "render targets",
+};
+
+/* Tracy keeps plot names by pointer, so they must be literals */
+static const char *CATEGORY_PLOTS[GPU_MEMORY_CATEGORY_NUM] = {
+  [GPU_MEMORY_OTHER] = "GPU memory: other (MiB)",
+  [GPU_MEMORY_DEBUG_GEOMETRY] = "GPU memory: debug geometry (MiB)",
+  [GPU_MEMORY_GEOMETRY] = "GPU memory: geometry (MiB)",
+  [GPU_MEMORY_UNIFORMS] = "GPU memory: uniforms (MiB)",
+  [GPU_MEMORY_INSTANCES] = "GPU memory: instances (MiB)",
+  [GPU_MEMORY_INDIRECT] = "GPU memory: indirect draws (MiB)",
+  [GPU_MEMORY_READBACK] = "GPU memory: readback (MiB)",
+  [GPU_MEMORY_RENDER_TARGETS] = "GPU memory: render targets (MiB)",
+};
+
+static void
+query_budgets (gpu_memory_t *mem)
+{
+  uint32_t heap_num = mem->props.memoryHeapCount;
+
+  for (uint32_t i = 0; i < heap_num; i++)
+    mem->tracked_at_query[i] = mem->tracked[i];
+
+  if (!mem->has_budget_extension)
+    {
+      for (uint32_t i = 0; i < heap_num; i++)
+        {
+          VkDeviceSize size = mem->props.memoryHeaps[i].size;
+          mem->budgets[i] = (VkDeviceSize)(size * FALLBACK_BUDGET);
+          mem->usages[i] = mem->tracked[i];
+        }
+
+      return;
+    }
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+  };
+
+  VkPhysicalDeviceMemoryProperties2 props = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+    .pNext = &budget,
+  };
+
+  vkGetPhysicalDeviceMemoryProperties2 (mem->vkpd, &props);
+
+  for (uint32_t i = 0; i < heap_num; i++)
+    {
+      mem->budgets[i] = budget.heapBudget[i];
+      mem->usages[i] = budget.heapUsage[i];
+    }
+}
+
+/* the driver's usage goes stale between queries, so it is corrected with
+ * whatever has been allocated or freed since */
+static VkDeviceSize
+current_usage (gpu_memory_t *mem, uint32_t heap)
+{
+  VkDeviceSize usage = mem->usages[heap] + mem->tracked[heap];
+  if (usage < mem->tracked_at_query[heap])
+    return 0;
+
+  return usage - mem->tracked_at_query[heap];
+}
+
+/* @return the heap closest to its budget, or -1 if no heap is */
+static int
+fullest_heap (gpu_memory_t *mem, double *fullness)
+{
+  int fullest = -1;
+  *fullness = 0.0;
+
+  for (uint32_t i = 0; i < mem->props.memoryHeapCount; i++)
+    {
+      if (mem->budgets[i] == 0)
+        continue;
+
+      double heap_fullness
+          = (double)current_usage (mem, i) / (double)mem->budgets[i];
+      if (heap_fullness > *fullness)
+        {
+          fullest = i;
+          *fullness = heap_fullness;
+        }
+    }
+
+  return fullest;
+}
+
+static void
+signal_pressure (gpu_memory_t *mem)
+{
+  mem->pressure_count++;
+
+  /* backwards, so callbacks may remove themselves */
+  for (size_t i = mem->callbacks.num; i > 0; i--)
+    {
+      struct pressure_callback *cb = &mem->callbacks.vals[i - 1];
+      cb->callback (cb->userdata);
+    }
+}
+
+static void
+plot_usage (gpu_memory_t *mem)
+{
+  VkDeviceSize usage = 0;
+  VkDeviceSize budget = 0;
+
+  for (uint32_t i = 0; i < mem->props.memoryHeapCount; i++)
+    {
+      if (mem->props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+          usage += current_usage (mem, i);
+          budget += mem->budgets[i];
+        }
+    }
+
+  TracyCPlot ("GPU memory: device-local usage (MiB)", usage / MIB);
+  TracyCPlot ("GPU memory: device-local budget (MiB)", budget / MIB);
+
+  for (int i = 0; i < GPU_MEMORY_CATEGORY_NUM; i++)
+    TracyCPlot (CATEGORY_PLOTS[i], mem->categories[i] / MIB);
+
+  /* silences unused warnings when Tracy is disabled */
+  (void)usage;
+  (void)budget;
+}
+
+int
+gpu_memory_new (gpu_memory_t **new_mem, gpu_device_t *gpu)
+{
+  gpu_memory_t *mem = calloc (1, sizeof (gpu_memory_t));
+  *new_mem = mem;
+
+  mem->gpu = gpu;
+  mem->vkd = gpu_device_get (gpu);
+  mem->vkpd = gpu_device_get_physical (gpu);
+  mem->has_budget_extension
+      = gpu_device_has_extension (gpu, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  vkGetPhysicalDeviceMemoryProperties (mem->vkpd, &mem->props);
+
+  mem->allocations.capacity = INITIAL_CAPACITY;
+  mem->allocations.vals
+      = calloc (INITIAL_CAPACITY, sizeof (struct allocation));
+
+  mem->callbacks.capacity = INITIAL_CAPACITY;
+  mem->callbacks.vals
+      = calloc (INITIAL_CAPACITY, sizeof (struct pressure_callback));
+
+  if (!mem->allocations.vals || !mem->callbacks.vals)
+    {
+      LOG_ERR ("failed to allocate GPU memory tracking");
+      return 1;
+    }
+
+  if (!mem->has_budget_extension)
+    LOG_INF ("%s is unsupported, so memory budgets are estimated",
+             VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  query_budgets (mem);
+
+  return 0;
+}
+
+void
+gpu_memory_delete (gpu_memory_t *mem)
+{
+  if (mem->allocations.num > 0)
+    LOG_WRN ("%zu GPU memory allocations were never freed",
+             mem->allocations.num);
+
+  if (mem->allocations.vals)
+    free (mem->allocations.vals);
+
+  if (mem->callbacks.vals)
+    free (mem->callbacks.vals);
+
+  free (mem);
+}
+
+int
+gpu_memory_allocate (gpu_memory_t *mem, const VkMemoryAllocateInfo *ai,
+                     enum gpu_memory_category category,
+                     VkDeviceMemory *memory)
+{
+  if (mem->allocations.num == mem->allocations.capacity)
+    {
+      size_t capacity = mem->allocations.capacity * 2;
+      struct allocation *vals = realloc (mem->allocations.vals,
+                                         capacity * sizeof (*vals));
+      if (!vals)
+        {
+          LOG_ERR ("failed to grow GPU memory tracking");
+          return 1;
+        }
+
+      mem->allocations.vals = vals;
+      mem->allocations.capacity = capacity;
+    }
+
+  VkResult result = vkAllocateMemory (mem->vkd, ai, NULL, memory);
+  if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY
+      || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+    {
+      LOG_WRN ("out of memory allocating %.1f MiB of %s",
+               ai->allocationSize / MIB, CATEGORY_NAMES[category]);
+
+      /* callbacks run at the next update, not in the middle of whatever
+       * this allocation was for */
+      mem->is_out_of_memory = 1;
+      return 1;
+    }
+  else if (result != VK_SUCCESS)
+    return 1;
+
+  uint32_t heap = mem->props.memoryTypes[ai->memoryTypeIndex].heapIndex;
+
+  mem->allocations.vals[mem->allocations.num++] = (struct allocation){
+    .memory = *memory,
+    .size = ai->allocationSize,
+    .heap = heap,
+    .category = category,
+  };
+
+  mem->tracked[heap] += ai->allocationSize;
+  mem->categories[category] += ai->allocationSize;
+
+  return 0;
+}
+
+void
+gpu_memory_free (gpu_memory_t *mem, VkDeviceMemory memory)
+{
+  if (memory == VK_NULL_HANDLE)
+    return;
+
+  vkFreeMemory (mem->vkd, memory, NULL);
+
+  for (size_t i = 0; i < mem->allocations.num; i++)
+    {
+      struct allocation *alloc = &mem->allocations.vals[i];
+      if (alloc->memory != memory)
+        continue;
+
+      mem->tracked[alloc->heap] -= alloc->size;
+      mem->categories[alloc->category] -= alloc->size;
+
+      *alloc = mem->allocations.vals[--mem->allocations.num];
+      return;
+    }
+
+  LOG_WRN ("freed untracked GPU memory");
+}
+
+void
+gpu_memory_update (gpu_memory_t *mem)
+{
+  query_budgets (mem);
+  plot_usage (mem);
+
+  double fullness;
+  int heap = fullest_heap (mem, &fullness);
+
+  if (!mem->is_under_pressure && fullness >= PRESSURE_HIGH)
+    {
+      LOG_WRN ("GPU heap %d is at %.1f of %.1f MiB", heap,
+               current_usage (mem, heap) / MIB, mem->budgets[heap] / MIB);
+      mem->is_under_pressure = 1;
+      signal_pressure (mem);
+    }
+  else if (mem->is_out_of_memory)
+    signal_pressure (mem);
+
+  if (fullness < PRESSURE_LOW)
+    mem->is_under_pressure = 0;
+
+  mem->is_out_of_memory = 0;
+}
+
+void
+gpu_memory_get_stats (gpu_memory_t *mem, struct gpu_memory_stats *stats)
+{
+  stats->heap_num = mem->props.memoryHeapCount;
+  stats->has_budget_extension = mem->has_budget_extension;
+
+  for (uint32_t i = 0; i < stats->heap_num; i++)
+    {
+      VkMemoryHeapFlags flags = mem->props.memoryHeaps[i].flags;
+      stats->heaps[i] = (struct gpu_memory_heap_stats){
+        .budget = mem->budgets[i],
+        .usage = current_usage (mem, i),
+        .tracked = mem->tracked[i],
+        .is_device_local = (flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+      };
+    }
+
+  for (int i = 0; i < GPU_MEMORY_CATEGORY_NUM; i++)
+    stats->categories[i] = mem->categories[i];
+}
+
+uint64_t
+gpu_memory_get_pressure_count (gpu_memory_t *mem)
+{
+  return mem->pressure_count;
+}
+
+int
+gpu_memory_add_pressure_callback (gpu_memory_t *mem,
+                                  gpu_memory_pressure_callback_t callback,
+                                  void *userdata)
+{
+  if (mem->callbacks.num == mem->callbacks.capacity)
+    {
+      size_t capacity = mem->callbacks.capacity * 2;
+      struct pressure_callback *vals
+          = realloc (mem->callbacks.vals, capacity * sizeof (*vals));
+      if (!vals)
+        {
+          LOG_ERR ("failed to grow memory pressure callbacks");
+          return 1;
+        }
+
+      mem->callbacks.vals = vals;
+      mem->callbacks.capacity = capacity;
+    }
+
+  mem->callbacks.vals[mem->callbacks.num++] = (struct pressure_callback){
+    .callback = callback,
+    .userdata = userdata,
+  };
+
+  return 0;
+}
+
+void
+gpu_memory_remove_pressure_callback (gpu_memory_t *mem,
+                                     gpu_memory_pressure_callback_t callback,
+                                     void *userdata)
+{
+  for (size_t i = 0; i < mem->callbacks.num; i++)
+    {
+      struct pressure_callback *cb = &mem->callbacks.vals[i];
+      if (cb->callback == callback && cb->userdata == userdata)
+        {
+          /* order is kept, since removal may happen during a signal */
+          for (size_t j = i + 1; j < mem->callbacks.num; j++)
+            mem->callbacks.vals[j - 1] = mem->callbacks.vals[j];
+
+          mem->callbacks.num--;
+          return;
+        }
+    }
+}
+
+const char *
+gpu_memory_category_name (enum gpu_memory_category category)
+{
+  if (category < 0 || category >= GPU_MEMORY_CATEGORY_NUM)
+    return "unknown";
+
+  return CATEGORY_NAMES[category];
+}
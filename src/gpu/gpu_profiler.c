@@ -0,0 +1,517 @@
+/** @file gpu_profiler.c
+ */
+
+#include "gpu/gpu_profiler.h"
+
+#include "log.h"
+
+/* TODO(marceline-cramer): custom mem alloc */
+#include <stdlib.h> /* for mem alloc */
+#include <string.h> /* for strlen */
+
+#include <TracyC.h>
+#include <uv.h>
+#include <vulkan/vulkan_core.h>
+
+/* a pair of timestamps per zone, each taking a query per view inside
+ * multiview render passes, plus the frame's own begin/end */
+#define QUERIES_PER_FRAME                                                     \
+  (GPU_PROFILER_MAX_ZONES * 2 * GPU_PROFILER_MAX_VIEWS + 2)
+#define FRAME_BEGIN_QUERY 0
+#define FRAME_END_QUERY 1
+
+struct zone_record
+{
+  const char *name;
+  int depth;
+  int is_subzone;
+  uint32_t begin_query;
+  uint32_t end_query;
+};
+
+struct frame_slot
+{
+  struct zone_record zones[GPU_PROFILER_MAX_ZONES];
+  int zone_num;
+  uint32_t query_num;
+  uint64_t frame;
+  int is_pending;
+};
+
+struct gpu_profiler_s
+{
+  gpu_device_t *gpu;
+  VkDevice vkd;
+
+  int is_supported;
+  double period_ms;
+  uint64_t timestamp_mask;
+
+  VkQueryPool query_pool;
+  struct frame_slot *slots;
+  int slot_num;
+
+  /* guards zone allocation, which may happen on recording threads */
+  uv_mutex_t mutex;
+  int has_mutex;
+
+  struct frame_slot *current;
+  uint32_t current_base;
+  int current_depth;
+  uint64_t frame_counter;
+
+  struct gpu_frame_stats stats;
+
+#ifdef TRACY_ENABLE
+  uint8_t tracy_context;
+#endif
+};
+
+static int
+check_support (gpu_profiler_t *prof)
+{
+  VkPhysicalDevice vkpd = gpu_device_get_physical (prof->gpu);
+
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties (vkpd, &props);
+
+  uint32_t family_num = 32;
+  VkQueueFamilyProperties families[32];
+  vkGetPhysicalDeviceQueueFamilyProperties (vkpd, &family_num, families);
+
+  uint32_t gfx_family = gpu_device_gfx_family (prof->gpu);
+  uint32_t valid_bits = 0;
+  if (gfx_family < family_num)
+    valid_bits = families[gfx_family].timestampValidBits;
+
+  if (valid_bits == 0 || props.limits.timestampPeriod == 0.0)
+    {
+      LOG_WRN ("GPU timestamps are unsupported; GPU profiling is disabled");
+      return 0;
+    }
+
+  prof->period_ms = props.limits.timestampPeriod / 1000000.0;
+  prof->timestamp_mask
+      = valid_bits >= 64 ? UINT64_MAX : (((uint64_t)1) << valid_bits) - 1;
+
+  return 1;
+}
+
+static int
+create_query_pool (gpu_profiler_t *prof)
+{
+  VkQueryPoolCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+    .queryType = VK_QUERY_TYPE_TIMESTAMP,
+    .queryCount = QUERIES_PER_FRAME * prof->slot_num,
+  };
+
+  if (vkCreateQueryPool (prof->vkd, &ci, NULL, &prof->query_pool)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create timestamp query pool");
+      return 1;
+    }
+
+  return 0;
+}
+
+#ifdef TRACY_ENABLE
+static int
+calibrate_tracy (gpu_profiler_t *prof, VkQueue queue)
+{
+  static uint8_t context_counter = 0;
+
+  VkCommandPoolCreateInfo pool_ci = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+    .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+    .queueFamilyIndex = gpu_device_gfx_family (prof->gpu),
+  };
+
+  VkCommandPool command_pool;
+  if (vkCreateCommandPool (prof->vkd, &pool_ci, NULL, &command_pool)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create calibration command pool");
+      return 1;
+    }
+
+  VkCommandBufferAllocateInfo cmd_info = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+    .commandPool = command_pool,
+    .commandBufferCount = 1,
+    .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+  };
+
+  VkCommandBuffer cmd;
+  vkAllocateCommandBuffers (prof->vkd, &cmd_info, &cmd);
+
+  VkCommandBufferBeginInfo begin_info = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+
+  vkBeginCommandBuffer (cmd, &begin_info);
+  vkCmdResetQueryPool (cmd, prof->query_pool, 0, 1);
+  vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       prof->query_pool, 0);
+  vkEndCommandBuffer (cmd);
+
+  VkSubmitInfo submit_info = {
+    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .commandBufferCount = 1,
+    .pCommandBuffers = &cmd,
+  };
+
+  /* this only happens once at startup, so blocking here is fine */
+  vkQueueSubmit (queue, 1, &submit_info, VK_NULL_HANDLE);
+  vkQueueWaitIdle (queue);
+
+  uint64_t gpu_time = 0;
+  VkResult result = vkGetQueryPoolResults (
+      prof->vkd, prof->query_pool, 0, 1, sizeof (gpu_time), &gpu_time,
+      sizeof (gpu_time), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+  vkDestroyCommandPool (prof->vkd, command_pool, NULL);
+
+  if (result != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to read calibration timestamp");
+      return 1;
+    }
+
+  prof->tracy_context = context_counter++;
+
+  const uint8_t TRACY_GPU_CONTEXT_VULKAN = 2;
+
+  struct ___tracy_gpu_new_context_data data = {
+    .gpuTime = (int64_t)gpu_time,
+    .period = prof->period_ms * 1000000.0,
+    .context = prof->tracy_context,
+    .flags = 0,
+    .type = TRACY_GPU_CONTEXT_VULKAN,
+  };
+
+  ___tracy_emit_gpu_new_context (data);
+
+  return 0;
+}
+
+static void
+tracy_zone_begin (gpu_profiler_t *prof, const char *name, uint32_t query)
+{
+  uint64_t srcloc = ___tracy_alloc_srcloc_name (
+      __LINE__, __FILE__, strlen (__FILE__), __func__, strlen (__func__),
+      name, strlen (name));
+
+  struct ___tracy_gpu_zone_begin_data data = {
+    .srcloc = srcloc,
+    .queryId = (uint16_t)query,
+    .context = prof->tracy_context,
+  };
+
+  ___tracy_emit_gpu_zone_begin_alloc_serial (data);
+}
+
+static void
+tracy_zone_end (gpu_profiler_t *prof, uint32_t query)
+{
+  struct ___tracy_gpu_zone_end_data data = {
+    .queryId = (uint16_t)query,
+    .context = prof->tracy_context,
+  };
+
+  ___tracy_emit_gpu_zone_end_serial (data);
+}
+
+static void
+tracy_time (gpu_profiler_t *prof, uint32_t query, uint64_t gpu_time)
+{
+  struct ___tracy_gpu_time_data data = {
+    .gpuTime = (int64_t)gpu_time,
+    .queryId = (uint16_t)query,
+    .context = prof->tracy_context,
+  };
+
+  ___tracy_emit_gpu_time_serial (data);
+}
+#endif
+
+static void
+resolve_slot (gpu_profiler_t *prof, int slot_index)
+{
+  struct frame_slot *slot = &prof->slots[slot_index];
+  if (!slot->is_pending)
+    return;
+
+  slot->is_pending = 0;
+
+  uint32_t base = slot_index * QUERIES_PER_FRAME;
+  uint64_t results[QUERIES_PER_FRAME];
+
+  /* the slot's submission has already finished, so this never waits */
+  VkResult result = vkGetQueryPoolResults (
+      prof->vkd, prof->query_pool, base, slot->query_num, sizeof (results),
+      results, sizeof (uint64_t), VK_QUERY_RESULT_64_BIT);
+
+  if (result != VK_SUCCESS)
+    {
+      LOG_WRN ("GPU timestamps for frame %lu were not ready",
+               (unsigned long)slot->frame);
+      return;
+    }
+
+  for (uint32_t i = 0; i < slot->query_num; i++)
+    {
+      results[i] &= prof->timestamp_mask;
+#ifdef TRACY_ENABLE
+      tracy_time (prof, base + i, results[i]);
+#endif
+    }
+
+  uint64_t frame_begin = results[FRAME_BEGIN_QUERY];
+  uint64_t frame_end = results[FRAME_END_QUERY];
+
+  struct gpu_frame_stats *stats = &prof->stats;
+  stats->frame = slot->frame;
+  stats->gpu_time_ms = (frame_end - frame_begin) * prof->period_ms;
+  stats->zone_num = slot->zone_num;
+
+  for (int i = 0; i < slot->zone_num; i++)
+    {
+      const struct zone_record *zone = &slot->zones[i];
+      uint64_t zone_begin = results[zone->begin_query - base];
+      uint64_t zone_end = results[zone->end_query - base];
+
+      stats->zones[i] = (struct gpu_zone_stats){
+        .name = zone->name,
+        .depth = zone->depth,
+        .begin_ms = (zone_begin - frame_begin) * prof->period_ms,
+        .duration_ms = (zone_end - zone_begin) * prof->period_ms,
+      };
+    }
+}
+
+int
+gpu_profiler_new (gpu_profiler_t **new_prof, gpu_device_t *gpu,
+                  VkQueue queue, int frame_num)
+{
+  gpu_profiler_t *prof = malloc (sizeof (gpu_profiler_t));
+  *new_prof = prof;
+
+  prof->gpu = gpu;
+  prof->vkd = gpu_device_get (gpu);
+  prof->is_supported = 0;
+  prof->period_ms = 0.0;
+  prof->timestamp_mask = 0;
+  prof->query_pool = VK_NULL_HANDLE;
+  prof->slots = NULL;
+  prof->slot_num = frame_num;
+  prof->has_mutex = 0;
+  prof->current = NULL;
+  prof->current_base = 0;
+  prof->current_depth = 0;
+  prof->frame_counter = 0;
+  prof->stats.frame = 0;
+  prof->stats.gpu_time_ms = 0.0;
+  prof->stats.zone_num = 0;
+
+  if (!check_support (prof))
+    return 0;
+
+  prof->slots = calloc (frame_num, sizeof (struct frame_slot));
+
+  if (uv_mutex_init (&prof->mutex))
+    {
+      LOG_ERR ("failed to create GPU profiler mutex");
+      return 1;
+    }
+
+  prof->has_mutex = 1;
+
+  if (create_query_pool (prof))
+    return 1;
+
+#ifdef TRACY_ENABLE
+  if (calibrate_tracy (prof, queue))
+    return 1;
+#endif
+
+  prof->is_supported = 1;
+  return 0;
+}
+
+void
+gpu_profiler_delete (gpu_profiler_t *prof)
+{
+  if (prof->query_pool)
+    vkDestroyQueryPool (prof->vkd, prof->query_pool, NULL);
+
+  if (prof->slots)
+    free (prof->slots);
+
+  if (prof->has_mutex)
+    uv_mutex_destroy (&prof->mutex);
+
+  free (prof);
+}
+
+void
+gpu_profiler_begin_frame (gpu_profiler_t *prof, VkCommandBuffer cmd,
+                          int slot_index)
+{
+  if (!prof->is_supported)
+    return;
+
+  resolve_slot (prof, slot_index);
+
+  struct frame_slot *slot = &prof->slots[slot_index];
+  slot->zone_num = 0;
+  slot->query_num = 2;
+  slot->frame = ++prof->frame_counter;
+
+  prof->current = slot;
+  prof->current_base = slot_index * QUERIES_PER_FRAME;
+  prof->current_depth = 0;
+
+  vkCmdResetQueryPool (cmd, prof->query_pool, prof->current_base,
+                       QUERIES_PER_FRAME);
+  vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       prof->query_pool,
+                       prof->current_base + FRAME_BEGIN_QUERY);
+
+#ifdef TRACY_ENABLE
+  tracy_zone_begin (prof, "frame", prof->current_base + FRAME_BEGIN_QUERY);
+#endif
+}
+
+void
+gpu_profiler_end_frame (gpu_profiler_t *prof, VkCommandBuffer cmd)
+{
+  if (!prof->is_supported || !prof->current)
+    return;
+
+  vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       prof->query_pool, prof->current_base + FRAME_END_QUERY);
+
+#ifdef TRACY_ENABLE
+  tracy_zone_end (prof, prof->current_base + FRAME_END_QUERY);
+#endif
+
+  prof->current->is_pending = 1;
+  prof->current = NULL;
+}
+
+static int
+alloc_zone (gpu_profiler_t *prof, const char *name, int depth,
+            int is_subzone, uint32_t view_num)
+{
+  if (view_num == 0 || view_num > GPU_PROFILER_MAX_VIEWS)
+    {
+      LOG_ERR ("GPU zones support up to %d views", GPU_PROFILER_MAX_VIEWS);
+      return -1;
+    }
+
+  uv_mutex_lock (&prof->mutex);
+
+  struct frame_slot *slot = prof->current;
+  if (slot->zone_num >= GPU_PROFILER_MAX_ZONES
+      || slot->query_num + view_num * 2 > QUERIES_PER_FRAME)
+    {
+      uv_mutex_unlock (&prof->mutex);
+      return -1;
+    }
+
+  int zone_index = slot->zone_num++;
+  struct zone_record *zone = &slot->zones[zone_index];
+
+  zone->name = name;
+  zone->depth = depth;
+  zone->is_subzone = is_subzone;
+
+  /* multiview writes view_num consecutive queries per timestamp; the
+   * first holds the result and the rest may be zero */
+  zone->begin_query = prof->current_base + slot->query_num;
+  zone->end_query = zone->begin_query + view_num;
+  slot->query_num += view_num * 2;
+
+  uv_mutex_unlock (&prof->mutex);
+
+  return zone_index;
+}
+
+static void
+write_zone_begin (gpu_profiler_t *prof, VkCommandBuffer cmd, int zone_index)
+{
+  struct zone_record *zone = &prof->current->zones[zone_index];
+
+  vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       prof->query_pool, zone->begin_query);
+
+#ifdef TRACY_ENABLE
+  tracy_zone_begin (prof, zone->name, zone->begin_query);
+#endif
+}
+
+int
+gpu_profiler_begin_zone (gpu_profiler_t *prof, VkCommandBuffer cmd,
+                         const char *name)
+{
+  if (!prof->is_supported || !prof->current)
+    return -1;
+
+  int zone = alloc_zone (prof, name, prof->current_depth, 0, 1);
+  if (zone < 0)
+    return -1;
+
+  prof->current_depth++;
+  write_zone_begin (prof, cmd, zone);
+
+  return zone;
+}
+
+int
+gpu_profiler_begin_subzone (gpu_profiler_t *prof, VkCommandBuffer cmd,
+                            const char *name, int depth, uint32_t view_num)
+{
+  if (!prof->is_supported || !prof->current)
+    return -1;
+
+  int zone = alloc_zone (prof, name, depth, 1, view_num);
+  if (zone < 0)
+    return -1;
+
+  write_zone_begin (prof, cmd, zone);
+
+  return zone;
+}
+
+void
+gpu_profiler_end_zone (gpu_profiler_t *prof, VkCommandBuffer cmd, int zone)
+{
+  if (zone < 0 || !prof->current)
+    return;
+
+  struct zone_record *record = &prof->current->zones[zone];
+  if (!record->is_subzone)
+    prof->current_depth--;
+
+  vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       prof->query_pool, record->end_query);
+
+#ifdef TRACY_ENABLE
+  tracy_zone_end (prof, record->end_query);
+#endif
+}
+
+uint64_t
+gpu_profiler_get_frame (gpu_profiler_t *prof)
+{
+  return prof->frame_counter;
+}
+
+const struct gpu_frame_stats *
+gpu_profiler_get_stats (gpu_profiler_t *prof)
+{
+  return &prof->stats;
+}
@@ -0,0 +1,78 @@
+/** @file gpu_push_constants.c
+ */
+
+#include "gpu/gpu_push_constants.h"
+
+#include "log.h"
+
+#include <vulkan/vulkan_core.h>
+
+#define BLOCK_ALIGNMENT 16
+
+void
+gpu_push_layout_init (struct gpu_push_layout *layout)
+{
+  layout->range_num = 0;
+  layout->size = 0;
+}
+
+int
+gpu_push_layout_add (struct gpu_push_layout *layout,
+                     VkShaderStageFlags stages, uint32_t size,
+                     struct gpu_push_block *block)
+{
+  if (layout->range_num >= GPU_PUSH_BLOCK_MAX)
+    {
+      LOG_ERR ("too many push constant blocks");
+      return 1;
+    }
+
+  /* push constant sizes and offsets must be multiples of four */
+  if (size == 0 || size % 4 != 0)
+    {
+      LOG_ERR ("push constant block size %u is not a multiple of four",
+               size);
+      return 1;
+    }
+
+  uint32_t offset = (layout->size + BLOCK_ALIGNMENT - 1)
+                    & ~(BLOCK_ALIGNMENT - 1);
+  if (offset + size > GPU_PUSH_CONSTANTS_MIN_SIZE)
+    {
+      LOG_ERR ("push constants need %u bytes, but only %d are guaranteed",
+               offset + size, GPU_PUSH_CONSTANTS_MIN_SIZE);
+      return 1;
+    }
+
+  /* blocks never overlap, so each is pushed with exactly its own stages */
+  layout->ranges[layout->range_num++] = (VkPushConstantRange){
+    .stageFlags = stages,
+    .offset = offset,
+    .size = size,
+  };
+
+  layout->size = offset + size;
+
+  *block = (struct gpu_push_block){
+    .stages = stages,
+    .offset = offset,
+    .size = size,
+  };
+
+  return 0;
+}
+
+void
+gpu_push_block_record (VkCommandBuffer cmd, VkPipelineLayout layout,
+                       const struct gpu_push_block *block, const void *data,
+                       uint32_t size)
+{
+  if (size != block->size)
+    {
+      LOG_ERR ("pushed %u bytes into a %u-byte push constant block", size,
+               block->size);
+      return;
+    }
+
+  vkCmdPushConstants (cmd, layout, block->stages, block->offset, size, data);
+}
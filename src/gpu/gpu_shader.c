@@ -6,18 +6,146 @@
 #include <stdio.h> /* for file I/O */
 /* TODO(marceline-cramer): custom mem alloc */
 #include <stdlib.h> /* for mem alloc */
+#include <string.h> /* for memcpy, memmove */
 #include <vulkan/vulkan_core.h>
 
 #include "log.h"
 
+/* 64-bit FNV-1a */
+#define HASH_BASIS 0xcbf29ce484222325ull
+#define HASH_PRIME 0x100000001b3ull
+
 struct gpu_shader_s
 {
   gpu_device_t *gpu;
   VkShaderStageFlags stage;
 
   VkShaderModule module;
+
+  /* of the SPIR-V, so that reloaded code gets new pipeline keys */
+  uint64_t code_hash;
 };
 
+static uint64_t
+hash_bytes (uint64_t hash, const void *bytes, size_t size)
+{
+  const unsigned char *p = bytes;
+  for (size_t i = 0; i < size; i++)
+    {
+      hash ^= p[i];
+      hash *= HASH_PRIME;
+    }
+
+  return hash;
+}
+
+static int
+set_constant (struct gpu_specialization *spec, uint32_t id,
+              enum gpu_constant_type type, uint32_t bits)
+{
+  uint32_t index = 0;
+  while (index < spec->constant_num && spec->entries[index].constantID < id)
+    index++;
+
+  if (index < spec->constant_num && spec->entries[index].constantID == id)
+    {
+      if (spec->types[index] != type)
+        {
+          LOG_ERR ("specialization constant %u was set with another type",
+                   id);
+          return 1;
+        }
+
+      spec->data[index] = bits;
+      return 0;
+    }
+
+  if (spec->constant_num >= GPU_SPECIALIZATION_MAX)
+    {
+      LOG_ERR ("too many specialization constants");
+      return 1;
+    }
+
+  uint32_t after = spec->constant_num - index;
+  memmove (&spec->entries[index + 1], &spec->entries[index],
+           after * sizeof (spec->entries[0]));
+  memmove (&spec->types[index + 1], &spec->types[index],
+           after * sizeof (spec->types[0]));
+  memmove (&spec->data[index + 1], &spec->data[index],
+           after * sizeof (spec->data[0]));
+
+  spec->types[index] = type;
+  spec->data[index] = bits;
+  spec->entries[index].constantID = id;
+  spec->constant_num++;
+
+  /* offsets follow the sorted order */
+  for (uint32_t i = 0; i < spec->constant_num; i++)
+    {
+      spec->entries[i].offset = i * sizeof (spec->data[0]);
+      spec->entries[i].size = sizeof (spec->data[0]);
+    }
+
+  return 0;
+}
+
+void
+gpu_specialization_init (struct gpu_specialization *spec)
+{
+  spec->constant_num = 0;
+  spec->info = (VkSpecializationInfo){ 0 };
+}
+
+int
+gpu_specialization_set_bool (struct gpu_specialization *spec, uint32_t id,
+                             int value)
+{
+  /* VkBool32 */
+  return set_constant (spec, id, GPU_CONSTANT_BOOL, value ? 1 : 0);
+}
+
+int
+gpu_specialization_set_int (struct gpu_specialization *spec, uint32_t id,
+                            int32_t value)
+{
+  uint32_t bits;
+  memcpy (&bits, &value, sizeof (bits));
+  return set_constant (spec, id, GPU_CONSTANT_INT, bits);
+}
+
+int
+gpu_specialization_set_uint (struct gpu_specialization *spec, uint32_t id,
+                             uint32_t value)
+{
+  return set_constant (spec, id, GPU_CONSTANT_UINT, value);
+}
+
+int
+gpu_specialization_set_float (struct gpu_specialization *spec, uint32_t id,
+                              float value)
+{
+  uint32_t bits;
+  memcpy (&bits, &value, sizeof (bits));
+  return set_constant (spec, id, GPU_CONSTANT_FLOAT, bits);
+}
+
+uint64_t
+gpu_specialization_hash (const struct gpu_specialization *spec)
+{
+  uint64_t hash = HASH_BASIS;
+
+  for (uint32_t i = 0; i < spec->constant_num; i++)
+    {
+      uint32_t type = spec->types[i];
+      hash = hash_bytes (hash, &spec->entries[i].constantID,
+                         sizeof (uint32_t));
+      hash = hash_bytes (hash, &type, sizeof (type));
+      hash = hash_bytes (hash, &spec->data[i], sizeof (uint32_t));
+    }
+
+  return hash;
+}
+
 int
 gpu_shader_new (gpu_shader_t **new_shader, gpu_device_t *gpu,
                 VkShaderStageFlags stage)
@@ -28,6 +156,7 @@ gpu_shader_new (gpu_shader_t **new_shader, gpu_device_t *gpu,
   shader->gpu = gpu;
   shader->stage = stage;
   shader->module = VK_NULL_HANDLE;
+  shader->code_hash = HASH_BASIS;
 
   return 0;
 }
@@ -76,6 +205,8 @@ gpu_shader_load_from_file (gpu_shader_t *shader, const char *filename)
       return 1;
     }
 
+  shader->code_hash = hash_bytes (HASH_BASIS, code, code_size);
+
   free (code);
   fclose (f);
   return 0;
@@ -99,3 +230,41 @@ gpu_shader_get (gpu_shader_t *shader, VkPipelineShaderStageCreateInfo *ci)
 
   return 0;
 }
+
+int
+gpu_shader_get_specialized (gpu_shader_t *shader,
+                            struct gpu_specialization *spec,
+                            VkPipelineShaderStageCreateInfo *ci)
+{
+  if (gpu_shader_get (shader, ci))
+    return 1;
+
+  if (spec->constant_num == 0)
+    return 0;
+
+  spec->info = (VkSpecializationInfo){
+    .mapEntryCount = spec->constant_num,
+    .pMapEntries = spec->entries,
+    .dataSize = spec->constant_num * sizeof (spec->data[0]),
+    .pData = spec->data,
+  };
+
+  ci->pSpecializationInfo = &spec->info;
+  return 0;
+}
+
+uint64_t
+gpu_shader_get_key (gpu_shader_t *shader,
+                    const struct gpu_specialization *spec)
+{
+  uint64_t hash = shader->code_hash;
+  hash = hash_bytes (hash, &shader->stage, sizeof (shader->stage));
+
+  if (spec)
+    {
+      uint64_t spec_hash = gpu_specialization_hash (spec);
+      hash = hash_bytes (hash, &spec_hash, sizeof (spec_hash));
+    }
+
+  return hash;
+}
@@ -0,0 +1,365 @@
+/** @file gpu_staging.c
+ */
+
+#include "gpu/gpu_staging.h"
+
+#include "gpu/gpu_debug.h"
+#include "gpu/gpu_memory.h"
+#include "gpu/gpu_timeline.h"
+#include "log.h"
+
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdlib.h> /* for mem alloc */
+#include <string.h> /* for memcpy */
+
+#include <vulkan/vulkan_core.h>
+
+#define DEFAULT_CHUNK_SIZE (4 * 1024 * 1024)
+#define DEFAULT_CHUNK_NUM 4
+
+struct staging_chunk
+{
+  VkCommandPool command_pool;
+  VkCommandBuffer cmd;
+
+  /* bytes copied since the chunk was begun */
+  size_t used;
+  int is_recording;
+
+  /* the timeline value of the chunk's last submission */
+  uint64_t timeline_value;
+};
+
+struct gpu_staging_s
+{
+  gpu_device_t *gpu;
+  VkDevice vkd;
+  VkQueue queue;
+  gpu_timeline_t *timeline;
+
+  /* one buffer, persistently mapped, split evenly between the chunks */
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  char *mapped;
+
+  size_t chunk_size;
+  struct staging_chunk *chunks;
+  int chunk_num;
+  int chunk_index;
+
+  uint64_t last_value;
+};
+
+static int
+create_buffer (gpu_staging_t *staging)
+{
+  VkBufferCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+    .size = staging->chunk_size * staging->chunk_num,
+    .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+  };
+
+  if (vkCreateBuffer (staging->vkd, &ci, NULL, &staging->buffer)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create staging buffer");
+      return 1;
+    }
+
+  gpu_debug_set_name (staging->gpu, VK_OBJECT_TYPE_BUFFER,
+                      (uint64_t)staging->buffer, "staging buffer");
+
+  VkMemoryRequirements reqs;
+  vkGetBufferMemoryRequirements (staging->vkd, staging->buffer, &reqs);
+
+  int memory_type = gpu_device_find_memory_type (
+      staging->gpu, reqs.memoryTypeBits,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+          | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (memory_type < 0)
+    return 1;
+
+  VkMemoryAllocateInfo ai = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+    .allocationSize = reqs.size,
+    .memoryTypeIndex = memory_type,
+  };
+
+  if (gpu_memory_allocate (gpu_device_get_memory (staging->gpu), &ai,
+                           GPU_MEMORY_OTHER, &staging->memory))
+    {
+      LOG_ERR ("failed to allocate staging memory");
+      return 1;
+    }
+
+  if (vkBindBufferMemory (staging->vkd, staging->buffer, staging->memory, 0)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to bind staging memory");
+      return 1;
+    }
+
+  void *mapped = NULL;
+  if (vkMapMemory (staging->vkd, staging->memory, 0, VK_WHOLE_SIZE, 0,
+                   &mapped)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to map staging memory");
+      return 1;
+    }
+
+  staging->mapped = mapped;
+  return 0;
+}
+
+static int
+create_chunk (gpu_staging_t *staging, struct staging_chunk *chunk)
+{
+  VkCommandPoolCreateInfo pool_ci = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+    .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+    .queueFamilyIndex = gpu_device_gfx_family (staging->gpu),
+  };
+
+  if (vkCreateCommandPool (staging->vkd, &pool_ci, NULL,
+                           &chunk->command_pool)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create staging command pool");
+      return 1;
+    }
+
+  VkCommandBufferAllocateInfo cmd_info = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+    .commandPool = chunk->command_pool,
+    .commandBufferCount = 1,
+    .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+  };
+
+  if (vkAllocateCommandBuffers (staging->vkd, &cmd_info, &chunk->cmd)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to allocate staging command buffer");
+      return 1;
+    }
+
+  return 0;
+}
+
+int
+gpu_staging_new (gpu_staging_t **new_staging,
+                 const struct gpu_staging_config *config)
+{
+  gpu_staging_t *staging = malloc (sizeof (gpu_staging_t));
+  *new_staging = staging;
+
+  staging->gpu = config->gpu;
+  staging->vkd = gpu_device_get (config->gpu);
+  staging->timeline = gpu_device_get_timeline (config->gpu);
+  staging->buffer = VK_NULL_HANDLE;
+  staging->memory = VK_NULL_HANDLE;
+  staging->mapped = NULL;
+  staging->chunk_index = 0;
+  staging->last_value = 0;
+
+  staging->chunk_size = config->chunk_size;
+  if (staging->chunk_size == 0)
+    staging->chunk_size = DEFAULT_CHUNK_SIZE;
+
+  staging->chunk_num = config->chunk_num;
+  if (staging->chunk_num <= 0)
+    staging->chunk_num = DEFAULT_CHUNK_NUM;
+
+  staging->chunks = calloc (staging->chunk_num, sizeof (struct staging_chunk));
+  if (!staging->chunks)
+    {
+      LOG_ERR ("failed to allocate staging chunks");
+      staging->chunk_num = 0;
+      return 1;
+    }
+
+  int gfx_family = gpu_device_gfx_family (config->gpu);
+  vkGetDeviceQueue (staging->vkd, gfx_family, 0, &staging->queue);
+
+  if (create_buffer (staging))
+    return 1;
+
+  for (int i = 0; i < staging->chunk_num; i++)
+    {
+      if (create_chunk (staging, &staging->chunks[i]))
+        return 1;
+    }
+
+  return 0;
+}
+
+void
+gpu_staging_delete (gpu_staging_t *staging)
+{
+  if (staging->chunks)
+    {
+      gpu_staging_flush (staging);
+      gpu_timeline_wait (staging->timeline, staging->last_value, UINT64_MAX);
+
+      for (int i = 0; i < staging->chunk_num; i++)
+        {
+          if (staging->chunks[i].command_pool)
+            vkDestroyCommandPool (staging->vkd,
+                                  staging->chunks[i].command_pool, NULL);
+        }
+
+      free (staging->chunks);
+    }
+
+  if (staging->mapped)
+    vkUnmapMemory (staging->vkd, staging->memory);
+
+  if (staging->buffer)
+    vkDestroyBuffer (staging->vkd, staging->buffer, NULL);
+
+  gpu_memory_free (gpu_device_get_memory (staging->gpu), staging->memory);
+
+  free (staging);
+}
+
+/* waits out the chunk's previous copy, if it has one */
+static int
+begin_chunk (gpu_staging_t *staging, struct staging_chunk *chunk)
+{
+  if (gpu_timeline_wait (staging->timeline, chunk->timeline_value,
+                         UINT64_MAX))
+    {
+      LOG_ERR ("failed to wait for staging chunk");
+      return 1;
+    }
+
+  vkResetCommandPool (staging->vkd, chunk->command_pool, 0);
+
+  VkCommandBufferBeginInfo begin_info = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+
+  if (vkBeginCommandBuffer (chunk->cmd, &begin_info) != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to begin staging command buffer");
+      return 1;
+    }
+
+  chunk->used = 0;
+  chunk->is_recording = 1;
+  return 0;
+}
+
+static int
+submit_chunk (gpu_staging_t *staging, struct staging_chunk *chunk)
+{
+  chunk->is_recording = 0;
+
+  /* later submissions on the queue are ordered after this barrier, so
+   * anything may read the data without waiting on the timeline */
+  VkMemoryBarrier barrier = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+    .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+  };
+
+  vkCmdPipelineBarrier (chunk->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                        NULL, 0, NULL);
+
+  if (vkEndCommandBuffer (chunk->cmd) != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to end staging command buffer");
+      return 1;
+    }
+
+  uint64_t value = gpu_timeline_next (staging->timeline);
+  VkSemaphore semaphore = gpu_timeline_get_semaphore (staging->timeline);
+
+  VkTimelineSemaphoreSubmitInfo timeline_info = {
+    .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+    .signalSemaphoreValueCount = 1,
+    .pSignalSemaphoreValues = &value,
+  };
+
+  VkSubmitInfo submit_info = {
+    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .pNext = &timeline_info,
+    .commandBufferCount = 1,
+    .pCommandBuffers = &chunk->cmd,
+    .signalSemaphoreCount = 1,
+    .pSignalSemaphores = &semaphore,
+  };
+
+  if (vkQueueSubmit (staging->queue, 1, &submit_info, VK_NULL_HANDLE)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to submit staging copies");
+      gpu_timeline_cancel (staging->timeline, value);
+      return 1;
+    }
+
+  chunk->timeline_value = value;
+  staging->last_value = value;
+  staging->chunk_index = (staging->chunk_index + 1) % staging->chunk_num;
+  return 0;
+}
+
+int
+gpu_staging_upload (gpu_staging_t *staging, VkBuffer dst,
+                    VkDeviceSize dst_offset, const void *src, size_t size)
+{
+  const char *bytes = src;
+
+  while (size > 0)
+    {
+      struct staging_chunk *chunk = &staging->chunks[staging->chunk_index];
+      if (!chunk->is_recording && begin_chunk (staging, chunk))
+        return 1;
+
+      size_t copy_size = staging->chunk_size - chunk->used;
+      if (copy_size > size)
+        copy_size = size;
+
+      size_t src_offset = staging->chunk_index * staging->chunk_size
+                          + chunk->used;
+      memcpy (staging->mapped + src_offset, bytes, copy_size);
+
+      VkBufferCopy region = {
+        .srcOffset = src_offset,
+        .dstOffset = dst_offset,
+        .size = copy_size,
+      };
+
+      vkCmdCopyBuffer (chunk->cmd, staging->buffer, dst, 1, &region);
+
+      chunk->used += copy_size;
+      bytes += copy_size;
+      dst_offset += copy_size;
+      size -= copy_size;
+
+      if (chunk->used == staging->chunk_size
+          && submit_chunk (staging, chunk))
+        return 1;
+    }
+
+  return 0;
+}
+
+int
+gpu_staging_flush (gpu_staging_t *staging)
+{
+  struct staging_chunk *chunk = &staging->chunks[staging->chunk_index];
+  if (!chunk->is_recording)
+    return 0;
+
+  return submit_chunk (staging, chunk);
+}
+
+uint64_t
+gpu_staging_get_value (gpu_staging_t *staging)
+{
+  return staging->last_value;
+}
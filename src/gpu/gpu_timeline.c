@@ -0,0 +1,256 @@
+/** @file gpu_timeline.c
+ */
+
+#include "gpu/gpu_timeline.h"
+
+#include "gpu/gpu_debug.h"
+#include "log.h"
+
+/* TODO(marceline-cramer): custom mem alloc */
+#include <stdlib.h> /* for mem alloc */
+#include <string.h> /* for memmove */
+#include <vulkan/vulkan_core.h>
+
+struct deferred_callback
+{
+  uint64_t value;
+  gpu_timeline_callback_t callback;
+  void *userdata;
+};
+
+struct gpu_timeline_s
+{
+  gpu_device_t *gpu;
+  VkDevice vkd;
+
+  VkSemaphore semaphore;
+  uint64_t pending;
+  uint64_t completed;
+
+  struct
+  {
+    struct deferred_callback *vals;
+    size_t num;
+    size_t capacity;
+  } deferred;
+};
+
+int
+gpu_timeline_new (gpu_timeline_t **new_tl, gpu_device_t *gpu)
+{
+  gpu_timeline_t *tl = malloc (sizeof (gpu_timeline_t));
+  *new_tl = tl;
+
+  tl->gpu = gpu;
+  tl->vkd = gpu_device_get (gpu);
+  tl->semaphore = VK_NULL_HANDLE;
+  tl->pending = 0;
+  tl->completed = 0;
+
+  const size_t CAPACITY = 64;
+  tl->deferred.num = 0;
+  tl->deferred.capacity = CAPACITY;
+  tl->deferred.vals = calloc (CAPACITY, sizeof (struct deferred_callback));
+
+  VkSemaphoreTypeCreateInfo type_ci = {
+    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+    .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+    .initialValue = 0,
+  };
+
+  VkSemaphoreCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    .pNext = &type_ci,
+  };
+
+  if (vkCreateSemaphore (tl->vkd, &ci, NULL, &tl->semaphore) != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create timeline semaphore");
+      return 1;
+    }
+
+  gpu_debug_set_name (gpu, VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)tl->semaphore,
+                      "GPU timeline");
+
+  return 0;
+}
+
+void
+gpu_timeline_delete (gpu_timeline_t *tl)
+{
+  if (tl->semaphore)
+    {
+      gpu_timeline_wait (tl, tl->pending, UINT64_MAX);
+      gpu_timeline_collect (tl);
+      vkDestroySemaphore (tl->vkd, tl->semaphore, NULL);
+    }
+
+  if (tl->deferred.num > 0)
+    LOG_WRN ("%zu deferred callbacks were never run", tl->deferred.num);
+
+  if (tl->deferred.vals)
+    free (tl->deferred.vals);
+
+  free (tl);
+}
+
+VkSemaphore
+gpu_timeline_get_semaphore (gpu_timeline_t *tl)
+{
+  return tl->semaphore;
+}
+
+uint64_t
+gpu_timeline_next (gpu_timeline_t *tl)
+{
+  return ++tl->pending;
+}
+
+int
+gpu_timeline_cancel (gpu_timeline_t *tl, uint64_t value)
+{
+  if (value != tl->pending)
+    {
+      LOG_ERR ("only the last reserved timeline value can be cancelled");
+      return 1;
+    }
+
+  tl->pending--;
+  return 0;
+}
+
+uint64_t
+gpu_timeline_pending (gpu_timeline_t *tl)
+{
+  return tl->pending;
+}
+
+uint64_t
+gpu_timeline_completed (gpu_timeline_t *tl)
+{
+  /* nothing in flight, so there's nothing new to ask the driver about */
+  if (tl->completed >= tl->pending)
+    return tl->completed;
+
+  uint64_t value;
+  if (vkGetSemaphoreCounterValue (tl->vkd, tl->semaphore, &value)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to query timeline semaphore value");
+      return tl->completed;
+    }
+
+  tl->completed = value;
+  return value;
+}
+
+int
+gpu_timeline_is_complete (gpu_timeline_t *tl, uint64_t value)
+{
+  if (value <= tl->completed)
+    return 1;
+
+  return value <= gpu_timeline_completed (tl);
+}
+
+int
+gpu_timeline_wait (gpu_timeline_t *tl, uint64_t value, uint64_t timeout)
+{
+  if (gpu_timeline_is_complete (tl, value))
+    return 0;
+
+  VkSemaphoreWaitInfo wait_info = {
+    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+    .semaphoreCount = 1,
+    .pSemaphores = &tl->semaphore,
+    .pValues = &value,
+  };
+
+  VkResult result = vkWaitSemaphores (tl->vkd, &wait_info, timeout);
+
+  if (result == VK_TIMEOUT)
+    return 1;
+
+  if (result != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to wait on timeline semaphore");
+      return 1;
+    }
+
+  if (value > tl->completed)
+    tl->completed = value;
+
+  return 0;
+}
+
+int
+gpu_timeline_defer (gpu_timeline_t *tl, uint64_t value,
+                    gpu_timeline_callback_t callback, void *userdata)
+{
+  /* nothing can be using it anymore, so run it right away */
+  if (gpu_timeline_is_complete (tl, value))
+    {
+      callback (userdata);
+      return 0;
+    }
+
+  size_t required_num = tl->deferred.num + 1;
+  if (tl->deferred.capacity < required_num)
+    {
+      size_t capacity = tl->deferred.capacity * 2;
+      size_t required_size = capacity * sizeof (struct deferred_callback);
+      struct deferred_callback *vals
+          = realloc (tl->deferred.vals, required_size);
+
+      if (!vals)
+        {
+          LOG_ERR ("failed to grow deferred callback queue");
+          return 1;
+        }
+
+      tl->deferred.vals = vals;
+      tl->deferred.capacity = capacity;
+    }
+
+  /* values are usually deferred in order, so insertion is almost always an
+   * append; otherwise keep the queue sorted so collection can stop early */
+  size_t index = tl->deferred.num;
+  while (index > 0 && tl->deferred.vals[index - 1].value > value)
+    index--;
+
+  struct deferred_callback *slot = &tl->deferred.vals[index];
+  memmove (slot + 1, slot,
+           (tl->deferred.num - index) * sizeof (struct deferred_callback));
+
+  slot->value = value;
+  slot->callback = callback;
+  slot->userdata = userdata;
+  tl->deferred.num++;
+
+  return 0;
+}
+
+void
+gpu_timeline_collect (gpu_timeline_t *tl)
+{
+  if (tl->deferred.num == 0)
+    return;
+
+  uint64_t completed = gpu_timeline_completed (tl);
+
+  size_t collected = 0;
+  while (collected < tl->deferred.num
+         && tl->deferred.vals[collected].value <= completed)
+    {
+      struct deferred_callback *deferred = &tl->deferred.vals[collected];
+      deferred->callback (deferred->userdata);
+      collected++;
+    }
+
+  if (collected == 0)
+    return;
+
+  tl->deferred.num -= collected;
+  memmove (tl->deferred.vals, &tl->deferred.vals[collected],
+           tl->deferred.num * sizeof (struct deferred_callback));
+}
@@ -4,6 +4,7 @@
 #include "gpu/gpu_vector.h"
 
 #include "gpu/gpu_device.h"
+#include "gpu/gpu_memory.h"
 #include "log.h"
 
 /* TODO(marceline-cramer): custom allocation */
@@ -11,15 +12,29 @@
 #include <string.h> /* for memcpy */
 #include <vulkan/vulkan_core.h>
 
+#define MIN_SIZE 1024
+
 struct gpu_vector_s
 {
   gpu_device_t *gpu;
   VkDevice vkd;
+  gpu_memory_t *tracker;
+  enum gpu_memory_category category;
+
+  /* the tracker's pressure count as of the last allocation */
+  uint64_t pressure_count;
 
   VkBuffer buffer;
   VkDeviceMemory memory;
   VkBufferUsageFlags usage;
   size_t size;
+  uint64_t generation;
+
+  /* only filled by transfers, so never mapped */
+  int is_device_local;
+
+  /* readback memory may be cached without being coherent */
+  int is_coherent;
 };
 
 static int
@@ -45,25 +60,6 @@ create_buffer (gpu_vector_t *vec)
   return 0;
 }
 
-static int
-find_memory_type (gpu_device_t *gpu, uint32_t type_filter,
-                  VkMemoryPropertyFlags desired)
-{
-  VkPhysicalDevice vkpd = gpu_device_get_physical (gpu);
-  VkPhysicalDeviceMemoryProperties properties;
-  vkGetPhysicalDeviceMemoryProperties (vkpd, &properties);
-
-  for (int i = 0; i < properties.memoryTypeCount; i++)
-    {
-      if ((type_filter & (1 << i))
-          && (properties.memoryTypes[i].propertyFlags & desired) == desired)
-        return i;
-    }
-
-  LOG_ERR ("failed to find suitable memory type\n");
-  return -1;
-}
-
 static int
 allocate_memory (gpu_vector_t *vec)
 {
@@ -72,9 +68,22 @@ allocate_memory (gpu_vector_t *vec)
 
   VkMemoryPropertyFlags memory_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
                                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  if (vec->is_device_local)
+    memory_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-  int memory_type_index
-      = find_memory_type (vec->gpu, reqs.memoryTypeBits, memory_flags);
+  int memory_type_index;
+  if (vec->category == GPU_MEMORY_READBACK && !vec->is_device_local)
+    {
+      /* uncached reads are many times slower than cached ones */
+      memory_type_index = gpu_device_find_preferred_memory_type (
+          vec->gpu, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+          VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    }
+  else
+    {
+      memory_type_index = gpu_device_find_memory_type (
+          vec->gpu, reqs.memoryTypeBits, memory_flags);
+    }
 
   if (memory_type_index < 0)
     {
@@ -82,13 +91,19 @@ allocate_memory (gpu_vector_t *vec)
       return 1;
     }
 
+  VkMemoryPropertyFlags type_flags
+      = gpu_device_get_memory_type_flags (vec->gpu, memory_type_index);
+  vec->is_coherent = (type_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
   VkMemoryAllocateInfo ai = {
     .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
     .memoryTypeIndex = memory_type_index,
     .allocationSize = vec->size,
   };
 
-  if (vkAllocateMemory (vec->vkd, &ai, NULL, &vec->memory) != VK_SUCCESS)
+  vec->pressure_count = gpu_memory_get_pressure_count (vec->tracker);
+
+  if (gpu_memory_allocate (vec->tracker, &ai, vec->category, &vec->memory))
     {
       LOG_ERR ("failed to allocate GPU memory");
       return 1;
@@ -102,20 +117,81 @@ allocate_memory (gpu_vector_t *vec)
 
   return 0;
 }
-int
-gpu_vector_new (gpu_vector_t **new_vec, gpu_device_t *gpu,
-                VkBufferUsageFlags usage)
+
+static int
+reallocate (gpu_vector_t *vec)
+{
+  /* the new buffer may well get the old one's handle */
+  vec->generation++;
+
+  if (vec->buffer)
+    vkDestroyBuffer (vec->vkd, vec->buffer, NULL);
+
+  gpu_memory_free (vec->tracker, vec->memory);
+  vec->buffer = VK_NULL_HANDLE;
+  vec->memory = VK_NULL_HANDLE;
+
+  if (create_buffer (vec))
+    {
+      LOG_ERR ("failed to resize GPU buffer");
+      return 1;
+    }
+
+  if (allocate_memory (vec))
+    {
+      LOG_ERR ("failed to resize GPU memory");
+      return 1;
+    }
+
+  return 0;
+}
+
+/* under memory pressure, buffers much bigger than what's written into them
+ * are shrunk to fit. Writes already require the buffer to be idle, so this
+ * is the safe point to do it. */
+static int
+trim (gpu_vector_t *vec, size_t required_size)
+{
+  if (vec->is_device_local)
+    return 0;
+
+  if (gpu_memory_get_pressure_count (vec->tracker) == vec->pressure_count)
+    return 0;
+
+  vec->pressure_count = gpu_memory_get_pressure_count (vec->tracker);
+
+  size_t trimmed_size = required_size + (required_size >> 1);
+  if (trimmed_size < MIN_SIZE)
+    trimmed_size = MIN_SIZE;
+
+  if (trimmed_size >= vec->size >> 1)
+    return 0;
+
+  vec->size = trimmed_size;
+  return reallocate (vec);
+}
+
+static int
+vector_new (gpu_vector_t **new_vec, gpu_device_t *gpu,
+            VkBufferUsageFlags usage, enum gpu_memory_category category,
+            int is_device_local)
 {
   gpu_vector_t *vec = malloc (sizeof (gpu_vector_t));
   *new_vec = vec;
 
   vec->gpu = gpu;
   vec->vkd = gpu_device_get (gpu);
+  vec->tracker = gpu_device_get_memory (gpu);
+  vec->category = category;
+  vec->pressure_count = 0;
 
   vec->memory = VK_NULL_HANDLE;
   vec->buffer = VK_NULL_HANDLE;
   vec->usage = usage;
-  vec->size = 1024;
+  vec->size = MIN_SIZE;
+  vec->generation = 1;
+  vec->is_device_local = is_device_local;
+  vec->is_coherent = 1;
 
   if (create_buffer (vec))
     return 1;
@@ -126,6 +202,22 @@ gpu_vector_new (gpu_vector_t **new_vec, gpu_device_t *gpu,
   return 0;
 }
 
+int
+gpu_vector_new (gpu_vector_t **new_vec, gpu_device_t *gpu,
+                VkBufferUsageFlags usage, enum gpu_memory_category category)
+{
+  return vector_new (new_vec, gpu, usage, category, 0);
+}
+
+int
+gpu_vector_new_device_local (gpu_vector_t **new_vec, gpu_device_t *gpu,
+                             VkBufferUsageFlags usage,
+                             enum gpu_memory_category category)
+{
+  return vector_new (new_vec, gpu, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     category, 1);
+}
+
 size_t
 gpu_vector_size (gpu_vector_t *vec)
 {
@@ -141,8 +233,7 @@ gpu_vector_delete (gpu_vector_t *vec)
   if (vec->buffer)
     vkDestroyBuffer (vec->vkd, vec->buffer, NULL);
 
-  if (vec->memory)
-    vkFreeMemory (vec->vkd, vec->memory, NULL);
+  gpu_memory_free (vec->tracker, vec->memory);
 
   free (vec);
 }
@@ -158,25 +249,7 @@ gpu_vector_reserve (gpu_vector_t *vec, size_t required_size)
     }
 
   if (resize_needed)
-    {
-      if (vec->buffer)
-        vkDestroyBuffer (vec->vkd, vec->buffer, NULL);
-
-      if (vec->memory)
-        vkFreeMemory (vec->vkd, vec->memory, NULL);
-
-      if (create_buffer (vec))
-        {
-          LOG_ERR ("failed to resize GPU buffer");
-          return 1;
-        }
-
-      if (allocate_memory (vec))
-        {
-          LOG_ERR ("failed to resize GPU memory");
-          return 1;
-        }
-    }
+    return reallocate (vec);
 
   return 0;
 }
@@ -189,6 +262,18 @@ gpu_vector_write (gpu_vector_t *vec, const void *src, size_t size, size_t num)
   if (copy_size == 0)
     return 0;
 
+  if (vec->is_device_local)
+    {
+      LOG_ERR ("device-local GPU buffers can't be written by the host");
+      return 1;
+    }
+
+  if (trim (vec, copy_size))
+    {
+      LOG_ERR ("failed to trim GPU buffer");
+      return 1;
+    }
+
   if (gpu_vector_reserve (vec, copy_size))
     {
       LOG_ERR ("failed to reserve GPU memory for transfer");
@@ -196,7 +281,8 @@ gpu_vector_write (gpu_vector_t *vec, const void *src, size_t size, size_t num)
     }
 
   void *dst = NULL;
-  if (vkMapMemory (vec->vkd, vec->memory, 0, copy_size, 0, &dst) != VK_SUCCESS)
+  if (vkMapMemory (vec->vkd, vec->memory, 0, VK_WHOLE_SIZE, 0, &dst)
+      != VK_SUCCESS)
     {
       LOG_ERR ("failed to map GPU memory");
       return 1;
@@ -204,6 +290,75 @@ gpu_vector_write (gpu_vector_t *vec, const void *src, size_t size, size_t num)
 
   memcpy (dst, src, copy_size);
 
+  if (!vec->is_coherent)
+    {
+      VkMappedMemoryRange range = {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = vec->memory,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+      };
+
+      if (vkFlushMappedMemoryRanges (vec->vkd, 1, &range) != VK_SUCCESS)
+        {
+          LOG_ERR ("failed to flush GPU memory");
+          vkUnmapMemory (vec->vkd, vec->memory);
+          return 1;
+        }
+    }
+
+  vkUnmapMemory (vec->vkd, vec->memory);
+
+  return 0;
+}
+
+int
+gpu_vector_read (gpu_vector_t *vec, void *dst, size_t size)
+{
+  if (size == 0)
+    return 0;
+
+  if (size > vec->size)
+    {
+      LOG_ERR ("attempted to read past the end of a GPU buffer");
+      return 1;
+    }
+
+  if (vec->is_device_local)
+    {
+      LOG_ERR ("device-local GPU buffers can't be read by the host");
+      return 1;
+    }
+
+  void *src = NULL;
+  if (vkMapMemory (vec->vkd, vec->memory, 0, VK_WHOLE_SIZE, 0, &src)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to map GPU memory");
+      return 1;
+    }
+
+  if (!vec->is_coherent)
+    {
+      /* ranges must be aligned to nonCoherentAtomSize; the whole mapping
+       * always is */
+      VkMappedMemoryRange range = {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = vec->memory,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+      };
+
+      if (vkInvalidateMappedMemoryRanges (vec->vkd, 1, &range) != VK_SUCCESS)
+        {
+          LOG_ERR ("failed to invalidate GPU memory");
+          vkUnmapMemory (vec->vkd, vec->memory);
+          return 1;
+        }
+    }
+
+  memcpy (dst, src, size);
+
   vkUnmapMemory (vec->vkd, vec->memory);
 
   return 0;
@@ -216,3 +371,9 @@ gpu_vector_get (gpu_vector_t *vec)
     LOG_WRN ("retrieving unitialized GPU buffer");
   return vec->buffer;
 }
+
+uint64_t
+gpu_vector_get_generation (gpu_vector_t *vec)
+{
+  return vec->generation;
+}
@@ -14,50 +14,96 @@ struct camera_s
   gpu_device_t *gpu;
   VkDevice vkd;
   VkRenderPass rp;
+  VkFormat depth_format;
+  enum camera_mode mode;
   viewport_t *viewports[MAX_VIEWPORTS_PER_CAMERA];
   int viewport_num;
 };
 
+static VkFormat
+choose_depth_format (camera_t *cam)
+{
+  /* reversed-Z only pays off with floating-point depth */
+  const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM };
+  VkPhysicalDevice vkpd = gpu_device_get_physical (cam->gpu);
+
+  for (int i = 0; i < 2; i++)
+    {
+      VkFormatProperties props;
+      vkGetPhysicalDeviceFormatProperties (vkpd, candidates[i], &props);
+      if (props.optimalTilingFeatures
+          & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        return candidates[i];
+    }
+
+  return VK_FORMAT_UNDEFINED;
+}
+
 static int
 create_render_pass (camera_t *cam)
 {
+  /* the render graph transitions the image in and out of the pass */
   VkAttachmentDescription swapchain_desc = {
     .format = VK_FORMAT_B8G8R8A8_SRGB,
     .samples = VK_SAMPLE_COUNT_1_BIT,
     .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
     .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-    .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+  };
+
+  /* never stored, so tiled GPUs can keep it in tile memory. The render
+   * graph transitions it too, after whatever aliased its memory before */
+  VkAttachmentDescription depth_desc = {
+    .format = cam->depth_format,
+    .samples = VK_SAMPLE_COUNT_1_BIT,
+    .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+    .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+    .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+    .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+    .initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
   };
 
+  VkAttachmentDescription attachments[2] = { swapchain_desc, depth_desc };
+  int has_depth = cam->depth_format != VK_FORMAT_UNDEFINED;
+
   VkAttachmentReference swapchain_ref = {
     .attachment = 0,
     .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
   };
 
+  VkAttachmentReference depth_ref = {
+    .attachment = 1,
+    .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+  };
+
   VkSubpassDescription composite_sp = {
     .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
     .colorAttachmentCount = 1,
     .pColorAttachments = &swapchain_ref,
+    .pDepthStencilAttachment = has_depth ? &depth_ref : NULL,
   };
 
-  VkSubpassDependency acquire_dep = {
-    .srcSubpass = VK_SUBPASS_EXTERNAL,
-    .dstSubpass = 0,
-    .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-    .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-    .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
-    .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+  /* both eyes see nearly the same thing, which the correlation mask lets
+   * implementations take advantage of */
+  uint32_t view_mask = 0x3;
+
+  VkRenderPassMultiviewCreateInfo multiview_ci = {
+    .sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+    .subpassCount = 1,
+    .pViewMasks = &view_mask,
+    .correlationMaskCount = 1,
+    .pCorrelationMasks = &view_mask,
   };
 
   VkRenderPassCreateInfo ci = {
     .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-    .attachmentCount = 1,
-    .pAttachments = &swapchain_desc,
+    .pNext = cam->mode == CAMERA_MODE_STEREO ? &multiview_ci : NULL,
+    .attachmentCount = has_depth ? 2 : 1,
+    .pAttachments = attachments,
     .subpassCount = 1,
     .pSubpasses = &composite_sp,
-    .dependencyCount = 1,
-    .pDependencies = &acquire_dep,
   };
 
   if (vkCreateRenderPass (cam->vkd, &ci, NULL, &cam->rp) != VK_SUCCESS)
@@ -84,16 +130,44 @@ camera_new (camera_t **new_cam, const struct camera_config *config)
   cam->gpu = config->gpu;
   cam->vkd = gpu_device_get (cam->gpu);
   cam->rp = VK_NULL_HANDLE;
+  cam->depth_format = VK_FORMAT_UNDEFINED;
+  cam->mode = config->mode;
   cam->viewport_num = 0;
 
+  if (cam->mode == CAMERA_MODE_STEREO && !gpu_device_has_multiview (cam->gpu))
+    {
+      LOG_ERR ("stereo cameras need multiview support");
+      return 1;
+    }
+
+  if (config->has_depth)
+    {
+      cam->depth_format = choose_depth_format (cam);
+      if (cam->depth_format == VK_FORMAT_UNDEFINED)
+        {
+          LOG_ERR ("no depth format is supported");
+          return 1;
+        }
+
+      if (cam->depth_format != VK_FORMAT_D32_SFLOAT)
+        LOG_WRN ("D32_SFLOAT depth is unsupported; falling back to D16");
+    }
+
   if (create_render_pass (cam))
     return 1;
 
   for (int i = 0; i < config->viewport_num; i++)
     {
+      struct viewport_config vp_config = config->viewport_configs[i];
+      vp_config.depth_format = cam->depth_format;
+      if (cam->mode == CAMERA_MODE_STEREO)
+        {
+          vp_config.view_num = 2;
+          vp_config.eye_separation = config->eye_separation;
+        }
+
       cam->viewport_num++;
-      if (viewport_new (&cam->viewports[i], cam->rp,
-                        &config->viewport_configs[i]))
+      if (viewport_new (&cam->viewports[i], cam->rp, &vp_config))
         {
           LOG_ERR ("failed to create viewport");
           return 1;
@@ -121,6 +195,27 @@ camera_get_render_pass (camera_t *cam)
   return cam->rp;
 }
 
+VkFormat
+camera_get_depth_format (camera_t *cam)
+{
+  return cam->depth_format;
+}
+
+enum camera_mode
+camera_get_mode (camera_t *cam)
+{
+  return cam->mode;
+}
+
+viewport_t *
+camera_get_viewport (camera_t *cam, int index)
+{
+  if (index < 0 || index >= cam->viewport_num)
+    return NULL;
+
+  return cam->viewports[index];
+}
+
 int
 camera_acquire (camera_t *cam, viewport_t **viewports)
 {
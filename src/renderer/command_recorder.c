@@ -0,0 +1,427 @@
+/** @file command_recorder.c
+ */
+
+#include "renderer/command_recorder.h"
+
+#include "log.h"
+
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdint.h> /* for uint64_t */
+#include <stdlib.h> /* for mem alloc */
+
+#include <uv.h>
+#include <vulkan/vulkan_core.h>
+
+#define MAX_RECORDER_THREADS 16
+
+struct thread_pool
+{
+  VkCommandPool command_pool;
+
+  /* secondaries are kept across frames and handed out again after reset */
+  VkCommandBuffer *cmds;
+  int cmd_num;
+  int used;
+};
+
+struct frame_pools
+{
+  /* index 0 belongs to the calling thread, the rest to the workers */
+  struct thread_pool threads[MAX_RECORDER_THREADS + 1];
+  VkCommandBuffer primary;
+};
+
+struct worker
+{
+  command_recorder_t *rec;
+  int thread_index;
+  uv_thread_t thread;
+};
+
+struct command_recorder_s
+{
+  gpu_device_t *gpu;
+  VkDevice vkd;
+
+  struct frame_pools *frames;
+  int frame_num;
+  int frame_index;
+
+  struct worker workers[MAX_RECORDER_THREADS];
+  int thread_num;
+  int threads_started;
+
+  uv_mutex_t mutex;
+  uv_cond_t work_cond;
+  uv_cond_t done_cond;
+  uint64_t generation;
+  int should_exit;
+
+  /* the batch currently being recorded */
+  int job_num;
+  int next_job;
+  int done_num;
+  int failed;
+  const VkCommandBufferInheritanceInfo *inheritance;
+  command_record_callback_t callback;
+  void *userdata;
+  VkCommandBuffer *secondaries;
+};
+
+static int
+default_thread_num ()
+{
+  uv_cpu_info_t *infos;
+  int count;
+
+  if (uv_cpu_info (&infos, &count))
+    return 0;
+
+  uv_free_cpu_info (infos, count);
+
+  /* leave a core for the calling thread, which also records */
+  return count - 1;
+}
+
+static int
+thread_pool_init (command_recorder_t *rec, struct thread_pool *tp)
+{
+  tp->command_pool = VK_NULL_HANDLE;
+  tp->cmds = NULL;
+  tp->cmd_num = 0;
+  tp->used = 0;
+
+  VkCommandPoolCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+    .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+    .queueFamilyIndex = gpu_device_gfx_family (rec->gpu),
+  };
+
+  if (vkCreateCommandPool (rec->vkd, &ci, NULL, &tp->command_pool)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create command pool");
+      return 1;
+    }
+
+  return 0;
+}
+
+static void
+thread_pool_cleanup (command_recorder_t *rec, struct thread_pool *tp)
+{
+  /* destroying the pool frees its command buffers */
+  if (tp->command_pool)
+    vkDestroyCommandPool (rec->vkd, tp->command_pool, NULL);
+
+  if (tp->cmds)
+    free (tp->cmds);
+}
+
+static VkCommandBuffer
+thread_pool_get_secondary (command_recorder_t *rec, struct thread_pool *tp)
+{
+  if (tp->used < tp->cmd_num)
+    return tp->cmds[tp->used++];
+
+  int cmd_num = tp->cmd_num > 0 ? tp->cmd_num * 2 : 4;
+  VkCommandBuffer *cmds = realloc (tp->cmds, cmd_num * sizeof (*cmds));
+  if (!cmds)
+    return VK_NULL_HANDLE;
+
+  tp->cmds = cmds;
+
+  VkCommandBufferAllocateInfo alloc_info = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+    .commandPool = tp->command_pool,
+    .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+    .commandBufferCount = cmd_num - tp->cmd_num,
+  };
+
+  if (vkAllocateCommandBuffers (rec->vkd, &alloc_info, &cmds[tp->cmd_num])
+      != VK_SUCCESS)
+    return VK_NULL_HANDLE;
+
+  tp->cmd_num = cmd_num;
+  return tp->cmds[tp->used++];
+}
+
+static int
+record_job (command_recorder_t *rec, int thread_index, int job)
+{
+  struct frame_pools *frame = &rec->frames[rec->frame_index];
+  struct thread_pool *tp = &frame->threads[thread_index];
+
+  VkCommandBuffer cmd = thread_pool_get_secondary (rec, tp);
+  if (cmd == VK_NULL_HANDLE)
+    {
+      LOG_ERR ("failed to allocate secondary command buffer");
+      return 1;
+    }
+
+  const VkCommandBufferInheritanceInfo *inheritance = &rec->inheritance[job];
+
+  VkCommandBufferUsageFlags flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (inheritance->renderPass != VK_NULL_HANDLE)
+    flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+
+  VkCommandBufferBeginInfo begin_info = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = flags,
+    .pInheritanceInfo = inheritance,
+  };
+
+  vkBeginCommandBuffer (cmd, &begin_info);
+  rec->callback (rec->userdata, job, cmd);
+  vkEndCommandBuffer (cmd);
+
+  rec->secondaries[job] = cmd;
+  return 0;
+}
+
+static void
+run_jobs (command_recorder_t *rec, int thread_index)
+{
+  for (;;)
+    {
+      uv_mutex_lock (&rec->mutex);
+      int job = -1;
+      if (rec->next_job < rec->job_num)
+        job = rec->next_job++;
+      uv_mutex_unlock (&rec->mutex);
+
+      if (job < 0)
+        break;
+
+      int failed = record_job (rec, thread_index, job);
+
+      uv_mutex_lock (&rec->mutex);
+      rec->failed |= failed;
+      rec->done_num++;
+      if (rec->done_num == rec->job_num)
+        uv_cond_signal (&rec->done_cond);
+      uv_mutex_unlock (&rec->mutex);
+    }
+}
+
+static void
+worker_main (void *arg)
+{
+  struct worker *w = arg;
+  command_recorder_t *rec = w->rec;
+  uint64_t seen_generation = 0;
+
+  uv_mutex_lock (&rec->mutex);
+  for (;;)
+    {
+      while (rec->generation == seen_generation && !rec->should_exit)
+        uv_cond_wait (&rec->work_cond, &rec->mutex);
+
+      if (rec->should_exit)
+        break;
+
+      seen_generation = rec->generation;
+
+      uv_mutex_unlock (&rec->mutex);
+      run_jobs (rec, w->thread_index);
+      uv_mutex_lock (&rec->mutex);
+    }
+  uv_mutex_unlock (&rec->mutex);
+}
+
+static int
+start_workers (command_recorder_t *rec)
+{
+  if (uv_mutex_init (&rec->mutex) || uv_cond_init (&rec->work_cond)
+      || uv_cond_init (&rec->done_cond))
+    {
+      LOG_ERR ("failed to create recorder synchronization primitives");
+      return 1;
+    }
+
+  rec->threads_started = 1;
+
+  for (int i = 0; i < rec->thread_num; i++)
+    {
+      struct worker *w = &rec->workers[i];
+      w->rec = rec;
+      w->thread_index = i + 1;
+
+      if (uv_thread_create (&w->thread, worker_main, w))
+        {
+          LOG_ERR ("failed to create recorder thread");
+          rec->thread_num = i;
+          return 1;
+        }
+    }
+
+  LOG_INF ("recording commands on %d worker threads", rec->thread_num);
+
+  return 0;
+}
+
+static void
+stop_workers (command_recorder_t *rec)
+{
+  if (!rec->threads_started)
+    return;
+
+  uv_mutex_lock (&rec->mutex);
+  rec->should_exit = 1;
+  uv_cond_broadcast (&rec->work_cond);
+  uv_mutex_unlock (&rec->mutex);
+
+  for (int i = 0; i < rec->thread_num; i++)
+    uv_thread_join (&rec->workers[i].thread);
+
+  uv_cond_destroy (&rec->done_cond);
+  uv_cond_destroy (&rec->work_cond);
+  uv_mutex_destroy (&rec->mutex);
+}
+
+int
+command_recorder_new (command_recorder_t **new_rec,
+                      const struct command_recorder_config *config)
+{
+  command_recorder_t *rec = malloc (sizeof (command_recorder_t));
+  *new_rec = rec;
+
+  rec->gpu = config->gpu;
+  rec->vkd = gpu_device_get (config->gpu);
+  rec->frame_num = config->frame_num;
+  rec->frame_index = 0;
+  rec->threads_started = 0;
+  rec->generation = 0;
+  rec->should_exit = 0;
+  rec->job_num = 0;
+  rec->next_job = 0;
+  rec->done_num = 0;
+  rec->failed = 0;
+
+  rec->thread_num = config->thread_num;
+  if (rec->thread_num < 0)
+    rec->thread_num = default_thread_num ();
+
+  if (rec->thread_num > MAX_RECORDER_THREADS)
+    rec->thread_num = MAX_RECORDER_THREADS;
+
+  rec->frames = calloc (rec->frame_num, sizeof (struct frame_pools));
+
+  for (int i = 0; i < rec->frame_num; i++)
+    {
+      struct frame_pools *frame = &rec->frames[i];
+      frame->primary = VK_NULL_HANDLE;
+
+      for (int j = 0; j <= rec->thread_num; j++)
+        {
+          if (thread_pool_init (rec, &frame->threads[j]))
+            return 1;
+        }
+
+      VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = frame->threads[0].command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+      };
+
+      if (vkAllocateCommandBuffers (rec->vkd, &alloc_info, &frame->primary)
+          != VK_SUCCESS)
+        {
+          LOG_ERR ("failed to allocate primary command buffer");
+          return 1;
+        }
+    }
+
+  if (start_workers (rec))
+    return 1;
+
+  return 0;
+}
+
+void
+command_recorder_delete (command_recorder_t *rec)
+{
+  stop_workers (rec);
+
+  if (rec->frames)
+    {
+      for (int i = 0; i < rec->frame_num; i++)
+        {
+          for (int j = 0; j <= rec->thread_num; j++)
+            thread_pool_cleanup (rec, &rec->frames[i].threads[j]);
+        }
+
+      free (rec->frames);
+    }
+
+  free (rec);
+}
+
+int
+command_recorder_thread_num (command_recorder_t *rec)
+{
+  return rec->thread_num;
+}
+
+void
+command_recorder_begin_frame (command_recorder_t *rec, int frame_index)
+{
+  rec->frame_index = frame_index;
+
+  struct frame_pools *frame = &rec->frames[frame_index];
+  for (int i = 0; i <= rec->thread_num; i++)
+    {
+      struct thread_pool *tp = &frame->threads[i];
+      vkResetCommandPool (rec->vkd, tp->command_pool, 0);
+      tp->used = 0;
+    }
+}
+
+VkCommandBuffer
+command_recorder_get_primary (command_recorder_t *rec)
+{
+  return rec->frames[rec->frame_index].primary;
+}
+
+int
+command_recorder_record (command_recorder_t *rec, int job_num,
+                         const VkCommandBufferInheritanceInfo *inheritance,
+                         command_record_callback_t callback, void *userdata,
+                         VkCommandBuffer *secondaries)
+{
+  if (job_num <= 0)
+    return 0;
+
+  uv_mutex_lock (&rec->mutex);
+  rec->job_num = job_num;
+  rec->next_job = 0;
+  rec->done_num = 0;
+  rec->failed = 0;
+  rec->inheritance = inheritance;
+  rec->callback = callback;
+  rec->userdata = userdata;
+  rec->secondaries = secondaries;
+  rec->generation++;
+  uv_cond_broadcast (&rec->work_cond);
+  uv_mutex_unlock (&rec->mutex);
+
+  /* the calling thread pitches in instead of idling */
+  run_jobs (rec, 0);
+
+  uv_mutex_lock (&rec->mutex);
+  while (rec->done_num < rec->job_num)
+    uv_cond_wait (&rec->done_cond, &rec->mutex);
+
+  int failed = rec->failed;
+  rec->job_num = 0;
+  uv_mutex_unlock (&rec->mutex);
+
+  if (failed)
+    {
+      LOG_ERR ("failed to record secondary command buffers");
+      return 1;
+    }
+
+  return 0;
+}
@@ -4,6 +4,7 @@
 #include "renderer/debug/debug_pass.h"
 
 #include "gpu/gpu_device.h"
+#include "gpu/gpu_push_constants.h"
 #include "gpu/gpu_shader.h"
 #include "log.h"
 #include "renderer/debug/debug_draw.h"
@@ -12,6 +13,19 @@
 #include <stdlib.h> /* for mem alloc */
 #include <vulkan/vulkan_core.h>
 
+/* specialization constant IDs in the vertex pulling shaders */
+#define VERTEX_FORMAT_ID 0
+
+/* enough for every format in both single-view and multiview */
+#define VARIANT_MAX 8
+
+struct pipeline_variant
+{
+  /* of the vertex shader and its specialization */
+  uint64_t key;
+  VkPipeline pipeline;
+};
+
 struct debug_pass_s
 {
   renderer_t *ren;
@@ -20,25 +34,87 @@ struct debug_pass_s
 
   debug_draw_list_t *ddl;
 
+  /* vertices are packed here before being uploaded */
+  enum debug_vertex_format format;
+  void *packed;
+  size_t packed_capacity;
+
+  /* fetch vertices from set 1 by index instead of through vertex input */
+  int vertex_pulling;
+  VkDescriptorSetLayout set_layout;
+
   gpu_shader_t *vertex_shader;
+  gpu_shader_t *multiview_vertex_shader;
   gpu_shader_t *fragment_shader;
 
   VkPipelineLayout pipeline_layout;
+
+  /* matches DebugConstants in the debug vertex shaders */
+  struct gpu_push_block bounds_block;
+
+  /* kept for building pipelines when the format changes */
+  VkRenderPass rp;
+  VkRenderPass multiview_rp;
+
+  /* every pipeline built so far, so that switching back to a format never
+   * compiles it again */
+  struct pipeline_variant variants[VARIANT_MAX];
+  int variant_num;
+
+  /* the current format's variants; the multiview one indexes the
+   * viewport's views with gl_ViewIndex */
   VkPipeline pipeline;
+  VkPipeline multiview_pipeline;
 };
 
+static int
+create_set_layout (debug_pass_t *dbp)
+{
+  VkDescriptorSetLayoutBinding binding = {
+    .binding = 0,
+    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 1,
+    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+  };
+
+  VkDescriptorSetLayoutCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .bindingCount = 1,
+    .pBindings = &binding,
+  };
+
+  if (vkCreateDescriptorSetLayout (dbp->vkd, &ci, NULL, &dbp->set_layout)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create debug descriptor set layout");
+      return 1;
+    }
+
+  return 0;
+}
+
 static int
 create_pipeline_layout (debug_pass_t *dbp)
 {
-  VkDescriptorSetLayout layouts[1];
+  VkDescriptorSetLayout layouts[2];
 
   layouts[0] = renderer_get_viewport_layout (dbp->ren);
+  layouts[1] = dbp->set_layout;
+
+  struct gpu_push_layout push_layout;
+  gpu_push_layout_init (&push_layout);
+  if (gpu_push_layout_add (&push_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                           sizeof (struct debug_vertex_bounds),
+                           &dbp->bounds_block))
+    return 1;
 
   VkPipelineLayoutCreateInfo ci = {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
     .flags = 0,
-    .setLayoutCount = 1,
+    .setLayoutCount = dbp->vertex_pulling ? 2 : 1,
     .pSetLayouts = layouts,
+    .pushConstantRangeCount = push_layout.range_num,
+    .pPushConstantRanges = push_layout.ranges,
   };
 
   if (vkCreatePipelineLayout (dbp->vkd, &ci, NULL, &dbp->pipeline_layout)
@@ -52,7 +128,7 @@ create_pipeline_layout (debug_pass_t *dbp)
 }
 
 static int
-load_shaders (debug_pass_t *dbp)
+load_shaders (debug_pass_t *dbp, int is_multiview)
 {
   if (gpu_shader_new (&dbp->vertex_shader, dbp->gpu,
                       VK_SHADER_STAGE_VERTEX_BIT))
@@ -61,6 +137,14 @@ load_shaders (debug_pass_t *dbp)
       return 1;
     }
 
+  if (is_multiview
+      && gpu_shader_new (&dbp->multiview_vertex_shader, dbp->gpu,
+                         VK_SHADER_STAGE_VERTEX_BIT))
+    {
+      LOG_ERR ("failed to create multiview vertex shader");
+      return 1;
+    }
+
   if (gpu_shader_new (&dbp->fragment_shader, dbp->gpu,
                       VK_SHADER_STAGE_FRAGMENT_BIT))
     {
@@ -69,9 +153,27 @@ load_shaders (debug_pass_t *dbp)
     }
 
   static const char *VERTEX_SOURCE = "./shaders/debug.vert.spv";
+  static const char *MULTIVIEW_VERTEX_SOURCE
+      = "./shaders/debug_multiview.vert.spv";
+  static const char *PULL_VERTEX_SOURCE = "./shaders/debug_pull.vert.spv";
+  static const char *PULL_MULTIVIEW_VERTEX_SOURCE
+      = "./shaders/debug_pull_multiview.vert.spv";
   static const char *FRAGMENT_SOURCE = "./shaders/debug.frag.spv";
 
-  if (gpu_shader_load_from_file (dbp->vertex_shader, VERTEX_SOURCE))
+  const char *vertex_source = VERTEX_SOURCE;
+  const char *multiview_vertex_source = MULTIVIEW_VERTEX_SOURCE;
+  if (dbp->vertex_pulling)
+    {
+      vertex_source = PULL_VERTEX_SOURCE;
+      multiview_vertex_source = PULL_MULTIVIEW_VERTEX_SOURCE;
+    }
+
+  if (gpu_shader_load_from_file (dbp->vertex_shader, vertex_source))
+    return 1;
+
+  if (is_multiview
+      && gpu_shader_load_from_file (dbp->multiview_vertex_shader,
+                                    multiview_vertex_source))
     return 1;
 
   if (gpu_shader_load_from_file (dbp->fragment_shader, FRAGMENT_SOURCE))
@@ -81,33 +183,17 @@ load_shaders (debug_pass_t *dbp)
 }
 
 static int
-create_pipeline (debug_pass_t *dbp, VkRenderPass rp)
+create_pipeline (debug_pass_t *dbp, VkRenderPass rp,
+                 gpu_shader_t *vertex_shader, enum debug_vertex_format format,
+                 struct gpu_specialization *spec, VkPipeline *pipeline)
 {
   VkPipelineShaderStageCreateInfo shader_stages[2];
-  gpu_shader_get (dbp->vertex_shader, &shader_stages[0]);
+  gpu_shader_get_specialized (vertex_shader, spec, &shader_stages[0]);
   gpu_shader_get (dbp->fragment_shader, &shader_stages[1]);
 
-  VkVertexInputBindingDescription binding_desc = {
-    .binding = 0,
-    .stride = sizeof (debug_draw_vertex_t),
-    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-  };
-
+  VkVertexInputBindingDescription binding_desc;
   VkVertexInputAttributeDescription attribute_descs[2];
-
-  attribute_descs[0] = (VkVertexInputAttributeDescription){
-    .binding = 0,
-    .location = 0,
-    .format = VK_FORMAT_R32G32B32_SFLOAT,
-    .offset = offsetof (debug_draw_vertex_t, position),
-  };
-
-  attribute_descs[1] = (VkVertexInputAttributeDescription){
-    .binding = 0,
-    .location = 1,
-    .format = VK_FORMAT_R32G32B32_SFLOAT,
-    .offset = offsetof (debug_draw_vertex_t, color),
-  };
+  debug_vertex_format_describe (format, 0, &binding_desc, attribute_descs);
 
   VkPipelineVertexInputStateCreateInfo vertex_input_state = {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
@@ -117,6 +203,13 @@ create_pipeline (debug_pass_t *dbp, VkRenderPass rp)
     .pVertexAttributeDescriptions = attribute_descs,
   };
 
+  /* pulling shaders decode the format themselves, so they take no input */
+  if (dbp->vertex_pulling)
+    {
+      vertex_input_state.vertexBindingDescriptionCount = 0;
+      vertex_input_state.vertexAttributeDescriptionCount = 0;
+    }
+
   VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
     .topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
@@ -146,9 +239,13 @@ create_pipeline (debug_pass_t *dbp, VkRenderPass rp)
     .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
   };
 
+  /* reversed-Z, so nearer fragments have greater depth */
+  VkBool32 has_depth = renderer_has_depth (dbp->ren) ? VK_TRUE : VK_FALSE;
   VkPipelineDepthStencilStateCreateInfo depth_stencil_state = {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-    .depthTestEnable = VK_FALSE,
+    .depthTestEnable = has_depth,
+    .depthWriteEnable = has_depth,
+    .depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL,
   };
 
   VkPipelineColorBlendAttachmentState color_blend_attachment = {
@@ -189,8 +286,8 @@ create_pipeline (debug_pass_t *dbp, VkRenderPass rp)
     .subpass = 0,
   };
 
-  VkPipelineCache cache = VK_NULL_HANDLE;
-  if (vkCreateGraphicsPipelines (dbp->vkd, cache, 1, &ci, NULL, &dbp->pipeline)
+  VkPipelineCache cache = gpu_device_get_pipeline_cache (dbp->gpu);
+  if (vkCreateGraphicsPipelines (dbp->vkd, cache, 1, &ci, NULL, pipeline)
       != VK_SUCCESS)
     {
       LOG_ERR ("failed to create debug pipeline");
@@ -200,8 +297,54 @@ create_pipeline (debug_pass_t *dbp, VkRenderPass rp)
   return 0;
 }
 
+static int
+find_pipeline (debug_pass_t *dbp, VkRenderPass rp,
+               gpu_shader_t *vertex_shader, enum debug_vertex_format format,
+               VkPipeline *pipeline)
+{
+  *pipeline = VK_NULL_HANDLE;
+  if (rp == VK_NULL_HANDLE)
+    return 0;
+
+  /* the format is specialized even without pulling, where the shader has
+   * no such constant and ignores it, so that it still tells keys apart. Each
+   * vertex shader is only ever used with one render pass, so the key needn't
+   * include it. */
+  struct gpu_specialization spec;
+  gpu_specialization_init (&spec);
+  gpu_specialization_set_uint (&spec, VERTEX_FORMAT_ID, format);
+
+  uint64_t key = gpu_shader_get_key (vertex_shader, &spec);
+  for (int i = 0; i < dbp->variant_num; i++)
+    {
+      if (dbp->variants[i].key == key)
+        {
+          *pipeline = dbp->variants[i].pipeline;
+          return 0;
+        }
+    }
+
+  if (dbp->variant_num == VARIANT_MAX)
+    {
+      LOG_ERR ("too many debug pipeline variants");
+      return 1;
+    }
+
+  if (create_pipeline (dbp, rp, vertex_shader, format, &spec, pipeline))
+    return 1;
+
+  dbp->variants[dbp->variant_num++] = (struct pipeline_variant){
+    .key = key,
+    .pipeline = *pipeline,
+  };
+
+  return 0;
+}
+
 int
-debug_pass_new (debug_pass_t **new_dbp, renderer_t *ren, VkRenderPass rp)
+debug_pass_new (debug_pass_t **new_dbp, renderer_t *ren, VkRenderPass rp,
+                VkRenderPass multiview_rp, enum debug_vertex_format format,
+                int vertex_pulling)
 {
   debug_pass_t *dbp = malloc (sizeof (debug_pass_t));
   *new_dbp = dbp;
@@ -212,11 +355,24 @@ debug_pass_new (debug_pass_t **new_dbp, renderer_t *ren, VkRenderPass rp)
 
   dbp->ddl = NULL;
 
+  dbp->format = format;
+  dbp->packed = NULL;
+  dbp->packed_capacity = 0;
+
+  dbp->vertex_pulling = vertex_pulling;
+  dbp->set_layout = VK_NULL_HANDLE;
+
   dbp->vertex_shader = NULL;
+  dbp->multiview_vertex_shader = NULL;
   dbp->fragment_shader = NULL;
 
   dbp->pipeline_layout = VK_NULL_HANDLE;
+  dbp->bounds_block = (struct gpu_push_block){ 0 };
+  dbp->rp = rp;
+  dbp->multiview_rp = multiview_rp;
+  dbp->variant_num = 0;
   dbp->pipeline = VK_NULL_HANDLE;
+  dbp->multiview_pipeline = VK_NULL_HANDLE;
 
   if (debug_draw_list_new (&dbp->ddl))
     {
@@ -224,13 +380,16 @@ debug_pass_new (debug_pass_t **new_dbp, renderer_t *ren, VkRenderPass rp)
       return 1;
     }
 
-  if (load_shaders (dbp))
+  if (load_shaders (dbp, multiview_rp != VK_NULL_HANDLE))
+    return 1;
+
+  if (dbp->vertex_pulling && create_set_layout (dbp))
     return 1;
 
   if (create_pipeline_layout (dbp))
     return 1;
 
-  if (create_pipeline (dbp, rp))
+  if (debug_pass_set_format (dbp, format))
     return 1;
 
   return 0;
@@ -239,24 +398,51 @@ debug_pass_new (debug_pass_t **new_dbp, renderer_t *ren, VkRenderPass rp)
 void
 debug_pass_delete (debug_pass_t *dbp)
 {
-  if (dbp->pipeline)
-    vkDestroyPipeline (dbp->vkd, dbp->pipeline, NULL);
+  for (int i = 0; i < dbp->variant_num; i++)
+    vkDestroyPipeline (dbp->vkd, dbp->variants[i].pipeline, NULL);
 
   if (dbp->pipeline_layout)
     vkDestroyPipelineLayout (dbp->vkd, dbp->pipeline_layout, NULL);
 
+  if (dbp->set_layout)
+    vkDestroyDescriptorSetLayout (dbp->vkd, dbp->set_layout, NULL);
+
   if (dbp->vertex_shader)
     gpu_shader_delete (dbp->vertex_shader);
 
+  if (dbp->multiview_vertex_shader)
+    gpu_shader_delete (dbp->multiview_vertex_shader);
+
   if (dbp->fragment_shader)
     gpu_shader_delete (dbp->fragment_shader);
 
   if (dbp->ddl)
     debug_draw_list_delete (dbp->ddl);
 
+  if (dbp->packed)
+    free (dbp->packed);
+
   free (dbp);
 }
 
+int
+debug_pass_set_format (debug_pass_t *dbp, enum debug_vertex_format format)
+{
+  VkPipeline pipeline;
+  if (find_pipeline (dbp, dbp->rp, dbp->vertex_shader, format, &pipeline))
+    return 1;
+
+  VkPipeline multiview_pipeline;
+  if (find_pipeline (dbp, dbp->multiview_rp, dbp->multiview_vertex_shader,
+                     format, &multiview_pipeline))
+    return 1;
+
+  dbp->format = format;
+  dbp->pipeline = pipeline;
+  dbp->multiview_pipeline = multiview_pipeline;
+  return 0;
+}
+
 debug_draw_list_t *
 debug_pass_get_draw_list (debug_pass_t *dbp)
 {
@@ -268,28 +454,78 @@ debug_frame_data_init (debug_pass_t *dbp, struct debug_frame_data *frame)
 {
   frame->vertices = NULL;
   frame->indices = NULL;
+  frame->descriptor_pool = VK_NULL_HANDLE;
+  frame->set = VK_NULL_HANDLE;
+  frame->batch = -1;
+  frame->pipeline = VK_NULL_HANDLE;
+  frame->multiview_pipeline = VK_NULL_HANDLE;
+
+  VkBufferUsageFlags vertex_usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  if (dbp->vertex_pulling)
+    vertex_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
-  const VkBufferUsageFlags VERTEX_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
   const VkBufferUsageFlags INDEX_USAGE = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 
-  if (gpu_vector_new (&frame->vertices, dbp->gpu, VERTEX_USAGE))
+  if (gpu_vector_new (&frame->vertices, dbp->gpu, vertex_usage,
+                      GPU_MEMORY_DEBUG_GEOMETRY))
     {
       LOG_ERR ("failed to create vertex buffer");
       return 1;
     }
 
-  if (gpu_vector_new (&frame->indices, dbp->gpu, INDEX_USAGE))
+  if (gpu_vector_new (&frame->indices, dbp->gpu, INDEX_USAGE,
+                      GPU_MEMORY_DEBUG_GEOMETRY))
     {
       LOG_ERR ("failed to create index buffer");
       return 1;
     }
 
+  if (!dbp->vertex_pulling)
+    return 0;
+
+  VkDescriptorPoolSize pool_size = {
+    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 1,
+  };
+
+  VkDescriptorPoolCreateInfo dp_ci = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+    .maxSets = 1,
+    .poolSizeCount = 1,
+    .pPoolSizes = &pool_size,
+  };
+
+  if (vkCreateDescriptorPool (dbp->vkd, &dp_ci, NULL,
+                              &frame->descriptor_pool)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create debug descriptor pool");
+      return 1;
+    }
+
+  VkDescriptorSetAllocateInfo alloc_info = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    .descriptorPool = frame->descriptor_pool,
+    .descriptorSetCount = 1,
+    .pSetLayouts = &dbp->set_layout,
+  };
+
+  if (vkAllocateDescriptorSets (dbp->vkd, &alloc_info, &frame->set)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to allocate debug descriptor set");
+      return 1;
+    }
+
   return 0;
 }
 
 void
 debug_frame_data_cleanup (debug_pass_t *dbp, struct debug_frame_data *frame)
 {
+  if (frame->descriptor_pool)
+    vkDestroyDescriptorPool (dbp->vkd, frame->descriptor_pool, NULL);
+
   if (frame->vertices)
     gpu_vector_delete (frame->vertices);
 
@@ -298,34 +534,126 @@ debug_frame_data_cleanup (debug_pass_t *dbp, struct debug_frame_data *frame)
 }
 
 void
-debug_pass_render (debug_pass_t *dbp, const struct render_context *ctx,
-                   struct debug_frame_data *frame)
+debug_pass_prepare (debug_pass_t *dbp, struct debug_frame_data *frame,
+                    indirect_draws_t *draws)
 {
-  vkCmdBindDescriptorSets (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                           dbp->pipeline_layout, 0, 1, &ctx->viewport_set, 0,
-                           NULL);
-
   frame->vertex_num = debug_draw_list_vertex_num (dbp->ddl);
   frame->index_num = debug_draw_list_index_num (dbp->ddl);
 
   const debug_draw_vertex_t *vertices = debug_draw_list_vertices (dbp->ddl);
   const debug_draw_index_t *indices = debug_draw_list_indices (dbp->ddl);
 
-  gpu_vector_write (frame->vertices, vertices, sizeof (debug_draw_vertex_t),
-                    frame->vertex_num);
+  size_t stride = debug_vertex_format_stride (dbp->format);
+  size_t packed_size = stride * frame->vertex_num;
+  if (packed_size > dbp->packed_capacity)
+    {
+      void *packed = realloc (dbp->packed, packed_size);
+      if (!packed)
+        {
+          LOG_ERR ("failed to allocate packed debug vertices");
+          frame->vertex_num = 0;
+          frame->index_num = 0;
+        }
+      else
+        {
+          dbp->packed = packed;
+          dbp->packed_capacity = packed_size;
+        }
+    }
+
+  debug_vertex_compute_bounds (dbp->format, vertices, frame->vertex_num,
+                               &frame->bounds);
+  debug_vertex_pack (dbp->format, &frame->bounds, vertices,
+                     frame->vertex_num, dbp->packed);
+
+  gpu_vector_write (frame->vertices, dbp->packed, stride, frame->vertex_num);
   gpu_vector_write (frame->indices, indices, sizeof (debug_draw_index_t),
                     frame->index_num);
 
   debug_draw_list_clear (dbp->ddl);
 
+  frame->pipeline = dbp->pipeline;
+  frame->multiview_pipeline = dbp->multiview_pipeline;
+
+  frame->batch = -1;
+  if (frame->index_num == 0)
+    return;
+
+  /* writing may have reallocated the vertex buffer */
+  if (dbp->vertex_pulling)
+    {
+      VkDescriptorBufferInfo buffer_info = {
+        .buffer = gpu_vector_get (frame->vertices),
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+      };
+
+      VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = frame->set,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffer_info,
+      };
+
+      vkUpdateDescriptorSets (dbp->vkd, 1, &write, 0, NULL);
+    }
+
+  VkDrawIndexedIndirectCommand command = {
+    .indexCount = frame->index_num,
+    .instanceCount = 1,
+    .firstIndex = 0,
+    .vertexOffset = 0,
+    .firstInstance = 0,
+  };
+
+  frame->batch = indirect_draws_begin_batch (draws);
+  if (frame->batch < 0 || indirect_draws_add (draws, &command))
+    {
+      LOG_ERR ("failed to add debug draw");
+      frame->batch = -1;
+    }
+}
+
+void
+debug_pass_render (debug_pass_t *dbp, const struct render_context *ctx,
+                   struct debug_frame_data *frame)
+{
+  if (frame->batch < 0)
+    return;
+
+  VkPipeline pipeline = frame->pipeline;
+  if (ctx->view_num > 1)
+    pipeline = frame->multiview_pipeline;
+
+  /* no pipeline was made for this kind of render pass */
+  if (pipeline == VK_NULL_HANDLE)
+    return;
+
+  vkCmdBindDescriptorSets (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           dbp->pipeline_layout, 0, 1, &ctx->viewport_set, 1,
+                           &ctx->viewport_offset);
+
   VkBuffer vertex_buffer = gpu_vector_get (frame->vertices);
   VkBuffer index_buffer = gpu_vector_get (frame->indices);
 
-  vkCmdBindPipeline (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, dbp->pipeline);
+  vkCmdBindPipeline (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+  GPU_PUSH_BLOCK (ctx->cmd, dbp->pipeline_layout, &dbp->bounds_block,
+                  &frame->bounds);
+
+  if (dbp->vertex_pulling)
+    vkCmdBindDescriptorSets (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                             dbp->pipeline_layout, 1, 1, &frame->set, 0,
+                             NULL);
+  else
+    {
+      size_t offsets[] = { 0 };
+      vkCmdBindVertexBuffers (ctx->cmd, 0, 1, &vertex_buffer, offsets);
+    }
 
-  size_t offsets[] = { 0 };
-  vkCmdBindVertexBuffers (ctx->cmd, 0, 1, &vertex_buffer, offsets);
   vkCmdBindIndexBuffer (ctx->cmd, index_buffer, 0, VK_INDEX_TYPE_UINT32);
 
-  vkCmdDrawIndexed (ctx->cmd, frame->index_num, 1, 0, 0, 0);
+  indirect_draws_record (ctx->draws, ctx->cmd, frame->batch);
 }
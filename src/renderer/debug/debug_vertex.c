@@ -0,0 +1,219 @@
+/** @file debug_vertex.c
+ */
+
+#include "renderer/debug/debug_vertex.h"
+
+#include <float.h>  /* for FLT_MAX */
+#include <math.h>   /* for lrintf */
+#include <string.h> /* for memcpy */
+
+/* both packed formats share this layout; only the position encoding
+ * differs */
+struct packed_vertex
+{
+  uint16_t position[4];
+  uint8_t color[4];
+};
+
+static uint16_t
+float_to_half (float value)
+{
+  uint32_t bits;
+  memcpy (&bits, &value, sizeof (bits));
+
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t float_exponent = (bits >> 23) & 0xff;
+  int32_t exponent = (int32_t)float_exponent - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  /* infinity and NaN */
+  if (float_exponent == 0xff)
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+  if (exponent >= 31)
+    return sign | 0x7c00;
+
+  /* subnormal, or too small for even that */
+  if (exponent <= 0)
+    {
+      if (exponent < -10)
+        return sign;
+
+      mantissa |= 0x800000;
+      uint32_t shift = 14 - exponent;
+      uint32_t half = mantissa >> shift;
+      if ((mantissa >> (shift - 1)) & 1)
+        half++;
+
+      return sign | half;
+    }
+
+  /* rounding may carry into the exponent, which is still correct */
+  uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+  if (mantissa & 0x1000)
+    half++;
+
+  return half;
+}
+
+static uint16_t
+float_to_snorm16 (float value)
+{
+  if (value > 1.0f)
+    value = 1.0f;
+  else if (value < -1.0f)
+    value = -1.0f;
+
+  int16_t snorm = (int16_t)lrintf (value * 32767.0f);
+
+  uint16_t bits;
+  memcpy (&bits, &snorm, sizeof (bits));
+  return bits;
+}
+
+static uint8_t
+float_to_unorm8 (float value)
+{
+  if (value > 1.0f)
+    value = 1.0f;
+  else if (value < 0.0f)
+    value = 0.0f;
+
+  return (uint8_t)lrintf (value * 255.0f);
+}
+
+size_t
+debug_vertex_format_stride (enum debug_vertex_format format)
+{
+  switch (format)
+    {
+    case DEBUG_VERTEX_FORMAT_HALF:
+    case DEBUG_VERTEX_FORMAT_SNORM16:
+      return sizeof (struct packed_vertex);
+    case DEBUG_VERTEX_FORMAT_FLOAT:
+    default:
+      return sizeof (debug_draw_vertex_t);
+    }
+}
+
+void
+debug_vertex_format_describe (enum debug_vertex_format format,
+                              uint32_t binding,
+                              VkVertexInputBindingDescription *binding_desc,
+                              VkVertexInputAttributeDescription attributes[2])
+{
+  *binding_desc = (VkVertexInputBindingDescription){
+    .binding = binding,
+    .stride = debug_vertex_format_stride (format),
+    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+
+  VkFormat position_format = VK_FORMAT_R32G32B32_SFLOAT;
+  VkFormat color_format = VK_FORMAT_R32G32B32_SFLOAT;
+  uint32_t position_offset = offsetof (debug_draw_vertex_t, position);
+  uint32_t color_offset = offsetof (debug_draw_vertex_t, color);
+
+  /* three-component 16-bit formats aren't guaranteed for vertex input, so
+   * positions are padded to four */
+  if (format != DEBUG_VERTEX_FORMAT_FLOAT)
+    {
+      position_format = format == DEBUG_VERTEX_FORMAT_HALF
+                            ? VK_FORMAT_R16G16B16A16_SFLOAT
+                            : VK_FORMAT_R16G16B16A16_SNORM;
+      color_format = VK_FORMAT_R8G8B8A8_UNORM;
+      position_offset = offsetof (struct packed_vertex, position);
+      color_offset = offsetof (struct packed_vertex, color);
+    }
+
+  attributes[0] = (VkVertexInputAttributeDescription){
+    .binding = binding,
+    .location = 0,
+    .format = position_format,
+    .offset = position_offset,
+  };
+
+  attributes[1] = (VkVertexInputAttributeDescription){
+    .binding = binding,
+    .location = 1,
+    .format = color_format,
+    .offset = color_offset,
+  };
+}
+
+void
+debug_vertex_compute_bounds (enum debug_vertex_format format,
+                             const debug_draw_vertex_t *vertices,
+                             size_t vertex_num,
+                             struct debug_vertex_bounds *bounds)
+{
+  *bounds = (struct debug_vertex_bounds){
+    .origin = { 0.0f, 0.0f, 0.0f, 0.0f },
+    .scale = { 1.0f, 1.0f, 1.0f, 1.0f },
+  };
+
+  if (format == DEBUG_VERTEX_FORMAT_FLOAT || vertex_num == 0)
+    return;
+
+  float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+  float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+  for (size_t i = 0; i < vertex_num; i++)
+    {
+      for (int j = 0; j < 3; j++)
+        {
+          float value = vertices[i].position[j];
+          min[j] = value < min[j] ? value : min[j];
+          max[j] = value > max[j] ? value : max[j];
+        }
+    }
+
+  for (int j = 0; j < 3; j++)
+    {
+      bounds->origin[j] = (min[j] + max[j]) * 0.5f;
+
+      /* half floats carry their own exponent, so only the origin helps */
+      float extent = (max[j] - min[j]) * 0.5f;
+      if (format == DEBUG_VERTEX_FORMAT_SNORM16 && extent > 0.0f)
+        bounds->scale[j] = extent;
+    }
+}
+
+void
+debug_vertex_pack (enum debug_vertex_format format,
+                   const struct debug_vertex_bounds *bounds,
+                   const debug_draw_vertex_t *vertices, size_t vertex_num,
+                   void *dst)
+{
+  if (format == DEBUG_VERTEX_FORMAT_FLOAT)
+    {
+      memcpy (dst, vertices, vertex_num * sizeof (debug_draw_vertex_t));
+      return;
+    }
+
+  float inv_scale[3];
+  for (int j = 0; j < 3; j++)
+    inv_scale[j] = 1.0f / bounds->scale[j];
+
+  struct packed_vertex *packed = dst;
+  for (size_t i = 0; i < vertex_num; i++)
+    {
+      const debug_draw_vertex_t *vertex = &vertices[i];
+
+      for (int j = 0; j < 3; j++)
+        {
+          float local
+              = (vertex->position[j] - bounds->origin[j]) * inv_scale[j];
+          if (format == DEBUG_VERTEX_FORMAT_HALF)
+            packed[i].position[j] = float_to_half (local);
+          else
+            packed[i].position[j] = float_to_snorm16 (local);
+        }
+
+      packed[i].position[3] = 0;
+
+      for (int j = 0; j < 3; j++)
+        packed[i].color[j] = float_to_unorm8 (vertex->color[j]);
+
+      packed[i].color[3] = 255;
+    }
+}
@@ -0,0 +1,654 @@
+/** @file frame_capture.c
+ */
+
+#include "renderer/frame_capture.h"
+
+#include "gpu/gpu_timeline.h"
+#include "gpu/gpu_vector.h"
+#include "log.h"
+
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdint.h> /* for uint8_t, uint32_t */
+#include <stdio.h>  /* for FILE */
+#include <stdlib.h> /* for mem alloc */
+#include <string.h> /* for strlen, memcpy */
+
+#include <uv.h>
+#include <vulkan/vulkan_core.h>
+
+#define DEFAULT_SLOT_NUM 4
+#define MAX_SLOT_NUM 16
+#define DEFAULT_FRAME_RATE 60
+
+/* the largest block deflate can store without compressing */
+#define MAX_STORED_BLOCK 65535
+
+enum slot_state
+{
+  SLOT_FREE,
+
+  /* owned by the GPU until its timeline value is reached */
+  SLOT_COPYING,
+
+  /* waiting for the worker */
+  SLOT_READY,
+  SLOT_ENCODING,
+};
+
+struct capture_slot
+{
+  enum slot_state state;
+  gpu_vector_t *buffer;
+
+  /* zero until the copy is submitted */
+  uint64_t timeline_value;
+
+  uint64_t frame;
+  int width;
+  int height;
+  int layer_num;
+};
+
+struct frame_capture_s
+{
+  gpu_device_t *gpu;
+  gpu_timeline_t *timeline;
+  viewport_t *vp;
+  enum frame_capture_format format;
+  char *path;
+  int frame_rate;
+
+  struct capture_slot slots[MAX_SLOT_NUM];
+  int slot_num;
+
+  /* main thread only */
+  int recording_slot;
+  uint64_t next_frame;
+
+  /* worker only */
+  uint8_t *pixels;
+  size_t pixels_size;
+  uint8_t *encoded;
+  size_t encoded_size;
+  FILE *stream;
+  int stream_width;
+  int stream_height;
+
+  /* guards slot states, stats, and should_exit */
+  uv_mutex_t mutex;
+  uv_cond_t ready_cond;
+  uv_thread_t worker;
+  int worker_started;
+  int should_exit;
+  struct frame_capture_stats stats;
+};
+
+static uint32_t crc_table[256];
+
+static void
+init_crc_table ()
+{
+  for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+
+      crc_table[i] = c;
+    }
+}
+
+static uint32_t
+update_crc (uint32_t crc, const uint8_t *data, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+    crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+  return crc;
+}
+
+static void
+put_u32_be (uint8_t *dst, uint32_t value)
+{
+  dst[0] = value >> 24;
+  dst[1] = value >> 16;
+  dst[2] = value >> 8;
+  dst[3] = value;
+}
+
+static int
+grow_scratch (uint8_t **scratch, size_t *scratch_size, size_t size)
+{
+  if (size <= *scratch_size)
+    return 0;
+
+  uint8_t *grown = realloc (*scratch, size);
+  if (!grown)
+    return 1;
+
+  *scratch = grown;
+  *scratch_size = size;
+  return 0;
+}
+
+static void
+write_png_chunk (FILE *file, const char *type, const uint8_t *data,
+                 uint32_t size)
+{
+  uint8_t header[8];
+  put_u32_be (header, size);
+  memcpy (&header[4], type, 4);
+
+  uint32_t crc = update_crc (0xffffffffu, &header[4], 4);
+  crc = update_crc (crc, data, size);
+
+  uint8_t footer[4];
+  put_u32_be (footer, crc ^ 0xffffffffu);
+
+  fwrite (header, 1, 8, file);
+  fwrite (data, 1, size, file);
+  fwrite (footer, 1, 4, file);
+}
+
+/* RGB8 without compression, which keeps encoding cheap enough to keep up */
+static int
+encode_png (frame_capture_t *cap, const struct capture_slot *slot,
+            FILE *file)
+{
+  int width = slot->width;
+  int height = slot->height * slot->layer_num;
+
+  size_t row_size = 1 + (size_t)width * 3;
+  size_t raw_size = row_size * height;
+  size_t block_num = (raw_size + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK;
+
+  /* zlib header, stored blocks, and the adler32 checksum */
+  size_t zlib_size = 2 + raw_size + block_num * 5 + 4;
+  if (grow_scratch (&cap->encoded, &cap->encoded_size, zlib_size))
+    return 1;
+
+  uint8_t *out = cap->encoded;
+  *out++ = 0x78;
+  *out++ = 0x01;
+
+  uint32_t adler_a = 1;
+  uint32_t adler_b = 0;
+  size_t block_left = 0;
+  size_t raw_left = raw_size;
+
+  for (int y = 0; y < height; y++)
+    {
+      const uint8_t *row = &cap->pixels[(size_t)y * width * 4];
+      for (int x = -1; x < width; x++)
+        {
+          /* every scanline starts with filter type zero */
+          uint8_t pixel[3] = { 0 };
+          int byte_num = 1;
+          if (x >= 0)
+            {
+              memcpy (pixel, &row[x * 4], 3);
+              byte_num = 3;
+            }
+
+          for (int i = 0; i < byte_num; i++)
+            {
+              if (block_left == 0)
+                {
+                  block_left = raw_left < MAX_STORED_BLOCK ? raw_left
+                                                           : MAX_STORED_BLOCK;
+                  *out++ = raw_left == block_left;
+                  *out++ = block_left & 0xff;
+                  *out++ = block_left >> 8;
+                  *out++ = ~block_left & 0xff;
+                  *out++ = (~block_left >> 8) & 0xff;
+                }
+
+              *out++ = pixel[i];
+              adler_a = (adler_a + pixel[i]) % 65521;
+              adler_b = (adler_b + adler_a) % 65521;
+              block_left--;
+              raw_left--;
+            }
+        }
+    }
+
+  put_u32_be (out, (adler_b << 16) | adler_a);
+
+  static const uint8_t SIGNATURE[8]
+      = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  fwrite (SIGNATURE, 1, 8, file);
+
+  uint8_t ihdr[13];
+  put_u32_be (&ihdr[0], width);
+  put_u32_be (&ihdr[4], height);
+  ihdr[8] = 8;  /* bit depth */
+  ihdr[9] = 2;  /* truecolor */
+  ihdr[10] = 0; /* deflate */
+  ihdr[11] = 0; /* adaptive filtering */
+  ihdr[12] = 0; /* not interlaced */
+
+  write_png_chunk (file, "IHDR", ihdr, 13);
+  write_png_chunk (file, "IDAT", cap->encoded, zlib_size);
+  write_png_chunk (file, "IEND", NULL, 0);
+  return 0;
+}
+
+/* full-range RGB to limited-range BT.601, without chroma subsampling */
+static int
+encode_y4m (frame_capture_t *cap, const struct capture_slot *slot)
+{
+  int width = slot->width;
+  int height = slot->height * slot->layer_num;
+
+  if (!cap->stream)
+    {
+      cap->stream = fopen (cap->path, "wb");
+      if (!cap->stream)
+        {
+          LOG_ERR ("failed to open %s", cap->path);
+          return 1;
+        }
+
+      cap->stream_width = width;
+      cap->stream_height = height;
+      fprintf (cap->stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width,
+               height, cap->frame_rate);
+    }
+
+  if (width != cap->stream_width || height != cap->stream_height)
+    {
+      LOG_WRN ("dropping a %dx%d frame from a %dx%d stream", width, height,
+               cap->stream_width, cap->stream_height);
+      return 1;
+    }
+
+  size_t plane_size = (size_t)width * height;
+  if (grow_scratch (&cap->encoded, &cap->encoded_size, plane_size * 3))
+    return 1;
+
+  uint8_t *y_plane = cap->encoded;
+  uint8_t *u_plane = &y_plane[plane_size];
+  uint8_t *v_plane = &u_plane[plane_size];
+
+  for (size_t i = 0; i < plane_size; i++)
+    {
+      int r = cap->pixels[i * 4 + 0];
+      int g = cap->pixels[i * 4 + 1];
+      int b = cap->pixels[i * 4 + 2];
+
+      y_plane[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+      u_plane[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+      v_plane[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+
+  fprintf (cap->stream, "FRAME\n");
+  fwrite (cap->encoded, 1, plane_size * 3, cap->stream);
+  return ferror (cap->stream) ? 1 : 0;
+}
+
+static int
+encode_file (frame_capture_t *cap, const struct capture_slot *slot)
+{
+  const char *extension
+      = cap->format == FRAME_CAPTURE_FORMAT_PNG ? "png" : "rgba";
+
+  char *path = malloc (strlen (cap->path) + 32);
+  sprintf (path, "%s_%06llu.%s", cap->path, (unsigned long long)slot->frame,
+           extension);
+
+  FILE *file = fopen (path, "wb");
+  if (!file)
+    {
+      LOG_ERR ("failed to open %s", path);
+      free (path);
+      return 1;
+    }
+
+  int result = 0;
+  if (cap->format == FRAME_CAPTURE_FORMAT_PNG)
+    result = encode_png (cap, slot, file);
+  else
+    {
+      size_t size = (size_t)slot->width * slot->height * slot->layer_num * 4;
+      fwrite (cap->pixels, 1, size, file);
+    }
+
+  if (ferror (file))
+    result = 1;
+
+  fclose (file);
+  free (path);
+  return result;
+}
+
+static int
+encode_slot (frame_capture_t *cap, const struct capture_slot *slot)
+{
+  size_t size = (size_t)slot->width * slot->height * slot->layer_num * 4;
+  if (grow_scratch (&cap->pixels, &cap->pixels_size, size))
+    {
+      LOG_ERR ("failed to allocate capture pixels");
+      return 1;
+    }
+
+  if (gpu_vector_read (slot->buffer, cap->pixels, size))
+    return 1;
+
+  /* BGRA to RGBA */
+  for (size_t i = 0; i < size; i += 4)
+    {
+      uint8_t blue = cap->pixels[i];
+      cap->pixels[i] = cap->pixels[i + 2];
+      cap->pixels[i + 2] = blue;
+    }
+
+  if (cap->format == FRAME_CAPTURE_FORMAT_Y4M)
+    return encode_y4m (cap, slot);
+
+  return encode_file (cap, slot);
+}
+
+/* oldest first, so streams stay in order */
+static struct capture_slot *
+next_ready_slot (frame_capture_t *cap)
+{
+  struct capture_slot *next = NULL;
+  for (int i = 0; i < cap->slot_num; i++)
+    {
+      struct capture_slot *slot = &cap->slots[i];
+      if (slot->state != SLOT_READY)
+        continue;
+
+      if (!next || slot->frame < next->frame)
+        next = slot;
+    }
+
+  return next;
+}
+
+static void
+worker_main (void *arg)
+{
+  frame_capture_t *cap = arg;
+
+  uv_mutex_lock (&cap->mutex);
+  for (;;)
+    {
+      struct capture_slot *slot = next_ready_slot (cap);
+      if (!slot)
+        {
+          /* finishes every ready frame before exiting */
+          if (cap->should_exit)
+            break;
+
+          uv_cond_wait (&cap->ready_cond, &cap->mutex);
+          continue;
+        }
+
+      slot->state = SLOT_ENCODING;
+      uv_mutex_unlock (&cap->mutex);
+
+      int failed = encode_slot (cap, slot);
+
+      uv_mutex_lock (&cap->mutex);
+      slot->state = SLOT_FREE;
+      if (failed)
+        cap->stats.failed++;
+      else
+        cap->stats.captured++;
+    }
+  uv_mutex_unlock (&cap->mutex);
+}
+
+int
+frame_capture_new (frame_capture_t **new_cap,
+                   const struct frame_capture_config *config)
+{
+  frame_capture_t *cap = malloc (sizeof (frame_capture_t));
+  *new_cap = cap;
+
+  cap->gpu = config->gpu;
+  cap->timeline = gpu_device_get_timeline (config->gpu);
+  cap->vp = config->vp;
+  cap->format = config->format;
+  cap->path = NULL;
+  cap->frame_rate = config->frame_rate;
+  cap->slot_num = 0;
+  cap->recording_slot = -1;
+  cap->next_frame = 0;
+  cap->pixels = NULL;
+  cap->pixels_size = 0;
+  cap->encoded = NULL;
+  cap->encoded_size = 0;
+  cap->stream = NULL;
+  cap->stream_width = 0;
+  cap->stream_height = 0;
+  cap->worker_started = 0;
+  cap->should_exit = 0;
+  cap->stats = (struct frame_capture_stats){ 0 };
+
+  if (cap->frame_rate <= 0)
+    cap->frame_rate = DEFAULT_FRAME_RATE;
+
+  int slot_num = config->slot_num;
+  if (slot_num <= 0)
+    slot_num = DEFAULT_SLOT_NUM;
+  else if (slot_num > MAX_SLOT_NUM)
+    slot_num = MAX_SLOT_NUM;
+
+  cap->path = malloc (strlen (config->path) + 1);
+  strcpy (cap->path, config->path);
+
+  if (!viewport_is_copyable (cap->vp))
+    LOG_WRN ("viewport can't be copied from; nothing will be captured");
+
+  for (int i = 0; i < slot_num; i++)
+    {
+      struct capture_slot *slot = &cap->slots[i];
+      cap->slot_num++;
+
+      slot->state = SLOT_FREE;
+      slot->timeline_value = 0;
+
+      if (gpu_vector_new (&slot->buffer, cap->gpu,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          GPU_MEMORY_READBACK))
+        {
+          LOG_ERR ("failed to create capture buffer");
+          slot->buffer = NULL;
+          return 1;
+        }
+    }
+
+  init_crc_table ();
+
+  if (uv_mutex_init (&cap->mutex) || uv_cond_init (&cap->ready_cond))
+    {
+      LOG_ERR ("failed to create capture synchronization primitives");
+      return 1;
+    }
+
+  if (uv_thread_create (&cap->worker, worker_main, cap))
+    {
+      LOG_ERR ("failed to create capture thread");
+      return 1;
+    }
+
+  cap->worker_started = 1;
+  return 0;
+}
+
+void
+frame_capture_delete (frame_capture_t *cap)
+{
+  if (cap->worker_started)
+    {
+      /* flush copies still on the GPU into the worker's queue */
+      for (int i = 0; i < cap->slot_num; i++)
+        {
+          struct capture_slot *slot = &cap->slots[i];
+          if (slot->state == SLOT_COPYING && slot->timeline_value != 0)
+            gpu_timeline_wait (cap->timeline, slot->timeline_value,
+                               UINT64_MAX);
+        }
+
+      frame_capture_poll (cap);
+
+      uv_mutex_lock (&cap->mutex);
+      cap->should_exit = 1;
+      uv_cond_signal (&cap->ready_cond);
+      uv_mutex_unlock (&cap->mutex);
+
+      uv_thread_join (&cap->worker);
+      uv_cond_destroy (&cap->ready_cond);
+      uv_mutex_destroy (&cap->mutex);
+
+      LOG_INF ("captured %llu frames, dropped %llu, failed %llu",
+               (unsigned long long)cap->stats.captured,
+               (unsigned long long)cap->stats.dropped,
+               (unsigned long long)cap->stats.failed);
+    }
+
+  for (int i = 0; i < cap->slot_num; i++)
+    {
+      if (cap->slots[i].buffer)
+        gpu_vector_delete (cap->slots[i].buffer);
+    }
+
+  if (cap->stream)
+    fclose (cap->stream);
+
+  if (cap->pixels)
+    free (cap->pixels);
+
+  if (cap->encoded)
+    free (cap->encoded);
+
+  if (cap->path)
+    free (cap->path);
+
+  free (cap);
+}
+
+viewport_t *
+frame_capture_get_viewport (frame_capture_t *cap)
+{
+  return cap->vp;
+}
+
+void
+frame_capture_poll (frame_capture_t *cap)
+{
+  int ready_num = 0;
+
+  uv_mutex_lock (&cap->mutex);
+  for (int i = 0; i < cap->slot_num; i++)
+    {
+      struct capture_slot *slot = &cap->slots[i];
+      if (slot->state != SLOT_COPYING || slot->timeline_value == 0)
+        continue;
+
+      if (!gpu_timeline_is_complete (cap->timeline, slot->timeline_value))
+        continue;
+
+      slot->state = SLOT_READY;
+      ready_num++;
+    }
+
+  if (ready_num > 0)
+    uv_cond_signal (&cap->ready_cond);
+  uv_mutex_unlock (&cap->mutex);
+}
+
+static void
+set_slot_state (frame_capture_t *cap, struct capture_slot *slot,
+                enum slot_state state)
+{
+  uv_mutex_lock (&cap->mutex);
+  slot->state = state;
+  uv_mutex_unlock (&cap->mutex);
+}
+
+VkBuffer
+frame_capture_begin (frame_capture_t *cap)
+{
+  if (!viewport_is_copyable (cap->vp))
+    return VK_NULL_HANDLE;
+
+  /* a copy that was begun but never submitted is abandoned */
+  if (cap->recording_slot >= 0)
+    {
+      set_slot_state (cap, &cap->slots[cap->recording_slot], SLOT_FREE);
+      cap->recording_slot = -1;
+    }
+
+  struct capture_slot *slot = NULL;
+
+  uv_mutex_lock (&cap->mutex);
+  for (int i = 0; i < cap->slot_num; i++)
+    {
+      if (cap->slots[i].state != SLOT_FREE)
+        continue;
+
+      slot = &cap->slots[i];
+      slot->state = SLOT_COPYING;
+      cap->recording_slot = i;
+      break;
+    }
+
+  if (!slot)
+    cap->stats.dropped++;
+  uv_mutex_unlock (&cap->mutex);
+
+  if (!slot)
+    return VK_NULL_HANDLE;
+
+  VkExtent2D extent = viewport_get_extent (cap->vp);
+  slot->width = extent.width;
+  slot->height = extent.height;
+  slot->layer_num = viewport_get_view_num (cap->vp);
+  slot->timeline_value = 0;
+  slot->frame = cap->next_frame;
+
+  size_t size = (size_t)slot->width * slot->height * slot->layer_num * 4;
+  if (gpu_vector_reserve (slot->buffer, size))
+    {
+      LOG_ERR ("failed to reserve capture buffer");
+      set_slot_state (cap, slot, SLOT_FREE);
+      cap->recording_slot = -1;
+      return VK_NULL_HANDLE;
+    }
+
+  cap->next_frame++;
+  return gpu_vector_get (slot->buffer);
+}
+
+void
+frame_capture_record (frame_capture_t *cap, VkCommandBuffer cmd)
+{
+  if (cap->recording_slot < 0)
+    return;
+
+  struct capture_slot *slot = &cap->slots[cap->recording_slot];
+  viewport_record_copy (cap->vp, cmd, gpu_vector_get (slot->buffer));
+}
+
+void
+frame_capture_mark_submitted (frame_capture_t *cap, uint64_t value)
+{
+  if (cap->recording_slot < 0)
+    return;
+
+  /* only read by the main thread until the slot is ready */
+  cap->slots[cap->recording_slot].timeline_value = value;
+  cap->recording_slot = -1;
+}
+
+void
+frame_capture_get_stats (frame_capture_t *cap,
+                         struct frame_capture_stats *stats)
+{
+  uv_mutex_lock (&cap->mutex);
+  *stats = cap->stats;
+  uv_mutex_unlock (&cap->mutex);
+}
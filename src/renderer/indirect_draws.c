@@ -0,0 +1,245 @@
+/** @file indirect_draws.c
+ */
+
+#include "renderer/indirect_draws.h"
+
+#include "gpu/gpu_vector.h"
+#include "log.h"
+
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdlib.h> /* for mem alloc */
+
+#include <vulkan/vulkan_core.h>
+
+#define INITIAL_CAPACITY 16
+
+struct indirect_batch
+{
+  uint32_t first;
+  uint32_t num;
+};
+
+struct indirect_draws_s
+{
+  gpu_device_t *gpu;
+  int has_multi_draw;
+  int has_draw_count;
+
+  VkDrawIndexedIndirectCommand *commands;
+  int command_num;
+  int command_capacity;
+
+  struct indirect_batch *batches;
+  uint32_t *counts;
+  int batch_num;
+  int batch_capacity;
+
+  gpu_vector_t *command_buf;
+  gpu_vector_t *count_buf;
+};
+
+static int
+grow (void **array, int *capacity, size_t size)
+{
+  int new_capacity = *capacity > 0 ? *capacity * 2 : INITIAL_CAPACITY;
+  void *new_array = realloc (*array, new_capacity * size);
+  if (!new_array)
+    return 1;
+
+  *array = new_array;
+  *capacity = new_capacity;
+  return 0;
+}
+
+int
+indirect_draws_new (indirect_draws_t **new_draws, gpu_device_t *gpu)
+{
+  indirect_draws_t *draws = malloc (sizeof (indirect_draws_t));
+  *new_draws = draws;
+
+  draws->gpu = gpu;
+  draws->has_multi_draw = gpu_device_has_multi_draw_indirect (gpu);
+  draws->has_draw_count = gpu_device_has_draw_indirect_count (gpu);
+
+  draws->commands = NULL;
+  draws->command_num = 0;
+  draws->command_capacity = 0;
+
+  draws->batches = NULL;
+  draws->counts = NULL;
+  draws->batch_num = 0;
+  draws->batch_capacity = 0;
+
+  draws->command_buf = NULL;
+  draws->count_buf = NULL;
+
+  /* storage usage leaves room for culling on the GPU */
+  const VkBufferUsageFlags USAGE = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                   | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+  if (gpu_vector_new (&draws->command_buf, gpu, USAGE, GPU_MEMORY_INDIRECT))
+    {
+      LOG_ERR ("failed to create indirect command buffer");
+      return 1;
+    }
+
+  if (gpu_vector_new (&draws->count_buf, gpu, USAGE, GPU_MEMORY_INDIRECT))
+    {
+      LOG_ERR ("failed to create indirect count buffer");
+      return 1;
+    }
+
+  return 0;
+}
+
+void
+indirect_draws_delete (indirect_draws_t *draws)
+{
+  if (draws->command_buf)
+    gpu_vector_delete (draws->command_buf);
+
+  if (draws->count_buf)
+    gpu_vector_delete (draws->count_buf);
+
+  if (draws->commands)
+    free (draws->commands);
+
+  if (draws->batches)
+    free (draws->batches);
+
+  if (draws->counts)
+    free (draws->counts);
+
+  free (draws);
+}
+
+void
+indirect_draws_clear (indirect_draws_t *draws)
+{
+  draws->command_num = 0;
+  draws->batch_num = 0;
+}
+
+int
+indirect_draws_begin_batch (indirect_draws_t *draws)
+{
+  if (draws->batch_num == draws->batch_capacity)
+    {
+      int capacity = draws->batch_capacity;
+      if (grow ((void **)&draws->batches, &capacity,
+                sizeof (struct indirect_batch))
+          || grow ((void **)&draws->counts, &draws->batch_capacity,
+                   sizeof (uint32_t)))
+        {
+          LOG_ERR ("failed to allocate indirect batch");
+          return -1;
+        }
+    }
+
+  int index = draws->batch_num++;
+  draws->batches[index] = (struct indirect_batch){
+    .first = draws->command_num,
+    .num = 0,
+  };
+
+  return index;
+}
+
+int
+indirect_draws_add (indirect_draws_t *draws,
+                    const VkDrawIndexedIndirectCommand *command)
+{
+  if (draws->batch_num == 0)
+    {
+      LOG_ERR ("indirect draw added outside of a batch");
+      return 1;
+    }
+
+  if (draws->command_num == draws->command_capacity)
+    {
+      if (grow ((void **)&draws->commands, &draws->command_capacity,
+                sizeof (VkDrawIndexedIndirectCommand)))
+        {
+          LOG_ERR ("failed to allocate indirect command");
+          return 1;
+        }
+    }
+
+  draws->commands[draws->command_num++] = *command;
+  draws->batches[draws->batch_num - 1].num++;
+  return 0;
+}
+
+int
+indirect_draws_upload (indirect_draws_t *draws)
+{
+  for (int i = 0; i < draws->batch_num; i++)
+    draws->counts[i] = draws->batches[i].num;
+
+  if (gpu_vector_write (draws->command_buf, draws->commands,
+                        sizeof (VkDrawIndexedIndirectCommand),
+                        draws->command_num))
+    {
+      LOG_ERR ("failed to upload indirect commands");
+      return 1;
+    }
+
+  if (gpu_vector_write (draws->count_buf, draws->counts, sizeof (uint32_t),
+                        draws->batch_num))
+    {
+      LOG_ERR ("failed to upload indirect counts");
+      return 1;
+    }
+
+  return 0;
+}
+
+void
+indirect_draws_record (indirect_draws_t *draws, VkCommandBuffer cmd,
+                       int batch_index)
+{
+  if (batch_index < 0 || batch_index >= draws->batch_num)
+    return;
+
+  const struct indirect_batch *batch = &draws->batches[batch_index];
+  if (batch->num == 0)
+    return;
+
+  VkBuffer commands = gpu_vector_get (draws->command_buf);
+  const uint32_t stride = sizeof (VkDrawIndexedIndirectCommand);
+  VkDeviceSize offset = batch->first * stride;
+
+  if (draws->has_draw_count)
+    {
+      VkBuffer counts = gpu_vector_get (draws->count_buf);
+      VkDeviceSize count_offset = batch_index * sizeof (uint32_t);
+      vkCmdDrawIndexedIndirectCount (cmd, commands, offset, counts,
+                                     count_offset, batch->num, stride);
+    }
+  else if (draws->has_multi_draw)
+    vkCmdDrawIndexedIndirect (cmd, commands, offset, batch->num, stride);
+  else
+    {
+      for (uint32_t i = 0; i < batch->num; i++)
+        vkCmdDrawIndexedIndirect (cmd, commands, offset + i * stride, 1,
+                                  stride);
+    }
+}
+
+uint32_t
+indirect_draws_get_first (indirect_draws_t *draws, int batch)
+{
+  return draws->batches[batch].first;
+}
+
+VkBuffer
+indirect_draws_get_commands (indirect_draws_t *draws)
+{
+  return gpu_vector_get (draws->command_buf);
+}
+
+VkBuffer
+indirect_draws_get_counts (indirect_draws_t *draws)
+{
+  return gpu_vector_get (draws->count_buf);
+}
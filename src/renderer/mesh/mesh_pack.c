@@ -0,0 +1,299 @@
+/** @file mesh_pack.c
+ */
+
+#include "renderer/mesh/mesh_pack.h"
+
+#include "log.h"
+
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdlib.h> /* for mem alloc */
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h> /* for CreateFileMappingA, MapViewOfFile */
+#else
+#include <fcntl.h>    /* for open */
+#include <sys/mman.h> /* for mmap, madvise */
+#include <sys/stat.h> /* for fstat */
+#include <unistd.h>   /* for close */
+#endif
+
+struct mesh_pack_s
+{
+  const char *data;
+  size_t size;
+
+#if defined(_WIN32)
+  HANDLE file;
+  HANDLE mapping;
+#endif
+};
+
+static int
+map_file (mesh_pack_t *pack, const char *path)
+{
+#if defined(_WIN32)
+  pack->file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (pack->file == INVALID_HANDLE_VALUE)
+    return 1;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx (pack->file, &size))
+    return 1;
+
+  pack->size = size.QuadPart;
+  pack->mapping
+      = CreateFileMappingA (pack->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!pack->mapping)
+    return 1;
+
+  pack->data = MapViewOfFile (pack->mapping, FILE_MAP_READ, 0, 0, 0);
+  return pack->data == NULL;
+#else
+  int fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return 1;
+
+  struct stat st;
+  if (fstat (fd, &st) != 0 || st.st_size == 0)
+    {
+      close (fd);
+      return 1;
+    }
+
+  /* the mapping keeps the file open */
+  void *data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+
+  if (data == MAP_FAILED)
+    return 1;
+
+  /* the blobs are read front to back exactly once */
+  madvise (data, st.st_size, MADV_SEQUENTIAL);
+
+  pack->data = data;
+  pack->size = st.st_size;
+  return 0;
+#endif
+}
+
+static void
+unmap_file (mesh_pack_t *pack)
+{
+#if defined(_WIN32)
+  if (pack->data)
+    UnmapViewOfFile (pack->data);
+
+  if (pack->mapping)
+    CloseHandle (pack->mapping);
+
+  if (pack->file != INVALID_HANDLE_VALUE)
+    CloseHandle (pack->file);
+#else
+  if (pack->data)
+    munmap ((void *)pack->data, pack->size);
+#endif
+}
+
+static int
+check_section (mesh_pack_t *pack, const char *name,
+               const struct mesh_pack_section *section, uint64_t stride,
+               uint64_t num)
+{
+  if (section->offset % MESH_PACK_ALIGNMENT != 0)
+    {
+      LOG_ERR ("mesh pack %s are misaligned", name);
+      return 1;
+    }
+
+  if (section->size != stride * num)
+    {
+      LOG_ERR ("mesh pack %s have the wrong size", name);
+      return 1;
+    }
+
+  if (section->offset > pack->size
+      || section->size > pack->size - section->offset)
+    {
+      LOG_ERR ("mesh pack %s run past the end of the file", name);
+      return 1;
+    }
+
+  return 0;
+}
+
+/* cooked data is trusted for speed, but not to stay within its buffers */
+static int
+check_tables (mesh_pack_t *pack)
+{
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+  const struct mesh_pack_mesh *meshes = mesh_pack_get_meshes (pack);
+  const struct mesh_pack_lod *lods = mesh_pack_get_lods (pack);
+  const struct mesh_pack_meshlet *meshlets = mesh_pack_get_meshlets (pack);
+  const uint32_t *indices = mesh_pack_get_indices (pack);
+
+  for (uint32_t i = 0; i < header->mesh_num; i++)
+    {
+      const struct mesh_pack_mesh *mesh = &meshes[i];
+      if (mesh->first_lod > header->lod_num
+          || mesh->lod_num > header->lod_num - mesh->first_lod)
+        {
+          LOG_ERR ("mesh %u has LODs out of range", i);
+          return 1;
+        }
+    }
+
+  for (uint32_t i = 0; i < header->lod_num; i++)
+    {
+      const struct mesh_pack_lod *lod = &lods[i];
+      if (lod->first_index > header->index_num
+          || lod->index_num > header->index_num - lod->first_index
+          || lod->vertex_offset < 0
+          || (uint32_t)lod->vertex_offset > header->vertex_num
+          || lod->first_meshlet > header->meshlet_num
+          || lod->meshlet_num > header->meshlet_num - lod->first_meshlet)
+        {
+          LOG_ERR ("mesh LOD %u is out of range", i);
+          return 1;
+        }
+
+      /* the vertex shader fetches without bounds checks */
+      uint32_t vertex_limit = header->vertex_num - lod->vertex_offset;
+      const uint32_t *lod_indices = &indices[lod->first_index];
+      for (uint32_t j = 0; j < lod->index_num; j++)
+        {
+          if (lod_indices[j] >= vertex_limit)
+            {
+              LOG_ERR ("mesh LOD %u indexes past the vertex blob", i);
+              return 1;
+            }
+        }
+    }
+
+  for (uint32_t i = 0; i < header->meshlet_num; i++)
+    {
+      const struct mesh_pack_meshlet *meshlet = &meshlets[i];
+      if (meshlet->first_index > header->index_num
+          || meshlet->triangle_num > MESH_PACK_MESHLET_TRIANGLES
+          || meshlet->triangle_num * 3
+                 > header->index_num - meshlet->first_index)
+        {
+          LOG_ERR ("meshlet %u is out of range", i);
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+int
+mesh_pack_open (mesh_pack_t **new_pack, const char *path)
+{
+  mesh_pack_t *pack = malloc (sizeof (mesh_pack_t));
+  *new_pack = pack;
+
+  pack->data = NULL;
+  pack->size = 0;
+
+#if defined(_WIN32)
+  pack->file = INVALID_HANDLE_VALUE;
+  pack->mapping = NULL;
+#endif
+
+  if (map_file (pack, path))
+    {
+      LOG_ERR ("failed to map mesh pack %s", path);
+      return 1;
+    }
+
+  if (pack->size < sizeof (struct mesh_pack_header))
+    {
+      LOG_ERR ("mesh pack %s is truncated", path);
+      return 1;
+    }
+
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+  if (header->magic != MESH_PACK_MAGIC)
+    {
+      LOG_ERR ("%s is not a mesh pack", path);
+      return 1;
+    }
+
+  if (header->version != MESH_PACK_VERSION)
+    {
+      LOG_ERR ("mesh pack %s has version %u, but %u is supported", path,
+               header->version, MESH_PACK_VERSION);
+      return 1;
+    }
+
+  if (check_section (pack, "meshes", &header->meshes,
+                     sizeof (struct mesh_pack_mesh), header->mesh_num)
+      || check_section (pack, "LODs", &header->lods,
+                        sizeof (struct mesh_pack_lod), header->lod_num)
+      || check_section (pack, "meshlets", &header->meshlets,
+                        sizeof (struct mesh_pack_meshlet),
+                        header->meshlet_num)
+      || check_section (pack, "vertices", &header->vertices,
+                        sizeof (struct mesh_pack_vertex), header->vertex_num)
+      || check_section (pack, "indices", &header->indices, sizeof (uint32_t),
+                        header->index_num))
+    return 1;
+
+  if (check_tables (pack))
+    return 1;
+
+  LOG_INF ("mapped %u meshes with %u vertices from %s", header->mesh_num,
+           header->vertex_num, path);
+
+  return 0;
+}
+
+void
+mesh_pack_close (mesh_pack_t *pack)
+{
+  unmap_file (pack);
+  free (pack);
+}
+
+const struct mesh_pack_header *
+mesh_pack_get_header (mesh_pack_t *pack)
+{
+  return (const struct mesh_pack_header *)pack->data;
+}
+
+const struct mesh_pack_mesh *
+mesh_pack_get_meshes (mesh_pack_t *pack)
+{
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+  return (const struct mesh_pack_mesh *)(pack->data + header->meshes.offset);
+}
+
+const struct mesh_pack_lod *
+mesh_pack_get_lods (mesh_pack_t *pack)
+{
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+  return (const struct mesh_pack_lod *)(pack->data + header->lods.offset);
+}
+
+const struct mesh_pack_meshlet *
+mesh_pack_get_meshlets (mesh_pack_t *pack)
+{
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+  return (const struct mesh_pack_meshlet *)(pack->data
+                                            + header->meshlets.offset);
+}
+
+const void *
+mesh_pack_get_vertices (mesh_pack_t *pack)
+{
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+  return pack->data + header->vertices.offset;
+}
+
+const void *
+mesh_pack_get_indices (mesh_pack_t *pack)
+{
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+  return pack->data + header->indices.offset;
+}
@@ -0,0 +1,721 @@
+/** @file mesh_pass.c
+ */
+
+#include "renderer/mesh/mesh_pass.h"
+
+#include "gpu/gpu_device.h"
+#include "gpu/gpu_shader.h"
+#include "gpu/gpu_staging.h"
+#include "gpu/gpu_vector.h"
+#include "log.h"
+#include "renderer/mesh/mesh_pack.h"
+
+/* TODO(marceline-cramer): custom mem alloc */
+#include <stdlib.h> /* for mem alloc */
+#include <string.h> /* for memcpy */
+#include <vulkan/vulkan_core.h>
+
+struct mesh_pass_s
+{
+  renderer_t *ren;
+  gpu_device_t *gpu;
+  VkDevice vkd;
+
+  /* the loaded pack's blobs, streamed into device-local memory */
+  gpu_vector_t *vertices;
+  gpu_vector_t *indices;
+
+  /* host copies of the loaded pack's tables */
+  struct mesh_pack_mesh *meshes;
+  uint32_t mesh_num;
+  struct mesh_pack_lod *lods;
+  uint32_t lod_num;
+
+  /* read by the vertex shader through gl_InstanceIndex */
+  gpu_vector_t *instances;
+  mesh_instance_t *instance_data;
+  uint32_t instance_num;
+
+  /* without drawIndirectFirstInstance, instances are drawn directly */
+  int has_first_instance;
+
+  gpu_shader_t *vertex_shader;
+  gpu_shader_t *multiview_vertex_shader;
+  gpu_shader_t *fragment_shader;
+
+  VkDescriptorSetLayout set_layout;
+  VkPipelineLayout pipeline_layout;
+  VkPipeline pipeline;
+  VkPipeline multiview_pipeline;
+};
+
+static int
+create_set_layout (mesh_pass_t *mp)
+{
+  VkDescriptorSetLayoutBinding bindings[2];
+
+  /* vertices */
+  bindings[0] = (VkDescriptorSetLayoutBinding){
+    .binding = 0,
+    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 1,
+    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+  };
+
+  /* instances */
+  bindings[1] = (VkDescriptorSetLayoutBinding){
+    .binding = 1,
+    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 1,
+    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+  };
+
+  VkDescriptorSetLayoutCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .bindingCount = 2,
+    .pBindings = bindings,
+  };
+
+  if (vkCreateDescriptorSetLayout (mp->vkd, &ci, NULL, &mp->set_layout)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create mesh descriptor set layout");
+      return 1;
+    }
+
+  return 0;
+}
+
+static int
+create_pipeline_layout (mesh_pass_t *mp)
+{
+  VkDescriptorSetLayout layouts[2];
+
+  layouts[0] = renderer_get_viewport_layout (mp->ren);
+  layouts[1] = mp->set_layout;
+
+  VkPipelineLayoutCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    .setLayoutCount = 2,
+    .pSetLayouts = layouts,
+  };
+
+  if (vkCreatePipelineLayout (mp->vkd, &ci, NULL, &mp->pipeline_layout)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create mesh pipeline layout");
+      return 1;
+    }
+
+  return 0;
+}
+
+static int
+load_shader (mesh_pass_t *mp, gpu_shader_t **shader,
+             VkShaderStageFlags stage, const char *path)
+{
+  if (gpu_shader_new (shader, mp->gpu, stage))
+    {
+      LOG_ERR ("failed to create shader");
+      return 1;
+    }
+
+  if (gpu_shader_load_from_file (*shader, path))
+    return 1;
+
+  return 0;
+}
+
+static int
+load_shaders (mesh_pass_t *mp, int is_multiview)
+{
+  static const char *VERTEX_SOURCE = "./shaders/mesh.vert.spv";
+  static const char *MULTIVIEW_VERTEX_SOURCE
+      = "./shaders/mesh_multiview.vert.spv";
+  static const char *FRAGMENT_SOURCE = "./shaders/mesh.frag.spv";
+
+  if (load_shader (mp, &mp->vertex_shader, VK_SHADER_STAGE_VERTEX_BIT,
+                   VERTEX_SOURCE))
+    return 1;
+
+  if (is_multiview
+      && load_shader (mp, &mp->multiview_vertex_shader,
+                      VK_SHADER_STAGE_VERTEX_BIT, MULTIVIEW_VERTEX_SOURCE))
+    return 1;
+
+  if (load_shader (mp, &mp->fragment_shader, VK_SHADER_STAGE_FRAGMENT_BIT,
+                   FRAGMENT_SOURCE))
+    return 1;
+
+  return 0;
+}
+
+static int
+create_pipeline (mesh_pass_t *mp, VkRenderPass rp,
+                 gpu_shader_t *vertex_shader, VkPipeline *pipeline)
+{
+  VkPipelineShaderStageCreateInfo shader_stages[2];
+  gpu_shader_get (vertex_shader, &shader_stages[0]);
+  gpu_shader_get (mp->fragment_shader, &shader_stages[1]);
+
+  /* vertices are pulled from a storage buffer by vertex index */
+  VkPipelineVertexInputStateCreateInfo vertex_input_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+  };
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+    .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+  };
+
+  VkViewport viewport = { 0 };
+  VkRect2D scissor = { 0 };
+
+  VkPipelineViewportStateCreateInfo viewport_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+    .viewportCount = 1,
+    .pViewports = &viewport,
+    .scissorCount = 1,
+    .pScissors = &scissor,
+  };
+
+  /* the projection doesn't flip Y, so the cooker's counter-clockwise
+   * triangles land clockwise in framebuffer space */
+  VkPipelineRasterizationStateCreateInfo rasterization_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+    .polygonMode = VK_POLYGON_MODE_FILL,
+    .cullMode = VK_CULL_MODE_BACK_BIT,
+    .frontFace = VK_FRONT_FACE_CLOCKWISE,
+    .lineWidth = 1.0,
+  };
+
+  VkPipelineMultisampleStateCreateInfo multisample_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+    .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+  };
+
+  /* depth is reversed, so nearer fragments have greater depth */
+  VkPipelineDepthStencilStateCreateInfo depth_stencil_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+    .depthTestEnable = renderer_has_depth (mp->ren) ? VK_TRUE : VK_FALSE,
+    .depthWriteEnable = renderer_has_depth (mp->ren) ? VK_TRUE : VK_FALSE,
+    .depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL,
+  };
+
+  VkPipelineColorBlendAttachmentState color_blend_attachment = {
+    .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+                      | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    .blendEnable = VK_FALSE,
+  };
+
+  VkPipelineColorBlendStateCreateInfo color_blend_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+    .attachmentCount = 1,
+    .pAttachments = &color_blend_attachment,
+  };
+
+  VkDynamicState dynamic_states[]
+      = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+  VkPipelineDynamicStateCreateInfo dynamic_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+    .dynamicStateCount = 2,
+    .pDynamicStates = dynamic_states,
+  };
+
+  VkGraphicsPipelineCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+    .stageCount = 2,
+    .pStages = shader_stages,
+    .pVertexInputState = &vertex_input_state,
+    .pInputAssemblyState = &input_assembly_state,
+    .pViewportState = &viewport_state,
+    .pRasterizationState = &rasterization_state,
+    .pMultisampleState = &multisample_state,
+    .pDepthStencilState = &depth_stencil_state,
+    .pColorBlendState = &color_blend_state,
+    .pDynamicState = &dynamic_state,
+    .layout = mp->pipeline_layout,
+    .renderPass = rp,
+    .subpass = 0,
+  };
+
+  VkPipelineCache cache = gpu_device_get_pipeline_cache (mp->gpu);
+  if (vkCreateGraphicsPipelines (mp->vkd, cache, 1, &ci, NULL, pipeline)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create mesh pipeline");
+      return 1;
+    }
+
+  return 0;
+}
+
+int
+mesh_pass_new (mesh_pass_t **new_mp, renderer_t *ren, VkRenderPass rp,
+               VkRenderPass multiview_rp)
+{
+  mesh_pass_t *mp = malloc (sizeof (mesh_pass_t));
+  *new_mp = mp;
+
+  mp->ren = ren;
+  mp->gpu = renderer_get_gpu (ren);
+  mp->vkd = gpu_device_get (mp->gpu);
+
+  mp->vertices = NULL;
+  mp->indices = NULL;
+  mp->meshes = NULL;
+  mp->mesh_num = 0;
+  mp->lods = NULL;
+  mp->lod_num = 0;
+
+  mp->instances = NULL;
+  mp->instance_data = NULL;
+  mp->instance_num = 0;
+
+  mp->has_first_instance
+      = gpu_device_has_draw_indirect_first_instance (mp->gpu);
+
+  mp->vertex_shader = NULL;
+  mp->multiview_vertex_shader = NULL;
+  mp->fragment_shader = NULL;
+
+  mp->set_layout = VK_NULL_HANDLE;
+  mp->pipeline_layout = VK_NULL_HANDLE;
+  mp->pipeline = VK_NULL_HANDLE;
+  mp->multiview_pipeline = VK_NULL_HANDLE;
+
+  if (gpu_vector_new_device_local (&mp->vertices, mp->gpu,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   GPU_MEMORY_GEOMETRY))
+    {
+      LOG_ERR ("failed to create mesh vertex buffer");
+      return 1;
+    }
+
+  if (gpu_vector_new_device_local (&mp->indices, mp->gpu,
+                                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                   GPU_MEMORY_GEOMETRY))
+    {
+      LOG_ERR ("failed to create mesh index buffer");
+      return 1;
+    }
+
+  if (gpu_vector_new (&mp->instances, mp->gpu,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      GPU_MEMORY_INSTANCES))
+    {
+      LOG_ERR ("failed to create mesh instance buffer");
+      return 1;
+    }
+
+  if (load_shaders (mp, multiview_rp != VK_NULL_HANDLE))
+    return 1;
+
+  if (create_set_layout (mp))
+    return 1;
+
+  if (create_pipeline_layout (mp))
+    return 1;
+
+  if (rp != VK_NULL_HANDLE
+      && create_pipeline (mp, rp, mp->vertex_shader, &mp->pipeline))
+    return 1;
+
+  if (multiview_rp != VK_NULL_HANDLE
+      && create_pipeline (mp, multiview_rp, mp->multiview_vertex_shader,
+                          &mp->multiview_pipeline))
+    return 1;
+
+  return 0;
+}
+
+void
+mesh_pass_delete (mesh_pass_t *mp)
+{
+  if (mp->pipeline)
+    vkDestroyPipeline (mp->vkd, mp->pipeline, NULL);
+
+  if (mp->multiview_pipeline)
+    vkDestroyPipeline (mp->vkd, mp->multiview_pipeline, NULL);
+
+  if (mp->pipeline_layout)
+    vkDestroyPipelineLayout (mp->vkd, mp->pipeline_layout, NULL);
+
+  if (mp->set_layout)
+    vkDestroyDescriptorSetLayout (mp->vkd, mp->set_layout, NULL);
+
+  if (mp->vertex_shader)
+    gpu_shader_delete (mp->vertex_shader);
+
+  if (mp->multiview_vertex_shader)
+    gpu_shader_delete (mp->multiview_vertex_shader);
+
+  if (mp->fragment_shader)
+    gpu_shader_delete (mp->fragment_shader);
+
+  if (mp->vertices)
+    gpu_vector_delete (mp->vertices);
+
+  if (mp->indices)
+    gpu_vector_delete (mp->indices);
+
+  if (mp->instances)
+    gpu_vector_delete (mp->instances);
+
+  if (mp->meshes)
+    free (mp->meshes);
+
+  if (mp->lods)
+    free (mp->lods);
+
+  if (mp->instance_data)
+    free (mp->instance_data);
+
+  free (mp);
+}
+
+/* streams the pack's blobs straight from the mapping to the GPU */
+static int
+upload_blobs (mesh_pass_t *mp, mesh_pack_t *pack)
+{
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+
+  if (gpu_vector_reserve (mp->vertices, header->vertices.size)
+      || gpu_vector_reserve (mp->indices, header->indices.size))
+    {
+      LOG_ERR ("failed to reserve mesh buffers");
+      return 1;
+    }
+
+  struct gpu_staging_config staging_config = {
+    .gpu = mp->gpu,
+  };
+
+  gpu_staging_t *staging;
+  if (gpu_staging_new (&staging, &staging_config))
+    {
+      LOG_ERR ("failed to create mesh staging");
+      gpu_staging_delete (staging);
+      return 1;
+    }
+
+  int result = 0;
+  if (gpu_staging_upload (staging, gpu_vector_get (mp->vertices), 0,
+                          mesh_pack_get_vertices (pack),
+                          header->vertices.size)
+      || gpu_staging_upload (staging, gpu_vector_get (mp->indices), 0,
+                             mesh_pack_get_indices (pack),
+                             header->indices.size))
+    {
+      LOG_ERR ("failed to upload mesh pack");
+      result = 1;
+    }
+
+  /* flushes the last chunk and waits for the copies */
+  gpu_staging_delete (staging);
+  return result;
+}
+
+static int
+copy_tables (mesh_pass_t *mp, mesh_pack_t *pack)
+{
+  const struct mesh_pack_header *header = mesh_pack_get_header (pack);
+
+  size_t meshes_size = header->mesh_num * sizeof (struct mesh_pack_mesh);
+  size_t lods_size = header->lod_num * sizeof (struct mesh_pack_lod);
+
+  mp->meshes = malloc (meshes_size > 0 ? meshes_size : 1);
+  mp->lods = malloc (lods_size > 0 ? lods_size : 1);
+  if (!mp->meshes || !mp->lods)
+    {
+      LOG_ERR ("failed to allocate mesh tables");
+      return 1;
+    }
+
+  memcpy (mp->meshes, mesh_pack_get_meshes (pack), meshes_size);
+  memcpy (mp->lods, mesh_pack_get_lods (pack), lods_size);
+
+  mp->mesh_num = header->mesh_num;
+  mp->lod_num = header->lod_num;
+  return 0;
+}
+
+int
+mesh_pass_load (mesh_pass_t *mp, const char *path)
+{
+  /* every frame in flight reads the same mesh buffers */
+  vkDeviceWaitIdle (mp->vkd);
+
+  if (mp->meshes)
+    free (mp->meshes);
+
+  if (mp->lods)
+    free (mp->lods);
+
+  mp->meshes = NULL;
+  mp->mesh_num = 0;
+  mp->lods = NULL;
+  mp->lod_num = 0;
+  mp->instance_num = 0;
+
+  mesh_pack_t *pack;
+  if (mesh_pack_open (&pack, path))
+    {
+      mesh_pack_close (pack);
+      return 1;
+    }
+
+  int result = upload_blobs (mp, pack) || copy_tables (mp, pack);
+  mesh_pack_close (pack);
+
+  if (result)
+    {
+      LOG_ERR ("failed to load mesh pack %s", path);
+      mp->mesh_num = 0;
+      mp->lod_num = 0;
+    }
+
+  return result;
+}
+
+uint32_t
+mesh_pass_get_mesh_num (mesh_pass_t *mp)
+{
+  return mp->mesh_num;
+}
+
+int
+mesh_pass_set_instances (mesh_pass_t *mp, const mesh_instance_t *instances,
+                         uint32_t instance_num)
+{
+  /* every frame in flight reads the same instance buffer */
+  vkDeviceWaitIdle (mp->vkd);
+
+  mp->instance_num = 0;
+
+  if (instance_num > 0)
+    {
+      mesh_instance_t *new_data = realloc (
+          mp->instance_data, instance_num * sizeof (mesh_instance_t));
+      if (!new_data)
+        {
+          LOG_ERR ("failed to allocate mesh instances");
+          return 1;
+        }
+
+      mp->instance_data = new_data;
+      memcpy (new_data, instances, instance_num * sizeof (mesh_instance_t));
+    }
+
+  if (gpu_vector_write (mp->instances, instances, sizeof (mesh_instance_t),
+                        instance_num))
+    {
+      LOG_ERR ("failed to upload mesh instances");
+      return 1;
+    }
+
+  mp->instance_num = instance_num;
+  return 0;
+}
+
+int
+mesh_frame_data_init (mesh_pass_t *mp, struct mesh_frame_data *frame)
+{
+  frame->descriptor_pool = VK_NULL_HANDLE;
+  frame->set = VK_NULL_HANDLE;
+  frame->batch = -1;
+  frame->instance_num = 0;
+
+  VkDescriptorPoolSize pool_size = {
+    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 2,
+  };
+
+  VkDescriptorPoolCreateInfo dp_ci = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+    .maxSets = 1,
+    .poolSizeCount = 1,
+    .pPoolSizes = &pool_size,
+  };
+
+  if (vkCreateDescriptorPool (mp->vkd, &dp_ci, NULL, &frame->descriptor_pool)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create mesh descriptor pool");
+      return 1;
+    }
+
+  VkDescriptorSetAllocateInfo alloc_info = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    .descriptorPool = frame->descriptor_pool,
+    .descriptorSetCount = 1,
+    .pSetLayouts = &mp->set_layout,
+  };
+
+  if (vkAllocateDescriptorSets (mp->vkd, &alloc_info, &frame->set)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to allocate mesh descriptor set");
+      return 1;
+    }
+
+  return 0;
+}
+
+void
+mesh_frame_data_cleanup (mesh_pass_t *mp, struct mesh_frame_data *frame)
+{
+  if (frame->descriptor_pool)
+    vkDestroyDescriptorPool (mp->vkd, frame->descriptor_pool, NULL);
+}
+
+/* picks the instance's LOD, or returns nonzero if it can't be drawn */
+static int
+build_command (mesh_pass_t *mp, uint32_t instance_index,
+               VkDrawIndexedIndirectCommand *command)
+{
+  const mesh_instance_t *instance = &mp->instance_data[instance_index];
+  if (instance->mesh >= mp->mesh_num)
+    return 1;
+
+  const struct mesh_pack_mesh *mesh = &mp->meshes[instance->mesh];
+  if (mesh->lod_num == 0)
+    return 1;
+
+  uint32_t lod_index = instance->lod;
+  if (lod_index >= mesh->lod_num)
+    lod_index = mesh->lod_num - 1;
+
+  const struct mesh_pack_lod *lod = &mp->lods[mesh->first_lod + lod_index];
+  if (lod->index_num == 0)
+    return 1;
+
+  *command = (VkDrawIndexedIndirectCommand){
+    .indexCount = lod->index_num,
+    .instanceCount = 1,
+    .firstIndex = lod->first_index,
+    .vertexOffset = lod->vertex_offset,
+    .firstInstance = instance_index,
+  };
+
+  return 0;
+}
+
+static void
+update_set (mesh_pass_t *mp, struct mesh_frame_data *frame)
+{
+  VkDescriptorBufferInfo buffer_infos[2];
+
+  buffer_infos[0] = (VkDescriptorBufferInfo){
+    .buffer = gpu_vector_get (mp->vertices),
+    .offset = 0,
+    .range = VK_WHOLE_SIZE,
+  };
+
+  buffer_infos[1] = (VkDescriptorBufferInfo){
+    .buffer = gpu_vector_get (mp->instances),
+    .offset = 0,
+    .range = VK_WHOLE_SIZE,
+  };
+
+  VkWriteDescriptorSet writes[2];
+  for (int i = 0; i < 2; i++)
+    {
+      writes[i] = (VkWriteDescriptorSet){
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = frame->set,
+        .dstBinding = i,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffer_infos[i],
+      };
+    }
+
+  vkUpdateDescriptorSets (mp->vkd, 2, writes, 0, NULL);
+}
+
+void
+mesh_pass_prepare (mesh_pass_t *mp, struct mesh_frame_data *frame,
+                   indirect_draws_t *draws)
+{
+  frame->batch = -1;
+  frame->instance_num = 0;
+
+  if (mp->instance_num == 0 || mp->mesh_num == 0)
+    return;
+
+  frame->instance_num = mp->instance_num;
+  update_set (mp, frame);
+
+  /* instances find their data by firstInstance, so without it they're
+   * drawn one call at a time instead */
+  if (!mp->has_first_instance)
+    return;
+
+  int batch = indirect_draws_begin_batch (draws);
+  if (batch < 0)
+    {
+      LOG_ERR ("failed to begin mesh batch");
+      return;
+    }
+
+  for (uint32_t i = 0; i < frame->instance_num; i++)
+    {
+      VkDrawIndexedIndirectCommand command;
+      if (build_command (mp, i, &command))
+        continue;
+
+      if (indirect_draws_add (draws, &command))
+        {
+          LOG_ERR ("failed to add mesh draw");
+          return;
+        }
+    }
+
+  frame->batch = batch;
+}
+
+void
+mesh_pass_render (mesh_pass_t *mp, const struct render_context *ctx,
+                  struct mesh_frame_data *frame)
+{
+  if (frame->instance_num == 0)
+    return;
+
+  VkPipeline pipeline = mp->pipeline;
+  if (ctx->view_num > 1)
+    pipeline = mp->multiview_pipeline;
+
+  /* no pipeline was made for this kind of render pass */
+  if (pipeline == VK_NULL_HANDLE)
+    return;
+
+  VkDescriptorSet sets[2] = { ctx->viewport_set, frame->set };
+  vkCmdBindDescriptorSets (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           mp->pipeline_layout, 0, 2, sets, 1,
+                           &ctx->viewport_offset);
+
+  vkCmdBindPipeline (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+  VkBuffer index_buffer = gpu_vector_get (mp->indices);
+  vkCmdBindIndexBuffer (ctx->cmd, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+  if (frame->batch >= 0)
+    {
+      indirect_draws_record (ctx->draws, ctx->cmd, frame->batch);
+      return;
+    }
+
+  for (uint32_t i = 0; i < frame->instance_num; i++)
+    {
+      VkDrawIndexedIndirectCommand command;
+      if (build_command (mp, i, &command))
+        continue;
+
+      vkCmdDrawIndexed (ctx->cmd, command.indexCount, command.instanceCount,
+                        command.firstIndex, command.vertexOffset,
+                        command.firstInstance);
+    }
+}
@@ -0,0 +1,1100 @@
+/** @file render_graph.c
+ */
+
+#include "renderer/render_graph.h"
+
+#include "gpu/gpu_debug.h"
+#include "gpu/gpu_memory.h"
+#include "log.h"
+
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdlib.h> /* for mem alloc */
+
+#include <vulkan/vulkan_core.h>
+
+#define MAX_PASS_USES 8
+#define MAX_MEMORY_BLOCKS 16
+
+enum resource_kind
+{
+  RESOURCE_IMAGE,
+  RESOURCE_BUFFER,
+};
+
+struct resource_use
+{
+  int resource;
+  struct render_access access;
+  int is_read;
+  int is_write;
+};
+
+/* a single vkCmdPipelineBarrier, indexing into the graph's barrier arrays */
+struct barrier_batch
+{
+  VkPipelineStageFlags src_stage;
+  VkPipelineStageFlags dst_stage;
+  int image_first;
+  int image_num;
+  int buffer_first;
+  int buffer_num;
+};
+
+struct graph_pass
+{
+  const char *name;
+  render_pass_callback_t callback;
+  void *userdata;
+
+  struct resource_use uses[MAX_PASS_USES];
+  int use_num;
+
+  int is_live;
+  struct barrier_batch barriers;
+};
+
+/* what the GPU has done to a resource so far while executing the graph */
+struct resource_state
+{
+  VkImageLayout layout;
+  VkPipelineStageFlags write_stage;
+  VkAccessFlags write_access;
+  VkPipelineStageFlags read_stages;
+  VkPipelineStageFlags visible_stages;
+  VkAccessFlags visible_access;
+  int is_dirty;
+};
+
+struct graph_resource
+{
+  enum resource_kind kind;
+  int is_transient;
+
+  VkImage image;
+  VkImageView image_view;
+  VkImageAspectFlags aspect;
+  VkBuffer buffer;
+
+  /* imported resources only */
+  struct render_access initial;
+  struct render_access final;
+
+  /* transient resources only */
+  struct render_image_desc desc;
+  int transient;
+
+  int is_output;
+  int is_needed;
+  int first_use;
+  int last_use;
+  struct resource_state state;
+};
+
+/* transient images are kept across compiles while their layout holds */
+struct transient_image
+{
+  struct render_image_desc desc;
+  int first_use;
+  int last_use;
+  int resource;
+
+  VkImage image;
+  VkImageView image_view;
+  VkMemoryRequirements reqs;
+  int block;
+  VkDeviceSize offset;
+};
+
+struct memory_block
+{
+  VkDeviceMemory memory;
+  uint32_t type_bits;
+  VkDeviceSize size;
+
+  /* only holds transient attachments, so it may be lazily allocated */
+  int is_lazy;
+};
+
+struct render_graph_s
+{
+  gpu_device_t *gpu;
+  VkDevice vkd;
+
+  struct graph_pass *passes;
+  int pass_num;
+  int pass_capacity;
+
+  struct graph_resource *resources;
+  int resource_num;
+  int resource_capacity;
+
+  VkImageMemoryBarrier *image_barriers;
+  int image_barrier_num;
+  int image_barrier_capacity;
+
+  VkBufferMemoryBarrier *buffer_barriers;
+  int buffer_barrier_num;
+  int buffer_barrier_capacity;
+
+  struct barrier_batch final_barriers;
+
+  struct transient_image *transients;
+  int transient_num;
+
+  struct memory_block blocks[MAX_MEMORY_BLOCKS];
+  int block_num;
+
+  int is_compiled;
+};
+
+static int
+grow (void **vals, int *capacity, int required, size_t val_size)
+{
+  if (required <= *capacity)
+    return 0;
+
+  int new_capacity = *capacity > 0 ? *capacity * 2 : 16;
+  while (new_capacity < required)
+    new_capacity *= 2;
+
+  void *new_vals = realloc (*vals, new_capacity * val_size);
+  if (!new_vals)
+    return 1;
+
+  *vals = new_vals;
+  *capacity = new_capacity;
+  return 0;
+}
+
+static int
+add_resource (render_graph_t *rg)
+{
+  if (grow ((void **)&rg->resources, &rg->resource_capacity,
+            rg->resource_num + 1, sizeof (struct graph_resource)))
+    {
+      LOG_ERR ("failed to grow render graph resources");
+      return -1;
+    }
+
+  int index = rg->resource_num++;
+  struct graph_resource *res = &rg->resources[index];
+
+  res->kind = RESOURCE_IMAGE;
+  res->is_transient = 0;
+  res->image = VK_NULL_HANDLE;
+  res->image_view = VK_NULL_HANDLE;
+  res->aspect = 0;
+  res->buffer = VK_NULL_HANDLE;
+  res->initial = (struct render_access){ 0 };
+  res->final = (struct render_access){ 0 };
+  res->transient = -1;
+  res->is_output = 0;
+  res->is_needed = 0;
+  res->first_use = -1;
+  res->last_use = -1;
+
+  return index;
+}
+
+static void
+destroy_transients (render_graph_t *rg)
+{
+  for (int i = 0; i < rg->transient_num; i++)
+    {
+      struct transient_image *t = &rg->transients[i];
+
+      if (t->image_view)
+        vkDestroyImageView (rg->vkd, t->image_view, NULL);
+
+      if (t->image)
+        vkDestroyImage (rg->vkd, t->image, NULL);
+    }
+
+  for (int i = 0; i < rg->block_num; i++)
+    {
+      gpu_memory_free (gpu_device_get_memory (rg->gpu), rg->blocks[i].memory);
+    }
+
+  if (rg->transients)
+    free (rg->transients);
+
+  rg->transients = NULL;
+  rg->transient_num = 0;
+  rg->block_num = 0;
+}
+
+int
+render_graph_new (render_graph_t **new_rg, gpu_device_t *gpu)
+{
+  render_graph_t *rg = malloc (sizeof (render_graph_t));
+  *new_rg = rg;
+
+  rg->gpu = gpu;
+  rg->vkd = gpu_device_get (gpu);
+
+  rg->passes = NULL;
+  rg->pass_num = 0;
+  rg->pass_capacity = 0;
+
+  rg->resources = NULL;
+  rg->resource_num = 0;
+  rg->resource_capacity = 0;
+
+  rg->image_barriers = NULL;
+  rg->image_barrier_num = 0;
+  rg->image_barrier_capacity = 0;
+
+  rg->buffer_barriers = NULL;
+  rg->buffer_barrier_num = 0;
+  rg->buffer_barrier_capacity = 0;
+
+  rg->transients = NULL;
+  rg->transient_num = 0;
+  rg->block_num = 0;
+
+  rg->is_compiled = 0;
+
+  return 0;
+}
+
+void
+render_graph_delete (render_graph_t *rg)
+{
+  destroy_transients (rg);
+
+  if (rg->passes)
+    free (rg->passes);
+
+  if (rg->resources)
+    free (rg->resources);
+
+  if (rg->image_barriers)
+    free (rg->image_barriers);
+
+  if (rg->buffer_barriers)
+    free (rg->buffer_barriers);
+
+  free (rg);
+}
+
+void
+render_graph_reset (render_graph_t *rg)
+{
+  rg->pass_num = 0;
+  rg->resource_num = 0;
+  rg->image_barrier_num = 0;
+  rg->buffer_barrier_num = 0;
+  rg->is_compiled = 0;
+}
+
+int
+render_graph_import_image (render_graph_t *rg, VkImage image,
+                           VkImageAspectFlags aspect,
+                           const struct render_access *initial,
+                           const struct render_access *final)
+{
+  int index = add_resource (rg);
+  if (index < 0)
+    return -1;
+
+  struct graph_resource *res = &rg->resources[index];
+  res->kind = RESOURCE_IMAGE;
+  res->image = image;
+  res->aspect = aspect;
+  res->initial = *initial;
+  res->final = *final;
+
+  return index;
+}
+
+int
+render_graph_import_buffer (render_graph_t *rg, VkBuffer buffer,
+                            const struct render_access *initial,
+                            const struct render_access *final)
+{
+  int index = add_resource (rg);
+  if (index < 0)
+    return -1;
+
+  struct graph_resource *res = &rg->resources[index];
+  res->kind = RESOURCE_BUFFER;
+  res->buffer = buffer;
+  res->initial = *initial;
+  res->final = *final;
+
+  return index;
+}
+
+int
+render_graph_create_image (render_graph_t *rg,
+                           const struct render_image_desc *desc)
+{
+  int index = add_resource (rg);
+  if (index < 0)
+    return -1;
+
+  struct graph_resource *res = &rg->resources[index];
+  res->kind = RESOURCE_IMAGE;
+  res->is_transient = 1;
+  res->aspect = desc->aspect;
+  res->desc = *desc;
+
+  if (res->desc.layer_num == 0)
+    res->desc.layer_num = 1;
+
+  /* contents start out undefined, so there's nothing to wait on */
+  res->initial = (struct render_access){
+    .stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+    .access = 0,
+    .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+
+  return index;
+}
+
+int
+render_graph_add_pass (render_graph_t *rg, const char *name,
+                       render_pass_callback_t callback, void *userdata)
+{
+  if (grow ((void **)&rg->passes, &rg->pass_capacity, rg->pass_num + 1,
+            sizeof (struct graph_pass)))
+    {
+      LOG_ERR ("failed to grow render graph passes");
+      return -1;
+    }
+
+  int index = rg->pass_num++;
+  struct graph_pass *pass = &rg->passes[index];
+
+  pass->name = name;
+  pass->callback = callback;
+  pass->userdata = userdata;
+  pass->use_num = 0;
+  pass->is_live = 0;
+
+  return index;
+}
+
+static void
+add_use (render_graph_t *rg, int pass_index, int resource,
+         const struct render_access *access, int is_write)
+{
+  if (pass_index < 0 || resource < 0)
+    return;
+
+  struct graph_pass *pass = &rg->passes[pass_index];
+  struct graph_resource *res = &rg->resources[resource];
+
+  /* a pass touching a resource twice needs a single combined barrier */
+  for (int i = 0; i < pass->use_num; i++)
+    {
+      struct resource_use *use = &pass->uses[i];
+      if (use->resource != resource)
+        continue;
+
+      if (res->kind == RESOURCE_IMAGE && use->access.layout != access->layout)
+        {
+          LOG_ERR ("pass %s uses an image in two layouts", pass->name);
+          return;
+        }
+
+      use->access.stage |= access->stage;
+      use->access.access |= access->access;
+      use->is_read |= !is_write;
+      use->is_write |= is_write;
+      return;
+    }
+
+  if (pass->use_num >= MAX_PASS_USES)
+    {
+      LOG_ERR ("pass %s uses too many resources", pass->name);
+      return;
+    }
+
+  pass->uses[pass->use_num++] = (struct resource_use){
+    .resource = resource,
+    .access = *access,
+    .is_read = !is_write,
+    .is_write = is_write,
+  };
+}
+
+void
+render_graph_read (render_graph_t *rg, int pass, int resource,
+                   const struct render_access *access)
+{
+  add_use (rg, pass, resource, access, 0);
+}
+
+void
+render_graph_write (render_graph_t *rg, int pass, int resource,
+                    const struct render_access *access)
+{
+  add_use (rg, pass, resource, access, 1);
+}
+
+void
+render_graph_mark_output (render_graph_t *rg, int resource)
+{
+  if (resource >= 0)
+    rg->resources[resource].is_output = 1;
+}
+
+VkImageView
+render_graph_get_image_view (render_graph_t *rg, int resource)
+{
+  return rg->resources[resource].image_view;
+}
+
+static void
+cull_passes (render_graph_t *rg)
+{
+  for (int i = 0; i < rg->resource_num; i++)
+    rg->resources[i].is_needed = rg->resources[i].is_output;
+
+  /* walk backwards from the outputs, keeping whatever feeds into them */
+  for (int i = rg->pass_num - 1; i >= 0; i--)
+    {
+      struct graph_pass *pass = &rg->passes[i];
+      pass->is_live = 0;
+
+      for (int j = 0; j < pass->use_num && !pass->is_live; j++)
+        {
+          const struct resource_use *use = &pass->uses[j];
+          if (use->is_write && rg->resources[use->resource].is_needed)
+            pass->is_live = 1;
+        }
+
+      if (!pass->is_live)
+        continue;
+
+      for (int j = 0; j < pass->use_num; j++)
+        {
+          const struct resource_use *use = &pass->uses[j];
+          struct graph_resource *res = &rg->resources[use->resource];
+
+          if (use->is_read)
+            res->is_needed = 1;
+
+          /* walking backwards, so the first pass seen is the last use */
+          if (res->last_use < 0)
+            res->last_use = i;
+
+          res->first_use = i;
+        }
+    }
+}
+
+static int
+desc_equal (const struct render_image_desc *a,
+            const struct render_image_desc *b)
+{
+  return a->format == b->format && a->width == b->width
+         && a->height == b->height && a->layer_num == b->layer_num
+         && a->usage == b->usage && a->aspect == b->aspect;
+}
+
+/* whether the live transients are laid out exactly as in the last compile */
+static int
+transients_match (render_graph_t *rg)
+{
+  int transient_num = 0;
+  for (int i = 0; i < rg->resource_num; i++)
+    {
+      const struct graph_resource *res = &rg->resources[i];
+      if (!res->is_transient || res->first_use < 0)
+        continue;
+
+      if (transient_num >= rg->transient_num)
+        return 0;
+
+      const struct transient_image *t = &rg->transients[transient_num++];
+      if (!desc_equal (&res->desc, &t->desc) || res->first_use != t->first_use
+          || res->last_use != t->last_use)
+        return 0;
+    }
+
+  return transient_num == rg->transient_num;
+}
+
+static int
+lifetimes_overlap (const struct transient_image *a,
+                   const struct transient_image *b)
+{
+  return a->first_use <= b->last_use && b->first_use <= a->last_use;
+}
+
+static int
+ranges_overlap (const struct transient_image *a,
+                const struct transient_image *b)
+{
+  return a->offset < b->offset + b->reqs.size
+         && b->offset < a->offset + a->reqs.size;
+}
+
+static VkDeviceSize
+align_up (VkDeviceSize value, VkDeviceSize alignment)
+{
+  if (alignment == 0)
+    return value;
+
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static int
+create_transient_image (render_graph_t *rg, struct transient_image *t)
+{
+  VkImageCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .imageType = VK_IMAGE_TYPE_2D,
+    .format = t->desc.format,
+    .extent = {
+      .width = t->desc.width,
+      .height = t->desc.height,
+      .depth = 1,
+    },
+    .mipLevels = 1,
+    .arrayLayers = t->desc.layer_num,
+    .samples = VK_SAMPLE_COUNT_1_BIT,
+    .tiling = VK_IMAGE_TILING_OPTIMAL,
+    .usage = t->desc.usage,
+    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+
+  if (vkCreateImage (rg->vkd, &ci, NULL, &t->image) != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create transient image");
+      return 1;
+    }
+
+  vkGetImageMemoryRequirements (rg->vkd, t->image, &t->reqs);
+
+  return 0;
+}
+
+static int
+create_transient_view (render_graph_t *rg, struct transient_image *t)
+{
+  VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D;
+  if (t->desc.layer_num > 1)
+    view_type = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+
+  VkImageViewCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+    .image = t->image,
+    .viewType = view_type,
+    .format = t->desc.format,
+    .subresourceRange = {
+      .aspectMask = t->desc.aspect,
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = t->desc.layer_num,
+    },
+  };
+
+  if (vkCreateImageView (rg->vkd, &ci, NULL, &t->image_view) != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create transient image view");
+      return 1;
+    }
+
+  return 0;
+}
+
+static int
+find_block (render_graph_t *rg, uint32_t type_bits, int is_lazy)
+{
+  for (int i = 0; i < rg->block_num; i++)
+    {
+      if (rg->blocks[i].type_bits == type_bits
+          && rg->blocks[i].is_lazy == is_lazy)
+        return i;
+    }
+
+  if (rg->block_num >= MAX_MEMORY_BLOCKS)
+    return -1;
+
+  int index = rg->block_num++;
+  rg->blocks[index] = (struct memory_block){
+    .memory = VK_NULL_HANDLE,
+    .type_bits = type_bits,
+    .size = 0,
+    .is_lazy = is_lazy,
+  };
+
+  return index;
+}
+
+/* places each image at the lowest offset that no image alive at the same
+ * time occupies, largest images first */
+static void
+place_transients (render_graph_t *rg, int *order)
+{
+  for (int i = 0; i < rg->transient_num; i++)
+    order[i] = i;
+
+  for (int i = 1; i < rg->transient_num; i++)
+    {
+      int index = order[i];
+      VkDeviceSize size = rg->transients[index].reqs.size;
+
+      int j = i;
+      while (j > 0 && rg->transients[order[j - 1]].reqs.size < size)
+        {
+          order[j] = order[j - 1];
+          j--;
+        }
+
+      order[j] = index;
+    }
+
+  for (int i = 0; i < rg->transient_num; i++)
+    {
+      struct transient_image *t = &rg->transients[order[i]];
+      t->offset = 0;
+
+      int is_placed = 0;
+      while (!is_placed)
+        {
+          is_placed = 1;
+
+          for (int j = 0; j < i; j++)
+            {
+              const struct transient_image *other
+                  = &rg->transients[order[j]];
+
+              if (other->block != t->block || !lifetimes_overlap (t, other)
+                  || !ranges_overlap (t, other))
+                continue;
+
+              t->offset = align_up (other->offset + other->reqs.size,
+                                    t->reqs.alignment);
+              is_placed = 0;
+            }
+        }
+
+      struct memory_block *block = &rg->blocks[t->block];
+      if (t->offset + t->reqs.size > block->size)
+        block->size = t->offset + t->reqs.size;
+    }
+}
+
+static int
+create_transients (render_graph_t *rg)
+{
+  destroy_transients (rg);
+
+  int transient_num = 0;
+  for (int i = 0; i < rg->resource_num; i++)
+    {
+      const struct graph_resource *res = &rg->resources[i];
+      if (res->is_transient && res->first_use >= 0)
+        transient_num++;
+    }
+
+  if (transient_num == 0)
+    return 0;
+
+  rg->transients = calloc (transient_num, sizeof (struct transient_image));
+  if (!rg->transients)
+    return 1;
+
+  for (int i = 0; i < rg->resource_num; i++)
+    {
+      const struct graph_resource *res = &rg->resources[i];
+      if (!res->is_transient || res->first_use < 0)
+        continue;
+
+      struct transient_image *t = &rg->transients[rg->transient_num++];
+      t->desc = res->desc;
+      t->first_use = res->first_use;
+      t->last_use = res->last_use;
+
+      if (create_transient_image (rg, t))
+        return 1;
+
+      int is_lazy
+          = (t->desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+      t->block = find_block (rg, t->reqs.memoryTypeBits, is_lazy);
+      if (t->block < 0)
+        {
+          LOG_ERR ("too many transient memory types");
+          return 1;
+        }
+    }
+
+  int *order = malloc (transient_num * sizeof (int));
+  if (!order)
+    return 1;
+
+  place_transients (rg, order);
+  free (order);
+
+  for (int i = 0; i < rg->block_num; i++)
+    {
+      struct memory_block *block = &rg->blocks[i];
+
+      /* tilers can keep lazily allocated attachments in tile memory and
+       * never back them at all */
+      int memory_type = gpu_device_find_preferred_memory_type (
+          rg->gpu, block->type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+          block->is_lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0);
+      if (memory_type < 0)
+        return 1;
+
+      VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = block->size,
+        .memoryTypeIndex = memory_type,
+      };
+
+      if (gpu_memory_allocate (gpu_device_get_memory (rg->gpu), &alloc_info,
+                               GPU_MEMORY_RENDER_TARGETS, &block->memory))
+        {
+          LOG_ERR ("failed to allocate transient memory");
+          return 1;
+        }
+    }
+
+  VkDeviceSize unaliased_size = 0;
+  VkDeviceSize aliased_size = 0;
+
+  for (int i = 0; i < rg->transient_num; i++)
+    {
+      struct transient_image *t = &rg->transients[i];
+      VkDeviceMemory memory = rg->blocks[t->block].memory;
+
+      if (vkBindImageMemory (rg->vkd, t->image, memory, t->offset)
+          != VK_SUCCESS)
+        {
+          LOG_ERR ("failed to bind transient image memory");
+          return 1;
+        }
+
+      if (create_transient_view (rg, t))
+        return 1;
+
+      unaliased_size += t->reqs.size;
+    }
+
+  for (int i = 0; i < rg->block_num; i++)
+    aliased_size += rg->blocks[i].size;
+
+  LOG_INF ("allocated %d transient images in %lu bytes (%lu unaliased)",
+           rg->transient_num, (unsigned long)aliased_size,
+           (unsigned long)unaliased_size);
+
+  return 0;
+}
+
+static void
+bind_transients (render_graph_t *rg)
+{
+  int transient_num = 0;
+  for (int i = 0; i < rg->resource_num; i++)
+    {
+      struct graph_resource *res = &rg->resources[i];
+      if (!res->is_transient || res->first_use < 0)
+        continue;
+
+      struct transient_image *t = &rg->transients[transient_num];
+      t->resource = i;
+
+      res->transient = transient_num;
+      res->image = t->image;
+      res->image_view = t->image_view;
+
+      transient_num++;
+    }
+}
+
+static void
+add_image_barrier (render_graph_t *rg, struct barrier_batch *batch,
+                   struct graph_resource *res, VkAccessFlags src_access,
+                   const struct render_access *dst)
+{
+  if (grow ((void **)&rg->image_barriers, &rg->image_barrier_capacity,
+            rg->image_barrier_num + 1, sizeof (VkImageMemoryBarrier)))
+    {
+      LOG_ERR ("failed to grow render graph barriers");
+      return;
+    }
+
+  if (batch->image_num == 0)
+    batch->image_first = rg->image_barrier_num;
+
+  rg->image_barriers[rg->image_barrier_num++] = (VkImageMemoryBarrier){
+    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+    .srcAccessMask = src_access,
+    .dstAccessMask = dst->access,
+    .oldLayout = res->state.layout,
+    .newLayout = dst->layout,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .image = res->image,
+    .subresourceRange = {
+      .aspectMask = res->aspect,
+      .baseMipLevel = 0,
+      .levelCount = VK_REMAINING_MIP_LEVELS,
+      .baseArrayLayer = 0,
+      .layerCount = VK_REMAINING_ARRAY_LAYERS,
+    },
+  };
+
+  batch->image_num++;
+}
+
+static void
+add_buffer_barrier (render_graph_t *rg, struct barrier_batch *batch,
+                    struct graph_resource *res, VkAccessFlags src_access,
+                    const struct render_access *dst)
+{
+  if (grow ((void **)&rg->buffer_barriers, &rg->buffer_barrier_capacity,
+            rg->buffer_barrier_num + 1, sizeof (VkBufferMemoryBarrier)))
+    {
+      LOG_ERR ("failed to grow render graph barriers");
+      return;
+    }
+
+  if (batch->buffer_num == 0)
+    batch->buffer_first = rg->buffer_barrier_num;
+
+  rg->buffer_barriers[rg->buffer_barrier_num++] = (VkBufferMemoryBarrier){
+    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    .srcAccessMask = src_access,
+    .dstAccessMask = dst->access,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .buffer = res->buffer,
+    .offset = 0,
+    .size = VK_WHOLE_SIZE,
+  };
+
+  batch->buffer_num++;
+}
+
+static void
+init_state (struct graph_resource *res)
+{
+  struct resource_state *st = &res->state;
+
+  st->layout = res->initial.layout;
+  st->write_stage = res->initial.stage;
+  st->write_access = res->initial.access;
+  st->read_stages = 0;
+  st->visible_stages = 0;
+  st->visible_access = 0;
+  st->is_dirty = 0;
+}
+
+/* aliased memory has to wait for the images that used it before */
+static void
+inherit_aliases (render_graph_t *rg, struct graph_resource *res)
+{
+  struct resource_state *st = &res->state;
+  const struct transient_image *t = &rg->transients[res->transient];
+  for (int i = 0; i < rg->transient_num; i++)
+    {
+      const struct transient_image *other = &rg->transients[i];
+      if (other->block != t->block || other->last_use >= t->first_use
+          || !ranges_overlap (t, other))
+        continue;
+
+      const struct resource_state *other_st
+          = &rg->resources[other->resource].state;
+
+      st->write_stage |= other_st->write_stage | other_st->read_stages;
+      st->write_access |= other_st->write_access;
+      st->is_dirty = 1;
+    }
+}
+
+static void
+sync_access (render_graph_t *rg, struct barrier_batch *batch,
+             struct graph_resource *res, const struct render_access *access,
+             int is_write)
+{
+  struct resource_state *st = &res->state;
+
+  int layout_change
+      = res->kind == RESOURCE_IMAGE && access->layout != st->layout;
+
+  if (!is_write && !layout_change)
+    {
+      int is_visible = (st->visible_stages & access->stage) == access->stage
+                       && (st->visible_access & access->access)
+                              == access->access;
+
+      /* reads only wait on writes they haven't seen yet */
+      if (!is_visible && (st->is_dirty || st->write_access != 0))
+        {
+          batch->src_stage |= st->write_stage;
+          batch->dst_stage |= access->stage;
+
+          if (res->kind == RESOURCE_IMAGE)
+            add_image_barrier (rg, batch, res, st->write_access, access);
+          else
+            add_buffer_barrier (rg, batch, res, st->write_access, access);
+
+          st->visible_stages |= access->stage;
+          st->visible_access |= access->access;
+        }
+
+      st->read_stages |= access->stage;
+      return;
+    }
+
+  /* writes and transitions wait on every access since the last write */
+  VkPipelineStageFlags src_stage = st->write_stage | st->read_stages;
+  VkAccessFlags src_access = st->write_access;
+
+  int is_needed = layout_change || src_access != 0
+                  || (src_stage & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) != 0;
+
+  if (is_needed)
+    {
+      batch->src_stage |= src_stage;
+      batch->dst_stage |= access->stage;
+
+      if (res->kind == RESOURCE_IMAGE)
+        add_image_barrier (rg, batch, res, src_access, access);
+      else
+        add_buffer_barrier (rg, batch, res, src_access, access);
+    }
+
+  st->layout = access->layout;
+  st->write_stage = access->stage;
+  st->write_access = is_write ? access->access : 0;
+  st->read_stages = is_write ? 0 : access->stage;
+  st->visible_stages = access->stage;
+  st->visible_access = access->access;
+  st->is_dirty = 1;
+}
+
+static void
+compute_barriers (render_graph_t *rg)
+{
+  for (int i = 0; i < rg->resource_num; i++)
+    {
+      struct graph_resource *res = &rg->resources[i];
+      if (res->is_transient && res->transient < 0)
+        continue;
+
+      init_state (res);
+    }
+
+  for (int i = 0; i < rg->pass_num; i++)
+    {
+      struct graph_pass *pass = &rg->passes[i];
+      pass->barriers = (struct barrier_batch){ 0 };
+
+      if (!pass->is_live)
+        continue;
+
+      for (int j = 0; j < pass->use_num; j++)
+        {
+          const struct resource_use *use = &pass->uses[j];
+          struct graph_resource *res = &rg->resources[use->resource];
+
+          if (res->is_transient && res->first_use == i)
+            inherit_aliases (rg, res);
+
+          sync_access (rg, &pass->barriers, res, &use->access,
+                       use->is_write);
+        }
+    }
+
+  rg->final_barriers = (struct barrier_batch){ 0 };
+
+  for (int i = 0; i < rg->resource_num; i++)
+    {
+      struct graph_resource *res = &rg->resources[i];
+      if (res->is_transient)
+        continue;
+
+      /* leaving the image as it is needs no barrier */
+      if (res->final.access == 0 && res->kind == RESOURCE_IMAGE
+          && res->final.layout == res->state.layout)
+        continue;
+
+      if (res->final.access == 0 && res->kind == RESOURCE_BUFFER)
+        continue;
+
+      sync_access (rg, &rg->final_barriers, res, &res->final, 0);
+    }
+}
+
+int
+render_graph_compile (render_graph_t *rg)
+{
+  rg->is_compiled = 0;
+  rg->image_barrier_num = 0;
+  rg->buffer_barrier_num = 0;
+
+  cull_passes (rg);
+
+  if (!transients_match (rg) && create_transients (rg))
+    {
+      LOG_ERR ("failed to create transient images");
+      destroy_transients (rg);
+      return 1;
+    }
+
+  bind_transients (rg);
+  compute_barriers (rg);
+
+  rg->is_compiled = 1;
+  return 0;
+}
+
+static void
+record_barriers (render_graph_t *rg, VkCommandBuffer cmd,
+                 const struct barrier_batch *batch)
+{
+  if (batch->image_num == 0 && batch->buffer_num == 0)
+    return;
+
+  VkPipelineStageFlags src_stage = batch->src_stage;
+  if (src_stage == 0)
+    src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+  VkPipelineStageFlags dst_stage = batch->dst_stage;
+  if (dst_stage == 0)
+    dst_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+  vkCmdPipelineBarrier (cmd, src_stage, dst_stage, 0, 0, NULL,
+                        batch->buffer_num,
+                        &rg->buffer_barriers[batch->buffer_first],
+                        batch->image_num,
+                        &rg->image_barriers[batch->image_first]);
+}
+
+void
+render_graph_execute (render_graph_t *rg, VkCommandBuffer cmd)
+{
+  if (!rg->is_compiled)
+    {
+      LOG_ERR ("render graph was executed before being compiled");
+      return;
+    }
+
+  for (int i = 0; i < rg->pass_num; i++)
+    {
+      struct graph_pass *pass = &rg->passes[i];
+      if (!pass->is_live)
+        continue;
+
+      record_barriers (rg, cmd, &pass->barriers);
+
+      if (pass->callback)
+        {
+          gpu_debug_begin_label (cmd, pass->name);
+          pass->callback (pass->userdata, cmd);
+          gpu_debug_end_label (cmd);
+        }
+    }
+
+  record_barriers (rg, cmd, &rg->final_barriers);
+}
@@ -5,43 +5,250 @@
 
 /* TODO(marceline-cramer): mdo_allocator */
 #include <stdlib.h> /* for mem alloc */
+#include <string.h> /* for memcpy */
 
 #include <TracyC.h>
+#include <uv.h>
 #include <vulkan/vulkan_core.h>
 
 #include "gpu/gpu_device.h"
+#include "gpu/gpu_memory.h"
+#include "gpu/gpu_profiler.h"
+#include "gpu/gpu_timeline.h"
 #include "log.h"
+#include "renderer/command_recorder.h"
 #include "renderer/debug/debug_pass.h"
+#include "renderer/frame_capture.h"
 #include "renderer/frame_data.h"
+#include "renderer/mesh/mesh_pass.h"
+#include "renderer/render_graph.h"
 #include "renderer/render_phases.h"
+#include "renderer/resolution_controller.h"
+#include "renderer/stars/star_pass.h"
+#include "renderer/viewport_atlas.h"
 #include "renderer/viewport_uniform.h"
 
-#define MAX_CAMERA_NUM 1024
-#define MAX_VIEWPORT_NUM (MAX_CAMERA_NUM * MAX_VIEWPORTS_PER_CAMERA)
+#define DEFAULT_THROUGHPUT_FRAMES 3
+#define DEFAULT_LOW_LATENCY_FRAMES 1
+
+/* below this many passes, handing work to threads costs more than it saves */
+#define PARALLEL_PASS_MIN 2
+
+/* frames whose latency hasn't been measured yet; the oldest are dropped */
+#define MAX_LATENCY_QUERIES 16
+
+struct latency_query
+{
+  uint64_t frame;
+  uint64_t timeline_value;
+  int is_complete;
+
+  /* zero if the frame wasn't presented with an ID */
+  uint64_t present_id;
+  viewport_t *vp;
+  VkSwapchainKHR swapchain;
+};
+
+/* a viewport drawn this frame, and its slot in the uniform buffer */
+struct viewport_draw
+{
+  viewport_t *vp;
+  camera_t *camera;
+  int index;
+};
+
+/* atlas viewports are grouped so each atlas gets one render pass */
+struct atlas_batch
+{
+  viewport_atlas_t *atlas;
+  int is_acquired;
+};
+
+/* per-frame bookkeeping, grown to fit the most viewports seen so far */
+struct frame_scratch
+{
+  int capacity;
+
+  viewport_t **viewports;
+  camera_t **cameras;
+  struct viewport_draw *draws;
+  struct atlas_batch *batches;
+
+  struct viewport_pass *passes;
+  VkCommandBufferInheritanceInfo *inheritance;
+  VkCommandBuffer *secondaries;
+
+  VkSwapchainKHR *swapchains;
+  VkSemaphore *wait_semaphores;
+  VkPipelineStageFlags *wait_stages;
+  uint32_t *image_indices;
+  viewport_t **present_viewports;
+  VkResult *present_results;
+  uint64_t *present_ids;
+};
 
 struct renderer_s
 {
   gpu_device_t *gpu;
   VkDevice vkd;
   VkQueue present_queue;
+  gpu_timeline_t *timeline;
+  gpu_profiler_t *profiler;
+  command_recorder_t *recorder;
+
+  /* null unless dynamic resolution has a GPU budget to keep to */
+  resolution_controller_t *resolution;
+  float render_scale;
 
   VkDescriptorSetLayout viewport_layout;
+  uint32_t viewport_stride;
+  int has_depth;
+
+  /* host-side staging for the per-frame viewport uniform buffer */
+  char *uniform_scratch;
+  size_t uniform_scratch_size;
+
+  struct frame_scratch scratch;
+
+  /* not owned; captured every frame their viewport is rendered */
+  frame_capture_t **captures;
+  int capture_num;
+  int capture_capacity;
 
   debug_pass_t *debug_pass;
+  mesh_pass_t *mesh_pass;
+  star_pass_t *star_pass;
 
   struct frame_data frames[MAX_FRAMES_IN_FLIGHT];
   int frame_num;
   int frame_index;
+
+  /* frame pacing */
+  enum renderer_latency_mode latency_mode;
+  int is_frame_begun;
+  uint64_t begin_time;
+  struct renderer_frame_stats stats;
+
+  /* stage timings and latency, if requested */
+  frame_stats_t *frame_stats;
+  struct latency_query latency_queries[MAX_LATENCY_QUERIES];
+  int latency_query_num;
+  int has_present_wait;
 };
 
+struct viewport_pass
+{
+  renderer_t *ren;
+  struct frame_data *frame;
+
+  /* the viewport whose image is rendered to, which for atlases is the
+   * atlas's own viewport rather than any being drawn */
+  viewport_t *vp;
+  const struct viewport_draw *draws;
+  int draw_num;
+
+  /* recorded ahead of time on the recorder's threads, if not null */
+  VkCommandBuffer secondary;
+
+  /* the render graph's depth image for the pass, or -1 */
+  int depth;
+};
+
+static void
+begin_stage (renderer_t *ren, enum frame_stage stage)
+{
+  if (ren->frame_stats)
+    frame_stats_begin_stage (ren->frame_stats, stage);
+}
+
+static void
+end_stage (renderer_t *ren, enum frame_stage stage)
+{
+  if (ren->frame_stats)
+    frame_stats_end_stage (ren->frame_stats, stage);
+}
+
+static void
+add_latency_query (renderer_t *ren, const struct latency_query *query)
+{
+  if (ren->latency_query_num == MAX_LATENCY_QUERIES)
+    {
+      memmove (&ren->latency_queries[0], &ren->latency_queries[1],
+               (MAX_LATENCY_QUERIES - 1) * sizeof (struct latency_query));
+      ren->latency_query_num--;
+    }
+
+  ren->latency_queries[ren->latency_query_num++] = *query;
+}
+
+/* returns non-zero once the query's presentation is known, or never will be */
+static int
+poll_present (renderer_t *ren, const struct latency_query *query,
+              uint64_t now)
+{
+  if (query->present_id == 0)
+    return 1;
+
+  /* a recreated swapchain's presents are never waited on */
+  if (!viewport_owns_swapchain (query->vp, query->swapchain))
+    return 1;
+
+#ifdef VK_KHR_present_wait
+  VkResult result = vkWaitForPresentKHR (ren->vkd, query->swapchain,
+                                        query->present_id, 0);
+
+  if (result == VK_TIMEOUT)
+    return 0;
+
+  if (result == VK_SUCCESS)
+    frame_stats_mark_latency (ren->frame_stats, query->frame, now,
+                              FRAME_LATENCY_PRESENTED);
+#endif
+
+  return 1;
+}
+
+/* checks up on outstanding frames without blocking, so the times observed
+ * are late by up to however long it's been since the last check */
+static void
+resolve_latency (renderer_t *ren)
+{
+  if (!ren->frame_stats)
+    return;
+
+  uint64_t now = uv_hrtime ();
+
+  int kept_num = 0;
+  for (int i = 0; i < ren->latency_query_num; i++)
+    {
+      struct latency_query *query = &ren->latency_queries[i];
+
+      if (!query->is_complete
+          && gpu_timeline_is_complete (ren->timeline, query->timeline_value))
+        {
+          query->is_complete = 1;
+          frame_stats_mark_latency (ren->frame_stats, query->frame, now,
+                                    FRAME_LATENCY_GPU_COMPLETE);
+        }
+
+      if (query->is_complete && poll_present (ren, query, now))
+        continue;
+
+      ren->latency_queries[kept_num++] = *query;
+    }
+
+  ren->latency_query_num = kept_num;
+}
+
 static int
 create_viewport_layout (renderer_t *ren)
 {
   VkDescriptorSetLayoutBinding binding = {
     .binding = 0,
-    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
     .descriptorCount = 1,
-    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT
+                  | VK_SHADER_STAGE_COMPUTE_BIT,
   };
 
   VkDescriptorSetLayoutCreateInfo ci = {
@@ -63,21 +270,18 @@ create_viewport_layout (renderer_t *ren)
 static int
 frame_data_init (renderer_t *ren, struct frame_data *frame)
 {
-  frame->command_pool = VK_NULL_HANDLE;
   frame->on_finished = VK_NULL_HANDLE;
-  frame->is_in_flight = VK_NULL_HANDLE;
+  frame->timeline_value = 0;
   frame->viewport_buf = NULL;
+  frame->draws = NULL;
   frame->descriptor_pool = VK_NULL_HANDLE;
+  frame->viewport_set = VK_NULL_HANDLE;
+  frame->viewport_set_generation = 0;
+  frame->graph = NULL;
 
-  VkCommandPoolCreateInfo cp_ci = {
-    .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-    .queueFamilyIndex = gpu_device_gfx_family (ren->gpu),
-  };
-
-  if (vkCreateCommandPool (ren->vkd, &cp_ci, NULL, &frame->command_pool)
-      != VK_SUCCESS)
+  if (render_graph_new (&frame->graph, ren->gpu))
     {
-      LOG_ERR ("failed to create command pool");
+      LOG_ERR ("failed to create render graph");
       return 1;
     }
 
@@ -92,35 +296,30 @@ frame_data_init (renderer_t *ren, struct frame_data *frame)
       return 1;
     }
 
-  VkFenceCreateInfo fence_ci = {
-    .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-    .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-  };
-
-  if (vkCreateFence (ren->vkd, &fence_ci, NULL, &frame->is_in_flight)
-      != VK_SUCCESS)
+  VkBufferUsageFlags viewport_usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  if (gpu_vector_new (&frame->viewport_buf, ren->gpu, viewport_usage,
+                      GPU_MEMORY_UNIFORMS))
     {
-      LOG_ERR ("failed to create fence");
+      fprintf (stderr, "failed to create viewport buffer\n");
       return 1;
     }
 
-  VkBufferUsageFlags viewport_usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-  if (gpu_vector_new (&frame->viewport_buf, ren->gpu, viewport_usage))
+  if (indirect_draws_new (&frame->draws, ren->gpu))
     {
-      fprintf (stderr, "failed to create viewport buffer\n");
+      LOG_ERR ("failed to create indirect draws");
       return 1;
     }
 
   VkDescriptorPoolSize pool_sizes[1];
 
   pool_sizes[0] = (VkDescriptorPoolSize){
-    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .descriptorCount = 100, /* picked arbitrarily */
+    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+    .descriptorCount = 1,
   };
 
   VkDescriptorPoolCreateInfo dp_ci = {
     .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-    .maxSets = 1000, /* arbitrarily picked */
+    .maxSets = 1,
     .poolSizeCount = 1,
     .pPoolSizes = pool_sizes,
   };
@@ -132,6 +331,21 @@ frame_data_init (renderer_t *ren, struct frame_data *frame)
       return 1;
     }
 
+  /* the set lives as long as the frame; only its buffer binding changes */
+  VkDescriptorSetAllocateInfo alloc_info = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    .descriptorPool = frame->descriptor_pool,
+    .descriptorSetCount = 1,
+    .pSetLayouts = &ren->viewport_layout,
+  };
+
+  if (vkAllocateDescriptorSets (ren->vkd, &alloc_info, &frame->viewport_set)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to allocate viewport descriptor set");
+      return 1;
+    }
+
   return 0;
 }
 
@@ -141,46 +355,641 @@ frame_data_cleanup (renderer_t *ren, struct frame_data *frame)
   if (frame->descriptor_pool)
     vkDestroyDescriptorPool (ren->vkd, frame->descriptor_pool, NULL);
 
+  if (frame->draws)
+    indirect_draws_delete (frame->draws);
+
   if (frame->viewport_buf)
     gpu_vector_delete (frame->viewport_buf);
 
-  if (frame->command_pool)
-    vkDestroyCommandPool (ren->vkd, frame->command_pool, NULL);
+  if (frame->graph)
+    render_graph_delete (frame->graph);
 
   if (frame->on_finished)
     vkDestroySemaphore (ren->vkd, frame->on_finished, NULL);
+}
+
+static void
+update_viewport_set (renderer_t *ren, struct frame_data *frame)
+{
+  /* the viewport buffer is only recreated when it's resized */
+  uint64_t generation = gpu_vector_get_generation (frame->viewport_buf);
+  if (generation == frame->viewport_set_generation)
+    return;
+
+  VkDescriptorBufferInfo vp_buf = {
+    .buffer = gpu_vector_get (frame->viewport_buf),
+    .offset = 0,
+    .range = sizeof (viewport_uniform_t),
+  };
+
+  VkWriteDescriptorSet write_info = {
+    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+    .dstSet = frame->viewport_set,
+    .dstBinding = 0,
+    .descriptorCount = 1,
+    .pBufferInfo = &vp_buf,
+  };
+
+  vkUpdateDescriptorSets (ren->vkd, 1, &write_info, 0, NULL);
+  frame->viewport_set_generation = generation;
+}
+
+static void *
+reserve_uniform_scratch (renderer_t *ren, size_t size)
+{
+  if (size > ren->uniform_scratch_size)
+    {
+      char *scratch = realloc (ren->uniform_scratch, size);
+      if (!scratch)
+        return NULL;
+
+      ren->uniform_scratch = scratch;
+      ren->uniform_scratch_size = size;
+    }
+
+  return ren->uniform_scratch;
+}
+
+static int
+grow_array (void **array, size_t element_size, int capacity)
+{
+  void *grown = realloc (*array, element_size * capacity);
+  if (!grown)
+    return 1;
+
+  *array = grown;
+  return 0;
+}
+
+#define GROW_SCRATCH(scratch, member, capacity)                              \
+  grow_array ((void **)&(scratch)->member, sizeof (*(scratch)->member),      \
+              capacity)
+
+static void
+frame_scratch_init (struct frame_scratch *scratch)
+{
+  *scratch = (struct frame_scratch){ 0 };
+}
+
+static void
+frame_scratch_cleanup (struct frame_scratch *scratch)
+{
+  free (scratch->viewports);
+  free (scratch->cameras);
+  free (scratch->draws);
+  free (scratch->batches);
+  free (scratch->passes);
+  free (scratch->inheritance);
+  free (scratch->secondaries);
+  free (scratch->swapchains);
+  free (scratch->wait_semaphores);
+  free (scratch->wait_stages);
+  free (scratch->image_indices);
+  free (scratch->present_viewports);
+  free (scratch->present_results);
+  free (scratch->present_ids);
+}
+
+/* every array holds at most one element per viewport */
+static int
+frame_scratch_reserve (struct frame_scratch *scratch, int viewport_num)
+{
+  if (viewport_num <= scratch->capacity)
+    return 0;
+
+  int capacity = scratch->capacity > 0 ? scratch->capacity : 16;
+  while (capacity < viewport_num)
+    capacity *= 2;
+
+  if (GROW_SCRATCH (scratch, viewports, capacity)
+      || GROW_SCRATCH (scratch, cameras, capacity)
+      || GROW_SCRATCH (scratch, draws, capacity)
+      || GROW_SCRATCH (scratch, batches, capacity)
+      || GROW_SCRATCH (scratch, passes, capacity)
+      || GROW_SCRATCH (scratch, inheritance, capacity)
+      || GROW_SCRATCH (scratch, secondaries, capacity)
+      || GROW_SCRATCH (scratch, swapchains, capacity)
+      || GROW_SCRATCH (scratch, wait_semaphores, capacity)
+      || GROW_SCRATCH (scratch, wait_stages, capacity)
+      || GROW_SCRATCH (scratch, image_indices, capacity)
+      || GROW_SCRATCH (scratch, present_viewports, capacity)
+      || GROW_SCRATCH (scratch, present_results, capacity)
+      || GROW_SCRATCH (scratch, present_ids, capacity))
+    return 1;
+
+  scratch->capacity = capacity;
+  return 0;
+}
+
+static void
+record_draws (const struct viewport_pass *pass, VkCommandBuffer cmd)
+{
+  renderer_t *ren = pass->ren;
+  struct frame_data *frame = pass->frame;
+
+  int draw_zone
+      = gpu_profiler_begin_subzone (ren->profiler, cmd, "draws", 1,
+                                    viewport_get_view_num (pass->vp));
+
+  for (int i = 0; i < pass->draw_num; i++)
+    {
+      const struct viewport_draw *draw = &pass->draws[i];
+
+      const struct render_context ctx = {
+        .cmd = cmd,
+        .camera = draw->camera,
+        .viewport_index = draw->index,
+        .view_num = viewport_get_view_num (draw->vp),
+        .viewport_set = frame->viewport_set,
+        .viewport_offset = draw->index * ren->viewport_stride,
+        .draws = frame->draws,
+      };
+
+      /* confines atlas viewports to their regions */
+      viewport_set_dynamic_state (draw->vp, cmd);
+      debug_pass_render (ren->debug_pass, &ctx, &frame->debug);
+      mesh_pass_render (ren->mesh_pass, &ctx, &frame->meshes);
+      star_pass_render (ren->star_pass, &ctx, &frame->stars);
+    }
+
+  gpu_profiler_end_zone (ren->profiler, cmd, draw_zone);
+}
+
+static void
+record_viewport_job (void *userdata, int job, VkCommandBuffer cmd)
+{
+  const struct viewport_pass *passes = userdata;
+  record_draws (&passes[job], cmd);
+}
+
+static void
+render_viewport_pass (void *userdata, VkCommandBuffer cmd)
+{
+  const struct viewport_pass *pass = userdata;
+  gpu_profiler_t *profiler = pass->ren->profiler;
+
+  int viewport_zone = gpu_profiler_begin_zone (profiler, cmd, "viewport");
+
+  VkImageView depth_view = VK_NULL_HANDLE;
+  if (pass->depth >= 0)
+    depth_view = render_graph_get_image_view (pass->frame->graph, pass->depth);
+
+  if (pass->secondary != VK_NULL_HANDLE)
+    {
+      viewport_begin_render_pass (
+          pass->vp, cmd, depth_view,
+          VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+      vkCmdExecuteCommands (cmd, 1, &pass->secondary);
+    }
+  else
+    {
+      viewport_begin_render_pass (pass->vp, cmd, depth_view,
+                                  VK_SUBPASS_CONTENTS_INLINE);
+      record_draws (pass, cmd);
+    }
+
+  vkCmdEndRenderPass (cmd);
+
+  gpu_profiler_end_zone (profiler, cmd, viewport_zone);
+}
+
+static void
+readback_viewport_pass (void *userdata, VkCommandBuffer cmd)
+{
+  viewport_t *vp = userdata;
+  viewport_record_readback (vp, cmd);
+}
+
+static void
+upscale_viewport_pass (void *userdata, VkCommandBuffer cmd)
+{
+  const struct viewport_pass *pass = userdata;
+  gpu_profiler_t *profiler = pass->ren->profiler;
+
+  int upscale_zone = gpu_profiler_begin_zone (profiler, cmd, "upscale");
+  viewport_record_upscale (pass->vp, cmd);
+  gpu_profiler_end_zone (profiler, cmd, upscale_zone);
+}
+
+static void
+capture_viewport_pass (void *userdata, VkCommandBuffer cmd)
+{
+  frame_capture_t *cap = userdata;
+  frame_capture_record (cap, cmd);
+}
+
+static void
+cull_stars_pass (void *userdata, VkCommandBuffer cmd)
+{
+  renderer_t *ren = userdata;
+  struct frame_data *frame = &ren->frames[ren->frame_index];
+
+  int cull_zone = gpu_profiler_begin_zone (ren->profiler, cmd, "star cull");
+  star_pass_cull (ren->star_pass, &frame->stars, cmd, frame->viewport_set);
+  gpu_profiler_end_zone (ren->profiler, cmd, cull_zone);
+}
+
+static void
+build_graph (renderer_t *ren, struct frame_data *frame, render_graph_t *graph,
+             int pass_num)
+{
+  const struct render_access color_write = {
+    .stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    .access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT
+              | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+  };
+
+  const struct render_access depth_write = {
+    .stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+             | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+    .access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+              | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+  };
+
+  const struct render_access transfer_read = {
+    .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
+    .access = VK_ACCESS_TRANSFER_READ_BIT,
+    .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+  };
+
+  const struct render_access transfer_write = {
+    .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
+    .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+  };
+
+  const struct render_access blit_write = {
+    .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
+    .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+    .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+  };
+
+  /* swapchain images are waited on at color output by the acquire
+   * semaphore, and offscreen images after their previous frame on the CPU */
+  const struct render_access surface_initial = {
+    .stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+
+  const struct render_access offscreen_initial = {
+    .stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+    .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+
+  const struct render_access surface_final = {
+    .stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+    .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+  };
+
+  const struct render_access readback_final = {
+    .stage = VK_PIPELINE_STAGE_HOST_BIT,
+    .access = VK_ACCESS_HOST_READ_BIT,
+  };
+
+  /* host writes are made visible by the submission itself */
+  const struct render_access host_written = {
+    .stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+  };
+
+  /* only the GPU touches these, and the frame's fence covered last use */
+  const struct render_access gpu_only = {
+    .stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+  };
+
+  const struct render_access compute_write = {
+    .stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    .access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+
+  const struct render_access indirect_read = {
+    .stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+    .access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+  };
+
+  const struct render_access vertex_read = {
+    .stage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+    .access = VK_ACCESS_SHADER_READ_BIT,
+  };
+
+  /* culling fills in draw commands before any viewport is drawn */
+  int commands = -1;
+  int visible_stars = -1;
+  if (star_pass_has_work (ren->star_pass, &frame->stars))
+    {
+      commands = render_graph_import_buffer (
+          graph, indirect_draws_get_commands (frame->draws), &host_written,
+          &indirect_read);
+      visible_stars = render_graph_import_buffer (
+          graph, gpu_vector_get (frame->stars.visible), &gpu_only,
+          &vertex_read);
+
+      int cull
+          = render_graph_add_pass (graph, "star cull", cull_stars_pass, ren);
+      render_graph_write (graph, cull, commands, &compute_write);
+      render_graph_write (graph, cull, visible_stars, &compute_write);
+    }
+
+  for (int i = 0; i < pass_num; i++)
+    {
+      struct viewport_pass *pass = &ren->scratch.passes[i];
+      viewport_t *vp = pass->vp;
+
+      int is_surface = viewport_get_type (vp) == VIEWPORT_TYPE_SURFACE;
+
+      /* offscreen images are left ready to be copied out of */
+      const struct render_access *initial
+          = is_surface ? &surface_initial : &offscreen_initial;
+      const struct render_access *final
+          = is_surface ? &surface_final : &transfer_read;
+
+      int color = render_graph_import_image (graph, viewport_get_image (vp),
+                                             VK_IMAGE_ASPECT_COLOR_BIT,
+                                             initial, final);
+      render_graph_mark_output (graph, color);
+
+      /* dynamic resolution renders into a target of its own, which is then
+       * stretched over the viewport's image */
+      int target = color;
+      VkImage scaled_image = viewport_get_scaled_image (vp);
+      if (scaled_image != VK_NULL_HANDLE)
+        target = render_graph_import_image (graph, scaled_image,
+                                            VK_IMAGE_ASPECT_COLOR_BIT,
+                                            initial, &transfer_read);
+
+      int render = render_graph_add_pass (graph, "viewport",
+                                          render_viewport_pass, pass);
+      render_graph_write (graph, render, target, &color_write);
+
+      /* only lives for the pass, so every viewport's depth shares memory */
+      pass->depth = -1;
+      struct render_image_desc depth_desc;
+      if (viewport_get_depth_desc (vp, &depth_desc))
+        {
+          pass->depth = render_graph_create_image (graph, &depth_desc);
+          render_graph_write (graph, render, pass->depth, &depth_write);
+        }
+
+      if (scaled_image != VK_NULL_HANDLE)
+        {
+          int upscale = render_graph_add_pass (graph, "upscale",
+                                               upscale_viewport_pass, pass);
+          render_graph_read (graph, upscale, target, &transfer_read);
+          render_graph_write (graph, upscale, color, &blit_write);
+        }
+
+      if (commands >= 0)
+        {
+          render_graph_read (graph, render, commands, &indirect_read);
+          render_graph_read (graph, render, visible_stars, &vertex_read);
+        }
+
+      VkBuffer readback_buffer = viewport_get_readback_buffer (vp);
+      if (readback_buffer != VK_NULL_HANDLE)
+        {
+          int readback = render_graph_import_buffer (
+              graph, readback_buffer, &offscreen_initial, &readback_final);
+          render_graph_mark_output (graph, readback);
+
+          int copy = render_graph_add_pass (graph, "readback",
+                                            readback_viewport_pass, vp);
+          render_graph_read (graph, copy, color, &transfer_read);
+          render_graph_write (graph, copy, readback, &transfer_write);
+        }
+
+      for (int j = 0; j < ren->capture_num; j++)
+        {
+          frame_capture_t *cap = ren->captures[j];
+          if (frame_capture_get_viewport (cap) != vp)
+            continue;
+
+          /* busy captures drop the frame rather than stall */
+          VkBuffer capture_buffer = frame_capture_begin (cap);
+          if (capture_buffer == VK_NULL_HANDLE)
+            continue;
+
+          int capture = render_graph_import_buffer (
+              graph, capture_buffer, &offscreen_initial, &readback_final);
+          render_graph_mark_output (graph, capture);
+
+          int copy = render_graph_add_pass (graph, "capture",
+                                            capture_viewport_pass, cap);
+          render_graph_read (graph, copy, color, &transfer_read);
+          render_graph_write (graph, copy, capture, &transfer_write);
+        }
+    }
+}
+
+static struct atlas_batch *
+find_batch (struct frame_scratch *scratch, int batch_num,
+            viewport_atlas_t *atlas)
+{
+  for (int i = 0; i < batch_num; i++)
+    {
+      if (scratch->batches[i].atlas == atlas)
+        return &scratch->batches[i];
+    }
+
+  return NULL;
+}
+
+/* acquires the gathered viewports and lays out this frame's draws and
+ * passes: one pass per ordinary viewport, then one per atlas, whose draws
+ * are kept next to each other
+ * @return the number of passes */
+static int
+acquire_passes (renderer_t *ren, struct frame_data *frame, int viewport_num,
+                int *draw_num)
+{
+  struct frame_scratch *scratch = &ren->scratch;
+  int pass_num = 0;
+  int batch_num = 0;
+  *draw_num = 0;
+
+  for (int i = 0; i < viewport_num; i++)
+    {
+      viewport_t *vp = scratch->viewports[i];
+      viewport_atlas_t *atlas = viewport_get_atlas (vp);
+
+      /* each atlas is only acquired once, however many viewports it has */
+      if (atlas)
+        {
+          if (find_batch (scratch, batch_num, atlas))
+            continue;
+
+          viewport_t *atlas_vp = viewport_atlas_get_viewport (atlas);
+          scratch->batches[batch_num++] = (struct atlas_batch){
+            .atlas = atlas,
+            .is_acquired = viewport_acquire (atlas_vp, ren->frame_index),
+          };
+
+          continue;
+        }
+
+      if (!viewport_acquire (vp, ren->frame_index))
+        continue;
+
+      struct viewport_draw *draw = &scratch->draws[*draw_num];
+      *draw = (struct viewport_draw){
+        .vp = vp,
+        .camera = scratch->cameras[i],
+        .index = *draw_num,
+      };
+
+      scratch->passes[pass_num++] = (struct viewport_pass){
+        .ren = ren,
+        .frame = frame,
+        .vp = vp,
+        .draws = draw,
+        .draw_num = 1,
+        .secondary = VK_NULL_HANDLE,
+      };
+
+      (*draw_num)++;
+    }
+
+  for (int i = 0; i < batch_num; i++)
+    {
+      struct atlas_batch *batch = &scratch->batches[i];
+      if (!batch->is_acquired)
+        continue;
+
+      struct viewport_pass *pass = &scratch->passes[pass_num++];
+      *pass = (struct viewport_pass){
+        .ren = ren,
+        .frame = frame,
+        .vp = viewport_atlas_get_viewport (batch->atlas),
+        .draws = &scratch->draws[*draw_num],
+        .draw_num = 0,
+        .secondary = VK_NULL_HANDLE,
+      };
+
+      for (int j = 0; j < viewport_num; j++)
+        {
+          viewport_t *vp = scratch->viewports[j];
+          if (viewport_get_atlas (vp) != batch->atlas)
+            continue;
+
+          scratch->draws[*draw_num] = (struct viewport_draw){
+            .vp = vp,
+            .camera = scratch->cameras[j],
+            .index = *draw_num,
+          };
+
+          pass->draw_num++;
+          (*draw_num)++;
+        }
+    }
 
-  if (frame->is_in_flight)
-    vkDestroyFence (ren->vkd, frame->is_in_flight, NULL);
+  return pass_num;
 }
 
 int
-renderer_new (renderer_t **new_ren, gpu_device_t *gpu, VkRenderPass rp)
+renderer_new (renderer_t **new_ren, const struct renderer_config *config)
 {
   renderer_t *ren = malloc (sizeof (renderer_t));
   *new_ren = ren;
 
+  gpu_device_t *gpu = config->gpu;
+
   ren->gpu = gpu;
   ren->vkd = gpu_device_get (gpu);
+  ren->timeline = gpu_device_get_timeline (gpu);
+  ren->profiler = NULL;
+  ren->recorder = NULL;
+  ren->resolution = NULL;
+  ren->render_scale = 1.0f;
   ren->viewport_layout = VK_NULL_HANDLE;
+  ren->has_depth = config->has_depth;
+  ren->uniform_scratch = NULL;
+  ren->uniform_scratch_size = 0;
+  frame_scratch_init (&ren->scratch);
   ren->debug_pass = NULL;
+  ren->mesh_pass = NULL;
+  ren->star_pass = NULL;
   ren->frame_index = 0;
   ren->frame_num = 0;
+  ren->latency_mode = config->latency_mode;
+  ren->is_frame_begun = 0;
+  ren->begin_time = 0;
+  ren->stats = (struct renderer_frame_stats){ 0 };
+  ren->frame_stats = config->frame_stats;
+  ren->latency_query_num = 0;
+  ren->has_present_wait = 0;
+  ren->captures = NULL;
+  ren->capture_num = 0;
+  ren->capture_capacity = 0;
+
+  int frame_num = config->frames_in_flight;
+  if (frame_num <= 0)
+    {
+      if (ren->latency_mode == RENDERER_LATENCY_LOW)
+        frame_num = DEFAULT_LOW_LATENCY_FRAMES;
+      else
+        frame_num = DEFAULT_THROUGHPUT_FRAMES;
+    }
+
+  if (frame_num > MAX_FRAMES_IN_FLIGHT)
+    {
+      LOG_WRN ("clamping %d frames in flight to %d", frame_num,
+               MAX_FRAMES_IN_FLIGHT);
+      frame_num = MAX_FRAMES_IN_FLIGHT;
+    }
+
+  const char *mode_name = "throughput";
+  if (ren->latency_mode == RENDERER_LATENCY_LOW)
+    mode_name = "low latency";
+
+  LOG_INF ("rendering with %d frames in flight in %s mode", frame_num,
+           mode_name);
+
+#ifdef VK_KHR_present_wait
+  ren->has_present_wait
+      = gpu_device_has_present_wait (gpu) && vkWaitForPresentKHR != NULL;
+#endif
+
+  if (ren->frame_stats && !ren->has_present_wait)
+    LOG_INF ("present waits unavailable, measuring latency to GPU completion");
 
   int gfx_family = gpu_device_gfx_family (gpu);
   int queue_index = 0;
   vkGetDeviceQueue (ren->vkd, gfx_family, queue_index, &ren->present_queue);
 
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties (gpu_device_get_physical (gpu), &props);
+
+  /* dynamic offsets must be multiples of the device's alignment */
+  VkDeviceSize alignment = props.limits.minUniformBufferOffsetAlignment;
+  VkDeviceSize stride = sizeof (viewport_uniform_t);
+  if (alignment > 0)
+    stride = (stride + alignment - 1) & ~(alignment - 1);
+  ren->viewport_stride = stride;
+
   if (create_viewport_layout (ren))
     return 1;
 
-  if (debug_pass_new (&ren->debug_pass, ren, rp))
+  if (debug_pass_new (&ren->debug_pass, ren, config->rp,
+                      config->multiview_rp, config->debug_vertex_format,
+                      config->debug_vertex_pulling))
     {
       LOG_ERR ("failed to create debug pass");
       return 1;
     }
 
-  for (int i = 0; i < 2; i++)
+  if (mesh_pass_new (&ren->mesh_pass, ren, config->rp, config->multiview_rp))
+    {
+      LOG_ERR ("failed to create mesh pass");
+      return 1;
+    }
+
+  if (star_pass_new (&ren->star_pass, ren, config->rp, config->multiview_rp))
+    {
+      LOG_ERR ("failed to create star pass");
+      return 1;
+    }
+
+  for (int i = 0; i < frame_num; i++)
     {
       ren->frame_num++;
       struct frame_data *frame = &ren->frames[i];
@@ -196,6 +1005,51 @@ renderer_new (renderer_t **new_ren, gpu_device_t *gpu, VkRenderPass rp)
           LOG_ERR ("failed to create debug frame data");
           return 1;
         }
+
+      if (mesh_frame_data_init (ren->mesh_pass, &frame->meshes))
+        {
+          LOG_ERR ("failed to create mesh frame data");
+          return 1;
+        }
+
+      if (star_frame_data_init (ren->star_pass, &frame->stars))
+        {
+          LOG_ERR ("failed to create star frame data");
+          return 1;
+        }
+    }
+
+  if (gpu_profiler_new (&ren->profiler, gpu, ren->present_queue,
+                        ren->frame_num))
+    {
+      LOG_ERR ("failed to create GPU profiler");
+      return 1;
+    }
+
+  struct command_recorder_config recorder_config = {
+    .gpu = gpu,
+    .frame_num = ren->frame_num,
+    .thread_num = -1,
+  };
+
+  if (command_recorder_new (&ren->recorder, &recorder_config))
+    {
+      LOG_ERR ("failed to create command recorder");
+      return 1;
+    }
+
+  if (config->gpu_budget_ms > 0.0f)
+    {
+      struct resolution_controller_config resolution_config = {
+        .budget_ms = config->gpu_budget_ms,
+        .min_scale = config->min_render_scale,
+      };
+
+      if (resolution_controller_new (&ren->resolution, &resolution_config))
+        {
+          LOG_ERR ("failed to create resolution controller");
+          return 1;
+        }
     }
 
   return 0;
@@ -210,14 +1064,35 @@ renderer_delete (renderer_t *ren)
     {
       struct frame_data *frame = &ren->frames[i];
       debug_frame_data_cleanup (ren->debug_pass, &frame->debug);
+      mesh_frame_data_cleanup (ren->mesh_pass, &frame->meshes);
+      star_frame_data_cleanup (ren->star_pass, &frame->stars);
       frame_data_cleanup (ren, frame);
     }
 
+  if (ren->recorder)
+    command_recorder_delete (ren->recorder);
+
+  if (ren->profiler)
+    gpu_profiler_delete (ren->profiler);
+
+  if (ren->resolution)
+    resolution_controller_delete (ren->resolution);
+
   debug_pass_delete (ren->debug_pass);
+  mesh_pass_delete (ren->mesh_pass);
+  star_pass_delete (ren->star_pass);
 
   if (ren->viewport_layout)
     vkDestroyDescriptorSetLayout (ren->vkd, ren->viewport_layout, NULL);
 
+  if (ren->uniform_scratch)
+    free (ren->uniform_scratch);
+
+  frame_scratch_cleanup (&ren->scratch);
+
+  if (ren->captures)
+    free (ren->captures);
+
   free (ren);
 }
 
@@ -239,14 +1114,88 @@ renderer_get_viewport_layout (renderer_t *ren)
   return ren->viewport_layout;
 }
 
+int
+renderer_has_depth (renderer_t *ren)
+{
+  return ren->has_depth;
+}
+
+int
+renderer_add_capture (renderer_t *ren, frame_capture_t *cap)
+{
+  if (ren->capture_num == ren->capture_capacity)
+    {
+      int capacity = ren->capture_capacity > 0 ? ren->capture_capacity * 2 : 4;
+      if (grow_array ((void **)&ren->captures, sizeof (frame_capture_t *),
+                      capacity))
+        {
+          LOG_ERR ("failed to add capture");
+          return 1;
+        }
+
+      ren->capture_capacity = capacity;
+    }
+
+  ren->captures[ren->capture_num++] = cap;
+  return 0;
+}
+
 void
-renderer_render_frame (renderer_t *ren, camera_t **cameras, int camera_num)
+renderer_remove_capture (renderer_t *ren, frame_capture_t *cap)
 {
-  if (camera_num > MAX_CAMERA_NUM)
+  for (int i = 0; i < ren->capture_num; i++)
     {
-      LOG_ERR ("too many cameras (how did you even do that?)");
+      if (ren->captures[i] != cap)
+        continue;
+
+      ren->captures[i] = ren->captures[--ren->capture_num];
       return;
     }
+}
+
+int
+renderer_set_debug_vertex_format (renderer_t *ren,
+                                  enum debug_vertex_format format)
+{
+  return debug_pass_set_format (ren->debug_pass, format);
+}
+
+int
+renderer_set_stars (renderer_t *ren, const star_instance_t *stars,
+                    uint32_t star_num)
+{
+  return star_pass_set_stars (ren->star_pass, stars, star_num);
+}
+
+int
+renderer_load_meshes (renderer_t *ren, const char *path)
+{
+  return mesh_pass_load (ren->mesh_pass, path);
+}
+
+uint32_t
+renderer_get_mesh_num (renderer_t *ren)
+{
+  return mesh_pass_get_mesh_num (ren->mesh_pass);
+}
+
+int
+renderer_set_mesh_instances (renderer_t *ren,
+                             const mesh_instance_t *instances,
+                             uint32_t instance_num)
+{
+  return mesh_pass_set_instances (ren->mesh_pass, instances, instance_num);
+}
+
+void
+renderer_begin_frame (renderer_t *ren)
+{
+  if (ren->is_frame_begun)
+    return;
+
+  uint64_t wait_start = uv_hrtime ();
+  resolve_latency (ren);
+  begin_stage (ren, FRAME_STAGE_WAIT);
 
   ren->frame_index++;
   if (ren->frame_index >= ren->frame_num)
@@ -254,113 +1203,262 @@ renderer_render_frame (renderer_t *ren, camera_t **cameras, int camera_num)
 
   struct frame_data *frame = &ren->frames[ren->frame_index];
 
-  vkWaitForFences (ren->vkd, 1, &frame->is_in_flight, VK_TRUE, UINT64_MAX);
-  vkResetFences (ren->vkd, 1, &frame->is_in_flight);
-  vkResetCommandPool (ren->vkd, frame->command_pool, 0);
-  vkResetDescriptorPool (ren->vkd, frame->descriptor_pool, 0);
+  uint64_t pending = gpu_timeline_pending (ren->timeline);
+  int queued_frames = pending - gpu_timeline_completed (ren->timeline);
+
+  /* low latency keeps the CPU from running ahead of the GPU at all, so input
+   * is sampled as late as it can be */
+  uint64_t wait_value = frame->timeline_value;
+  if (ren->latency_mode == RENDERER_LATENCY_LOW)
+    wait_value = pending;
+
+  if (gpu_timeline_wait (ren->timeline, wait_value, UINT64_MAX))
+    {
+      LOG_ERR ("failed to wait for frame to finish");
+      return;
+    }
+
+  end_stage (ren, FRAME_STAGE_WAIT);
+  resolve_latency (ren);
+
+  gpu_timeline_collect (ren->timeline);
+
+  /* after deferred deletions, so their memory isn't counted as pressure */
+  gpu_memory_update (gpu_device_get_memory (ren->gpu));
+
+  command_recorder_begin_frame (ren->recorder, ren->frame_index);
+
+  uint64_t now = uv_hrtime ();
+  struct renderer_frame_stats *stats = &ren->stats;
+
+  stats->frame++;
+  stats->wait_ms = (now - wait_start) / 1000000.0;
+  stats->queued_frames = queued_frames;
+
+  if (ren->begin_time > 0)
+    stats->frame_time_ms = (now - ren->begin_time) / 1000000.0;
+
+  ren->begin_time = now;
+  ren->is_frame_begun = 1;
+}
+
+/* a frame that fails before it's submitted still has to hand back what it
+ * acquired. The primary is ended if it's recording, and the acquire
+ * semaphores are waited on by an empty batch so they're unsignaled by the
+ * time their slot comes around again.
+ * @param cmd The recording primary, or VK_NULL_HANDLE. */
+static void
+abandon_frame (renderer_t *ren, struct frame_data *frame, int pass_num,
+               VkCommandBuffer cmd)
+{
+  if (cmd != VK_NULL_HANDLE)
+    vkEndCommandBuffer (cmd);
+
+  struct frame_scratch *scratch = &ren->scratch;
+  int wait_semaphore_num = 0;
+  for (int i = 0; i < pass_num; i++)
+    {
+      viewport_t *vp = scratch->passes[i].vp;
+      if (viewport_get_swapchain (vp) == VK_NULL_HANDLE)
+        continue;
+
+      viewport_abandon_image (vp);
+
+      VkSemaphore wait_semaphore = viewport_get_on_acquire (vp);
+      if (wait_semaphore == VK_NULL_HANDLE)
+        continue;
+
+      scratch->wait_stages[wait_semaphore_num]
+          = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      scratch->wait_semaphores[wait_semaphore_num] = wait_semaphore;
+      wait_semaphore_num++;
+    }
+
+  if (wait_semaphore_num == 0)
+    return;
+
+  /* signals the timeline too, so retired swapchains and the frame's slot
+   * wait for the semaphores to be consumed */
+  uint64_t timeline_value = gpu_timeline_next (ren->timeline);
+  VkSemaphore timeline_semaphore = gpu_timeline_get_semaphore (ren->timeline);
+
+  VkTimelineSemaphoreSubmitInfo timeline_info = {
+    .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+    .signalSemaphoreValueCount = 1,
+    .pSignalSemaphoreValues = &timeline_value,
+  };
+
+  VkSubmitInfo submit_info = {
+    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .pNext = &timeline_info,
+    .waitSemaphoreCount = wait_semaphore_num,
+    .pWaitSemaphores = scratch->wait_semaphores,
+    .pWaitDstStageMask = scratch->wait_stages,
+    .signalSemaphoreCount = 1,
+    .pSignalSemaphores = &timeline_semaphore,
+  };
+
+  if (vkQueueSubmit (ren->present_queue, 1, &submit_info, VK_NULL_HANDLE)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to release an abandoned frame's semaphores");
+      gpu_timeline_cancel (ren->timeline, timeline_value);
+      return;
+    }
+
+  frame->timeline_value = timeline_value;
+}
+
+void
+renderer_render_frame (renderer_t *ren, camera_t **cameras, int camera_num)
+{
+  renderer_begin_frame (ren);
+  if (!ren->is_frame_begun)
+    return;
+
+  /* the frame is over from here on, whether or not it gets submitted */
+  ren->is_frame_begun = 0;
+
+  uint64_t record_start = uv_hrtime ();
+  struct frame_data *frame = &ren->frames[ren->frame_index];
+
+  begin_stage (ren, FRAME_STAGE_ACQUIRE);
+
+  struct frame_scratch *scratch = &ren->scratch;
 
   int viewport_num = 0;
-  viewport_t *viewports[MAX_VIEWPORT_NUM];
-  camera_t *viewport_cameras[MAX_VIEWPORT_NUM];
   for (int i = 0; i < camera_num; i++)
     {
-      int acquired_num = camera_acquire (cameras[i], &viewports[viewport_num]);
+      if (frame_scratch_reserve (scratch,
+                                 viewport_num + MAX_VIEWPORTS_PER_CAMERA))
+        {
+          LOG_ERR ("failed to allocate frame scratch");
+          abandon_frame (ren, frame, 0, VK_NULL_HANDLE);
+          return;
+        }
+
+      viewport_t **viewports = &scratch->viewports[viewport_num];
+      int acquired_num = camera_acquire (cameras[i], viewports);
 
       for (int j = 0; j < acquired_num; j++)
-        viewport_cameras[j + viewport_num] = cameras[j];
+        scratch->cameras[j + viewport_num] = cameras[i];
 
       viewport_num += acquired_num;
     }
 
-  int acquired_num = 0;
-  for (int i = 0; i < viewport_num; i++)
+  int draw_num = 0;
+  int pass_num = acquire_passes (ren, frame, viewport_num, &draw_num);
+
+  end_stage (ren, FRAME_STAGE_ACQUIRE);
+  begin_stage (ren, FRAME_STAGE_EXTRACT);
+
+  /* scales apply to whole images, so they're set before any draws that
+   * depend on the render size are laid out */
+  if (ren->resolution)
     {
-      if (viewport_acquire (viewports[i]))
-        {
-          viewports[acquired_num] = viewports[i];
-          acquired_num++;
-        }
+      const struct gpu_frame_stats *gpu_stats
+          = gpu_profiler_get_stats (ren->profiler);
+      ren->render_scale
+          = resolution_controller_update (ren->resolution, gpu_stats);
+
+      for (int i = 0; i < pass_num; i++)
+        viewport_set_render_scale (scratch->passes[i].vp, ren->render_scale);
     }
 
-  /* cull out unacquired viewports */
-  viewport_num = acquired_num;
+  ren->stats.render_scale = ren->render_scale;
 
-  viewport_uniform_t viewport_uniforms[MAX_VIEWPORT_NUM];
-  for (int i = 0; i < viewport_num; i++)
+  size_t stride = ren->viewport_stride;
+  char *uniforms = reserve_uniform_scratch (ren, stride * draw_num);
+  if (draw_num > 0 && !uniforms)
     {
-      viewport_write_uniform (viewports[i], &viewport_uniforms[i]);
+      LOG_ERR ("failed to allocate viewport uniforms");
+      abandon_frame (ren, frame, pass_num, VK_NULL_HANDLE);
+      return;
     }
 
-  gpu_vector_write (frame->viewport_buf, viewport_uniforms, viewport_num,
-                    sizeof (viewport_uniform_t));
+  indirect_draws_clear (frame->draws);
+  star_pass_prepare (ren->star_pass, &frame->stars);
 
-  VkDescriptorSetAllocateInfo alloc_info = {
-    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-    .descriptorPool = frame->descriptor_pool,
-    .descriptorSetCount = 1,
-    .pSetLayouts = &ren->viewport_layout,
-  };
+  for (int i = 0; i < draw_num; i++)
+    {
+      viewport_t *vp = scratch->draws[i].vp;
 
-  vkAllocateDescriptorSets (ren->vkd, &alloc_info, &frame->viewport_set);
+      /* scratch offsets may not satisfy cglm's alignment, so go via stack */
+      viewport_uniform_t uniform;
+      viewport_write_uniform (vp, &uniform);
 
-  VkDescriptorBufferInfo vp_buf = {
-    .buffer = gpu_vector_get (frame->viewport_buf),
-    .offset = 0,
-    /*.range = gpu_vector_size (frame->viewport_buf),*/
-    .range = sizeof (viewport_uniform_t),
-  };
+      /* only the views the viewport has are written */
+      size_t size = viewport_get_view_num (vp) * sizeof (viewport_view_t);
+      memcpy (&uniforms[i * stride], &uniform, size);
 
-  VkWriteDescriptorSet write_info = {
-    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .dstSet = frame->viewport_set,
-    .dstBinding = 0,
-    .descriptorCount = 1,
-    .pBufferInfo = &vp_buf,
-  };
+      star_pass_add_viewport (ren->star_pass, &frame->stars, frame->draws, vp,
+                              i * stride);
+    }
 
-  vkUpdateDescriptorSets (ren->vkd, 1, &write_info, 0, NULL);
+  gpu_vector_write (frame->viewport_buf, uniforms, stride, draw_num);
+  update_viewport_set (ren, frame);
 
-  int swapchain_num = 0;
-  VkSwapchainKHR swapchains[MAX_VIEWPORT_NUM];
+  debug_pass_prepare (ren->debug_pass, &frame->debug, frame->draws);
+  mesh_pass_prepare (ren->mesh_pass, &frame->meshes, frame->draws);
 
-  int wait_semaphore_num = 0;
-  VkSemaphore wait_semaphores[MAX_VIEWPORT_NUM];
-  VkPipelineStageFlags wait_stage_flags[MAX_VIEWPORT_NUM];
+  if (indirect_draws_upload (frame->draws))
+    {
+      LOG_ERR ("failed to upload indirect draws");
+      abandon_frame (ren, frame, pass_num, VK_NULL_HANDLE);
+      return;
+    }
 
-  uint32_t image_indices[MAX_VIEWPORT_NUM];
+  /* the upload may have moved the command buffer */
+  if (star_pass_update (ren->star_pass, &frame->stars, frame->draws))
+    {
+      LOG_ERR ("failed to update star pass");
+      abandon_frame (ren, frame, pass_num, VK_NULL_HANDLE);
+      return;
+    }
 
-  for (int i = 0; i < viewport_num; i++)
+  int swapchain_num = 0;
+  int wait_semaphore_num = 0;
+  for (int i = 0; i < pass_num; i++)
     {
-      VkSwapchainKHR swapchain = viewport_get_swapchain (viewports[i]);
-      if (swapchain != VK_NULL_HANDLE)
+      viewport_t *vp = scratch->passes[i].vp;
+
+      VkSwapchainKHR swapchain = viewport_get_swapchain (vp);
+      if (swapchain == VK_NULL_HANDLE)
+        continue;
+
+      VkSemaphore wait_semaphore = viewport_get_on_acquire (vp);
+      if (wait_semaphore != VK_NULL_HANDLE)
         {
-          VkSemaphore wait_semaphore = viewport_get_on_acquire (viewports[i]);
-          if (wait_semaphore != VK_NULL_HANDLE)
-            {
-              wait_stage_flags[wait_semaphore_num]
-                  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-              wait_semaphores[wait_semaphore_num] = wait_semaphore;
-              wait_semaphore_num++;
-            }
-
-          image_indices[swapchain_num]
-              = viewport_get_image_index (viewports[i]);
-          swapchains[swapchain_num] = swapchain;
-          swapchain_num++;
+          scratch->wait_stages[wait_semaphore_num]
+              = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+          scratch->wait_semaphores[wait_semaphore_num] = wait_semaphore;
+          wait_semaphore_num++;
         }
+
+      scratch->image_indices[swapchain_num] = viewport_get_image_index (vp);
+      scratch->swapchains[swapchain_num] = swapchain;
+      scratch->present_viewports[swapchain_num] = vp;
+      swapchain_num++;
     }
 
-  VkCommandBuffer cmd;
+  for (int i = 0; i < ren->capture_num; i++)
+    frame_capture_poll (ren->captures[i]);
 
-  VkCommandBufferAllocateInfo cmd_info = {
-    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-    .commandPool = frame->command_pool,
-    .commandBufferCount = 1,
-    .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-  };
+  render_graph_t *graph = frame->graph;
+  render_graph_reset (graph);
+  build_graph (ren, frame, graph, pass_num);
 
-  vkAllocateCommandBuffers (ren->vkd, &cmd_info, &cmd);
+  if (render_graph_compile (graph))
+    {
+      LOG_ERR ("failed to compile render graph");
+      abandon_frame (ren, frame, pass_num, VK_NULL_HANDLE);
+      return;
+    }
+
+  end_stage (ren, FRAME_STAGE_EXTRACT);
+  begin_stage (ren, FRAME_STAGE_RECORD);
+
+  VkCommandBuffer cmd = command_recorder_get_primary (ren->recorder);
 
   VkCommandBufferBeginInfo begin_info = {
     .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -369,36 +1467,126 @@ renderer_render_frame (renderer_t *ren, camera_t **cameras, int camera_num)
 
   vkBeginCommandBuffer (cmd, &begin_info);
 
-  for (int i = 0; i < viewport_num; i++)
-    {
-      viewport_begin_render_pass (viewports[i], cmd);
+  gpu_profiler_begin_frame (ren->profiler, cmd, ren->frame_index);
 
-      const struct render_context ctx = {
-        .cmd = cmd,
-        .camera = viewport_cameras[i],
-        .viewport_index = i,
-        .viewport_set = frame->viewport_set,
-      };
+  if (ren->resolution)
+    resolution_controller_mark_frame (ren->resolution,
+                                      gpu_profiler_get_frame (ren->profiler),
+                                      ren->render_scale);
 
-      debug_pass_render (ren->debug_pass, &ctx, &frame->debug);
+  int is_parallel = command_recorder_thread_num (ren->recorder) > 0
+                    && pass_num >= PARALLEL_PASS_MIN;
+
+  if (is_parallel)
+    {
+      for (int i = 0; i < pass_num; i++)
+        {
+          viewport_t *vp = scratch->passes[i].vp;
+
+          scratch->inheritance[i] = (VkCommandBufferInheritanceInfo){
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .renderPass = viewport_get_render_pass (vp),
+            .subpass = 0,
+            .framebuffer = viewport_get_framebuffer (vp),
+          };
+        }
 
-      vkCmdEndRenderPass (cmd);
+      /* the profiler's frame must already have begun, since secondaries
+       * allocate their zones from it */
+      if (command_recorder_record (ren->recorder, pass_num,
+                                   scratch->inheritance, record_viewport_job,
+                                   scratch->passes, scratch->secondaries))
+        {
+          LOG_ERR ("failed to record viewports");
+          abandon_frame (ren, frame, pass_num, cmd);
+          return;
+        }
+
+      for (int i = 0; i < pass_num; i++)
+        scratch->passes[i].secondary = scratch->secondaries[i];
     }
 
+  render_graph_execute (graph, cmd);
+
+  gpu_profiler_end_frame (ren->profiler, cmd);
+
   vkEndCommandBuffer (cmd);
 
+  end_stage (ren, FRAME_STAGE_RECORD);
+  begin_stage (ren, FRAME_STAGE_SUBMIT);
+
+  uint64_t timeline_value = gpu_timeline_next (ren->timeline);
+
+  VkSemaphore signal_semaphores[2] = {
+    frame->on_finished,
+    gpu_timeline_get_semaphore (ren->timeline),
+  };
+
+  /* the binary semaphore's value is ignored */
+  uint64_t signal_values[2] = { 0, timeline_value };
+
+  VkTimelineSemaphoreSubmitInfo timeline_info = {
+    .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+    .signalSemaphoreValueCount = 2,
+    .pSignalSemaphoreValues = signal_values,
+  };
+
   VkSubmitInfo submit_info = {
     .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .pNext = &timeline_info,
     .waitSemaphoreCount = wait_semaphore_num,
-    .pWaitSemaphores = wait_semaphores,
-    .pWaitDstStageMask = wait_stage_flags,
+    .pWaitSemaphores = scratch->wait_semaphores,
+    .pWaitDstStageMask = scratch->wait_stages,
     .commandBufferCount = 1,
     .pCommandBuffers = &cmd,
-    .signalSemaphoreCount = 1,
-    .pSignalSemaphores = &frame->on_finished,
+    .signalSemaphoreCount = 2,
+    .pSignalSemaphores = signal_semaphores,
+  };
+
+  if (vkQueueSubmit (ren->present_queue, 1, &submit_info, VK_NULL_HANDLE)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to submit frame");
+      gpu_timeline_cancel (ren->timeline, timeline_value);
+      abandon_frame (ren, frame, pass_num, VK_NULL_HANDLE);
+      return;
+    }
+
+  /* the frame's slot is only waited on once its value will be signaled */
+  frame->timeline_value = timeline_value;
+
+  end_stage (ren, FRAME_STAGE_SUBMIT);
+
+  for (int i = 0; i < pass_num; i++)
+    viewport_mark_submitted (scratch->passes[i].vp, frame->timeline_value);
+
+  for (int i = 0; i < ren->capture_num; i++)
+    frame_capture_mark_submitted (ren->captures[i], frame->timeline_value);
+
+  /* present IDs only need to increase, so the frame's ID will do */
+  uint64_t stats_frame = 0;
+  if (ren->frame_stats)
+    stats_frame = frame_stats_current (ren->frame_stats);
+
+  struct latency_query query = {
+    .frame = stats_frame,
+    .timeline_value = frame->timeline_value,
+    .is_complete = 0,
+    .present_id = 0,
+    .vp = NULL,
+    .swapchain = VK_NULL_HANDLE,
   };
 
-  vkQueueSubmit (ren->present_queue, 1, &submit_info, frame->is_in_flight);
+  if (ren->has_present_wait && swapchain_num > 0)
+    {
+      query.present_id = stats_frame;
+      query.vp = scratch->present_viewports[0];
+      query.swapchain = scratch->swapchains[0];
+    }
+
+  uint64_t submit_time = uv_hrtime ();
+  ren->stats.record_ms = (submit_time - record_start) / 1000000.0;
+  ren->stats.input_to_submit_ms = (submit_time - ren->begin_time) / 1000000.0;
 
   if (swapchain_num > 0)
     {
@@ -407,15 +1595,58 @@ renderer_render_frame (renderer_t *ren, camera_t **cameras, int camera_num)
         .waitSemaphoreCount = 1,
         .pWaitSemaphores = &frame->on_finished,
         .swapchainCount = swapchain_num,
-        .pSwapchains = swapchains,
-        .pImageIndices = image_indices,
+        .pSwapchains = scratch->swapchains,
+        .pImageIndices = scratch->image_indices,
+        .pResults = scratch->present_results,
       };
 
-      if (vkQueuePresentKHR (ren->present_queue, &present_info) != VK_SUCCESS)
-        {
-          LOG_ERR ("failed to present to swapchains");
-        }
+#ifdef VK_KHR_present_id
+      for (int i = 0; i < swapchain_num; i++)
+        scratch->present_ids[i] = query.present_id;
+
+      VkPresentIdKHR present_id_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .swapchainCount = swapchain_num,
+        .pPresentIds = scratch->present_ids,
+      };
+
+      if (query.present_id != 0)
+        present_info.pNext = &present_id_info;
+#endif
+
+      begin_stage (ren, FRAME_STAGE_PRESENT);
+      vkQueuePresentKHR (ren->present_queue, &present_info);
+      end_stage (ren, FRAME_STAGE_PRESENT);
+
+      /* stale swapchains are recreated when they're next acquired */
+      for (int i = 0; i < swapchain_num; i++)
+        viewport_present_result (scratch->present_viewports[i],
+                                 scratch->present_results[i]);
+    }
+
+  if (stats_frame != 0)
+    {
+      add_latency_query (ren, &query);
+      resolve_latency (ren);
     }
 
   TracyCFrameMarkNamed ("render");
 }
+
+uint64_t
+renderer_get_frame_value (renderer_t *ren)
+{
+  return ren->frames[ren->frame_index].timeline_value;
+}
+
+const struct gpu_frame_stats *
+renderer_get_gpu_stats (renderer_t *ren)
+{
+  return gpu_profiler_get_stats (ren->profiler);
+}
+
+const struct renderer_frame_stats *
+renderer_get_frame_stats (renderer_t *ren)
+{
+  return &ren->stats;
+}
@@ -0,0 +1,157 @@
+/** @file resolution_controller.c
+ */
+
+#include "renderer/resolution_controller.h"
+
+#include "log.h"
+
+#include <math.h> /* for sqrtf, fabsf */
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdlib.h> /* for mem alloc */
+
+#define DEFAULT_MIN_SCALE 0.5f
+#define MAX_SCALE 1.0f
+
+/* must be longer than the GPU profiler lags behind */
+#define HISTORY_SIZE 16
+
+/* aim a little under budget, so noise doesn't push frames over */
+#define HEADROOM 0.9f
+
+/* how much of the gap to a cheaper full-resolution estimate is closed per
+ * frame; costlier estimates are taken right away */
+#define COST_SMOOTHING 0.1f
+
+/* the most the scale may grow by in one frame */
+#define MAX_SCALE_STEP 0.02f
+
+/* changes smaller than this aren't worth the blurrier image */
+#define SCALE_DEADBAND 0.01f
+
+struct scale_record
+{
+  uint64_t frame;
+  float scale;
+};
+
+struct resolution_controller_s
+{
+  float budget_ms;
+  float min_scale;
+  float scale;
+
+  /* smoothed estimate of a frame's GPU time at full resolution */
+  float full_ms;
+
+  uint64_t last_frame;
+  struct scale_record history[HISTORY_SIZE];
+};
+
+int
+resolution_controller_new (resolution_controller_t **new_rc,
+                           const struct resolution_controller_config *config)
+{
+  resolution_controller_t *rc = malloc (sizeof (resolution_controller_t));
+  *new_rc = rc;
+
+  rc->budget_ms = config->budget_ms;
+  rc->min_scale = config->min_scale;
+  rc->scale = MAX_SCALE;
+  rc->full_ms = 0.0f;
+  rc->last_frame = 0;
+
+  for (int i = 0; i < HISTORY_SIZE; i++)
+    rc->history[i] = (struct scale_record){ 0 };
+
+  if (rc->min_scale <= 0.0f)
+    rc->min_scale = DEFAULT_MIN_SCALE;
+
+  if (rc->budget_ms <= 0.0f)
+    {
+      LOG_ERR ("GPU time budget must be positive");
+      return 1;
+    }
+
+  if (rc->min_scale > MAX_SCALE)
+    {
+      LOG_ERR ("minimum render scale must be at most %.1f", MAX_SCALE);
+      return 1;
+    }
+
+  LOG_INF ("scaling resolution to fit a %.2fms GPU budget", rc->budget_ms);
+  return 0;
+}
+
+void
+resolution_controller_delete (resolution_controller_t *rc)
+{
+  free (rc);
+}
+
+static float
+find_scale (resolution_controller_t *rc, uint64_t frame)
+{
+  struct scale_record *record = &rc->history[frame % HISTORY_SIZE];
+  if (record->frame != frame)
+    return rc->scale;
+
+  return record->scale;
+}
+
+float
+resolution_controller_update (resolution_controller_t *rc,
+                              const struct gpu_frame_stats *stats)
+{
+  if (stats->frame == 0 || stats->frame <= rc->last_frame)
+    return rc->scale;
+
+  rc->last_frame = stats->frame;
+
+  if (stats->gpu_time_ms <= 0.0)
+    return rc->scale;
+
+  float used_scale = find_scale (rc, stats->frame);
+  float full_ms = stats->gpu_time_ms / (used_scale * used_scale);
+
+  if (rc->full_ms <= 0.0f || full_ms > rc->full_ms)
+    rc->full_ms = full_ms;
+  else
+    rc->full_ms += (full_ms - rc->full_ms) * COST_SMOOTHING;
+
+  float target = sqrtf (rc->budget_ms * HEADROOM / rc->full_ms);
+
+  if (target > rc->scale + MAX_SCALE_STEP)
+    target = rc->scale + MAX_SCALE_STEP;
+
+  if (target < rc->min_scale)
+    target = rc->min_scale;
+  else if (target > MAX_SCALE)
+    target = MAX_SCALE;
+
+  /* the clamps are always allowed through, so the limits can be reached */
+  float change = fabsf (target - rc->scale);
+  if (change >= SCALE_DEADBAND || target == rc->min_scale
+      || target == MAX_SCALE)
+    rc->scale = target;
+
+  return rc->scale;
+}
+
+void
+resolution_controller_mark_frame (resolution_controller_t *rc,
+                                  uint64_t frame, float scale)
+{
+  if (frame == 0)
+    return;
+
+  rc->history[frame % HISTORY_SIZE] = (struct scale_record){
+    .frame = frame,
+    .scale = scale,
+  };
+}
+
+float
+resolution_controller_get_scale (resolution_controller_t *rc)
+{
+  return rc->scale;
+}
@@ -0,0 +1,773 @@
+/** @file star_pass.c
+ */
+
+#include "renderer/stars/star_pass.h"
+
+#include "gpu/gpu_device.h"
+#include "gpu/gpu_push_constants.h"
+#include "gpu/gpu_shader.h"
+#include "gpu/gpu_staging.h"
+#include "log.h"
+
+/* TODO(marceline-cramer): custom mem alloc */
+#include <stdlib.h> /* for mem alloc */
+#include <vulkan/vulkan_core.h>
+
+/* the preferred culling workgroup size, lowered to fit the device */
+#define CULL_GROUP_SIZE 256
+
+/* specialization constant IDs in star_cull.comp */
+#define CULL_GROUP_SIZE_ID 0
+
+/* the minimum guaranteed maxComputeWorkGroupCount */
+#define MAX_GROUP_COUNT 65535
+
+/* stars with a smaller on-screen radius than this, in pixels, are culled */
+#define MIN_PIXEL_SIZE 0.25f
+
+/* the most stars one draw can show; any more surviving culling are dropped,
+ * instead of every draw reserving room for the whole catalog */
+#define MAX_VISIBLE_STARS (1 << 17)
+
+/* matches StarConstants in the star shaders */
+struct star_constants
+{
+  uint32_t star_num;
+  uint32_t visible_base;
+  uint32_t command_index;
+  uint32_t view_num;
+  float min_pixel_size;
+  float viewport_height;
+  uint32_t visible_capacity;
+};
+
+struct star_pass_s
+{
+  renderer_t *ren;
+  gpu_device_t *gpu;
+  VkDevice vkd;
+
+  gpu_vector_t *instances;
+  uint32_t star_num;
+
+  /* the two triangles of every star's quad */
+  gpu_vector_t *quad_indices;
+
+  gpu_shader_t *cull_shader;
+  gpu_shader_t *vertex_shader;
+  gpu_shader_t *multiview_vertex_shader;
+  gpu_shader_t *fragment_shader;
+
+  VkDescriptorSetLayout set_layout;
+  VkPipelineLayout pipeline_layout;
+  struct gpu_push_block constants_block;
+  VkPipeline cull_pipeline;
+  uint32_t cull_group_size;
+  VkPipeline pipeline;
+  VkPipeline multiview_pipeline;
+};
+
+static const VkShaderStageFlags CONSTANT_STAGES
+    = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+
+static int
+create_set_layout (star_pass_t *sp)
+{
+  VkDescriptorSetLayoutBinding bindings[3];
+
+  /* stars */
+  bindings[0] = (VkDescriptorSetLayoutBinding){
+    .binding = 0,
+    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 1,
+    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+  };
+
+  /* visible star indices */
+  bindings[1] = (VkDescriptorSetLayoutBinding){
+    .binding = 1,
+    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 1,
+    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+  };
+
+  /* indirect draw commands */
+  bindings[2] = (VkDescriptorSetLayoutBinding){
+    .binding = 2,
+    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 1,
+    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+  };
+
+  VkDescriptorSetLayoutCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .bindingCount = 3,
+    .pBindings = bindings,
+  };
+
+  if (vkCreateDescriptorSetLayout (sp->vkd, &ci, NULL, &sp->set_layout)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create star descriptor set layout");
+      return 1;
+    }
+
+  return 0;
+}
+
+static int
+create_pipeline_layout (star_pass_t *sp)
+{
+  VkDescriptorSetLayout layouts[2];
+
+  layouts[0] = renderer_get_viewport_layout (sp->ren);
+  layouts[1] = sp->set_layout;
+
+  struct gpu_push_layout push_layout;
+  gpu_push_layout_init (&push_layout);
+  if (gpu_push_layout_add (&push_layout, CONSTANT_STAGES,
+                           sizeof (struct star_constants),
+                           &sp->constants_block))
+    return 1;
+
+  /* shared by culling and drawing, so they can share descriptor sets */
+  VkPipelineLayoutCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    .setLayoutCount = 2,
+    .pSetLayouts = layouts,
+    .pushConstantRangeCount = push_layout.range_num,
+    .pPushConstantRanges = push_layout.ranges,
+  };
+
+  if (vkCreatePipelineLayout (sp->vkd, &ci, NULL, &sp->pipeline_layout)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create star pipeline layout");
+      return 1;
+    }
+
+  return 0;
+}
+
+static int
+load_shader (star_pass_t *sp, gpu_shader_t **shader,
+             VkShaderStageFlags stage, const char *path)
+{
+  if (gpu_shader_new (shader, sp->gpu, stage))
+    {
+      LOG_ERR ("failed to create shader");
+      return 1;
+    }
+
+  if (gpu_shader_load_from_file (*shader, path))
+    return 1;
+
+  return 0;
+}
+
+static int
+load_shaders (star_pass_t *sp, int is_multiview)
+{
+  static const char *CULL_SOURCE = "./shaders/star_cull.comp.spv";
+  static const char *VERTEX_SOURCE = "./shaders/star.vert.spv";
+  static const char *MULTIVIEW_VERTEX_SOURCE
+      = "./shaders/star_multiview.vert.spv";
+  static const char *FRAGMENT_SOURCE = "./shaders/star.frag.spv";
+
+  if (load_shader (sp, &sp->cull_shader, VK_SHADER_STAGE_COMPUTE_BIT,
+                   CULL_SOURCE))
+    return 1;
+
+  if (load_shader (sp, &sp->vertex_shader, VK_SHADER_STAGE_VERTEX_BIT,
+                   VERTEX_SOURCE))
+    return 1;
+
+  if (is_multiview
+      && load_shader (sp, &sp->multiview_vertex_shader,
+                      VK_SHADER_STAGE_VERTEX_BIT, MULTIVIEW_VERTEX_SOURCE))
+    return 1;
+
+  if (load_shader (sp, &sp->fragment_shader, VK_SHADER_STAGE_FRAGMENT_BIT,
+                   FRAGMENT_SOURCE))
+    return 1;
+
+  return 0;
+}
+
+static uint32_t
+choose_cull_group_size (star_pass_t *sp)
+{
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties (gpu_device_get_physical (sp->gpu), &props);
+
+  uint32_t size = CULL_GROUP_SIZE;
+  if (size > props.limits.maxComputeWorkGroupSize[0])
+    size = props.limits.maxComputeWorkGroupSize[0];
+  if (size > props.limits.maxComputeWorkGroupInvocations)
+    size = props.limits.maxComputeWorkGroupInvocations;
+
+  return size;
+}
+
+static int
+create_cull_pipeline (star_pass_t *sp)
+{
+  sp->cull_group_size = choose_cull_group_size (sp);
+
+  struct gpu_specialization spec;
+  gpu_specialization_init (&spec);
+  gpu_specialization_set_uint (&spec, CULL_GROUP_SIZE_ID,
+                               sp->cull_group_size);
+
+  VkComputePipelineCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+    .layout = sp->pipeline_layout,
+  };
+
+  gpu_shader_get_specialized (sp->cull_shader, &spec, &ci.stage);
+
+  VkPipelineCache cache = gpu_device_get_pipeline_cache (sp->gpu);
+  if (vkCreateComputePipelines (sp->vkd, cache, 1, &ci, NULL,
+                                &sp->cull_pipeline)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create star culling pipeline");
+      return 1;
+    }
+
+  return 0;
+}
+
+static int
+create_pipeline (star_pass_t *sp, VkRenderPass rp,
+                 gpu_shader_t *vertex_shader, VkPipeline *pipeline)
+{
+  VkPipelineShaderStageCreateInfo shader_stages[2];
+  gpu_shader_get (vertex_shader, &shader_stages[0]);
+  gpu_shader_get (sp->fragment_shader, &shader_stages[1]);
+
+  /* stars are pulled from storage buffers by instance index */
+  VkPipelineVertexInputStateCreateInfo vertex_input_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+  };
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+    .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+  };
+
+  VkViewport viewport = { 0 };
+  VkRect2D scissor = { 0 };
+
+  VkPipelineViewportStateCreateInfo viewport_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+    .viewportCount = 1,
+    .pViewports = &viewport,
+    .scissorCount = 1,
+    .pScissors = &scissor,
+  };
+
+  VkPipelineRasterizationStateCreateInfo rasterization_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+    .polygonMode = VK_POLYGON_MODE_FILL,
+    .cullMode = VK_CULL_MODE_NONE,
+    .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+    .lineWidth = 1.0,
+  };
+
+  VkPipelineMultisampleStateCreateInfo multisample_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+    .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+  };
+
+  /* stars are hidden behind nearer geometry, but being additive, they
+   * don't write depth and hide each other */
+  VkPipelineDepthStencilStateCreateInfo depth_stencil_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+    .depthTestEnable = renderer_has_depth (sp->ren) ? VK_TRUE : VK_FALSE,
+    .depthWriteEnable = VK_FALSE,
+    .depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL,
+  };
+
+  /* overlapping stars add up instead of occluding each other */
+  VkPipelineColorBlendAttachmentState color_blend_attachment = {
+    .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+                      | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    .blendEnable = VK_TRUE,
+    .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+    .dstColorBlendFactor = VK_BLEND_FACTOR_ONE,
+    .colorBlendOp = VK_BLEND_OP_ADD,
+    .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+    .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+    .alphaBlendOp = VK_BLEND_OP_ADD,
+  };
+
+  VkPipelineColorBlendStateCreateInfo color_blend_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+    .attachmentCount = 1,
+    .pAttachments = &color_blend_attachment,
+  };
+
+  VkDynamicState dynamic_states[]
+      = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+  VkPipelineDynamicStateCreateInfo dynamic_state = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+    .dynamicStateCount = 2,
+    .pDynamicStates = dynamic_states,
+  };
+
+  VkGraphicsPipelineCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+    .stageCount = 2,
+    .pStages = shader_stages,
+    .pVertexInputState = &vertex_input_state,
+    .pInputAssemblyState = &input_assembly_state,
+    .pViewportState = &viewport_state,
+    .pRasterizationState = &rasterization_state,
+    .pMultisampleState = &multisample_state,
+    .pDepthStencilState = &depth_stencil_state,
+    .pColorBlendState = &color_blend_state,
+    .pDynamicState = &dynamic_state,
+    .layout = sp->pipeline_layout,
+    .renderPass = rp,
+    .subpass = 0,
+  };
+
+  VkPipelineCache cache = gpu_device_get_pipeline_cache (sp->gpu);
+  if (vkCreateGraphicsPipelines (sp->vkd, cache, 1, &ci, NULL, pipeline)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create star pipeline");
+      return 1;
+    }
+
+  return 0;
+}
+
+int
+star_pass_new (star_pass_t **new_sp, renderer_t *ren, VkRenderPass rp,
+               VkRenderPass multiview_rp)
+{
+  star_pass_t *sp = malloc (sizeof (star_pass_t));
+  *new_sp = sp;
+
+  sp->ren = ren;
+  sp->gpu = renderer_get_gpu (ren);
+  sp->vkd = gpu_device_get (sp->gpu);
+
+  sp->instances = NULL;
+  sp->star_num = 0;
+  sp->quad_indices = NULL;
+
+  sp->cull_shader = NULL;
+  sp->vertex_shader = NULL;
+  sp->multiview_vertex_shader = NULL;
+  sp->fragment_shader = NULL;
+
+  sp->set_layout = VK_NULL_HANDLE;
+  sp->pipeline_layout = VK_NULL_HANDLE;
+  sp->constants_block = (struct gpu_push_block){ 0 };
+  sp->cull_pipeline = VK_NULL_HANDLE;
+  sp->cull_group_size = CULL_GROUP_SIZE;
+  sp->pipeline = VK_NULL_HANDLE;
+  sp->multiview_pipeline = VK_NULL_HANDLE;
+
+  if (gpu_vector_new_device_local (&sp->instances, sp->gpu,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   GPU_MEMORY_INSTANCES))
+    {
+      LOG_ERR ("failed to create star buffer");
+      return 1;
+    }
+
+  if (gpu_vector_new (&sp->quad_indices, sp->gpu,
+                      VK_BUFFER_USAGE_INDEX_BUFFER_BIT, GPU_MEMORY_GEOMETRY))
+    {
+      LOG_ERR ("failed to create star index buffer");
+      return 1;
+    }
+
+  const uint32_t QUAD_INDICES[] = { 0, 1, 2, 2, 1, 3 };
+  if (gpu_vector_write (sp->quad_indices, QUAD_INDICES, sizeof (uint32_t), 6))
+    return 1;
+
+  if (load_shaders (sp, multiview_rp != VK_NULL_HANDLE))
+    return 1;
+
+  if (create_set_layout (sp))
+    return 1;
+
+  if (create_pipeline_layout (sp))
+    return 1;
+
+  if (create_cull_pipeline (sp))
+    return 1;
+
+  if (rp != VK_NULL_HANDLE
+      && create_pipeline (sp, rp, sp->vertex_shader, &sp->pipeline))
+    return 1;
+
+  if (multiview_rp != VK_NULL_HANDLE
+      && create_pipeline (sp, multiview_rp, sp->multiview_vertex_shader,
+                          &sp->multiview_pipeline))
+    return 1;
+
+  return 0;
+}
+
+void
+star_pass_delete (star_pass_t *sp)
+{
+  if (sp->cull_pipeline)
+    vkDestroyPipeline (sp->vkd, sp->cull_pipeline, NULL);
+
+  if (sp->pipeline)
+    vkDestroyPipeline (sp->vkd, sp->pipeline, NULL);
+
+  if (sp->multiview_pipeline)
+    vkDestroyPipeline (sp->vkd, sp->multiview_pipeline, NULL);
+
+  if (sp->pipeline_layout)
+    vkDestroyPipelineLayout (sp->vkd, sp->pipeline_layout, NULL);
+
+  if (sp->set_layout)
+    vkDestroyDescriptorSetLayout (sp->vkd, sp->set_layout, NULL);
+
+  if (sp->cull_shader)
+    gpu_shader_delete (sp->cull_shader);
+
+  if (sp->vertex_shader)
+    gpu_shader_delete (sp->vertex_shader);
+
+  if (sp->multiview_vertex_shader)
+    gpu_shader_delete (sp->multiview_vertex_shader);
+
+  if (sp->fragment_shader)
+    gpu_shader_delete (sp->fragment_shader);
+
+  if (sp->instances)
+    gpu_vector_delete (sp->instances);
+
+  if (sp->quad_indices)
+    gpu_vector_delete (sp->quad_indices);
+
+  free (sp);
+}
+
+int
+star_pass_set_stars (star_pass_t *sp, const star_instance_t *stars,
+                     uint32_t star_num)
+{
+  /* every frame in flight reads the same star buffer */
+  vkDeviceWaitIdle (sp->vkd);
+
+  sp->star_num = 0;
+  if (star_num == 0)
+    return 0;
+
+  size_t size = star_num * sizeof (star_instance_t);
+  if (gpu_vector_reserve (sp->instances, size))
+    {
+      LOG_ERR ("failed to reserve star buffer");
+      return 1;
+    }
+
+  struct gpu_staging_config staging_config = {
+    .gpu = sp->gpu,
+  };
+
+  gpu_staging_t *staging;
+  if (gpu_staging_new (&staging, &staging_config))
+    {
+      LOG_ERR ("failed to create star staging");
+      gpu_staging_delete (staging);
+      return 1;
+    }
+
+  int result = 0;
+  if (gpu_staging_upload (staging, gpu_vector_get (sp->instances), 0, stars,
+                          size))
+    {
+      LOG_ERR ("failed to upload stars");
+      result = 1;
+    }
+
+  /* flushes the last chunk and waits for the copies */
+  gpu_staging_delete (staging);
+
+  if (!result)
+    sp->star_num = star_num;
+
+  return result;
+}
+
+int
+star_frame_data_init (star_pass_t *sp, struct star_frame_data *frame)
+{
+  frame->visible = NULL;
+  frame->descriptor_pool = VK_NULL_HANDLE;
+  frame->set = VK_NULL_HANDLE;
+  frame->draws = NULL;
+  frame->draw_num = 0;
+  frame->draw_capacity = 0;
+  frame->star_num = 0;
+  frame->visible_capacity = 0;
+
+  if (gpu_vector_new_device_local (&frame->visible, sp->gpu,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   GPU_MEMORY_INSTANCES))
+    {
+      LOG_ERR ("failed to create visible star buffer");
+      return 1;
+    }
+
+  VkDescriptorPoolSize pool_size = {
+    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptorCount = 3,
+  };
+
+  VkDescriptorPoolCreateInfo dp_ci = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+    .maxSets = 1,
+    .poolSizeCount = 1,
+    .pPoolSizes = &pool_size,
+  };
+
+  if (vkCreateDescriptorPool (sp->vkd, &dp_ci, NULL, &frame->descriptor_pool)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create star descriptor pool");
+      return 1;
+    }
+
+  VkDescriptorSetAllocateInfo alloc_info = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    .descriptorPool = frame->descriptor_pool,
+    .descriptorSetCount = 1,
+    .pSetLayouts = &sp->set_layout,
+  };
+
+  if (vkAllocateDescriptorSets (sp->vkd, &alloc_info, &frame->set)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to allocate star descriptor set");
+      return 1;
+    }
+
+  return 0;
+}
+
+void
+star_frame_data_cleanup (star_pass_t *sp, struct star_frame_data *frame)
+{
+  if (frame->descriptor_pool)
+    vkDestroyDescriptorPool (sp->vkd, frame->descriptor_pool, NULL);
+
+  if (frame->visible)
+    gpu_vector_delete (frame->visible);
+
+  if (frame->draws)
+    free (frame->draws);
+}
+
+void
+star_pass_prepare (star_pass_t *sp, struct star_frame_data *frame)
+{
+  frame->draw_num = 0;
+  frame->star_num = sp->star_num;
+
+  frame->visible_capacity = sp->star_num;
+  if (frame->visible_capacity > MAX_VISIBLE_STARS)
+    frame->visible_capacity = MAX_VISIBLE_STARS;
+}
+
+void
+star_pass_add_viewport (star_pass_t *sp, struct star_frame_data *frame,
+                        indirect_draws_t *draws, viewport_t *vp,
+                        uint32_t viewport_offset)
+{
+  if (frame->star_num == 0)
+    return;
+
+  if (frame->draw_num == frame->draw_capacity)
+    {
+      int capacity = frame->draw_capacity > 0 ? frame->draw_capacity * 2 : 16;
+      struct star_draw *new_draws
+          = realloc (frame->draws, capacity * sizeof (struct star_draw));
+      if (!new_draws)
+        {
+          LOG_ERR ("failed to allocate star draw");
+          return;
+        }
+
+      frame->draws = new_draws;
+      frame->draw_capacity = capacity;
+    }
+
+  struct star_draw *draw = &frame->draws[frame->draw_num++];
+  draw->batch = -1;
+  draw->viewport_offset = viewport_offset;
+  draw->view_num = viewport_get_view_num (vp);
+  draw->viewport_height = viewport_get_render_extent (vp).height;
+
+  /* instances are counted up by culling */
+  VkDrawIndexedIndirectCommand command = {
+    .indexCount = 6,
+    .instanceCount = 0,
+    .firstIndex = 0,
+    .vertexOffset = 0,
+    .firstInstance = 0,
+  };
+
+  int batch = indirect_draws_begin_batch (draws);
+  if (batch < 0 || indirect_draws_add (draws, &command))
+    {
+      LOG_ERR ("failed to add star draw");
+      return;
+    }
+
+  draw->batch = batch;
+  draw->command_index = indirect_draws_get_first (draws, batch);
+}
+
+int
+star_pass_update (star_pass_t *sp, struct star_frame_data *frame,
+                  indirect_draws_t *draws)
+{
+  if (!star_pass_has_work (sp, frame))
+    return 0;
+
+  size_t visible_size = (size_t)frame->visible_capacity * frame->draw_num
+                        * sizeof (uint32_t);
+  if (gpu_vector_reserve (frame->visible, visible_size))
+    {
+      LOG_ERR ("failed to reserve visible star buffer");
+      return 1;
+    }
+
+  VkDescriptorBufferInfo buffer_infos[3];
+
+  buffer_infos[0] = (VkDescriptorBufferInfo){
+    .buffer = gpu_vector_get (sp->instances),
+    .offset = 0,
+    .range = VK_WHOLE_SIZE,
+  };
+
+  buffer_infos[1] = (VkDescriptorBufferInfo){
+    .buffer = gpu_vector_get (frame->visible),
+    .offset = 0,
+    .range = VK_WHOLE_SIZE,
+  };
+
+  buffer_infos[2] = (VkDescriptorBufferInfo){
+    .buffer = indirect_draws_get_commands (draws),
+    .offset = 0,
+    .range = VK_WHOLE_SIZE,
+  };
+
+  VkWriteDescriptorSet writes[3];
+  for (int i = 0; i < 3; i++)
+    {
+      writes[i] = (VkWriteDescriptorSet){
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = frame->set,
+        .dstBinding = i,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffer_infos[i],
+      };
+    }
+
+  vkUpdateDescriptorSets (sp->vkd, 3, writes, 0, NULL);
+  return 0;
+}
+
+int
+star_pass_has_work (star_pass_t *sp, struct star_frame_data *frame)
+{
+  return frame->star_num > 0 && frame->draw_num > 0;
+}
+
+void
+star_pass_cull (star_pass_t *sp, struct star_frame_data *frame,
+                VkCommandBuffer cmd, VkDescriptorSet viewport_set)
+{
+  if (!star_pass_has_work (sp, frame))
+    return;
+
+  uint32_t group_size = sp->cull_group_size;
+  uint32_t group_num = (frame->star_num + group_size - 1) / group_size;
+  uint32_t group_x = group_num < MAX_GROUP_COUNT ? group_num : MAX_GROUP_COUNT;
+  uint32_t group_y = (group_num + group_x - 1) / group_x;
+
+  vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE, sp->cull_pipeline);
+  vkCmdBindDescriptorSets (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           sp->pipeline_layout, 1, 1, &frame->set, 0, NULL);
+
+  for (int i = 0; i < frame->draw_num; i++)
+    {
+      const struct star_draw *draw = &frame->draws[i];
+      if (draw->batch < 0)
+        continue;
+
+      vkCmdBindDescriptorSets (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                               sp->pipeline_layout, 0, 1, &viewport_set, 1,
+                               &draw->viewport_offset);
+
+      struct star_constants constants = {
+        .star_num = frame->star_num,
+        .visible_base = i * frame->visible_capacity,
+        .command_index = draw->command_index,
+        .view_num = draw->view_num,
+        .min_pixel_size = MIN_PIXEL_SIZE,
+        .viewport_height = draw->viewport_height,
+        .visible_capacity = frame->visible_capacity,
+      };
+
+      GPU_PUSH_BLOCK (cmd, sp->pipeline_layout, &sp->constants_block,
+                      &constants);
+      vkCmdDispatch (cmd, group_x, group_y, 1);
+    }
+}
+
+void
+star_pass_render (star_pass_t *sp, const struct render_context *ctx,
+                  struct star_frame_data *frame)
+{
+  if (ctx->viewport_index >= frame->draw_num)
+    return;
+
+  const struct star_draw *draw = &frame->draws[ctx->viewport_index];
+  if (draw->batch < 0)
+    return;
+
+  VkPipeline pipeline = sp->pipeline;
+  if (ctx->view_num > 1)
+    pipeline = sp->multiview_pipeline;
+
+  /* no pipeline was made for this kind of render pass */
+  if (pipeline == VK_NULL_HANDLE)
+    return;
+
+  VkDescriptorSet sets[2] = { ctx->viewport_set, frame->set };
+  vkCmdBindDescriptorSets (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           sp->pipeline_layout, 0, 2, sets, 1,
+                           &ctx->viewport_offset);
+
+  vkCmdBindPipeline (ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+  struct star_constants constants = {
+    .star_num = frame->star_num,
+    .visible_base = ctx->viewport_index * frame->visible_capacity,
+  };
+
+  GPU_PUSH_BLOCK (ctx->cmd, sp->pipeline_layout, &sp->constants_block,
+                  &constants);
+
+  VkBuffer index_buffer = gpu_vector_get (sp->quad_indices);
+  vkCmdBindIndexBuffer (ctx->cmd, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+  indirect_draws_record (ctx->draws, ctx->cmd, draw->batch);
+}
@@ -3,9 +3,15 @@
 
 #include "renderer/viewport.h"
 
+#include "gpu/gpu_debug.h"
 #include "gpu/gpu_device.h"
+#include "gpu/gpu_memory.h"
+#include "gpu/gpu_timeline.h"
+#include "gpu/gpu_vector.h"
 #include "log.h"
+#include "renderer/render_graph.h"
 #include "renderer/render_phases.h"
+#include "renderer/viewport_atlas.h"
 
 #include <cglm/mat4.h>
 /* TODO(marceline-cramer): mdo_allocator */
@@ -14,12 +20,35 @@
 #include <vulkan/vulkan_core.h>
 
 #define MAX_IMAGE_NUM 8
+#define DEFAULT_OFFSCREEN_IMAGE_NUM 2
+#define DEFAULT_SURFACE_IMAGE_NUM 3
+#define MAX_PRESENT_MODE_NUM 16
+#define MIN_RENDER_SCALE 0.25f
+
+#define SCALED_USAGE                                                         \
+  (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+
+/* transient, so tilers that support lazy allocation never back it */
+#define DEPTH_USAGE                                                          \
+  (VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT                               \
+   | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
 
 struct vp_image
 {
   VkImage image;
   VkImageView image_view;
-  VkFramebuffer framebuffer;
+
+  /* offscreen-only */
+  VkDeviceMemory memory;
+  gpu_vector_t *readback;
+
+  /* dynamic resolution only; what's actually rendered into */
+  VkImage scaled_image;
+  VkDeviceMemory scaled_memory;
+  VkImageView scaled_view;
+
+  /* GPU timeline value at which rendering to this image finishes */
+  uint64_t frame_value;
 };
 
 struct viewport_s
@@ -27,50 +56,185 @@ struct viewport_s
   gpu_device_t *gpu;
   VkDevice vkd;
   VkRenderPass rp;
+  enum viewport_type type;
+  int readback;
+
+  /* dynamic resolution is turned off if the image can't be blitted into */
+  int wants_dynamic;
+  int is_dynamic;
+  float render_scale;
+
+  /* surface-only */
+  VkSurfaceKHR surface;
   VkSwapchainKHR swapchain;
+  enum viewport_present_mode present_mode;
+  int requested_image_num;
+  int needs_recreate;
+  int is_copyable;
+
+  /* atlas-only */
+  viewport_atlas_t *atlas;
+  VkRect2D atlas_rect;
 
   int width;
   int height;
+  int view_num;
+  float eye_separation;
+
+  /* the depth image itself is a render graph transient */
+  VkFormat depth_format;
+
+  /* imageless, so one framebuffer serves every image */
+  VkImageUsageFlags color_usage;
+  VkFramebuffer framebuffer;
 
   struct vp_image images[MAX_IMAGE_NUM];
   int image_num;
   int image_index;
 
+  /* one per renderer frame slot, so a semaphore is only reused once the
+   * submission that waited on it has finished */
   VkSemaphore on_image_acquire[MAX_FRAMES_IN_FLIGHT];
   int image_acquire_index;
 };
 
-static int
-surface_init (viewport_t *vp, const struct viewport_config *config)
+/* a swapchain's leftovers, destroyed once the GPU stops using them */
+struct retired_swapchain
 {
-  LOG_INF ("creating surface-based viewport");
+  VkDevice vkd;
+  gpu_memory_t *tracker;
+  VkSwapchainKHR swapchain;
+  VkImageView image_views[MAX_IMAGE_NUM];
+  VkImage scaled_images[MAX_IMAGE_NUM];
+  VkDeviceMemory scaled_memories[MAX_IMAGE_NUM];
+  VkImageView scaled_views[MAX_IMAGE_NUM];
+  VkFramebuffer framebuffer;
+  int image_num;
+};
 
-  VkPhysicalDevice vkpd = gpu_device_get_physical (vp->gpu);
-  int gfx_family = gpu_device_gfx_family (vp->gpu);
-  VkSurfaceKHR surface = config->sub.surface.surface;
-  VkBool32 supported;
-  vkGetPhysicalDeviceSurfaceSupportKHR (vkpd, gfx_family, surface, &supported);
-  if (supported != VK_TRUE)
+static const char *
+present_mode_name (VkPresentModeKHR mode)
+{
+  switch (mode)
     {
-      LOG_ERR ("surface is unsupported on this queue family");
-      return 1;
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+      return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+      return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+      return "relaxed FIFO";
+    default:
+      return "unknown";
+    }
+}
+
+static VkPresentModeKHR
+choose_present_mode (viewport_t *vp, VkPhysicalDevice vkpd)
+{
+  VkPresentModeKHR modes[MAX_PRESENT_MODE_NUM];
+  uint32_t mode_num = MAX_PRESENT_MODE_NUM;
+  vkGetPhysicalDeviceSurfacePresentModesKHR (vkpd, vp->surface, &mode_num,
+                                             modes);
+
+  /* FIFO is always supported, so every list ends with it; mailbox falls back
+   * to FIFO rather than tearing */
+  VkPresentModeKHR preferences[3];
+  int preference_num = 0;
+
+  switch (vp->present_mode)
+    {
+    case VIEWPORT_PRESENT_MODE_IMMEDIATE:
+      preferences[preference_num++] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+      preferences[preference_num++] = VK_PRESENT_MODE_MAILBOX_KHR;
+      break;
+    case VIEWPORT_PRESENT_MODE_MAILBOX:
+      preferences[preference_num++] = VK_PRESENT_MODE_MAILBOX_KHR;
+      break;
+    default:
+      break;
+    }
+
+  preferences[preference_num++] = VK_PRESENT_MODE_FIFO_KHR;
+
+  for (int i = 0; i < preference_num; i++)
+    {
+      for (uint32_t j = 0; j < mode_num; j++)
+        {
+          if (modes[j] == preferences[i])
+            return preferences[i];
+        }
     }
 
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static int
+choose_image_num (viewport_t *vp, const VkSurfaceCapabilitiesKHR *caps)
+{
+  int image_num = vp->requested_image_num;
+  if (image_num <= 0)
+    image_num = DEFAULT_SURFACE_IMAGE_NUM;
+
+  if (image_num < caps->minImageCount)
+    image_num = caps->minImageCount;
+
+  /* a max of zero means there is no limit */
+  if (caps->maxImageCount > 0 && image_num > caps->maxImageCount)
+    image_num = caps->maxImageCount;
+
+  if (image_num > MAX_IMAGE_NUM)
+    image_num = MAX_IMAGE_NUM;
+
+  return image_num;
+}
+
+/* creates a new swapchain, retiring the current one if there is one
+ * @return 1 on failure, -1 if the surface has no area to present to */
+static int
+create_swapchain (viewport_t *vp)
+{
+  VkPhysicalDevice vkpd = gpu_device_get_physical (vp->gpu);
+
   VkSurfaceCapabilitiesKHR caps;
-  if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR (vkpd, surface, &caps)
+  if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR (vkpd, vp->surface, &caps)
       != VK_SUCCESS)
     {
       LOG_ERR ("failed to get surface capabilities");
       return 1;
     }
 
-  int image_count = caps.minImageCount;
-  if (image_count < 3)
-    image_count = 3;
+  /* the surface decides the extent unless it leaves it up to us */
+  if (caps.currentExtent.width != UINT32_MAX)
+    {
+      vp->width = caps.currentExtent.width;
+      vp->height = caps.currentExtent.height;
+    }
+
+  /* minimized windows can't be presented to until they come back */
+  if (vp->width == 0 || vp->height == 0)
+    return -1;
+
+  VkPresentModeKHR present_mode = choose_present_mode (vp, vkpd);
+  int image_count = choose_image_num (vp, &caps);
+
+  VkSwapchainKHR old_swapchain = vp->swapchain;
+  vp->is_copyable = (caps.supportedUsageFlags
+                     & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+                    != 0;
+
+  int is_blittable = (caps.supportedUsageFlags
+                      & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+                     != 0;
+  if (vp->wants_dynamic && !is_blittable && !vp->is_dynamic)
+    LOG_WRN ("surface can't be blitted to; disabling dynamic resolution");
+
+  vp->is_dynamic = vp->wants_dynamic && is_blittable;
 
   VkSwapchainCreateInfoKHR ci = {
     .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-    .surface = surface,
+    .surface = vp->surface,
     .minImageCount = image_count,
 
     /* TODO(marceline-cramer): autoselect */
@@ -78,25 +242,34 @@ surface_init (viewport_t *vp, const struct viewport_config *config)
     .imageColorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR,
 
     .imageExtent = {
-      .width = config->width,
-      .height = config->height,
+      .width = vp->width,
+      .height = vp->height,
     },
 
     .imageArrayLayers = 1,
-    .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+
+    /* copyable where possible, so the window can be captured, and
+     * blittable, so it can be upscaled into */
+    .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                  | (caps.supportedUsageFlags
+                     & (VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+                        | (vp->is_dynamic ? VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                                          : 0))),
     .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
     .preTransform = caps.currentTransform,
     .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-
-    /* TODO(marceline-cramer): autoselect */
-    .presentMode = VK_PRESENT_MODE_FIFO_KHR,
-
+    .presentMode = present_mode,
     .clipped = VK_TRUE,
-    .oldSwapchain = VK_NULL_HANDLE,
+    .oldSwapchain = old_swapchain,
   };
 
-  if (vkCreateSwapchainKHR (vp->vkd, &ci, NULL, &vp->swapchain) != VK_SUCCESS)
+  VkResult result
+      = vkCreateSwapchainKHR (vp->vkd, &ci, NULL, &vp->swapchain);
+
+  if (result != VK_SUCCESS)
     {
+      /* the old swapchain is retired either way */
+      vp->swapchain = VK_NULL_HANDLE;
       LOG_ERR ("failed to create swapchain");
       return 1;
     }
@@ -110,9 +283,321 @@ surface_init (viewport_t *vp, const struct viewport_config *config)
       return 1;
     }
 
+  vp->color_usage = ci.imageUsage;
   vp->image_num = image_num;
+  vp->image_index = -1;
   for (int i = 0; i < image_num; i++)
-    vp->images[i].image = images[i];
+    {
+      vp->images[i].image = images[i];
+      vp->images[i].image_view = VK_NULL_HANDLE;
+      vp->images[i].scaled_image = VK_NULL_HANDLE;
+      vp->images[i].scaled_memory = VK_NULL_HANDLE;
+      vp->images[i].scaled_view = VK_NULL_HANDLE;
+    }
+
+  LOG_INF ("created %dx%d swapchain with %d images in %s mode", vp->width,
+           vp->height, vp->image_num, present_mode_name (present_mode));
+
+  return 0;
+}
+
+static int
+surface_init (viewport_t *vp, const struct viewport_config *config)
+{
+  LOG_INF ("creating surface-based viewport");
+
+  vp->surface = config->sub.surface.surface;
+  vp->present_mode = config->sub.surface.present_mode;
+  vp->requested_image_num = config->sub.surface.image_num;
+
+  VkPhysicalDevice vkpd = gpu_device_get_physical (vp->gpu);
+  int gfx_family = gpu_device_gfx_family (vp->gpu);
+  VkBool32 supported;
+  vkGetPhysicalDeviceSurfaceSupportKHR (vkpd, gfx_family, vp->surface,
+                                        &supported);
+  if (supported != VK_TRUE)
+    {
+      LOG_ERR ("surface is unsupported on this queue family");
+      return 1;
+    }
+
+  int result = create_swapchain (vp);
+  if (result > 0)
+    return 1;
+
+  /* starting out minimized just delays the swapchain */
+  if (result < 0)
+    vp->needs_recreate = 1;
+
+  return 0;
+}
+
+static int
+offscreen_init (viewport_t *vp, const struct viewport_config *config)
+{
+  LOG_INF ("creating offscreen viewport");
+
+  const struct viewport_offscreen_config *offscreen = &config->sub.offscreen;
+
+  int image_num = offscreen->image_num;
+  if (image_num <= 0)
+    image_num = DEFAULT_OFFSCREEN_IMAGE_NUM;
+
+  if (image_num > MAX_IMAGE_NUM)
+    {
+      LOG_ERR ("too many offscreen images");
+      return 1;
+    }
+
+  vp->readback = offscreen->readback;
+
+  VkImageCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .imageType = VK_IMAGE_TYPE_2D,
+    /* TODO(marceline-cramer): autoselect */
+    .format = VK_FORMAT_B8G8R8A8_SRGB,
+    .extent = {
+      .width = vp->width,
+      .height = vp->height,
+      .depth = 1,
+    },
+    .mipLevels = 1,
+    .arrayLayers = vp->view_num,
+    .samples = VK_SAMPLE_COUNT_1_BIT,
+    .tiling = VK_IMAGE_TILING_OPTIMAL,
+    .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+             | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+             | (vp->is_dynamic ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0),
+    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+
+  vp->color_usage = ci.usage;
+
+  for (int i = 0; i < image_num; i++)
+    {
+      struct vp_image *image = &vp->images[i];
+      vp->image_num++;
+
+      if (vkCreateImage (vp->vkd, &ci, NULL, &image->image) != VK_SUCCESS)
+        {
+          LOG_ERR ("failed to create offscreen image");
+          return 1;
+        }
+
+      gpu_debug_set_name (vp->gpu, VK_OBJECT_TYPE_IMAGE,
+                          (uint64_t)image->image, "viewport offscreen image");
+
+      VkMemoryRequirements reqs;
+      vkGetImageMemoryRequirements (vp->vkd, image->image, &reqs);
+
+      int memory_type = gpu_device_find_memory_type (
+          vp->gpu, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      if (memory_type < 0)
+        return 1;
+
+      VkMemoryAllocateInfo ai = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = reqs.size,
+        .memoryTypeIndex = memory_type,
+      };
+
+      if (gpu_memory_allocate (gpu_device_get_memory (vp->gpu), &ai,
+                               GPU_MEMORY_RENDER_TARGETS, &image->memory))
+        {
+          LOG_ERR ("failed to allocate offscreen image memory");
+          return 1;
+        }
+
+      if (vkBindImageMemory (vp->vkd, image->image, image->memory, 0)
+          != VK_SUCCESS)
+        {
+          LOG_ERR ("failed to bind offscreen image memory");
+          return 1;
+        }
+
+      if (!vp->readback)
+        continue;
+
+      const VkBufferUsageFlags READBACK_USAGE
+          = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+      if (gpu_vector_new (&image->readback, vp->gpu, READBACK_USAGE,
+                          GPU_MEMORY_READBACK))
+        {
+          LOG_ERR ("failed to create readback buffer");
+          return 1;
+        }
+
+      size_t readback_size = vp->width * vp->height * 4 * vp->view_num;
+      if (gpu_vector_reserve (image->readback, readback_size))
+        {
+          LOG_ERR ("failed to reserve readback buffer");
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+static int
+atlas_init (viewport_t *vp, const struct viewport_config *config)
+{
+  vp->atlas = config->sub.atlas.atlas;
+  if (!vp->atlas)
+    {
+      LOG_ERR ("atlas viewport has no atlas");
+      return 1;
+    }
+
+  if (viewport_atlas_allocate (vp->atlas, vp->width, vp->height,
+                               &vp->atlas_rect))
+    {
+      vp->atlas = NULL;
+      return 1;
+    }
+
+  return 0;
+}
+
+/* full-size, so changing the scale only changes how much of it is used */
+static int
+create_scaled_image (viewport_t *vp, struct vp_image *image,
+                     VkImageViewType view_type)
+{
+  VkImageCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .imageType = VK_IMAGE_TYPE_2D,
+    /* TODO(marceline-cramer): autoselect */
+    .format = VK_FORMAT_B8G8R8A8_SRGB,
+    .extent = {
+      .width = vp->width,
+      .height = vp->height,
+      .depth = 1,
+    },
+    .mipLevels = 1,
+    .arrayLayers = vp->view_num,
+    .samples = VK_SAMPLE_COUNT_1_BIT,
+    .tiling = VK_IMAGE_TILING_OPTIMAL,
+    .usage = SCALED_USAGE,
+    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+
+  if (vkCreateImage (vp->vkd, &ci, NULL, &image->scaled_image) != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create scaled image");
+      return 1;
+    }
+
+  gpu_debug_set_name (vp->gpu, VK_OBJECT_TYPE_IMAGE,
+                      (uint64_t)image->scaled_image, "viewport scaled image");
+
+  VkMemoryRequirements reqs;
+  vkGetImageMemoryRequirements (vp->vkd, image->scaled_image, &reqs);
+
+  int memory_type = gpu_device_find_memory_type (
+      vp->gpu, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (memory_type < 0)
+    return 1;
+
+  VkMemoryAllocateInfo ai = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+    .allocationSize = reqs.size,
+    .memoryTypeIndex = memory_type,
+  };
+
+  if (gpu_memory_allocate (gpu_device_get_memory (vp->gpu), &ai,
+                           GPU_MEMORY_RENDER_TARGETS, &image->scaled_memory))
+    {
+      LOG_ERR ("failed to allocate scaled image memory");
+      return 1;
+    }
+
+  if (vkBindImageMemory (vp->vkd, image->scaled_image, image->scaled_memory,
+                         0)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to bind scaled image memory");
+      return 1;
+    }
+
+  VkImageViewCreateInfo view_ci = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+    .image = image->scaled_image,
+    .viewType = view_type,
+    .format = VK_FORMAT_B8G8R8A8_SRGB,
+    .subresourceRange = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = vp->view_num,
+    },};
+
+  if (vkCreateImageView (vp->vkd, &view_ci, NULL, &image->scaled_view)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create scaled image view");
+      return 1;
+    }
+
+  return 0;
+}
+
+/* imageless, so the framebuffer only describes its attachments and the
+ * views themselves are passed when the render pass begins */
+static int
+create_framebuffer (viewport_t *vp, VkRenderPass rp)
+{
+  const VkFormat color_format = VK_FORMAT_B8G8R8A8_SRGB;
+
+  VkFramebufferAttachmentImageInfo attachment_infos[2] = {
+    {
+      .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO,
+      .usage = vp->is_dynamic ? SCALED_USAGE : vp->color_usage,
+      .width = vp->width,
+      .height = vp->height,
+      .layerCount = vp->view_num,
+      .viewFormatCount = 1,
+      .pViewFormats = &color_format,
+    },
+    {
+      .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO,
+      .usage = DEPTH_USAGE,
+      .width = vp->width,
+      .height = vp->height,
+      .layerCount = vp->view_num,
+      .viewFormatCount = 1,
+      .pViewFormats = &vp->depth_format,
+    },
+  };
+
+  int has_depth = vp->depth_format != VK_FORMAT_UNDEFINED;
+
+  VkFramebufferAttachmentsCreateInfo attachments_ci = {
+    .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO,
+    .attachmentImageInfoCount = has_depth ? 2 : 1,
+    .pAttachmentImageInfos = attachment_infos,
+  };
+
+  /* multiview framebuffers have one layer, whatever the view count */
+  VkFramebufferCreateInfo ci = {
+    .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+    .pNext = &attachments_ci,
+    .flags = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT,
+    .renderPass = rp,
+    .attachmentCount = has_depth ? 2 : 1,
+    .width = vp->width,
+    .height = vp->height,
+    .layers = 1,
+  };
+
+  if (vkCreateFramebuffer (vp->vkd, &ci, NULL, &vp->framebuffer)
+      != VK_SUCCESS)
+    {
+      LOG_ERR ("failed to create framebuffer");
+      return 1;
+    }
 
   return 0;
 }
@@ -120,12 +605,24 @@ surface_init (viewport_t *vp, const struct viewport_config *config)
 static int
 create_images (viewport_t *vp, VkRenderPass rp)
 {
+  /* atlas viewports are rendered through the atlas's own viewport */
+  if (vp->image_num == 0)
+    return 0;
+
+  VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D;
+  if (vp->view_num > 1)
+    view_type = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+
   for (int i = 0; i < vp->image_num; i++)
     {
+      if (vp->is_dynamic
+          && create_scaled_image (vp, &vp->images[i], view_type))
+        return 1;
+
       VkImageViewCreateInfo view_ci = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .image = vp->images[i].image,
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .viewType = view_type,
         /* TODO(marceline-cramer): autoselect */
         .format = VK_FORMAT_B8G8R8A8_SRGB,
         .components = {
@@ -138,7 +635,7 @@ create_images (viewport_t *vp, VkRenderPass rp)
           .baseMipLevel = 0,
           .levelCount = 1,
           .baseArrayLayer = 0,
-          .layerCount = 1,
+          .layerCount = vp->view_num,
         },};
 
       if (vkCreateImageView (vp->vkd, &view_ci, NULL,
@@ -148,26 +645,86 @@ create_images (viewport_t *vp, VkRenderPass rp)
           LOG_ERR ("failed to create image view");
           return 1;
         }
+    }
 
-      VkFramebufferCreateInfo fb_ci = {
-        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-        .renderPass = rp,
-        .attachmentCount = 1,
-        .pAttachments = &vp->images[i].image_view,
-        .width = vp->width,
-        .height = vp->height,
-        .layers = 1,
-      };
+  return create_framebuffer (vp, rp);
+}
 
-      if (vkCreateFramebuffer (vp->vkd, &fb_ci, NULL,
-                               &vp->images[i].framebuffer)
-          != VK_SUCCESS)
+static void
+destroy_retired_swapchain (void *userdata)
+{
+  struct retired_swapchain *retired = userdata;
+
+  for (int i = 0; i < retired->image_num; i++)
+    {
+      if (retired->image_views[i])
+        vkDestroyImageView (retired->vkd, retired->image_views[i], NULL);
+
+      if (retired->scaled_views[i])
+        vkDestroyImageView (retired->vkd, retired->scaled_views[i], NULL);
+
+      if (retired->scaled_images[i])
+        vkDestroyImage (retired->vkd, retired->scaled_images[i], NULL);
+
+      gpu_memory_free (retired->tracker, retired->scaled_memories[i]);
+    }
+
+  if (retired->framebuffer)
+    vkDestroyFramebuffer (retired->vkd, retired->framebuffer, NULL);
+
+  if (retired->swapchain)
+    vkDestroySwapchainKHR (retired->vkd, retired->swapchain, NULL);
+
+  free (retired);
+}
+
+static int
+recreate_swapchain (viewport_t *vp)
+{
+  /* frames still in flight may use the old images, so instead of idling the
+   * device, destroy them once the last submitted frame finishes */
+  if (vp->swapchain != VK_NULL_HANDLE)
+    {
+      struct retired_swapchain *retired
+          = malloc (sizeof (struct retired_swapchain));
+      if (!retired)
+        return 1;
+
+      retired->vkd = vp->vkd;
+      retired->tracker = gpu_device_get_memory (vp->gpu);
+      retired->swapchain = vp->swapchain;
+      retired->image_num = vp->image_num;
+
+      for (int i = 0; i < vp->image_num; i++)
         {
-          LOG_ERR ("failed to create framebuffer");
-          return 1;
+          retired->image_views[i] = vp->images[i].image_view;
+          retired->scaled_images[i] = vp->images[i].scaled_image;
+          retired->scaled_memories[i] = vp->images[i].scaled_memory;
+          retired->scaled_views[i] = vp->images[i].scaled_view;
         }
+
+      retired->framebuffer = vp->framebuffer;
+      vp->framebuffer = VK_NULL_HANDLE;
+
+      gpu_timeline_t *timeline = gpu_device_get_timeline (vp->gpu);
+      gpu_timeline_defer (timeline, gpu_timeline_pending (timeline),
+                          destroy_retired_swapchain, retired);
     }
 
+  vp->image_num = 0;
+
+  /* the retired swapchain is still passed along so it can hand over */
+  int result = create_swapchain (vp);
+  if (result < 0)
+    vp->swapchain = VK_NULL_HANDLE;
+
+  if (result)
+    return 1;
+
+  if (create_images (vp, vp->rp))
+    return 1;
+
+  vp->needs_recreate = 0;
   return 0;
 }
 
@@ -201,12 +758,64 @@ viewport_new (viewport_t **new_vp, VkRenderPass rp,
   vp->gpu = config->gpu;
   vp->vkd = gpu_device_get (vp->gpu);
   vp->rp = rp;
+  vp->type = config->type;
+  vp->readback = 0;
+  vp->wants_dynamic = config->dynamic_resolution;
+  vp->is_dynamic = vp->wants_dynamic;
+  vp->render_scale = 1.0f;
+  vp->surface = VK_NULL_HANDLE;
   vp->swapchain = VK_NULL_HANDLE;
+  vp->present_mode = VIEWPORT_PRESENT_MODE_FIFO;
+  vp->requested_image_num = 0;
+  vp->needs_recreate = 0;
+  vp->is_copyable = 0;
+  vp->atlas = NULL;
+  vp->atlas_rect = (VkRect2D){ 0 };
   vp->width = config->width;
   vp->height = config->height;
+  vp->view_num = config->view_num > 0 ? config->view_num : 1;
+  vp->eye_separation = config->eye_separation;
+  vp->depth_format = config->depth_format;
+  vp->color_usage = 0;
+  vp->framebuffer = VK_NULL_HANDLE;
   vp->image_num = 0;
+  vp->image_index = -1;
   vp->image_acquire_index = -1;
 
+  for (int i = 0; i < MAX_IMAGE_NUM; i++)
+    {
+      struct vp_image *image = &vp->images[i];
+      image->image = VK_NULL_HANDLE;
+      image->image_view = VK_NULL_HANDLE;
+      image->memory = VK_NULL_HANDLE;
+      image->readback = NULL;
+      image->scaled_image = VK_NULL_HANDLE;
+      image->scaled_memory = VK_NULL_HANDLE;
+      image->scaled_view = VK_NULL_HANDLE;
+      image->frame_value = 0;
+    }
+
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    vp->on_image_acquire[i] = VK_NULL_HANDLE;
+
+  if (vp->view_num > MAX_VIEWPORT_VIEWS)
+    {
+      LOG_ERR ("viewports can have at most %d views", MAX_VIEWPORT_VIEWS);
+      return 1;
+    }
+
+  if (vp->view_num > 1 && vp->type != VIEWPORT_TYPE_OFFSCREEN)
+    {
+      LOG_ERR ("only offscreen viewports can have multiple views");
+      return 1;
+    }
+
+  if (vp->wants_dynamic && vp->type == VIEWPORT_TYPE_ATLAS)
+    {
+      LOG_ERR ("atlas viewports can't have dynamic resolution");
+      return 1;
+    }
+
   switch (config->type)
     {
     case VIEWPORT_TYPE_SURFACE:
@@ -215,6 +824,18 @@ viewport_new (viewport_t **new_vp, VkRenderPass rp,
           return 1;
         break;
       }
+    case VIEWPORT_TYPE_OFFSCREEN:
+      {
+        if (offscreen_init (vp, config))
+          return 1;
+        break;
+      }
+    case VIEWPORT_TYPE_ATLAS:
+      {
+        if (atlas_init (vp, config))
+          return 1;
+        break;
+      }
     default:
       {
         LOG_ERR ("unrecognized viewport type");
@@ -225,7 +846,7 @@ viewport_new (viewport_t **new_vp, VkRenderPass rp,
   if (create_images (vp, rp))
     return 1;
 
-  if (create_semaphores (vp))
+  if (vp->type == VIEWPORT_TYPE_SURFACE && create_semaphores (vp))
     return 1;
 
   return 0;
@@ -234,39 +855,134 @@ viewport_new (viewport_t **new_vp, VkRenderPass rp,
 void
 viewport_delete (viewport_t *vp)
 {
+  /* retired swapchains must go before their surface does */
+  if (vp->type == VIEWPORT_TYPE_SURFACE)
+    {
+      gpu_timeline_t *timeline = gpu_device_get_timeline (vp->gpu);
+      gpu_timeline_wait (timeline, gpu_timeline_pending (timeline),
+                         UINT64_MAX);
+      gpu_timeline_collect (timeline);
+    }
+
   for (int i = 0; i < vp->image_num; i++)
     {
-      vkDestroyImageView (vp->vkd, vp->images[i].image_view, NULL);
-      vkDestroyFramebuffer (vp->vkd, vp->images[i].framebuffer, NULL);
+      struct vp_image *image = &vp->images[i];
+
+      if (image->image_view)
+        vkDestroyImageView (vp->vkd, image->image_view, NULL);
+
+      if (image->scaled_view)
+        vkDestroyImageView (vp->vkd, image->scaled_view, NULL);
+
+      if (image->scaled_image)
+        vkDestroyImage (vp->vkd, image->scaled_image, NULL);
+
+      gpu_memory_free (gpu_device_get_memory (vp->gpu),
+                       image->scaled_memory);
+
+      /* swapchain images are owned by the swapchain */
+      if (vp->type == VIEWPORT_TYPE_OFFSCREEN)
+        {
+          if (image->image)
+            vkDestroyImage (vp->vkd, image->image, NULL);
+
+          gpu_memory_free (gpu_device_get_memory (vp->gpu), image->memory);
+
+          if (image->readback)
+            gpu_vector_delete (image->readback);
+        }
     }
 
+  if (vp->framebuffer)
+    vkDestroyFramebuffer (vp->vkd, vp->framebuffer, NULL);
+
   if (vp->swapchain)
     vkDestroySwapchainKHR (vp->vkd, vp->swapchain, NULL);
 
+  if (vp->atlas)
+    viewport_atlas_free (vp->atlas, &vp->atlas_rect);
+
   for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    vkDestroySemaphore (vp->vkd, vp->on_image_acquire[i], NULL);
+    {
+      if (vp->on_image_acquire[i])
+        vkDestroySemaphore (vp->vkd, vp->on_image_acquire[i], NULL);
+    }
 
   free (vp);
 }
 
+/* rewrites the depth terms so the near plane lands on one and the far plane
+ * on zero, which spreads float precision evenly over the depth range */
+static void
+reverse_depth (mat4 proj, float near, float far)
+{
+  proj[2][2] = near / (far - near);
+  proj[3][2] = near * far / (far - near);
+}
+
 void
 viewport_write_uniform (viewport_t *vp, viewport_uniform_t *ubo)
 {
   float aspect = ((float)vp->width) / vp->height;
-  glm_perspective (90.0, aspect, 0.1, 1000.0, ubo->projection_mat);
 
   vec3 eye = { 10.0, 10.0, 10.0 };
   vec3 center = { 0.0, 0.0, 0.0 };
   vec3 up = { 0.0, 1.0, 0.0 };
-  glm_lookat (eye, center, up, ubo->view_mat);
+
+  for (int i = 0; i < vp->view_num; i++)
+    {
+      viewport_view_t *view = &ubo->views[i];
+      glm_perspective (90.0, aspect, 0.1, 1000.0, view->projection_mat);
+      reverse_depth (view->projection_mat, 0.1, 1000.0);
+      glm_lookat (eye, center, up, view->view_mat);
+
+      if (vp->view_num == 1)
+        continue;
+
+      /* eyes are offset sideways in view space, left eye first */
+      float offset = vp->eye_separation * (i == 0 ? 0.5 : -0.5);
+      vec3 translation = { offset, 0.0, 0.0 };
+      mat4 eye_mat = GLM_MAT4_IDENTITY_INIT;
+      glm_translate (eye_mat, translation);
+      glm_mat4_mul (eye_mat, view->view_mat, view->view_mat);
+    }
 }
 
 int
-viewport_acquire (viewport_t *vp)
+viewport_acquire (viewport_t *vp, int frame_index)
 {
-  vp->image_acquire_index++;
-  if (vp->image_acquire_index >= MAX_FRAMES_IN_FLIGHT)
-    vp->image_acquire_index = 0;
+  /* the atlas's own viewport is acquired instead */
+  if (vp->type == VIEWPORT_TYPE_ATLAS)
+    return 1;
+
+  if (vp->type == VIEWPORT_TYPE_OFFSCREEN)
+    {
+      vp->image_index++;
+      if (vp->image_index >= vp->image_num)
+        vp->image_index = 0;
+
+      /* only blocks if there are fewer images than frames in flight */
+      gpu_timeline_t *timeline = gpu_device_get_timeline (vp->gpu);
+      uint64_t frame_value = vp->images[vp->image_index].frame_value;
+      if (gpu_timeline_wait (timeline, frame_value, UINT64_MAX))
+        {
+          LOG_ERR ("failed to wait for offscreen image");
+          return 0;
+        }
+
+      return 1;
+    }
+
+  if (vp->needs_recreate && recreate_swapchain (vp))
+    return 0;
+
+  if (frame_index < 0 || frame_index >= MAX_FRAMES_IN_FLIGHT)
+    {
+      LOG_ERR ("frame index %d is out of range", frame_index);
+      return 0;
+    }
+
+  vp->image_acquire_index = frame_index;
   VkSemaphore on_acquire = vp->on_image_acquire[vp->image_acquire_index];
 
   uint32_t image_index;
@@ -274,9 +990,31 @@ viewport_acquire (viewport_t *vp)
       = vkAcquireNextImageKHR (vp->vkd, vp->swapchain, UINT64_MAX, on_acquire,
                                VK_NULL_HANDLE, &image_index);
 
+  /* nothing was signaled, so recreate and try again right away */
+  if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+      if (recreate_swapchain (vp))
+        return 0;
+
+      result = vkAcquireNextImageKHR (vp->vkd, vp->swapchain, UINT64_MAX,
+                                      on_acquire, VK_NULL_HANDLE,
+                                      &image_index);
+    }
+
+  /* the image is still usable, so recreate after it's been presented */
+  if (result == VK_SUBOPTIMAL_KHR)
+    {
+      vp->needs_recreate = 1;
+      result = VK_SUCCESS;
+    }
+
   if (result != VK_SUCCESS)
     {
-      LOG_ERR ("failed to acquire swapchain image");
+      if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        vp->needs_recreate = 1;
+      else
+        LOG_ERR ("failed to acquire swapchain image");
+
       return 0;
     }
 
@@ -284,19 +1022,87 @@ viewport_acquire (viewport_t *vp)
   return 1;
 }
 
+enum viewport_type
+viewport_get_type (viewport_t *vp)
+{
+  return vp->type;
+}
+
+viewport_atlas_t *
+viewport_get_atlas (viewport_t *vp)
+{
+  return vp->atlas;
+}
+
+VkRect2D
+viewport_get_atlas_rect (viewport_t *vp)
+{
+  return vp->atlas_rect;
+}
+
+int
+viewport_get_view_num (viewport_t *vp)
+{
+  return vp->view_num;
+}
+
+VkExtent2D
+viewport_get_extent (viewport_t *vp)
+{
+  return (VkExtent2D){
+    .width = vp->width,
+    .height = vp->height,
+  };
+}
+
+VkExtent2D
+viewport_get_render_extent (viewport_t *vp)
+{
+  if (!vp->is_dynamic)
+    return viewport_get_extent (vp);
+
+  int width = vp->width * vp->render_scale + 0.5f;
+  int height = vp->height * vp->render_scale + 0.5f;
+
+  return (VkExtent2D){
+    .width = width > 0 ? width : 1,
+    .height = height > 0 ? height : 1,
+  };
+}
+
+void
+viewport_set_render_scale (viewport_t *vp, float scale)
+{
+  if (scale < MIN_RENDER_SCALE)
+    scale = MIN_RENDER_SCALE;
+  else if (scale > 1.0f)
+    scale = 1.0f;
+
+  vp->render_scale = scale;
+}
+
 VkSwapchainKHR
 viewport_get_swapchain (viewport_t *vp)
 {
   if (vp->image_acquire_index < 0)
-    return NULL;
+    return VK_NULL_HANDLE;
   else
     return vp->swapchain;
 }
 
+int
+viewport_owns_swapchain (viewport_t *vp, VkSwapchainKHR swapchain)
+{
+  return swapchain != VK_NULL_HANDLE && swapchain == vp->swapchain;
+}
+
 VkSemaphore
 viewport_get_on_acquire (viewport_t *vp)
 {
-  return vp->on_image_acquire[vp->image_acquire_index];
+  if (vp->image_acquire_index < 0)
+    return VK_NULL_HANDLE;
+  else
+    return vp->on_image_acquire[vp->image_acquire_index];
 }
 
 int
@@ -305,49 +1111,297 @@ viewport_get_image_index (viewport_t *vp)
   return vp->image_index;
 }
 
+VkRenderPass
+viewport_get_render_pass (viewport_t *vp)
+{
+  return vp->rp;
+}
+
+VkFramebuffer
+viewport_get_framebuffer (viewport_t *vp)
+{
+  return vp->framebuffer;
+}
+
+int
+viewport_get_depth_desc (viewport_t *vp, struct render_image_desc *desc)
+{
+  if (vp->depth_format == VK_FORMAT_UNDEFINED)
+    return 0;
+
+  *desc = (struct render_image_desc){
+    .format = vp->depth_format,
+    .width = vp->width,
+    .height = vp->height,
+    .layer_num = vp->view_num,
+    .usage = DEPTH_USAGE,
+    .aspect = VK_IMAGE_ASPECT_DEPTH_BIT,
+  };
+
+  return 1;
+}
+
 void
-viewport_begin_render_pass (viewport_t *vp, VkCommandBuffer cmd)
+viewport_begin_render_pass (viewport_t *vp, VkCommandBuffer cmd,
+                            VkImageView depth_view, VkSubpassContents contents)
 {
-  VkClearValue clear_value = { .color = { 0.0, 0.0, 0.0, 1.0 } };
+  const struct vp_image *image = &vp->images[vp->image_index];
+
+  /* dynamic resolution renders into the scaled image instead */
+  VkImageView attachments[2] = {
+    vp->is_dynamic ? image->scaled_view : image->image_view,
+    depth_view,
+  };
+
+  int has_depth = vp->depth_format != VK_FORMAT_UNDEFINED;
+
+  VkRenderPassAttachmentBeginInfo attachment_info = {
+    .sType = VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO,
+    .attachmentCount = has_depth ? 2 : 1,
+    .pAttachments = attachments,
+  };
+
+  /* reversed-Z, so the far plane is at zero */
+  VkClearValue clear_values[2] = {
+    { .color = { 0.0, 0.0, 0.0, 1.0 } },
+    { .depthStencil = { 0.0, 0 } },
+  };
+
+  VkExtent2D extent = viewport_get_render_extent (vp);
 
   VkRenderPassBeginInfo begin_info = {
     .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+    .pNext = &attachment_info,
     .renderPass = vp->rp,
-    .framebuffer = vp->images[vp->image_index].framebuffer,
+    .framebuffer = vp->framebuffer,
     .renderArea = {
       .offset = {
         .x = 0,
         .y = 0,
       },
-      .extent = {
-        .width = vp->width,
-        .height = vp->height,
-      },
+      .extent = extent,
     },
-    .clearValueCount = 1,
-    .pClearValues = &clear_value,
+    .clearValueCount = has_depth ? 2 : 1,
+    .pClearValues = clear_values,
   };
 
-  vkCmdBeginRenderPass (cmd, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass (cmd, &begin_info, contents);
+
+  /* secondaries don't inherit dynamic state, so they set their own */
+  if (contents == VK_SUBPASS_CONTENTS_INLINE)
+    viewport_set_dynamic_state (vp, cmd);
+}
+
+void
+viewport_set_dynamic_state (viewport_t *vp, VkCommandBuffer cmd)
+{
+  /* the scissor keeps atlas viewports from drawing over their neighbors */
+  VkRect2D scissor = {
+    .offset = vp->atlas_rect.offset,
+    .extent = viewport_get_render_extent (vp),
+  };
 
   VkViewport viewport = {
-    .x = 0,
-    .y = 0,
-    .width = vp->width,
-    .height = vp->height,
+    .x = scissor.offset.x,
+    .y = scissor.offset.y,
+    .width = scissor.extent.width,
+    .height = scissor.extent.height,
   };
 
-  VkRect2D scissor = {
-    .offset = {
-      .x = 0,
-      .y = 0,
+  vkCmdSetViewport (cmd, 0, 1, &viewport);
+  vkCmdSetScissor (cmd, 0, 1, &scissor);
+}
+
+VkImage
+viewport_get_image (viewport_t *vp)
+{
+  return vp->images[vp->image_index].image;
+}
+
+VkImage
+viewport_get_scaled_image (viewport_t *vp)
+{
+  if (!vp->is_dynamic)
+    return VK_NULL_HANDLE;
+
+  return vp->images[vp->image_index].scaled_image;
+}
+
+void
+viewport_record_upscale (viewport_t *vp, VkCommandBuffer cmd)
+{
+  if (!vp->is_dynamic)
+    return;
+
+  struct vp_image *image = &vp->images[vp->image_index];
+  VkExtent2D extent = viewport_get_render_extent (vp);
+
+  VkImageBlit region = {
+    .srcSubresource = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .mipLevel = 0,
+      .baseArrayLayer = 0,
+      .layerCount = vp->view_num,
     },
-    .extent = {
+    .srcOffsets = {
+      { 0, 0, 0 },
+      { extent.width, extent.height, 1 },
+    },
+    .dstSubresource = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .mipLevel = 0,
+      .baseArrayLayer = 0,
+      .layerCount = vp->view_num,
+    },
+    .dstOffsets = {
+      { 0, 0, 0 },
+      { vp->width, vp->height, 1 },
+    },
+  };
+
+  vkCmdBlitImage (cmd, image->scaled_image,
+                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image->image,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                  VK_FILTER_LINEAR);
+}
+
+VkBuffer
+viewport_get_readback_buffer (viewport_t *vp)
+{
+  if (!vp->readback)
+    return VK_NULL_HANDLE;
+
+  return gpu_vector_get (vp->images[vp->image_index].readback);
+}
+
+void
+viewport_record_readback (viewport_t *vp, VkCommandBuffer cmd)
+{
+  if (!vp->readback)
+    return;
+
+  struct vp_image *image = &vp->images[vp->image_index];
+  viewport_record_copy (vp, cmd, gpu_vector_get (image->readback));
+}
+
+int
+viewport_is_copyable (viewport_t *vp)
+{
+  switch (vp->type)
+    {
+    case VIEWPORT_TYPE_SURFACE:
+      return vp->is_copyable;
+    case VIEWPORT_TYPE_OFFSCREEN:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+void
+viewport_record_copy (viewport_t *vp, VkCommandBuffer cmd, VkBuffer dst)
+{
+  struct vp_image *image = &vp->images[vp->image_index];
+
+  VkBufferImageCopy region = {
+    .bufferOffset = 0,
+    .bufferRowLength = 0,
+    .bufferImageHeight = 0,
+    .imageSubresource = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .mipLevel = 0,
+      .baseArrayLayer = 0,
+      .layerCount = vp->view_num,
+    },
+    .imageOffset = { 0, 0, 0 },
+    .imageExtent = {
       .width = vp->width,
-      .height = vp->height
+      .height = vp->height,
+      .depth = 1,
     },
   };
 
-  vkCmdSetViewport (cmd, 0, 1, &viewport);
-  vkCmdSetScissor (cmd, 0, 1, &scissor);
+  vkCmdCopyImageToBuffer (cmd, image->image,
+                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, 1,
+                          &region);
+}
+
+void
+viewport_present_result (viewport_t *vp, VkResult result)
+{
+  if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
+    vp->needs_recreate = 1;
+  else if (result != VK_SUCCESS)
+    LOG_ERR ("failed to present viewport");
+}
+
+void
+viewport_abandon_image (viewport_t *vp)
+{
+  if (vp->type == VIEWPORT_TYPE_SURFACE)
+    vp->needs_recreate = 1;
+}
+
+int
+viewport_resize (viewport_t *vp, int width, int height)
+{
+  if (vp->type != VIEWPORT_TYPE_SURFACE)
+    {
+      LOG_ERR ("only surface viewports can be resized");
+      return 1;
+    }
+
+  if (width == vp->width && height == vp->height)
+    return 0;
+
+  vp->width = width;
+  vp->height = height;
+  vp->needs_recreate = 1;
+  return 0;
+}
+
+void
+viewport_mark_submitted (viewport_t *vp, uint64_t value)
+{
+  if (vp->image_index >= 0)
+    vp->images[vp->image_index].frame_value = value;
+}
+
+uint64_t
+viewport_read_pixels (viewport_t *vp, void *dst, size_t size)
+{
+  if (!vp->readback)
+    {
+      LOG_ERR ("viewport was not created with readback enabled");
+      return 0;
+    }
+
+  size_t image_size = vp->width * vp->height * 4 * vp->view_num;
+  if (size < image_size)
+    {
+      LOG_ERR ("pixel destination is too small");
+      return 0;
+    }
+
+  gpu_timeline_t *timeline = gpu_device_get_timeline (vp->gpu);
+
+  struct vp_image *latest = NULL;
+  for (int i = 0; i < vp->image_num; i++)
+    {
+      struct vp_image *image = &vp->images[i];
+      if (image->frame_value == 0
+          || !gpu_timeline_is_complete (timeline, image->frame_value))
+        continue;
+
+      if (!latest || image->frame_value > latest->frame_value)
+        latest = image;
+    }
+
+  if (!latest)
+    return 0;
+
+  if (gpu_vector_read (latest->readback, dst, image_size))
+    return 0;
+
+  return latest->frame_value;
 }
@@ -0,0 +1,185 @@
+/** @file viewport_atlas.c
+ */
+
+#include "renderer/viewport_atlas.h"
+
+#include "log.h"
+
+/* TODO(marceline-cramer): mdo_allocator */
+#include <stdlib.h> /* for mem alloc */
+
+#include <vulkan/vulkan_core.h>
+
+/* a row of regions sharing a height */
+struct shelf
+{
+  int y;
+  int height;
+  int cursor;
+  int region_num;
+};
+
+struct viewport_atlas_s
+{
+  viewport_t *vp;
+  int width;
+  int height;
+
+  struct shelf *shelves;
+  int shelf_num;
+  int shelf_capacity;
+
+  /* where the next shelf goes */
+  int shelf_top;
+};
+
+static struct shelf *
+add_shelf (viewport_atlas_t *atlas, int height)
+{
+  if (atlas->shelf_top + height > atlas->height)
+    return NULL;
+
+  if (atlas->shelf_num == atlas->shelf_capacity)
+    {
+      int capacity = atlas->shelf_capacity > 0 ? atlas->shelf_capacity * 2 : 8;
+      struct shelf *shelves
+          = realloc (atlas->shelves, capacity * sizeof (struct shelf));
+      if (!shelves)
+        return NULL;
+
+      atlas->shelves = shelves;
+      atlas->shelf_capacity = capacity;
+    }
+
+  struct shelf *shelf = &atlas->shelves[atlas->shelf_num++];
+  shelf->y = atlas->shelf_top;
+  shelf->height = height;
+  shelf->cursor = 0;
+  shelf->region_num = 0;
+
+  atlas->shelf_top += height;
+  return shelf;
+}
+
+int
+viewport_atlas_new (viewport_atlas_t **new_atlas, VkRenderPass rp,
+                    const struct viewport_atlas_config *config)
+{
+  viewport_atlas_t *atlas = malloc (sizeof (viewport_atlas_t));
+  *new_atlas = atlas;
+
+  atlas->vp = NULL;
+  atlas->width = config->width;
+  atlas->height = config->height;
+  atlas->shelves = NULL;
+  atlas->shelf_num = 0;
+  atlas->shelf_capacity = 0;
+  atlas->shelf_top = 0;
+
+  struct viewport_config vp_config = {
+    .gpu = config->gpu,
+    .type = VIEWPORT_TYPE_OFFSCREEN,
+    .width = config->width,
+    .height = config->height,
+    .depth_format = config->depth_format,
+
+    .sub = {
+      .offscreen = {
+        .image_num = config->image_num,
+        .readback = config->readback,
+      },
+    },
+  };
+
+  if (viewport_new (&atlas->vp, rp, &vp_config))
+    {
+      LOG_ERR ("failed to create atlas viewport");
+      return 1;
+    }
+
+  return 0;
+}
+
+void
+viewport_atlas_delete (viewport_atlas_t *atlas)
+{
+  if (atlas->vp)
+    viewport_delete (atlas->vp);
+
+  if (atlas->shelves)
+    free (atlas->shelves);
+
+  free (atlas);
+}
+
+int
+viewport_atlas_allocate (viewport_atlas_t *atlas, int width, int height,
+                         VkRect2D *rect)
+{
+  if (width <= 0 || height <= 0 || width > atlas->width)
+    {
+      LOG_ERR ("%dx%d region can't fit in atlas", width, height);
+      return 1;
+    }
+
+  /* the shortest shelf that fits wastes the least space */
+  struct shelf *best = NULL;
+  for (int i = 0; i < atlas->shelf_num; i++)
+    {
+      struct shelf *shelf = &atlas->shelves[i];
+      if (shelf->height < height || shelf->cursor + width > atlas->width)
+        continue;
+
+      if (!best || shelf->height < best->height)
+        best = shelf;
+    }
+
+  if (!best)
+    best = add_shelf (atlas, height);
+
+  if (!best)
+    {
+      LOG_ERR ("atlas is out of space for a %dx%d region", width, height);
+      return 1;
+    }
+
+  *rect = (VkRect2D){
+    .offset = {
+      .x = best->cursor,
+      .y = best->y,
+    },
+    .extent = {
+      .width = width,
+      .height = height,
+    },
+  };
+
+  best->cursor += width;
+  best->region_num++;
+  return 0;
+}
+
+void
+viewport_atlas_free (viewport_atlas_t *atlas, const VkRect2D *rect)
+{
+  for (int i = 0; i < atlas->shelf_num; i++)
+    {
+      struct shelf *shelf = &atlas->shelves[i];
+      if (shelf->y != rect->offset.y)
+        continue;
+
+      shelf->region_num--;
+      if (shelf->region_num == 0)
+        shelf->cursor = 0;
+
+      return;
+    }
+
+  LOG_WRN ("freeing a region that isn't in the atlas");
+}
+
+viewport_t *
+viewport_atlas_get_viewport (viewport_atlas_t *atlas)
+{
+  return atlas->vp;
+}
@@ -0,0 +1,860 @@
+/** @file mesh_cook.c
+ * Cooks Wavefront OBJ files into a mesh pack, the preprocessed format the
+ * mesh pass maps and uploads without any parsing. Each input file becomes
+ * one mesh with a chain of LODs, decimated by vertex clustering, and every
+ * LOD is split into meshlets with bounds for culling.
+ */
+
+#include <math.h>   /* for sqrtf, lroundf */
+#include <stdint.h> /* for uint32_t, int32_t */
+#include <stdio.h>  /* for FILE, fprintf */
+#include <stdlib.h> /* for mem alloc, strtol */
+#include <string.h> /* for strcmp, strtok */
+
+#include "renderer/mesh/mesh_pack_format.h"
+
+#define DEFAULT_LOD_NUM 4
+#define MAX_LOD_NUM 8
+
+/* the clustering grid of the first decimated LOD, halved for each after */
+#define FIRST_LOD_GRID 64
+
+#define LINE_SIZE 4096
+
+/* a growable array of fixed-size elements */
+struct array
+{
+  char *data;
+  size_t num;
+  size_t capacity;
+  size_t stride;
+};
+
+struct cook_vertex
+{
+  float position[3];
+  float normal[3];
+};
+
+/* one LOD's vertices and triangles, indexed from its first vertex */
+struct cook_lod
+{
+  struct array vertices;
+  struct array indices;
+  float error;
+};
+
+/* an OBJ face corner; normal is -1 if the file didn't give one */
+struct obj_corner
+{
+  int32_t position;
+  int32_t normal;
+};
+
+/* everything cooked so far, in the order it's written */
+struct cook_pack
+{
+  struct array meshes;
+  struct array lods;
+  struct array meshlets;
+  struct array vertices;
+  struct array indices;
+};
+
+static void
+array_init (struct array *arr, size_t stride)
+{
+  arr->data = NULL;
+  arr->num = 0;
+  arr->capacity = 0;
+  arr->stride = stride;
+}
+
+static void
+array_free (struct array *arr)
+{
+  free (arr->data);
+  array_init (arr, arr->stride);
+}
+
+/* cooking is all-or-nothing, so running out of memory just exits */
+static void *
+array_push (struct array *arr)
+{
+  if (arr->num == arr->capacity)
+    {
+      size_t capacity = arr->capacity > 0 ? arr->capacity * 2 : 64;
+      char *data = realloc (arr->data, capacity * arr->stride);
+      if (!data)
+        {
+          fprintf (stderr, "out of memory\n");
+          exit (1);
+        }
+
+      arr->data = data;
+      arr->capacity = capacity;
+    }
+
+  void *element = arr->data + arr->num * arr->stride;
+  memset (element, 0, arr->stride);
+  arr->num++;
+  return element;
+}
+
+static void *
+array_at (const struct array *arr, size_t index)
+{
+  return arr->data + index * arr->stride;
+}
+
+/* OBJ indices count from one, or back from the end if negative */
+static int
+resolve_index (long index, size_t num, int32_t *resolved)
+{
+  if (index > 0 && (size_t)index <= num)
+    {
+      *resolved = index - 1;
+      return 0;
+    }
+
+  if (index < 0 && (size_t)-index <= num)
+    {
+      *resolved = (int32_t)(num + index);
+      return 0;
+    }
+
+  return 1;
+}
+
+/* parses v, v/t, v//n, or v/t/n; texture coordinates are ignored */
+static int
+parse_corner (char *token, size_t position_num, size_t normal_num,
+              struct obj_corner *corner)
+{
+  char *end;
+  long position = strtol (token, &end, 10);
+  if (end == token || resolve_index (position, position_num,
+                                     &corner->position))
+    return 1;
+
+  corner->normal = -1;
+  if (*end != '/')
+    return 0;
+
+  strtol (end + 1, &end, 10);
+  if (*end != '/')
+    return 0;
+
+  char *normal_start = end + 1;
+  long normal = strtol (normal_start, &end, 10);
+  if (end == normal_start)
+    return 0;
+
+  return resolve_index (normal, normal_num, &corner->normal);
+}
+
+static int
+parse_vec3 (float *vec)
+{
+  for (int i = 0; i < 3; i++)
+    {
+      char *token = strtok (NULL, " \t\r\n");
+      if (!token)
+        return 1;
+
+      vec[i] = strtof (token, NULL);
+    }
+
+  return 0;
+}
+
+/* reads an OBJ's positions and normals, and its faces as fanned triangles
+ * of corners */
+static int
+read_obj (const char *path, struct array *positions, struct array *normals,
+          struct array *corners)
+{
+  FILE *file = fopen (path, "r");
+  if (!file)
+    {
+      fprintf (stderr, "failed to open %s\n", path);
+      return 1;
+    }
+
+  char line[LINE_SIZE];
+  int line_num = 0;
+  int result = 0;
+
+  while (!result && fgets (line, sizeof (line), file))
+    {
+      line_num++;
+
+      char *keyword = strtok (line, " \t\r\n");
+      if (!keyword)
+        continue;
+
+      if (strcmp (keyword, "v") == 0)
+        {
+          result = parse_vec3 (array_push (positions));
+        }
+      else if (strcmp (keyword, "vn") == 0)
+        {
+          result = parse_vec3 (array_push (normals));
+        }
+      else if (strcmp (keyword, "f") == 0)
+        {
+          struct obj_corner first = { 0 }, previous = { 0 }, corner;
+          int corner_num = 0;
+
+          char *token;
+          while ((token = strtok (NULL, " \t\r\n")))
+            {
+              if (parse_corner (token, positions->num, normals->num,
+                                &corner))
+                {
+                  result = 1;
+                  break;
+                }
+
+              if (corner_num == 0)
+                first = corner;
+
+              if (corner_num >= 2)
+                {
+                  const struct obj_corner triangle[3]
+                      = { first, previous, corner };
+                  for (int i = 0; i < 3; i++)
+                    {
+                      struct obj_corner *pushed = array_push (corners);
+                      *pushed = triangle[i];
+                    }
+                }
+
+              previous = corner;
+              corner_num++;
+            }
+        }
+
+      if (result)
+        fprintf (stderr, "%s:%d: malformed line\n", path, line_num);
+    }
+
+  fclose (file);
+  return result;
+}
+
+static void
+vec3_sub (const float *a, const float *b, float *out)
+{
+  for (int i = 0; i < 3; i++)
+    out[i] = a[i] - b[i];
+}
+
+static float
+vec3_length (const float *vec)
+{
+  return sqrtf (vec[0] * vec[0] + vec[1] * vec[1] + vec[2] * vec[2]);
+}
+
+static void
+vec3_normalize (float *vec)
+{
+  float length = vec3_length (vec);
+  if (length > 0.0f)
+    {
+      for (int i = 0; i < 3; i++)
+        vec[i] /= length;
+    }
+}
+
+static uint32_t
+hash_corner (const struct obj_corner *corner)
+{
+  uint32_t hash = (uint32_t)corner->position * 2654435761u;
+  return hash ^ ((uint32_t)corner->normal * 2246822519u);
+}
+
+/* merges identical corners into shared vertices. Corners without a normal
+ * get a smooth one, averaged over the faces sharing their position. */
+static void
+build_vertices (const struct array *positions, const struct array *normals,
+                const struct array *corners, struct cook_lod *lod)
+{
+  size_t table_size = 64;
+  while (table_size < corners->num * 2)
+    table_size *= 2;
+
+  struct obj_corner *keys = malloc (table_size * sizeof (struct obj_corner));
+  uint32_t *values = malloc (table_size * sizeof (uint32_t));
+  char *is_smooth = NULL;
+  if (!keys || !values)
+    {
+      fprintf (stderr, "out of memory\n");
+      exit (1);
+    }
+
+  for (size_t i = 0; i < table_size; i++)
+    keys[i].position = -1;
+
+  for (size_t i = 0; i < corners->num; i++)
+    {
+      const struct obj_corner *corner = array_at (corners, i);
+
+      size_t slot = hash_corner (corner) & (table_size - 1);
+      while (keys[slot].position >= 0
+             && (keys[slot].position != corner->position
+                 || keys[slot].normal != corner->normal))
+        slot = (slot + 1) & (table_size - 1);
+
+      if (keys[slot].position < 0)
+        {
+          keys[slot] = *corner;
+          values[slot] = lod->vertices.num;
+
+          struct cook_vertex *vertex = array_push (&lod->vertices);
+          memcpy (vertex->position, array_at (positions, corner->position),
+                  sizeof (vertex->position));
+
+          if (corner->normal >= 0)
+            memcpy (vertex->normal, array_at (normals, corner->normal),
+                    sizeof (vertex->normal));
+        }
+
+      uint32_t *index = array_push (&lod->indices);
+      *index = values[slot];
+    }
+
+  free (keys);
+  free (values);
+
+  is_smooth = calloc (lod->vertices.num + 1, 1);
+  if (!is_smooth)
+    {
+      fprintf (stderr, "out of memory\n");
+      exit (1);
+    }
+
+  for (size_t i = 0; i < corners->num; i++)
+    {
+      const struct obj_corner *corner = array_at (corners, i);
+      if (corner->normal < 0)
+        is_smooth[*(uint32_t *)array_at (&lod->indices, i)] = 1;
+    }
+
+  /* face normals are area-weighted by leaving the cross product unscaled */
+  const uint32_t *indices = (const uint32_t *)lod->indices.data;
+  for (size_t i = 0; i + 2 < lod->indices.num; i += 3)
+    {
+      struct cook_vertex *v[3];
+      for (int j = 0; j < 3; j++)
+        v[j] = array_at (&lod->vertices, indices[i + j]);
+
+      float edge_a[3], edge_b[3];
+      vec3_sub (v[1]->position, v[0]->position, edge_a);
+      vec3_sub (v[2]->position, v[0]->position, edge_b);
+
+      float face_normal[3] = {
+        edge_a[1] * edge_b[2] - edge_a[2] * edge_b[1],
+        edge_a[2] * edge_b[0] - edge_a[0] * edge_b[2],
+        edge_a[0] * edge_b[1] - edge_a[1] * edge_b[0],
+      };
+
+      for (int j = 0; j < 3; j++)
+        {
+          if (!is_smooth[indices[i + j]])
+            continue;
+
+          for (int k = 0; k < 3; k++)
+            v[j]->normal[k] += face_normal[k];
+        }
+    }
+
+  for (size_t i = 0; i < lod->vertices.num; i++)
+    {
+      struct cook_vertex *vertex = array_at (&lod->vertices, i);
+      vec3_normalize (vertex->normal);
+    }
+
+  free (is_smooth);
+}
+
+static void
+compute_bounds (const struct array *vertices, float *min, float *max)
+{
+  for (int i = 0; i < 3; i++)
+    {
+      min[i] = vertices->num > 0 ? INFINITY : 0.0f;
+      max[i] = vertices->num > 0 ? -INFINITY : 0.0f;
+    }
+
+  for (size_t i = 0; i < vertices->num; i++)
+    {
+      const struct cook_vertex *vertex = array_at (vertices, i);
+      for (int j = 0; j < 3; j++)
+        {
+          if (vertex->position[j] < min[j])
+            min[j] = vertex->position[j];
+          if (vertex->position[j] > max[j])
+            max[j] = vertex->position[j];
+        }
+    }
+}
+
+/* a sphere around the indexed vertices, centered on their bounding box */
+static void
+bound_sphere (const struct array *vertices, const uint32_t *indices,
+              size_t index_num, float *center, float *radius)
+{
+  float min[3] = { INFINITY, INFINITY, INFINITY };
+  float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+  for (size_t i = 0; i < index_num; i++)
+    {
+      const struct cook_vertex *vertex = array_at (vertices, indices[i]);
+      for (int j = 0; j < 3; j++)
+        {
+          if (vertex->position[j] < min[j])
+            min[j] = vertex->position[j];
+          if (vertex->position[j] > max[j])
+            max[j] = vertex->position[j];
+        }
+    }
+
+  *radius = 0.0f;
+  if (index_num == 0)
+    {
+      center[0] = center[1] = center[2] = 0.0f;
+      return;
+    }
+
+  for (int i = 0; i < 3; i++)
+    center[i] = (min[i] + max[i]) * 0.5f;
+
+  for (size_t i = 0; i < index_num; i++)
+    {
+      const struct cook_vertex *vertex = array_at (vertices, indices[i]);
+
+      float offset[3];
+      vec3_sub (vertex->position, center, offset);
+
+      float distance = vec3_length (offset);
+      if (distance > *radius)
+        *radius = distance;
+    }
+}
+
+struct cluster
+{
+  float position[3];
+  float normal[3];
+  uint32_t vertex_num;
+
+  /* the cluster's vertex in the decimated LOD, once it's referenced */
+  int32_t output;
+};
+
+/* merges every vertex in each cell of a grid into its average, dropping
+ * the triangles that collapse. Vertices move at most a cell's diagonal. */
+static void
+cluster_lod (const struct cook_lod *src, uint32_t grid, const float *min,
+             float cell_size, struct cook_lod *dst)
+{
+  size_t cell_num = (size_t)grid * grid * grid;
+  int32_t *cells = malloc (cell_num * sizeof (int32_t));
+  uint32_t *remap = malloc ((src->vertices.num + 1) * sizeof (uint32_t));
+  if (!cells || !remap)
+    {
+      fprintf (stderr, "out of memory\n");
+      exit (1);
+    }
+
+  for (size_t i = 0; i < cell_num; i++)
+    cells[i] = -1;
+
+  struct array clusters;
+  array_init (&clusters, sizeof (struct cluster));
+
+  for (size_t i = 0; i < src->vertices.num; i++)
+    {
+      const struct cook_vertex *vertex = array_at (&src->vertices, i);
+
+      size_t cell = 0;
+      for (int j = 0; j < 3; j++)
+        {
+          long coord = (long)((vertex->position[j] - min[j]) / cell_size);
+          if (coord < 0)
+            coord = 0;
+          if (coord >= (long)grid)
+            coord = grid - 1;
+
+          cell = cell * grid + coord;
+        }
+
+      if (cells[cell] < 0)
+        {
+          struct cluster *new_cluster = array_push (&clusters);
+          new_cluster->output = -1;
+          cells[cell] = clusters.num - 1;
+        }
+
+      struct cluster *cluster = array_at (&clusters, cells[cell]);
+      for (int j = 0; j < 3; j++)
+        {
+          cluster->position[j] += vertex->position[j];
+          cluster->normal[j] += vertex->normal[j];
+        }
+
+      cluster->vertex_num++;
+      remap[i] = cells[cell];
+    }
+
+  free (cells);
+
+  const uint32_t *indices = (const uint32_t *)src->indices.data;
+  for (size_t i = 0; i + 2 < src->indices.num; i += 3)
+    {
+      uint32_t a = remap[indices[i]];
+      uint32_t b = remap[indices[i + 1]];
+      uint32_t c = remap[indices[i + 2]];
+      if (a == b || b == c || c == a)
+        continue;
+
+      uint32_t triangle[3] = { a, b, c };
+      for (int j = 0; j < 3; j++)
+        {
+          struct cluster *cluster = array_at (&clusters, triangle[j]);
+
+          /* vertices are emitted in first-use order, for locality */
+          if (cluster->output < 0)
+            {
+              cluster->output = dst->vertices.num;
+
+              struct cook_vertex *vertex = array_push (&dst->vertices);
+              for (int k = 0; k < 3; k++)
+                {
+                  vertex->position[k]
+                      = cluster->position[k] / cluster->vertex_num;
+                  vertex->normal[k] = cluster->normal[k];
+                }
+
+              vec3_normalize (vertex->normal);
+            }
+
+          uint32_t *index = array_push (&dst->indices);
+          *index = cluster->output;
+        }
+    }
+
+  dst->error = cell_size * sqrtf (3.0f);
+
+  free (remap);
+  array_free (&clusters);
+}
+
+static uint32_t
+pack_normal (const float *normal)
+{
+  uint32_t packed = 0;
+  for (int i = 0; i < 3; i++)
+    {
+      float component = normal[i];
+      if (component < -1.0f)
+        component = -1.0f;
+      if (component > 1.0f)
+        component = 1.0f;
+
+      int8_t snorm = (int8_t)lroundf (component * 127.0f);
+      packed |= (uint32_t)(uint8_t)snorm << (i * 8);
+    }
+
+  return packed;
+}
+
+/* appends one LOD's vertices, indices, and meshlets to the pack */
+static void
+add_lod (struct cook_pack *pack, const struct cook_lod *lod)
+{
+  struct mesh_pack_lod *pack_lod = array_push (&pack->lods);
+  pack_lod->first_index = pack->indices.num;
+  pack_lod->index_num = lod->indices.num;
+  pack_lod->vertex_offset = pack->vertices.num;
+  pack_lod->first_meshlet = pack->meshlets.num;
+  pack_lod->error = lod->error;
+
+  for (size_t i = 0; i < lod->vertices.num; i++)
+    {
+      const struct cook_vertex *vertex = array_at (&lod->vertices, i);
+      struct mesh_pack_vertex *pack_vertex = array_push (&pack->vertices);
+      memcpy (pack_vertex->position, vertex->position,
+              sizeof (pack_vertex->position));
+      pack_vertex->normal = pack_normal (vertex->normal);
+    }
+
+  const uint32_t *indices = (const uint32_t *)lod->indices.data;
+  size_t triangle_num = lod->indices.num / 3;
+
+  for (size_t i = 0; i < triangle_num; i += MESH_PACK_MESHLET_TRIANGLES)
+    {
+      size_t meshlet_triangles = triangle_num - i;
+      if (meshlet_triangles > MESH_PACK_MESHLET_TRIANGLES)
+        meshlet_triangles = MESH_PACK_MESHLET_TRIANGLES;
+
+      struct mesh_pack_meshlet *meshlet = array_push (&pack->meshlets);
+      meshlet->first_index = pack_lod->first_index + i * 3;
+      meshlet->triangle_num = meshlet_triangles;
+      bound_sphere (&lod->vertices, &indices[i * 3], meshlet_triangles * 3,
+                    meshlet->center, &meshlet->radius);
+
+      pack_lod->meshlet_num++;
+    }
+
+  for (size_t i = 0; i < lod->indices.num; i++)
+    {
+      uint32_t *index = array_push (&pack->indices);
+      *index = indices[i];
+    }
+}
+
+static void
+free_lod (struct cook_lod *lod)
+{
+  array_free (&lod->vertices);
+  array_free (&lod->indices);
+}
+
+static int
+cook_mesh (struct cook_pack *pack, const char *path, int lod_num)
+{
+  struct array positions, normals, corners;
+  array_init (&positions, sizeof (float[3]));
+  array_init (&normals, sizeof (float[3]));
+  array_init (&corners, sizeof (struct obj_corner));
+
+  int result = read_obj (path, &positions, &normals, &corners);
+
+  struct cook_lod full;
+  array_init (&full.vertices, sizeof (struct cook_vertex));
+  array_init (&full.indices, sizeof (uint32_t));
+  full.error = 0.0f;
+
+  if (!result)
+    build_vertices (&positions, &normals, &corners, &full);
+
+  array_free (&positions);
+  array_free (&normals);
+  array_free (&corners);
+
+  if (result)
+    return 1;
+
+  struct mesh_pack_mesh *mesh = array_push (&pack->meshes);
+  mesh->first_lod = pack->lods.num;
+  bound_sphere (&full.vertices, (const uint32_t *)full.indices.data,
+                full.indices.num, mesh->center, &mesh->radius);
+
+  add_lod (pack, &full);
+  mesh->lod_num = 1;
+
+  float min[3], max[3];
+  compute_bounds (&full.vertices, min, max);
+
+  float extent = 0.0f;
+  for (int i = 0; i < 3; i++)
+    {
+      if (max[i] - min[i] > extent)
+        extent = max[i] - min[i];
+    }
+
+  /* each LOD is decimated from the full mesh, so errors don't compound */
+  size_t previous_index_num = full.indices.num;
+  uint32_t grid = FIRST_LOD_GRID;
+  for (int i = 1; i < lod_num && grid > 0 && extent > 0.0f; i++, grid /= 2)
+    {
+      struct cook_lod lod;
+      array_init (&lod.vertices, sizeof (struct cook_vertex));
+      array_init (&lod.indices, sizeof (uint32_t));
+
+      cluster_lod (&full, grid, min, extent / grid, &lod);
+
+      /* coarser grids would only lose the mesh or change nothing */
+      int is_useful = lod.indices.num > 0
+                      && lod.indices.num < previous_index_num;
+      if (is_useful)
+        {
+          add_lod (pack, &lod);
+          mesh->lod_num++;
+          previous_index_num = lod.indices.num;
+        }
+
+      free_lod (&lod);
+      if (!is_useful)
+        break;
+    }
+
+  fprintf (stderr, "%s: %zu vertices, %zu triangles, %u LODs\n", path,
+           full.vertices.num, full.indices.num / 3, mesh->lod_num);
+
+  free_lod (&full);
+  return 0;
+}
+
+static uint64_t
+align_offset (uint64_t offset)
+{
+  return (offset + MESH_PACK_ALIGNMENT - 1)
+         & ~(uint64_t)(MESH_PACK_ALIGNMENT - 1);
+}
+
+/* places a section at the next aligned offset after the previous one */
+static void
+layout_section (struct mesh_pack_section *section, const struct array *arr,
+                uint64_t *offset)
+{
+  section->offset = align_offset (*offset);
+  section->size = arr->num * arr->stride;
+  *offset = section->offset + section->size;
+}
+
+static int
+write_section (FILE *file, const struct mesh_pack_section *section,
+               const struct array *arr, uint64_t *offset)
+{
+  static const char ZEROES[MESH_PACK_ALIGNMENT] = { 0 };
+
+  size_t padding = section->offset - *offset;
+  if (padding > 0 && fwrite (ZEROES, 1, padding, file) != padding)
+    return 1;
+
+  if (section->size > 0
+      && fwrite (arr->data, 1, section->size, file) != section->size)
+    return 1;
+
+  *offset = section->offset + section->size;
+  return 0;
+}
+
+static int
+write_pack (const struct cook_pack *pack, const char *path)
+{
+  struct mesh_pack_header header = {
+    .magic = MESH_PACK_MAGIC,
+    .version = MESH_PACK_VERSION,
+    .mesh_num = pack->meshes.num,
+    .lod_num = pack->lods.num,
+    .meshlet_num = pack->meshlets.num,
+    .vertex_num = pack->vertices.num,
+    .index_num = pack->indices.num,
+  };
+
+  uint64_t offset = sizeof (header);
+  layout_section (&header.meshes, &pack->meshes, &offset);
+  layout_section (&header.lods, &pack->lods, &offset);
+  layout_section (&header.meshlets, &pack->meshlets, &offset);
+  layout_section (&header.vertices, &pack->vertices, &offset);
+  layout_section (&header.indices, &pack->indices, &offset);
+
+  FILE *file = fopen (path, "wb");
+  if (!file)
+    {
+      fprintf (stderr, "failed to open %s for writing\n", path);
+      return 1;
+    }
+
+  offset = sizeof (header);
+  int result = fwrite (&header, sizeof (header), 1, file) != 1
+               || write_section (file, &header.meshes, &pack->meshes, &offset)
+               || write_section (file, &header.lods, &pack->lods, &offset)
+               || write_section (file, &header.meshlets, &pack->meshlets,
+                                 &offset)
+               || write_section (file, &header.vertices, &pack->vertices,
+                                 &offset)
+               || write_section (file, &header.indices, &pack->indices,
+                                 &offset);
+
+  if (fclose (file) != 0)
+    result = 1;
+
+  if (result)
+    fprintf (stderr, "failed to write %s\n", path);
+
+  return result;
+}
+
+static void
+print_help (const char *argv0)
+{
+  fprintf (stderr,
+           "Usage\n  %s -o <path> [--lods <num>] <mesh.obj>...\n"
+           "\n"
+           "  -o <path>        Write the mesh pack here.\n"
+           "  --lods <num>     Cook up to this many LODs per mesh, from 1 "
+           "to %d.\n"
+           "                   Defaults to %d.\n",
+           argv0, MAX_LOD_NUM, DEFAULT_LOD_NUM);
+}
+
+int
+main (int argc, const char *argv[])
+{
+  const char *out_path = NULL;
+  int lod_num = DEFAULT_LOD_NUM;
+
+  const char **inputs = malloc (argc * sizeof (const char *));
+  int input_num = 0;
+  if (!inputs)
+    return 1;
+
+  for (int i = 1; i < argc; i++)
+    {
+      const char *arg = argv[i];
+
+      if (strcmp (arg, "-o") == 0 && i + 1 < argc)
+        {
+          out_path = argv[++i];
+        }
+      else if (strcmp (arg, "--lods") == 0 && i + 1 < argc)
+        {
+          lod_num = atoi (argv[++i]);
+        }
+      else if (arg[0] == '-')
+        {
+          print_help (argv[0]);
+          free (inputs);
+          return 1;
+        }
+      else
+        {
+          inputs[input_num++] = arg;
+        }
+    }
+
+  if (!out_path || input_num == 0 || lod_num < 1 || lod_num > MAX_LOD_NUM)
+    {
+      print_help (argv[0]);
+      free (inputs);
+      return 1;
+    }
+
+  struct cook_pack pack;
+  array_init (&pack.meshes, sizeof (struct mesh_pack_mesh));
+  array_init (&pack.lods, sizeof (struct mesh_pack_lod));
+  array_init (&pack.meshlets, sizeof (struct mesh_pack_meshlet));
+  array_init (&pack.vertices, sizeof (struct mesh_pack_vertex));
+  array_init (&pack.indices, sizeof (uint32_t));
+
+  int result = 0;
+  for (int i = 0; i < input_num && !result; i++)
+    result = cook_mesh (&pack, inputs[i], lod_num);
+
+  if (!result)
+    result = write_pack (&pack, out_path);
+
+  array_free (&pack.meshes);
+  array_free (&pack.lods);
+  array_free (&pack.meshlets);
+  array_free (&pack.vertices);
+  array_free (&pack.indices);
+  free (inputs);
+
+  return result;
+}